@@ -0,0 +1,117 @@
+#include "broadcast_group.hpp"
+
+BroadcastGroup::BroadcastGroup(TCPConnectionManager& tcpConnMgr) : m_tcpConnMgr(tcpConnMgr)
+{
+    m_closedConnection = m_tcpConnMgr.connectionClosed.connect([this](TCPConnInfo connInfo) { unsubscribe(connInfo); });
+}
+
+BroadcastGroup::~BroadcastGroup()
+{
+    m_closedConnection.disconnect();
+}
+
+bool BroadcastGroup::subscribe(ConnHandle handle)
+{
+    const auto conn = m_tcpConnMgr.getConnectionDirect(handle);
+    if (!conn) return false;
+    // the registered generation, in case the handle came with the wildcard one
+    const ConnHandle registered = conn->connInfo().handle();
+    const SOCKET sockfd = registered.sockfd();
+
+    {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_members.find(sockfd);
+        if (it != m_members.end()) {
+            if (it->second.generation == registered.generation()) return true;
+            // an earlier connection on the descriptor whose connectionClosed hasn't come through yet
+            removeMember(it);
+        }
+
+        std::shared_ptr<Bucket> bucket;
+        for (const auto& candidate : m_buckets) {
+            if (&candidate->loop == &conn->eventLoop()) bucket = candidate;
+        }
+        if (!bucket) bucket = m_buckets.emplace_back(std::make_shared<Bucket>(conn->eventLoop()));
+
+        std::lock_guard bucketLock(bucket->mutex);
+        bucket->members.emplace(sockfd, conn);
+        m_members.emplace(sockfd, Membership{registered.generation(), bucket});
+        if (m_writeLimits) conn->setWriteBufferLimits(*m_writeLimits);
+    }
+
+    // Closed between the lookup and now: its connectionClosed may have come before the subscription. Checked
+    // without holding m_mutex, which the connectionClosed slot takes.
+    if (m_tcpConnMgr.getConnectionDirect(registered) != conn) {
+        unsubscribe(registered);
+        return false;
+    }
+    return true;
+}
+
+void BroadcastGroup::unsubscribe(ConnHandle handle)
+{
+    std::lock_guard lock(m_mutex);
+    const auto it = m_members.find(handle.sockfd());
+    if (it == m_members.end()) return;
+    if (handle.generation() != 0 && handle.generation() != it->second.generation) return;
+    removeMember(it);
+}
+
+void BroadcastGroup::removeMember(std::unordered_map<SOCKET, Membership>::iterator it)
+{
+    {
+        std::lock_guard bucketLock(it->second.bucket->mutex);
+        it->second.bucket->members.erase(it->first);
+    }
+    m_members.erase(it);
+}
+
+std::size_t BroadcastGroup::size() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_members.size();
+}
+
+void BroadcastGroup::setWriteBufferLimits(const WriteBufferLimits& limits)
+{
+    std::lock_guard lock(m_mutex);
+    m_writeLimits = limits;
+    for (const auto& bucket : m_buckets) {
+        std::lock_guard bucketLock(bucket->mutex);
+        for (const auto& member : bucket->members) member.second->setWriteBufferLimits(limits);
+    }
+}
+
+std::size_t BroadcastGroup::publish(std::string message)
+{
+    return publish(std::make_shared<const std::string>(std::move(message)));
+}
+
+std::size_t BroadcastGroup::publish(SharedBuffer message)
+{
+    if (!message) return 0;
+
+    std::vector<std::shared_ptr<Bucket>> buckets;
+    std::size_t subscribers;
+    {
+        std::lock_guard lock(m_mutex);
+        buckets = m_buckets;
+        subscribers = m_members.size();
+    }
+
+    for (const auto& bucket : buckets) {
+        bucket->loop.post([&tcpConnMgr = m_tcpConnMgr, bucket, message]() {
+            // copied, so a send failure closing a connection (and unsubscribing it) doesn't find the bucket locked
+            std::vector<std::shared_ptr<TCPConnection>> members;
+            {
+                std::lock_guard lock(bucket->mutex);
+                members.reserve(bucket->members.size());
+                for (const auto& member : bucket->members) members.push_back(member.second);
+            }
+            for (const auto& conn : members) {
+                if (!conn->socketClosed()) tcpConnMgr.enqueueOutbound(conn, message);
+            }
+        });
+    }
+    return subscribers;
+}
@@ -0,0 +1,176 @@
+#include "connection_registry.hpp"
+
+#include "tcp_connection.hpp"
+
+namespace
+{
+std::atomic<std::size_t> g_nextStripe{0};
+// threads are spread over the stripes round-robin, in the order they first read a registry
+thread_local const std::size_t t_stripe = g_nextStripe++;
+} // namespace
+
+ConnectionRegistry::ReadGuard::ReadGuard(const ConnectionRegistry& registry)
+    : m_count(registry.m_readers[t_stripe % stripeCount].count[registry.m_epoch.load(std::memory_order_seq_cst) & 1])
+{
+    m_count.fetch_add(1, std::memory_order_seq_cst);
+}
+
+ConnectionRegistry::ReadGuard::~ReadGuard()
+{
+    m_count.fetch_sub(1, std::memory_order_release);
+}
+
+ConnectionRegistry::ConnectionRegistry() = default;
+
+ConnectionRegistry::~ConnectionRegistry()
+{
+    for (auto& page : m_pages) {
+        Page* p = page.load();
+        if (!p) continue;
+        for (auto& slot : p->slots) delete slot.load();
+        delete p;
+    }
+    for (Entry* entry : m_retiring) delete entry;
+    for (Entry* entry : m_waiting) delete entry;
+}
+
+bool ConnectionRegistry::inTable(SOCKET sockfd)
+{
+    return (std::size_t)sockfd < pageSize * pageCount;
+}
+
+std::atomic<ConnectionRegistry::Entry*>* ConnectionRegistry::slotFor(SOCKET sockfd) const
+{
+    Page* page = m_pages[(std::size_t)sockfd >> pageBits].load(std::memory_order_acquire);
+    return page ? &page->slots[(std::size_t)sockfd & (pageSize - 1)] : nullptr;
+}
+
+bool ConnectionRegistry::insert(SOCKET sockfd, uint32_t generation, Value conn)
+{
+    if (!inTable(sockfd)) {
+        std::lock_guard lock(m_overflowMutex);
+        if (!m_overflow.emplace(sockfd, Entry{std::move(conn), generation}).second) return false;
+        ++m_size;
+        return true;
+    }
+
+    std::lock_guard lock(m_writeMutex);
+    auto& page = m_pages[(std::size_t)sockfd >> pageBits];
+    if (!page.load(std::memory_order_relaxed)) page.store(new Page, std::memory_order_release);
+
+    std::atomic<Entry*>* slot = slotFor(sockfd);
+    if (slot->load(std::memory_order_relaxed)) return false;
+    slot->store(new Entry{std::move(conn), generation}, std::memory_order_seq_cst);
+    ++m_size;
+    reclaim();
+    return true;
+}
+
+ConnectionRegistry::Value ConnectionRegistry::erase(SOCKET sockfd, uint32_t generation)
+{
+    if (!inTable(sockfd)) {
+        std::lock_guard lock(m_overflowMutex);
+        const auto it = m_overflow.find(sockfd);
+        if (it == m_overflow.end() || !it->second.matches(generation)) return nullptr;
+        Value conn = std::move(it->second.conn);
+        m_overflow.erase(it);
+        --m_size;
+        return conn;
+    }
+
+    std::lock_guard lock(m_writeMutex);
+    // entries only change under the writer mutex, so the one checked is the one swapped out
+    std::atomic<Entry*>* slot = slotFor(sockfd);
+    Entry* entry = slot ? slot->load(std::memory_order_relaxed) : nullptr;
+    if (!entry || !entry->matches(generation)) return nullptr;
+    slot->store(nullptr, std::memory_order_seq_cst);
+
+    // readers may still be copying the shared_ptr out of the entry, so it is only retired
+    Value conn = entry->conn;
+    --m_size;
+    retire(entry);
+    reclaim();
+    return conn;
+}
+
+ConnectionRegistry::Value ConnectionRegistry::find(SOCKET sockfd, uint32_t generation) const
+{
+    if (!inTable(sockfd)) {
+        std::lock_guard lock(m_overflowMutex);
+        const auto it = m_overflow.find(sockfd);
+        return it != m_overflow.end() && it->second.matches(generation) ? it->second.conn : nullptr;
+    }
+
+    std::atomic<Entry*>* slot = slotFor(sockfd);
+    if (!slot) return nullptr;
+    const ReadGuard guard(*this);
+    const Entry* entry = slot->load(std::memory_order_seq_cst);
+    return entry && entry->matches(generation) ? entry->conn : nullptr;
+}
+
+bool ConnectionRegistry::contains(SOCKET sockfd, uint32_t generation) const
+{
+    if (!inTable(sockfd)) {
+        std::lock_guard lock(m_overflowMutex);
+        const auto it = m_overflow.find(sockfd);
+        return it != m_overflow.end() && it->second.matches(generation);
+    }
+
+    std::atomic<Entry*>* slot = slotFor(sockfd);
+    if (!slot) return false;
+    if (generation == anyGeneration) {
+        // only the pointer is looked at, never dereferenced, so no guard is needed
+        return slot->load(std::memory_order_acquire) != nullptr;
+    }
+    const ReadGuard guard(*this);
+    const Entry* entry = slot->load(std::memory_order_seq_cst);
+    return entry && entry->matches(generation);
+}
+
+std::vector<ConnectionRegistry::Value> ConnectionRegistry::snapshot() const
+{
+    std::vector<Value> conns;
+    conns.reserve(size());
+    {
+        // entries are only freed under the writer mutex
+        std::lock_guard lock(m_writeMutex);
+        for (const auto& page : m_pages) {
+            const Page* p = page.load(std::memory_order_acquire);
+            if (!p) continue;
+            for (const auto& slot : p->slots) {
+                if (const Entry* entry = slot.load(std::memory_order_acquire)) conns.push_back(entry->conn);
+            }
+        }
+    }
+
+    std::lock_guard lock(m_overflowMutex);
+    for (const auto& [sockfd, entry] : m_overflow) conns.push_back(entry.conn);
+    return conns;
+}
+
+std::size_t ConnectionRegistry::size() const
+{
+    return m_size;
+}
+
+void ConnectionRegistry::retire(Entry* entry)
+{
+    m_retiring.push_back(entry);
+}
+
+void ConnectionRegistry::reclaim()
+{
+    // Readers counted under the previous parity may have seen anything retired before the last flip. Once they
+    // are gone that batch is unreachable: readers arriving later already see the slots cleared.
+    const std::size_t previous = (m_epoch.load(std::memory_order_relaxed) & 1) ^ 1;
+    for (const auto& stripe : m_readers) {
+        if (stripe.count[previous].load(std::memory_order_seq_cst) != 0) return;
+    }
+
+    for (Entry* entry : m_waiting) delete entry;
+    m_waiting.clear();
+    if (m_retiring.empty()) return;
+
+    m_waiting.swap(m_retiring);
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+}
@@ -0,0 +1,228 @@
+#include "delimiter_codec.hpp"
+
+#include <bit>
+#include <cstring>
+#include <format>
+#include <iostream>
+
+#include "cpu_features.hpp"
+
+namespace
+{
+void appendMatches(uint64_t mask, std::size_t base, std::vector<std::size_t>& positions)
+{
+    while (mask) {
+        positions.push_back(base + std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+}
+
+void findTail(const char* data, std::size_t from, std::size_t size, char delimiter, std::vector<std::size_t>& positions)
+{
+    for (std::size_t i = from; i < size; ++i) {
+        if (data[i] == delimiter) positions.push_back(i);
+    }
+}
+
+void findScalar(const char* data, std::size_t size, char delimiter, std::vector<std::size_t>& positions)
+{
+    const char* const end = data + size;
+    for (const char* pos = data; pos < end; ++pos) {
+        pos = static_cast<const char*>(std::memchr(pos, delimiter, end - pos));
+        if (!pos) break;
+        positions.push_back(pos - data);
+    }
+}
+
+#ifdef SIMD_X86
+void findSse2(const char* data, std::size_t size, char delimiter, std::vector<std::size_t>& positions)
+{
+    const __m128i needle = _mm_set1_epi8(delimiter);
+    auto compare = [&](std::size_t at) {
+        return _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + at)), needle);
+    };
+    std::size_t i = 0;
+    // four compares per round, and one test of all of them, so sparse delimiters cost one branch per 64 bytes
+    for (; i + 64 <= size; i += 64) {
+        const __m128i a = compare(i), b = compare(i + 16), c = compare(i + 32), d = compare(i + 48);
+        if (!_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) continue;
+        const uint64_t mask = (uint64_t)(uint32_t)_mm_movemask_epi8(a) |
+                              ((uint64_t)(uint32_t)_mm_movemask_epi8(b) << 16) |
+                              ((uint64_t)(uint32_t)_mm_movemask_epi8(c) << 32) |
+                              ((uint64_t)(uint32_t)_mm_movemask_epi8(d) << 48);
+        appendMatches(mask, i, positions);
+    }
+    for (; i + 16 <= size; i += 16) appendMatches((uint32_t)_mm_movemask_epi8(compare(i)), i, positions);
+    findTail(data, i, size, delimiter, positions);
+}
+
+SIMD_AVX2_TARGET
+void findAvx2(const char* data, std::size_t size, char delimiter, std::vector<std::size_t>& positions)
+{
+    const __m256i needle = _mm256_set1_epi8(delimiter);
+    auto compare = [&](std::size_t at) SIMD_AVX2_TARGET {
+        return _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + at)), needle);
+    };
+    auto matches = [](__m256i low, __m256i high) SIMD_AVX2_TARGET {
+        return (uint64_t)(uint32_t)_mm256_movemask_epi8(low) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(high) << 32);
+    };
+    std::size_t i = 0;
+    // as with SSE2: four compares per round and one test of all of them, here per 128 bytes
+    for (; i + 128 <= size; i += 128) {
+        const __m256i a = compare(i), b = compare(i + 32), c = compare(i + 64), d = compare(i + 96);
+        if (_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)), _mm256_set1_epi8(-1))) {
+            continue;
+        }
+        appendMatches(matches(a, b), i, positions);
+        appendMatches(matches(c, d), i + 64, positions);
+    }
+    for (; i + 32 <= size; i += 32) appendMatches((uint32_t)_mm256_movemask_epi8(compare(i)), i, positions);
+    findTail(data, i, size, delimiter, positions);
+}
+#endif // SIMD_X86
+} // namespace
+
+DelimiterScanner::DelimiterScanner(char delimiter, Kernel kernel) : m_delimiter(delimiter), m_find(findScalar)
+{
+    if (!simdKernelAvailable(kernel)) {
+        std::cerr << std::format("{} delimiter scanning isn't available on this CPU; using {}\n",
+                                 simdKernelName(kernel), simdKernelName(bestSimdKernel()));
+        kernel = bestSimdKernel();
+    }
+    m_kernel = kernel;
+#ifdef SIMD_X86
+    if (kernel == Kernel::Avx2) m_find = findAvx2;
+    else if (kernel == Kernel::Sse2) m_find = findSse2;
+#endif
+}
+
+void DelimiterScanner::findAll(std::string_view data, std::vector<std::size_t>& positions) const
+{
+    m_find(data.data(), data.size(), m_delimiter, positions);
+}
+
+DelimiterDecoder::DelimiterDecoder(DelimiterCodecOptions options, DelimiterScanner::Kernel kernel)
+    : m_options(options), m_scanner(options.delimiter, kernel)
+{}
+
+bool DelimiterDecoder::split(std::string_view data)
+{
+    m_records.clear();
+    m_positions.clear();
+    m_scanner.findAll(data, m_positions);
+
+    if (m_positions.empty()) {
+        // the whole chunk continues the pending record
+        if (m_partial.size() + data.size() > m_options.maxRecordSize) return false;
+        m_partial.append(data);
+        m_tail = {};
+        m_tailComplete = false;
+        return true;
+    }
+
+    std::size_t start = 0;
+    for (const std::size_t pos : m_positions) {
+        std::string_view record = data.substr(start, pos - start);
+        if (start == 0 && !m_partial.empty()) {
+            if (m_partial.size() + record.size() > m_options.maxRecordSize) return false;
+            m_partial.append(record);
+            record = m_partial;
+        } else if (record.size() > m_options.maxRecordSize) {
+            return false;
+        }
+        if (m_options.trimCarriageReturn && !record.empty() && record.back() == '\r') record.remove_suffix(1);
+        m_records.push_back(record);
+        start = pos + 1;
+    }
+
+    m_tail = data.substr(start);
+    m_tailComplete = true;
+    return m_tail.size() <= m_options.maxRecordSize;
+}
+
+void DelimiterDecoder::keepTail()
+{
+    if (!m_tailComplete) return;
+    m_partial.assign(m_tail);
+    m_tail = {};
+    m_tailComplete = false;
+}
+
+struct DelimiterCodec::Attachment {
+    Attachment(const TCPConnInfo& connInfo, const DelimiterCodecOptions& options)
+        : connInfo(connInfo), decoder(options)
+    {}
+
+    const TCPConnInfo connInfo;
+    ScopedEventConnection dataConnection;
+
+    // only touched by the connection's event loop
+    DelimiterDecoder decoder;
+};
+
+DelimiterCodec::DelimiterCodec(TCPConnectionManager& tcpConnMgr, DelimiterCodecOptions options)
+    : m_tcpConnMgr(tcpConnMgr), m_options(options), m_attachments(tcpConnMgr)
+{
+}
+
+DelimiterCodec::~DelimiterCodec()
+{
+    m_attachments.clear();
+}
+
+bool DelimiterCodec::attach(ConnHandle handle)
+{
+    return m_attachments.attach(
+        handle,
+        [this](const TCPConnInfo& connInfo, TCPConnection&) { return std::make_shared<Attachment>(connInfo, m_options); },
+        [this](Attachment& attachment, const RecvBuffer& buffer) { onData(attachment, buffer); });
+}
+
+void DelimiterCodec::detach(ConnHandle handle)
+{
+    m_attachments.detach(handle);
+}
+
+std::size_t DelimiterCodec::attachedCount() const
+{
+    return m_attachments.size();
+}
+
+bool DelimiterCodec::send(ConnHandle handle, std::string_view record)
+{
+    return send(handle, std::span<const std::string_view>(&record, 1));
+}
+
+bool DelimiterCodec::send(ConnHandle handle, std::span<const std::string_view> records)
+{
+    std::size_t total = 0;
+    for (const auto& record : records) {
+        if (record.find(m_options.delimiter) != std::string_view::npos) {
+            std::cerr << "record contains the delimiter; not sent\n";
+            return false;
+        }
+        total += record.size() + 1;
+    }
+
+    std::string message;
+    message.reserve(total);
+    for (const auto& record : records) {
+        message.append(record);
+        message.push_back(m_options.delimiter);
+    }
+    return m_tcpConnMgr.write(handle, std::move(message));
+}
+
+void DelimiterCodec::onData(Attachment& attachment, const RecvBuffer& buffer)
+{
+    const bool ok = attachment.decoder.feed(buffer.view(), [&](std::span<const std::string_view> records) {
+        m_recordsDelivered += records.size();
+        ++m_batchesDelivered;
+        recordsArrived(attachment.connInfo, records);
+    });
+    if (!ok) {
+        std::cerr << std::format("record above {} bytes on socket {}; closing connection!\n", m_options.maxRecordSize,
+                                 attachment.connInfo.sockfd);
+        m_tcpConnMgr.closeConn(attachment.connInfo);
+    }
+}
@@ -0,0 +1,236 @@
+#include "dns_resolver.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "tcp_connection_manager.hpp"
+#include "tcp_util.hpp"
+
+namespace
+{
+bool isIpLiteral(const std::string& host)
+{
+    in6_addr addr;
+    return inet_pton(AF_INET, host.c_str(), &addr) == 1 || inet_pton(AF_INET6, host.c_str(), &addr) == 1;
+}
+
+// same order as TCPConnectionManager::dnsLookupAll: IPv6 first, then alternating families
+DNSResolver::Addresses interleaveFamilies(const DNSResolver::Addresses& addresses)
+{
+    DNSResolver::Addresses ipv6Addresses;
+    DNSResolver::Addresses ipv4Addresses;
+    for (const auto& address : addresses) {
+        auto& family = address.find(':') != std::string::npos ? ipv6Addresses : ipv4Addresses;
+        if (std::find(family.begin(), family.end(), address) == family.end()) family.push_back(address);
+    }
+
+    DNSResolver::Addresses ordered;
+    ordered.reserve(ipv6Addresses.size() + ipv4Addresses.size());
+    for (std::size_t i = 0; i < std::max(ipv6Addresses.size(), ipv4Addresses.size()); ++i) {
+        if (i < ipv6Addresses.size()) ordered.push_back(ipv6Addresses[i]);
+        if (i < ipv4Addresses.size()) ordered.push_back(ipv4Addresses[i]);
+    }
+    return ordered;
+}
+
+std::string toLower(std::string host)
+{
+    std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return host;
+}
+} // namespace
+
+DNSResolver::DNSResolver(std::size_t numWorkers, std::chrono::milliseconds ttl, std::chrono::milliseconds negativeTtl,
+                         Backend backend)
+    : m_ttl(ttl), m_negativeTtl(negativeTtl), m_backend(backend ? std::move(backend) : systemBackend())
+{
+    m_workers.reserve(std::max<std::size_t>(1, numWorkers));
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, numWorkers); ++i) {
+        m_workers.emplace_back([this](std::stop_token st) { workerLoop(st); });
+    }
+}
+
+DNSResolver::~DNSResolver()
+{
+    stop();
+}
+
+void DNSResolver::stop()
+{
+    if (m_stopped.exchange(true)) return;
+
+    for (auto& worker : m_workers) worker.request_stop();
+    m_queueCv.notify_all();
+    m_workers.clear(); // joins
+
+    // nobody is going to answer the names still queued
+    for (auto& shard : m_shards) {
+        std::unordered_map<std::string, std::vector<Callback>> inFlight;
+        {
+            std::lock_guard lock(shard.mutex);
+            inFlight.swap(shard.inFlight);
+        }
+        for (auto& [host, callbacks] : inFlight) {
+            for (auto& callback : callbacks) callback({});
+        }
+    }
+}
+
+void DNSResolver::resolve(const std::string& hostName, Callback callback)
+{
+    if (hostName.empty()) {
+        callback({});
+        return;
+    }
+    if (isIpLiteral(hostName)) {
+        callback({hostName});
+        return;
+    }
+
+    const std::string host = toLower(hostName);
+    Shard& shard = shardFor(host);
+    std::unique_lock lock(shard.mutex);
+    if (m_stopped) { // checked under the shard lock, so stop() either sees this lookup or it never gets queued
+        lock.unlock();
+        callback({});
+        return;
+    }
+
+    const auto cached = shard.cache.find(host);
+    if (cached != shard.cache.end()) {
+        if (cached->second.expiry > std::chrono::steady_clock::now()) {
+            const Addresses addresses = cached->second.addresses;
+            lock.unlock();
+            ++m_cacheHits;
+            callback(addresses);
+            return;
+        }
+        shard.cache.erase(cached);
+    }
+
+    ++m_cacheMisses;
+    auto [waiting, firstLookup] = shard.inFlight.try_emplace(host);
+    waiting->second.push_back(std::move(callback));
+    lock.unlock();
+
+    if (!firstLookup) {
+        ++m_coalesced; // answered together with the query already in flight
+        return;
+    }
+
+    {
+        std::lock_guard queueLock(m_queueMutex);
+        m_queue.push_back(host);
+    }
+    m_queueCv.notify_one();
+}
+
+std::future<DNSResolver::Addresses> DNSResolver::resolve(const std::string& host)
+{
+    auto promise = std::make_shared<std::promise<Addresses>>();
+    auto future = promise->get_future();
+    resolve(host, [promise](const Addresses& addresses) { promise->set_value(addresses); });
+    return future;
+}
+
+void DNSResolver::setBackend(Backend backend)
+{
+    {
+        std::lock_guard lock(m_backendMutex);
+        m_backend = backend ? std::move(backend) : systemBackend();
+        ++m_backendEpoch;
+    }
+    clearCache();
+}
+
+void DNSResolver::clearCache()
+{
+    for (auto& shard : m_shards) {
+        std::lock_guard lock(shard.mutex);
+        shard.cache.clear();
+    }
+}
+
+DNSResolverStats DNSResolver::stats() const
+{
+    return {.cacheHits = m_cacheHits, .cacheMisses = m_cacheMisses, .coalesced = m_coalesced, .queries = m_queries};
+}
+
+DNSResolver::Shard& DNSResolver::shardFor(const std::string& host)
+{
+    return m_shards[std::hash<std::string>{}(host) % shardCount];
+}
+
+void DNSResolver::workerLoop(std::stop_token st)
+{
+    while (true) {
+        std::string host;
+        {
+            std::unique_lock lock(m_queueMutex);
+            if (!m_queueCv.wait(lock, st, [this]() { return !m_queue.empty(); })) return; // stop requested
+            host = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        Backend backend;
+        uint64_t epoch = 0;
+        {
+            std::lock_guard lock(m_backendMutex);
+            backend = m_backend;
+            epoch = m_backendEpoch;
+        }
+        ++m_queries;
+        complete(host, interleaveFamilies(backend(host)), epoch);
+    }
+}
+
+void DNSResolver::complete(const std::string& host, const Addresses& addresses, uint64_t epoch)
+{
+    std::vector<Callback> callbacks;
+    Shard& shard = shardFor(host);
+    {
+        std::lock_guard lock(shard.mutex);
+        // Checked under the shard lock: either setBackend()'s clearCache() comes after this and drops the entry,
+        // or the epoch has already moved on here.
+        const auto ttl = addresses.empty() ? m_negativeTtl : m_ttl;
+        if (ttl.count() > 0 && epoch == m_backendEpoch) {
+            shard.cache[host] = {addresses, std::chrono::steady_clock::now() + ttl};
+        }
+
+        const auto waiting = shard.inFlight.find(host);
+        if (waiting == shard.inFlight.end()) return; // failed by stop() in the meantime
+        callbacks.swap(waiting->second);
+        shard.inFlight.erase(waiting);
+    }
+    for (auto& callback : callbacks) callback(addresses);
+}
+
+DNSResolver::Backend DNSResolver::systemBackend()
+{
+    return [](const std::string& host) { return TCPConnectionManager::dnsLookupAll(host); };
+}
+
+DNSResolver::Backend DNSResolver::hostsFileBackend(const std::string& path)
+{
+    std::unordered_map<std::string, Addresses> hosts;
+    std::ifstream file(path);
+    if (!file) std::cerr << "couldn't open hosts file " << path << std::endl;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string address;
+        if (!(fields >> address) || !isIpLiteral(address)) continue;
+        std::string name;
+        while (fields >> name) hosts[toLower(name)].push_back(address);
+    }
+
+    return [hosts = std::move(hosts)](const std::string& host) {
+        const auto it = hosts.find(host);
+        return it != hosts.end() ? it->second : Addresses{};
+    };
+}
@@ -0,0 +1,402 @@
+#include "event_loop.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <format>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+uint32_t toNativeEvents(uint32_t events)
+{
+    uint32_t native = 0;
+    if (events & EventLoop::Readable) native |= EPOLLIN | EPOLLRDHUP;
+    if (events & EventLoop::Writable) native |= EPOLLOUT;
+    if (events & EventLoop::EdgeTriggered) native |= EPOLLET;
+    return native;
+}
+
+uint32_t fromNativeEvents(uint32_t native)
+{
+    uint32_t events = 0;
+    if (native & (EPOLLIN | EPOLLRDHUP)) events |= EventLoop::Readable;
+    if (native & EPOLLOUT) events |= EventLoop::Writable;
+    if (native & (EPOLLHUP | EPOLLERR)) events |= EventLoop::Error | EventLoop::Readable;
+    return events;
+}
+#else
+short toNativeEvents(uint32_t events)
+{
+    short native = 0;
+    if (events & EventLoop::Readable) native |= POLLIN;
+    if (events & EventLoop::Writable) native |= POLLOUT;
+    return native;
+}
+
+uint32_t fromNativeEvents(short native)
+{
+    uint32_t events = 0;
+    if (native & POLLIN) events |= EventLoop::Readable;
+    if (native & POLLOUT) events |= EventLoop::Writable;
+    if (native & (POLLHUP | POLLERR | POLLNVAL)) events |= EventLoop::Error | EventLoop::Readable;
+    return events;
+}
+
+// there is no eventfd outside Linux, so the loop wakes itself up through a UDP socket connected to itself
+SOCKET makeWakeSocket()
+{
+    const SOCKET sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd == INVALID_SOCKET) return INVALID_SOCKET;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(sockfd, (sockaddr*)&addr, sizeof(addr)) || getsockname(sockfd, (sockaddr*)&addr, &len) ||
+        connect(sockfd, (sockaddr*)&addr, sizeof(addr)) || !setNonBlocking(sockfd)) {
+        closesocket(sockfd);
+        return INVALID_SOCKET;
+    }
+    return sockfd;
+}
+#endif
+} // namespace
+
+void EventLoop::start()
+{
+    if (m_running.exchange(true)) return;
+    m_thread = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void EventLoop::stop()
+{
+    if (!m_thread.joinable()) return;
+
+    m_thread.request_stop();
+    wakeUp();
+    // a handler stopping its own loop can't join itself; the owner's stop() will finish the job
+    if (isInLoopThread()) return;
+    m_thread.join();
+
+    // from here on the loop's work runs on the callers' threads, one at a time
+    std::lock_guard stoppedLock(m_stoppedMutex);
+    Retirable* retired = takeRetired();
+    std::vector<Task> tasks;
+    {
+        std::lock_guard lock(m_tasksMutex);
+        m_running = false;
+        tasks.swap(m_tasks);
+    }
+    for (auto& task : tasks) task();
+    runRetired(retired);
+    // items retired while the loop was still marked running, after the first take
+    runRetired(takeRetired());
+}
+
+void EventLoop::post(Task task)
+{
+    bool queued = false;
+    bool wasEmpty = false;
+    {
+        std::lock_guard lock(m_tasksMutex);
+        if (m_running) {
+            wasEmpty = m_tasks.empty();
+            m_tasks.emplace_back(std::move(task));
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        std::lock_guard lock(m_stoppedMutex);
+        task();
+        return;
+    }
+    if (wasEmpty) wakeUp();
+}
+
+EventLoop::TimerId EventLoop::runAfter(std::chrono::milliseconds delay, Task task)
+{
+    const TimerId timerId = m_nextTimerId++;
+    const auto deadline = std::chrono::steady_clock::now() + delay;
+    post([this, timerId, deadline, task = std::move(task)]() mutable {
+        m_timers.emplace(TimerKey{deadline, timerId}, std::move(task));
+        m_timerDeadlines.emplace(timerId, deadline);
+    });
+    return timerId;
+}
+
+void EventLoop::cancelTimer(TimerId timerId)
+{
+    post([this, timerId]() {
+        const auto it = m_timerDeadlines.find(timerId);
+        if (it == m_timerDeadlines.end()) return; // already fired
+        m_timers.erase(TimerKey{it->second, timerId});
+        m_timerDeadlines.erase(it);
+    });
+}
+
+void EventLoop::add(SOCKET sockfd, uint32_t events, Handler handler)
+{
+    post([this, sockfd, events, handler = std::move(handler)]() mutable {
+        addDirect(sockfd, events, std::move(handler));
+    });
+}
+
+void EventLoop::modify(SOCKET sockfd, uint32_t events)
+{
+    post([this, sockfd, events]() { modifyDirect(sockfd, events); });
+}
+
+void EventLoop::remove(SOCKET sockfd)
+{
+    post([this, sockfd]() { removeDirect(sockfd); });
+}
+
+void EventLoop::retire(SOCKET sockfd, Retirable& item)
+{
+    item.m_retiredSocket = sockfd;
+    Retirable* head = m_retired.load(std::memory_order_relaxed);
+    do {
+        item.m_nextRetired = head;
+    } while (!m_retired.compare_exchange_weak(head, &item, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+    // Either this sees the loop stopped, or stop() clears the flag after the push and drains the item itself. The
+    // exchange hands every item to exactly one of them, and the lock keeps their removeDirect() calls apart.
+    if (!m_running) {
+        std::lock_guard lock(m_stoppedMutex);
+        runRetired(takeRetired());
+        return;
+    }
+    // the loop drains everything on the wakeup that follows the first push; later pushes ride along
+    if (!head) wakeUp();
+}
+
+bool EventLoop::isInLoopThread() const
+{
+    return std::this_thread::get_id() == m_thread.get_id();
+}
+
+std::size_t EventLoop::watchedSockets() const
+{
+    return m_watchedSockets;
+}
+
+void EventLoop::runPendingTasks()
+{
+    // The retire queue is taken before the tasks: whatever was posted before a retire() is then part of this
+    // batch, so a socket's registration always runs before its release. Items retired by the batch itself wait
+    // for the next wakeup, behind the tasks posted before them.
+    Retirable* retired = takeRetired();
+    std::vector<Task> tasks;
+    {
+        std::lock_guard lock(m_tasksMutex);
+        tasks.swap(m_tasks);
+    }
+    for (auto& task : tasks) task();
+    runRetired(retired);
+}
+
+EventLoop::Retirable* EventLoop::takeRetired()
+{
+    Retirable* item = m_retired.exchange(nullptr, std::memory_order_seq_cst);
+
+    // the stack is newest first; reversed, so sockets are released in the order they were retired
+    Retirable* ordered = nullptr;
+    while (item) {
+        Retirable* next = item->m_nextRetired;
+        item->m_nextRetired = ordered;
+        ordered = item;
+        item = next;
+    }
+    return ordered;
+}
+
+void EventLoop::runRetired(Retirable* ordered)
+{
+    while (ordered) {
+        Retirable* next = ordered->m_nextRetired; // retired() may free the item
+        ordered->m_nextRetired = nullptr;
+        removeDirect(ordered->m_retiredSocket);
+        ordered->retired();
+        ordered = next;
+    }
+}
+
+int EventLoop::runDueTimers()
+{
+    while (!m_timers.empty()) {
+        const auto it = m_timers.begin();
+        const auto now = std::chrono::steady_clock::now();
+        if (it->first.first > now) {
+            // rounded up, so the loop doesn't spin on a zero timeout just before the deadline
+            const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(it->first.first - now);
+            return (int)std::min<std::chrono::milliseconds::rep>(remaining.count(), INT32_MAX);
+        }
+
+        Task task = std::move(it->second);
+        m_timerDeadlines.erase(it->first.second);
+        m_timers.erase(it);
+        task();
+    }
+    return -1;
+}
+
+ReactorLoop::ReactorLoop()
+{
+#ifdef __linux__
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        std::cerr << "couldn't create event loop" << std::endl;
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+#else
+    m_wakeFd = makeWakeSocket();
+    if (m_wakeFd == INVALID_SOCKET) std::cerr << "couldn't create event loop wake-up socket" << std::endl;
+#endif
+}
+
+ReactorLoop::~ReactorLoop()
+{
+    stop();
+#ifdef __linux__
+    if (m_epollFd >= 0) ::close(m_epollFd);
+    if (m_wakeFd >= 0) ::close(m_wakeFd);
+#else
+    if (m_wakeFd != INVALID_SOCKET) closesocket(m_wakeFd);
+#endif
+}
+
+void ReactorLoop::addDirect(SOCKET sockfd, uint32_t events, Handler handler)
+{
+    if (m_handlers.contains(sockfd)) return;
+
+#ifdef __linux__
+    epoll_event ev{};
+    ev.events = toNativeEvents(events);
+    ev.data.fd = sockfd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        std::cerr << std::format("couldn't add socket {} to the event loop\n", sockfd);
+        return;
+    }
+#else
+    m_pollFdsDirty = true;
+#endif
+
+    m_handlers.emplace(sockfd, Registration{events, std::move(handler)});
+    ++m_watchedSockets;
+}
+
+void ReactorLoop::modifyDirect(SOCKET sockfd, uint32_t events)
+{
+    const auto it = m_handlers.find(sockfd);
+    if (it == m_handlers.end() || it->second.events == events) return;
+    it->second.events = events;
+
+#ifdef __linux__
+    epoll_event ev{};
+    ev.events = toNativeEvents(events);
+    ev.data.fd = sockfd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_MOD, sockfd, &ev);
+#else
+    m_pollFdsDirty = true;
+#endif
+}
+
+void ReactorLoop::removeDirect(SOCKET sockfd)
+{
+    if (!m_handlers.erase(sockfd)) return;
+    --m_watchedSockets;
+
+#ifdef __linux__
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, sockfd, nullptr);
+#else
+    m_pollFdsDirty = true;
+#endif
+}
+
+void ReactorLoop::dispatch(SOCKET sockfd, uint32_t events)
+{
+    const auto it = m_handlers.find(sockfd);
+    if (it == m_handlers.end()) return; // removed earlier in this batch
+    it->second.handler(events);
+}
+
+void ReactorLoop::wakeUp()
+{
+#ifdef __linux__
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto res = ::write(m_wakeFd, &one, sizeof(one));
+#else
+    const char byte = 0;
+    send(m_wakeFd, &byte, 1, 0);
+#endif
+}
+
+void ReactorLoop::run(std::stop_token st)
+{
+#ifdef __linux__
+    std::vector<epoll_event> events(256);
+    while (!st.stop_requested()) {
+        const int timeout = runDueTimers();
+        const int count = epoll_wait(m_epollFd, events.data(), (int)events.size(), timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait() failed with error: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == m_wakeFd) {
+                uint64_t value;
+                [[maybe_unused]] const auto res = ::read(m_wakeFd, &value, sizeof(value));
+                continue;
+            }
+            dispatch(events[i].data.fd, fromNativeEvents(events[i].events));
+        }
+
+        runPendingTasks();
+    }
+#else
+    while (!st.stop_requested()) {
+        if (m_pollFdsDirty) {
+            m_pollFds.clear();
+            m_pollFds.push_back({.fd = m_wakeFd, .events = POLLIN});
+            for (const auto& [sockfd, reg] : m_handlers) {
+                m_pollFds.push_back({.fd = sockfd, .events = toNativeEvents(reg.events)});
+            }
+            m_pollFdsDirty = false;
+        }
+
+        const int count = WSAPoll(m_pollFds.data(), (unsigned long)m_pollFds.size(), runDueTimers());
+        if (count < 0) {
+            std::cerr << "WSAPoll() failed with error: " << WSAGetLastError() << std::endl;
+            break;
+        }
+
+        if (m_pollFds[0].revents & POLLIN) {
+            char buffer[64];
+            while (recv(m_wakeFd, buffer, sizeof(buffer), 0) > 0) {}
+        }
+
+        for (std::size_t i = 1; i < m_pollFds.size(); ++i) {
+            if (m_pollFds[i].revents) dispatch(m_pollFds[i].fd, fromNativeEvents(m_pollFds[i].revents));
+        }
+
+        runPendingTasks();
+    }
+#endif
+    runPendingTasks();
+}
@@ -0,0 +1,132 @@
+#include "frame_codec.hpp"
+
+#include <format>
+#include <iostream>
+
+FrameDecoder::FrameDecoder(std::size_t maxFrameSize) : m_maxFrameSize(maxFrameSize) {}
+
+void FrameDecoder::beginAssembly()
+{
+    if (m_frameSize <= RecvBufferPool::blockSize) m_assembly = RecvBufferPool::acquire();
+    else m_largeAssembly = std::make_shared<std::string>(m_frameSize, '\0');
+}
+
+char* FrameDecoder::assemblyData()
+{
+    return m_largeAssembly ? m_largeAssembly->data() : m_assembly.writableData();
+}
+
+Frame FrameDecoder::finishAssembly()
+{
+    Frame frame;
+    frame.m_assembled = true;
+    if (m_largeAssembly) {
+        frame.m_view = std::string_view(m_largeAssembly->data(), m_frameSize);
+        frame.m_large = std::move(m_largeAssembly);
+    } else {
+        m_assembly.resize(m_frameSize);
+        frame.m_view = std::string_view(m_assembly.data(), m_frameSize);
+        frame.m_buffer = std::move(m_assembly);
+    }
+    return frame;
+}
+
+struct FrameCodec::Attachment {
+    Attachment(const TCPConnInfo& connInfo, EventLoop& loop, std::size_t maxFrameSize)
+        : connInfo(connInfo), loop(loop), decoder(maxFrameSize)
+    {}
+
+    const TCPConnInfo connInfo;
+    EventLoop& loop;
+    ScopedEventConnection dataConnection;
+
+    // only touched by the connection's event loop
+    FrameDecoder decoder;
+    std::size_t lowWatermark{1}; // SO_RCVLOWAT as last set on the socket
+};
+
+FrameCodec::FrameCodec(TCPConnectionManager& tcpConnMgr, FrameCodecOptions options)
+    : m_tcpConnMgr(tcpConnMgr), m_options(options), m_attachments(tcpConnMgr, &FrameCodec::resetLowWatermark)
+{
+}
+
+FrameCodec::~FrameCodec()
+{
+    m_attachments.clear();
+}
+
+bool FrameCodec::attach(ConnHandle handle)
+{
+    return m_attachments.attach(
+        handle,
+        [this](const TCPConnInfo& connInfo, TCPConnection& conn) {
+            return std::make_shared<Attachment>(connInfo, conn.eventLoop(), m_options.maxFrameSize);
+        },
+        [this](Attachment& attachment, const RecvBuffer& buffer) { onData(attachment, buffer); });
+}
+
+void FrameCodec::detach(ConnHandle handle)
+{
+    m_attachments.detach(handle);
+}
+
+std::size_t FrameCodec::attachedCount() const
+{
+    return m_attachments.size();
+}
+
+void FrameCodec::resetLowWatermark(const std::shared_ptr<Attachment>& attachment)
+{
+    // Runs after any delivery still in progress. A raised SO_RCVLOWAT would hold back whoever reads the socket
+    // next; should the descriptor have been reused meanwhile, 1 is the default anyway.
+    attachment->loop.post([attachment]() {
+        if (attachment->lowWatermark != 1) setReceiveLowWatermark(attachment->connInfo.sockfd, 1);
+    });
+}
+
+std::string FrameCodec::encode(std::string_view payload)
+{
+    const auto size = (uint32_t)payload.size();
+    std::string frame(FrameDecoder::headerSize + payload.size(), '\0');
+    frame[0] = char(size >> 24);
+    frame[1] = char(size >> 16);
+    frame[2] = char(size >> 8);
+    frame[3] = char(size);
+    std::memcpy(frame.data() + FrameDecoder::headerSize, payload.data(), payload.size());
+    return frame;
+}
+
+bool FrameCodec::send(ConnHandle handle, std::string_view payload)
+{
+    if (payload.size() > m_options.maxFrameSize || payload.size() > UINT32_MAX) {
+        std::cerr << std::format("frame of {} bytes is above the limit of {}\n", payload.size(), m_options.maxFrameSize);
+        return false;
+    }
+    return m_tcpConnMgr.write(handle, encode(payload));
+}
+
+void FrameCodec::onData(Attachment& attachment, const RecvBuffer& buffer)
+{
+    const bool ok = attachment.decoder.feed(buffer, [&](const Frame& frame) {
+        ++(frame.assembled() ? m_framesAssembled : m_framesInPlace);
+        frameArrived(attachment.connInfo, frame);
+    });
+    if (!ok) {
+        std::cerr << std::format("frame above {} bytes on socket {}; closing connection!\n", m_options.maxFrameSize,
+                                 attachment.connInfo.sockfd);
+        m_tcpConnMgr.closeConn(attachment.connInfo);
+        return;
+    }
+    updateLowWatermark(attachment);
+}
+
+void FrameCodec::updateLowWatermark(Attachment& attachment)
+{
+    if (m_options.lowWatermarkThreshold == 0) return;
+
+    // only ever the bytes the frame still needs, so the socket can't wait for data the peer won't send
+    const std::size_t missing = attachment.decoder.missingBytes();
+    const std::size_t wanted = missing >= m_options.lowWatermarkThreshold ? std::min(missing, m_options.maxLowWatermark) : 1;
+    if (wanted == attachment.lowWatermark) return;
+    if (setReceiveLowWatermark(attachment.connInfo.sockfd, (int)wanted)) attachment.lowWatermark = wanted;
+}
@@ -0,0 +1,551 @@
+#include "http_client.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+// RFC 9110, section 9.2.2; only these are retried, or pipelined (RFC 9112, section 9.3.2)
+bool isIdempotent(std::string_view method)
+{
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" || method == "PUT" ||
+           method == "DELETE";
+}
+
+std::string serializeRequest(const std::string& host, uint16_t port, const HttpClientRequest& request)
+{
+    std::string out;
+    out.reserve(64 + host.size() + request.target.size() + request.body.size());
+    out += request.method;
+    out += ' ';
+    out += request.target;
+    out += " HTTP/1.1\r\n";
+
+    bool hasHost = false;
+    for (const auto& [name, value] : request.headers) {
+        hasHost = hasHost || httpEqualsIgnoreCase(name, "Host");
+        out += name;
+        out += ": ";
+        out += value;
+        out += "\r\n";
+    }
+    if (!hasHost) {
+        out += "Host: ";
+        // IPv6 literals are bracketed (RFC 9110, section 7.2)
+        const bool ipv6 = host.find(':') != std::string::npos;
+        if (ipv6) out += '[';
+        out += host;
+        if (ipv6) out += ']';
+        if (port != 80) {
+            out += ':';
+            appendNumber(out, port);
+        }
+        out += "\r\n";
+    }
+    // without a length the server could not tell where a POST or PUT ends
+    if (!request.body.empty() || request.method == "POST" || request.method == "PUT") {
+        out += "Content-Length: ";
+        appendNumber(out, request.body.size());
+        out += "\r\n";
+    }
+    out += "\r\n";
+    out += request.body;
+    return out;
+}
+} // namespace
+
+class HttpClient::Pool : public std::enable_shared_from_this<Pool>
+{
+public:
+    Pool(TCPConnectionManager& tcpConnMgr, HttpClientOptions options);
+
+    void start();
+    void shutdown();
+    void submit(const std::string& host, uint16_t port, const HttpClientRequest& request,
+                HttpResponseCallback callback);
+
+    std::size_t connectionCount() const;
+    HttpClientStats stats() const;
+
+private:
+    struct Host;
+    struct Connection;
+
+    struct Request {
+        std::string wire;
+        bool head{false};
+        bool idempotent{true};
+        HttpResponseCallback callback;
+        Host* host{nullptr};
+        EventLoop* timerLoop{nullptr};
+        EventLoop::TimerId timer{0};
+
+        // guarded by m_mutex
+        bool done{false};
+        int attempts{0};
+        std::weak_ptr<Connection> conn; // the one it was last handed to
+    };
+
+    struct Connection {
+        Connection(Host& host, const HttpParserLimits& limits) : host(host), parser(limits) {}
+
+        Host& host;
+
+        // guarded by m_mutex
+        TCPConnInfo connInfo;
+        EventLoop* loop{nullptr};           // nullptr while connecting
+        std::size_t outstanding{0};         // handed to the connection and not answered yet
+        std::size_t unsafeOutstanding{0};   // the non-idempotent ones among them
+        bool reusable{true};                // false once it is being closed
+        std::vector<std::shared_ptr<Request>> toSend; // waiting for flush()
+        bool flushPosted{false};
+
+        // only touched by the connection's event loop
+        ScopedEventConnection dataConnection;
+        HttpResponseParser parser;
+        std::deque<std::shared_ptr<Request>> inFlight; // sent, in order
+        std::string out;
+    };
+
+    struct Host {
+        Host(std::string name, uint16_t port) : name(std::move(name)), port(port) {}
+
+        const std::string name;
+        const uint16_t port;
+        std::vector<std::shared_ptr<Connection>> connections; // open or connecting
+        std::size_t connecting{0};
+        std::deque<std::shared_ptr<Request>> waiting;
+    };
+
+    using Answer = std::pair<std::shared_ptr<Request>, HttpClientResponse>;
+
+    // work decided with m_mutex held and carried out once it is released
+    struct Deferred {
+        std::vector<std::pair<std::shared_ptr<Request>, HttpClientResult>> completions;
+        std::vector<std::shared_ptr<Connection>> connects;
+        std::vector<std::shared_ptr<Connection>> flushes;
+        std::vector<TCPConnInfo> closes;
+    };
+
+    // these run with m_mutex held
+    void dispatch(Host& host, Deferred& deferred);
+    std::shared_ptr<Connection> pick(const Host& host, const Request& request) const;
+    void assign(const std::shared_ptr<Connection>& conn, const std::shared_ptr<Request>& request, Deferred& deferred);
+    void complete(const std::shared_ptr<Request>& request, int error, HttpClientResponse response,
+                  Deferred& deferred);
+    void answer(Connection& conn, std::vector<Answer>& answers, Deferred& deferred);
+    void run(Deferred& deferred);
+
+    void onConnected(const std::shared_ptr<Connection>& conn, const TCPConnInfo& connInfo, int error);
+    void onConnectionClosed(const TCPConnInfo& connInfo);
+    void onDeadline(const std::shared_ptr<Request>& request);
+    // on the connection's event loop
+    void flush(const std::shared_ptr<Connection>& conn);
+    void onData(const std::shared_ptr<Connection>& conn, const RecvBuffer& buffer);
+    void onClosed(const std::shared_ptr<Connection>& conn);
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    const HttpClientOptions m_options;
+
+    mutable std::mutex m_mutex;
+    bool m_shutdown{false};
+    std::map<std::pair<std::string, uint16_t>, std::unique_ptr<Host>> m_hosts;
+    std::unordered_map<SOCKET, std::shared_ptr<Connection>> m_connections; // open ones, by socket
+    HttpClientStats m_stats;
+
+    ScopedEventConnection m_closedConnection;
+};
+
+HttpClient::Pool::Pool(TCPConnectionManager& tcpConnMgr, HttpClientOptions options)
+    : m_tcpConnMgr(tcpConnMgr), m_options(options)
+{}
+
+void HttpClient::Pool::start()
+{
+    m_closedConnection = m_tcpConnMgr.connectionClosed.connect([weak = weak_from_this()](TCPConnInfo connInfo) {
+        if (const auto self = weak.lock()) self->onConnectionClosed(connInfo);
+    });
+}
+
+void HttpClient::Pool::shutdown()
+{
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        m_shutdown = true;
+        for (auto& [key, host] : m_hosts) {
+            for (const auto& request : host->waiting) complete(request, ECANCELED, {}, deferred);
+            host->waiting.clear();
+            // requests handed to a connection fail once its loop has seen the close
+            for (const auto& conn : host->connections) {
+                if (conn->loop) deferred.closes.push_back(conn->connInfo);
+            }
+        }
+    }
+    run(deferred);
+}
+
+void HttpClient::Pool::submit(const std::string& host, uint16_t port, const HttpClientRequest& request,
+                              HttpResponseCallback callback)
+{
+    auto pending = std::make_shared<Request>();
+    pending->wire = serializeRequest(host, port, request);
+    pending->head = request.method == "HEAD";
+    pending->idempotent = isIdempotent(request.method);
+    pending->callback = std::move(callback);
+    const auto timeout = request.timeout.count() ? request.timeout : m_options.timeout;
+
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_shutdown) {
+            complete(pending, ECANCELED, {}, deferred);
+        } else {
+            auto& entry = m_hosts[{host, port}];
+            if (!entry) entry = std::make_unique<Host>(host, port);
+            pending->host = entry.get();
+
+            EventLoop& loop = m_tcpConnMgr.nextEventLoop();
+            pending->timerLoop = &loop;
+            pending->timer = loop.runAfter(timeout, [weak = weak_from_this(), pending]() {
+                if (const auto self = weak.lock()) self->onDeadline(pending);
+            });
+            entry->waiting.push_back(std::move(pending));
+            dispatch(*entry, deferred);
+        }
+    }
+    run(deferred);
+}
+
+std::size_t HttpClient::Pool::connectionCount() const
+{
+    std::lock_guard lock(m_mutex);
+    std::size_t count = 0;
+    for (const auto& [key, host] : m_hosts) count += host->connections.size();
+    return count;
+}
+
+HttpClientStats HttpClient::Pool::stats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+void HttpClient::Pool::dispatch(Host& host, Deferred& deferred)
+{
+    // in order, so a request that has to wait holds back the ones behind it
+    while (!host.waiting.empty()) {
+        const auto conn = pick(host, *host.waiting.front());
+        if (!conn) break;
+        assign(conn, host.waiting.front(), deferred);
+        host.waiting.pop_front();
+    }
+
+    // grow the pool while more requests wait than connections are on their way
+    while (!m_shutdown && host.waiting.size() > host.connecting &&
+           host.connections.size() < m_options.maxConnectionsPerHost) {
+        auto conn = std::make_shared<Connection>(host, m_options.limits);
+        host.connections.push_back(conn);
+        ++host.connecting;
+        deferred.connects.push_back(std::move(conn));
+    }
+}
+
+std::shared_ptr<HttpClient::Pool::Connection> HttpClient::Pool::pick(const Host& host, const Request& request) const
+{
+    std::shared_ptr<Connection> least;
+    for (const auto& conn : host.connections) {
+        if (!conn->loop || !conn->reusable) continue;
+        if (conn->outstanding == 0) return conn;
+        if (!request.idempotent || conn->unsafeOutstanding || conn->outstanding >= m_options.maxPipelineDepth) {
+            continue;
+        }
+        if (!least || conn->outstanding < least->outstanding) least = conn;
+    }
+    // pipelining queues a request behind other responses; a connection that is or can be opened beats that
+    if (host.connecting || host.connections.size() < m_options.maxConnectionsPerHost) return nullptr;
+    return least;
+}
+
+void HttpClient::Pool::assign(const std::shared_ptr<Connection>& conn, const std::shared_ptr<Request>& request,
+                              Deferred& deferred)
+{
+    request->conn = conn;
+    ++request->attempts;
+    ++conn->outstanding;
+    if (!request->idempotent) ++conn->unsafeOutstanding;
+    ++m_stats.requestsSent;
+    if (conn->outstanding > 1) ++m_stats.pipelinedRequests;
+
+    // everything handed over before the loop gets to it leaves in one write
+    conn->toSend.push_back(request);
+    if (!conn->flushPosted) {
+        conn->flushPosted = true;
+        deferred.flushes.push_back(conn);
+    }
+}
+
+void HttpClient::Pool::complete(const std::shared_ptr<Request>& request, int error, HttpClientResponse response,
+                                Deferred& deferred)
+{
+    if (request->done) return;
+    request->done = true;
+    if (request->timerLoop) request->timerLoop->cancelTimer(request->timer);
+    deferred.completions.emplace_back(request, HttpClientResult{error, std::move(response)});
+}
+
+void HttpClient::Pool::answer(Connection& conn, std::vector<Answer>& answers, Deferred& deferred)
+{
+    for (auto& [request, response] : answers) {
+        --conn.outstanding;
+        if (!request->idempotent) --conn.unsafeOutstanding;
+        // the server closes after this response; requests pipelined behind it go elsewhere
+        if (!response.keepAlive && conn.reusable) {
+            conn.reusable = false;
+            deferred.closes.push_back(conn.connInfo);
+        }
+        complete(request, 0, std::move(response), deferred);
+    }
+}
+
+void HttpClient::Pool::run(Deferred& deferred)
+{
+    for (const auto& conn : deferred.connects) {
+        m_tcpConnMgr.openConnectionByName(
+            conn->host.name, conn->host.port,
+            [self = shared_from_this(), conn](TCPConnInfo connInfo, int error) {
+                self->onConnected(conn, connInfo, error);
+            },
+            m_options.connectTimeout);
+    }
+    for (const auto& conn : deferred.flushes) {
+        conn->loop->post([self = shared_from_this(), conn]() { self->flush(conn); });
+    }
+    for (const auto& connInfo : deferred.closes) m_tcpConnMgr.closeConn(connInfo);
+    for (auto& [request, result] : deferred.completions) {
+        request->callback(std::move(result));
+        request->callback = nullptr;
+    }
+}
+
+void HttpClient::Pool::onConnected(const std::shared_ptr<Connection>& conn, const TCPConnInfo& connInfo, int error)
+{
+    std::shared_ptr<TCPConnection> tcpConn;
+    if (!error) {
+        tcpConn = m_tcpConnMgr.getConnectionDirect(connInfo);
+        if (!tcpConn) error = ECONNRESET;
+    }
+
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        Host& host = conn->host;
+        --host.connecting;
+        if (error || m_shutdown) {
+            std::erase(host.connections, conn);
+            if (!error) {
+                deferred.closes.push_back(connInfo);
+            } else if (host.connections.empty()) {
+                // nothing left that could take the waiting requests
+                for (const auto& request : host.waiting) complete(request, error, {}, deferred);
+                host.waiting.clear();
+            }
+        } else {
+            conn->connInfo = connInfo;
+            conn->loop = &tcpConn->eventLoop();
+            conn->dataConnection = tcpConn->newDataArrived.connect(
+                [self = shared_from_this(), conn](const RecvBuffer& buffer) { self->onData(conn, buffer); });
+            m_connections[connInfo.sockfd] = conn;
+            ++m_stats.connectionsOpened;
+            dispatch(host, deferred);
+        }
+    }
+    run(deferred);
+
+    // see ConnectionAttachments::attach: the connection may have closed before it was registered
+    if (tcpConn && m_tcpConnMgr.getConnectionDirect(connInfo) != tcpConn) onConnectionClosed(connInfo);
+}
+
+void HttpClient::Pool::onConnectionClosed(const TCPConnInfo& connInfo)
+{
+    std::shared_ptr<Connection> conn;
+    {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_connections.find(connInfo.sockfd);
+        if (it == m_connections.end() || it->second->connInfo.generation != connInfo.generation) return;
+        conn = std::move(it->second);
+        m_connections.erase(it);
+        conn->reusable = false;
+    }
+    // the requests in flight belong to the loop
+    conn->loop->post([self = shared_from_this(), conn]() { self->onClosed(conn); });
+}
+
+void HttpClient::Pool::onDeadline(const std::shared_ptr<Request>& request)
+{
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        if (request->done) return;
+        request->timerLoop = nullptr; // fired
+        ++m_stats.timeouts;
+
+        Host& host = *request->host;
+        const auto waiting = std::find(host.waiting.begin(), host.waiting.end(), request);
+        if (waiting != host.waiting.end()) {
+            host.waiting.erase(waiting);
+        } else if (const auto conn = request->conn.lock()) {
+            const auto queued = std::find(conn->toSend.begin(), conn->toSend.end(), request);
+            if (queued != conn->toSend.end()) {
+                // not written yet, so the connection is unaffected
+                conn->toSend.erase(queued);
+                --conn->outstanding;
+                if (!request->idempotent) --conn->unsafeOutstanding;
+            } else if (conn->reusable) {
+                conn->reusable = false;
+                deferred.closes.push_back(conn->connInfo);
+            }
+        }
+        complete(request, ETIMEDOUT, {}, deferred);
+    }
+    run(deferred);
+}
+
+void HttpClient::Pool::flush(const std::shared_ptr<Connection>& conn)
+{
+    std::vector<std::shared_ptr<Request>> batch;
+    {
+        std::lock_guard lock(m_mutex);
+        conn->flushPosted = false;
+        batch.swap(conn->toSend);
+    }
+    if (batch.empty()) return;
+
+    for (const auto& request : batch) {
+        conn->inFlight.push_back(request);
+        conn->parser.expectResponse(request->head);
+        conn->out += request->wire;
+    }
+    m_tcpConnMgr.write(conn->connInfo, std::move(conn->out));
+    conn->out.clear();
+}
+
+void HttpClient::Pool::onData(const std::shared_ptr<Connection>& conn, const RecvBuffer& buffer)
+{
+    if (conn->parser.failed()) return;
+
+    std::vector<Answer> answers;
+    const bool ok = conn->parser.feed(buffer, [&](HttpClientResponse&& response) {
+        answers.emplace_back(std::move(conn->inFlight.front()), std::move(response));
+        conn->inFlight.pop_front();
+    });
+    if (ok && answers.empty()) return;
+
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        answer(*conn, answers, deferred);
+        if (!ok) {
+            std::cerr << std::format("malformed HTTP response from {}:{}; closing connection!\n", conn->host.name,
+                                     conn->host.port);
+            if (!conn->inFlight.empty()) {
+                const auto request = std::move(conn->inFlight.front());
+                conn->inFlight.pop_front();
+                --conn->outstanding;
+                if (!request->idempotent) --conn->unsafeOutstanding;
+                complete(request, EPROTO, {}, deferred);
+            }
+            if (conn->reusable) {
+                conn->reusable = false;
+                deferred.closes.push_back(conn->connInfo);
+            }
+        }
+        dispatch(conn->host, deferred);
+    }
+    run(deferred);
+}
+
+void HttpClient::Pool::onClosed(const std::shared_ptr<Connection>& conn)
+{
+    std::vector<Answer> answers;
+    bool cutOff = false;
+    if (!conn->parser.failed()) {
+        // the close may be what ends the last response
+        cutOff = !conn->parser.finish([&](HttpClientResponse&& response) {
+            answers.emplace_back(std::move(conn->inFlight.front()), std::move(response));
+            conn->inFlight.pop_front();
+        });
+    }
+    conn->dataConnection.disconnect();
+
+    Deferred deferred;
+    {
+        std::lock_guard lock(m_mutex);
+        Host& host = conn->host;
+        std::erase(host.connections, conn);
+        answer(*conn, answers, deferred);
+
+        // the server may have processed a request whose response had started, so only the others are retried
+        std::vector<std::shared_ptr<Request>> retry;
+        auto lost = [&](const std::shared_ptr<Request>& request, bool started) {
+            if (request->done) return;
+            if (!m_shutdown && request->idempotent && request->attempts < 2 && !started) {
+                retry.push_back(request);
+                ++m_stats.retries;
+            } else {
+                complete(request, m_shutdown ? ECANCELED : ECONNRESET, {}, deferred);
+            }
+        };
+        for (std::size_t i = 0; i < conn->inFlight.size(); ++i) lost(conn->inFlight[i], i == 0 && cutOff);
+        for (const auto& request : conn->toSend) lost(request, false);
+        conn->inFlight.clear();
+        conn->toSend.clear();
+        conn->outstanding = 0;
+        conn->unsafeOutstanding = 0;
+
+        host.waiting.insert(host.waiting.begin(), retry.begin(), retry.end());
+        dispatch(host, deferred);
+    }
+    run(deferred);
+}
+
+HttpClient::HttpClient(TCPConnectionManager& tcpConnMgr, HttpClientOptions options)
+    : m_pool(std::make_shared<Pool>(tcpConnMgr, options))
+{
+    m_pool->start();
+}
+
+HttpClient::~HttpClient()
+{
+    m_pool->shutdown();
+}
+
+void HttpClient::request(const std::string& host, uint16_t port, HttpClientRequest request,
+                         HttpResponseCallback callback)
+{
+    m_pool->submit(host, port, request, std::move(callback));
+}
+
+std::future<HttpClientResult> HttpClient::request(const std::string& host, uint16_t port, HttpClientRequest request)
+{
+    auto promise = std::make_shared<std::promise<HttpClientResult>>();
+    auto future = promise->get_future();
+    m_pool->submit(host, port, request, [promise](HttpClientResult result) { promise->set_value(std::move(result)); });
+    return future;
+}
+
+std::size_t HttpClient::connectionCount() const
+{
+    return m_pool->connectionCount();
+}
+
+HttpClientStats HttpClient::stats() const
+{
+    return m_pool->stats();
+}
@@ -0,0 +1,570 @@
+#include "http_parser.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// longest chunk-size line accepted, extensions included
+constexpr std::size_t maxChunkLine = 1024;
+
+char lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c;
+}
+
+std::string_view trimWhitespace(std::string_view value)
+{
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+// RFC 9110 token characters, as allowed in methods and header names
+bool isTokenChar(char c)
+{
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return true;
+    switch (c) {
+    case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+': case '-': case '.':
+    case '^': case '_': case '`': case '|': case '~':
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isToken(std::string_view value)
+{
+    if (value.empty()) return false;
+    for (const char c : value) {
+        if (!isTokenChar(c)) return false;
+    }
+    return true;
+}
+
+bool parseDecimal(std::string_view digits, std::size_t& value)
+{
+    if (digits.empty() || digits.size() > 18) return false;
+    value = 0;
+    for (const char c : digits) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + std::size_t(c - '0');
+    }
+    return true;
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c = lower(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+enum class FieldsResult { Ok, Malformed, TooMany };
+
+// the header fields of head from pos, which follows the start line, up to the empty line ending the block
+FieldsResult parseFields(std::string_view head, std::size_t pos, std::size_t maxHeaders,
+                         std::vector<HttpHeader>& headers)
+{
+    while (pos < head.size() - 2) {
+        const std::size_t end = head.find("\r\n", pos);
+        const std::string_view field = head.substr(pos, end - pos);
+        pos = end + 2;
+        const std::size_t colon = field.find(':');
+        // obsolete line folding and whitespace before the colon are rejected (RFC 9112, sections 5.1 and 5.2)
+        if (colon == std::string_view::npos || !isToken(field.substr(0, colon))) return FieldsResult::Malformed;
+        if (headers.size() == maxHeaders) return FieldsResult::TooMany;
+        headers.push_back({field.substr(0, colon), trimWhitespace(field.substr(colon + 1))});
+    }
+    return FieldsResult::Ok;
+}
+
+// chunk-size [ chunk-ext ]; false unless it starts with hex digits
+bool parseChunkSize(std::string_view line, std::size_t maxSize, std::size_t& size, bool& tooLarge)
+{
+    size = 0;
+    tooLarge = false;
+    std::size_t digits = 0;
+    for (const char c : line) {
+        const int value = hexValue(c);
+        if (value < 0) {
+            if (c == ';' || c == ' ' || c == '\t') break;
+            return false;
+        }
+        size = size * 16 + std::size_t(value);
+        if (size > maxSize) {
+            tooLarge = true;
+            return false;
+        }
+        ++digits;
+    }
+    return digits != 0;
+}
+} // namespace
+
+bool httpEqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) return false;
+    }
+    return true;
+}
+
+bool httpHasToken(std::string_view value, std::string_view token)
+{
+    while (!value.empty()) {
+        const std::size_t comma = value.find(',');
+        if (httpEqualsIgnoreCase(trimWhitespace(value.substr(0, comma)), token)) return true;
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+std::string_view HttpRequest::header(std::string_view name) const
+{
+    for (const auto& header : headers) {
+        if (httpEqualsIgnoreCase(header.name, name)) return header.value;
+    }
+    return {};
+}
+
+HttpRequestParser::HttpRequestParser(HttpParserLimits limits) : m_limits(limits) {}
+
+HttpRequestParser::Result HttpRequestParser::parse(std::string_view window, std::size_t& consumed)
+{
+    if (m_headEnd == 0) {
+        // only the bytes that arrived since the last call are searched, and the 3 before them
+        const std::size_t from = m_headScanned >= 3 ? m_headScanned - 3 : 0;
+        const std::size_t end = window.find("\r\n\r\n", from);
+        if (end == std::string_view::npos) {
+            if (window.size() > m_limits.maxHeaderSize) return fail(431);
+            m_headScanned = window.size();
+            return Result::NeedMore;
+        }
+        if (end + 4 > m_limits.maxHeaderSize) return fail(431);
+        m_headEnd = end + 4;
+        if (!parseHead(window.substr(0, m_headEnd))) return Result::Error;
+        m_parsedBase = window.data();
+    }
+
+    switch (m_framing) {
+    case BodyFraming::None:
+        m_request.body = {};
+        consumed = m_headEnd;
+        break;
+    case BodyFraming::Length:
+        if (window.size() - m_headEnd < m_contentLength) return Result::NeedMore;
+        m_request.body = window.substr(m_headEnd, m_contentLength);
+        consumed = m_headEnd + m_contentLength;
+        break;
+    case BodyFraming::Chunked: {
+        const Result result = parseChunks(window);
+        if (result != Result::Complete) return result;
+        m_request.body = m_chunkedBody;
+        consumed = m_chunkPos;
+        break;
+    }
+    }
+
+    // the head was parsed while the request sat in another buffer; point the views at this one
+    if (window.data() != m_parsedBase && !parseHead(window.substr(0, m_headEnd))) return Result::Error;
+    return Result::Complete;
+}
+
+bool HttpRequestParser::parseHead(std::string_view head)
+{
+    HttpRequest& request = m_request;
+    request.headers.clear();
+
+    // request-line = method SP request-target SP HTTP-version
+    const std::size_t lineEnd = head.find("\r\n");
+    const std::string_view line = head.substr(0, lineEnd);
+    const std::size_t methodEnd = line.find(' ');
+    const std::size_t targetEnd = methodEnd == std::string_view::npos ? methodEnd : line.find(' ', methodEnd + 1);
+    if (targetEnd == std::string_view::npos || targetEnd == methodEnd + 1) {
+        fail(400);
+        return false;
+    }
+    request.method = line.substr(0, methodEnd);
+    request.target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    const std::string_view version = line.substr(targetEnd + 1);
+    if (!isToken(request.method) || request.target.find_first_of(" \t") != std::string_view::npos) {
+        fail(400);
+        return false;
+    }
+    if (version.size() != 8 || version.substr(0, 5) != "HTTP/" || version[6] != '.') {
+        fail(400);
+        return false;
+    }
+    if (version[5] != '1' || (version[7] != '0' && version[7] != '1')) {
+        fail(505);
+        return false;
+    }
+    request.minorVersion = version[7] - '0';
+
+    const std::size_t question = request.target.find('?');
+    request.path = request.target.substr(0, question);
+    request.query = question == std::string_view::npos ? std::string_view() : request.target.substr(question + 1);
+
+    const FieldsResult fields = parseFields(head, lineEnd + 2, m_limits.maxHeaders, request.headers);
+    if (fields != FieldsResult::Ok) {
+        fail(fields == FieldsResult::TooMany ? 431 : 400);
+        return false;
+    }
+
+    // body framing; both headers together are a request smuggling vector and refused
+    bool hasLength = false;
+    bool chunked = false;
+    std::string_view connection;
+    for (const auto& header : request.headers) {
+        if (httpEqualsIgnoreCase(header.name, "Content-Length")) {
+            std::size_t length = 0;
+            if (!parseDecimal(header.value, length) || (hasLength && length != m_contentLength)) {
+                fail(400);
+                return false;
+            }
+            hasLength = true;
+            m_contentLength = length;
+        } else if (httpEqualsIgnoreCase(header.name, "Transfer-Encoding")) {
+            // chunked is the only transfer coding understood
+            if (!httpEqualsIgnoreCase(header.value, "chunked")) {
+                fail(501);
+                return false;
+            }
+            chunked = true;
+        } else if (httpEqualsIgnoreCase(header.name, "Connection")) {
+            connection = header.value;
+        }
+    }
+    if (hasLength && chunked) {
+        fail(400);
+        return false;
+    }
+    if (m_contentLength > m_limits.maxBodySize) {
+        fail(413);
+        return false;
+    }
+    m_framing = chunked ? BodyFraming::Chunked : m_contentLength ? BodyFraming::Length : BodyFraming::None;
+    request.keepAlive = request.minorVersion == 1 ? !httpHasToken(connection, "close")
+                                                  : httpHasToken(connection, "keep-alive");
+    return true;
+}
+
+HttpRequestParser::Result HttpRequestParser::parseChunks(std::string_view window)
+{
+    if (m_chunkPos == 0) m_chunkPos = m_headEnd;
+
+    // chunk = chunk-size [ chunk-ext ] CRLF chunk-data CRLF; the last chunk has size 0 and is followed by the
+    // trailer section and an empty line
+    for (;;) {
+        const std::size_t lineEnd = window.find("\r\n", m_chunkPos);
+        if (lineEnd == std::string_view::npos) {
+            if (window.size() - m_chunkPos > maxChunkLine) return fail(m_inTrailer ? 431 : 400);
+            return Result::NeedMore;
+        }
+        const std::string_view line = window.substr(m_chunkPos, lineEnd - m_chunkPos);
+
+        if (m_inTrailer) {
+            // trailer fields are skipped
+            m_chunkPos = lineEnd + 2;
+            if (line.empty()) return Result::Complete;
+            continue;
+        }
+
+        std::size_t size = 0;
+        bool tooLarge = false;
+        if (!parseChunkSize(line, m_limits.maxBodySize, size, tooLarge)) return fail(tooLarge ? 413 : 400);
+
+        if (size == 0) {
+            m_inTrailer = true;
+            m_chunkPos = lineEnd + 2;
+            continue;
+        }
+        if (m_chunkedBody.size() + size > m_limits.maxBodySize) return fail(413);
+        const std::size_t dataStart = lineEnd + 2;
+        if (window.size() < dataStart + size + 2) return Result::NeedMore;
+        if (window.substr(dataStart + size, 2) != "\r\n") return fail(400);
+        m_chunkedBody.append(window.substr(dataStart, size));
+        m_chunkPos = dataStart + size + 2;
+    }
+}
+
+HttpRequestParser::Result HttpRequestParser::fail(int status)
+{
+    m_errorStatus = status;
+    return Result::Error;
+}
+
+void HttpRequestParser::reset()
+{
+    m_request.headers.clear(); // keeps the capacity for the next request
+    m_parsedBase = nullptr;
+    m_headScanned = 0;
+    m_headEnd = 0;
+    m_framing = BodyFraming::None;
+    m_contentLength = 0;
+    m_chunkPos = 0;
+    m_inTrailer = false;
+    m_chunkedBody.clear();
+}
+
+std::string_view HttpClientResponse::header(std::string_view name) const
+{
+    for (const auto& header : headers) {
+        if (httpEqualsIgnoreCase(header.name, name)) return header.value;
+    }
+    return {};
+}
+
+std::size_t HttpClientResponse::bodySize() const
+{
+    std::size_t size = 0;
+    for (const auto& segment : body) size += segment.size();
+    return size;
+}
+
+std::string HttpClientResponse::bodyString() const
+{
+    std::string joined;
+    joined.reserve(bodySize());
+    for (const auto& segment : body) joined.append(segment);
+    return joined;
+}
+
+HttpResponseParser::HttpResponseParser(HttpParserLimits limits) : m_limits(limits)
+{
+    m_limits.maxHeaderSize = std::min(m_limits.maxHeaderSize, RecvBufferPool::blockSize);
+}
+
+void HttpResponseParser::expectResponse(bool toHead)
+{
+    m_expected.push_back(toHead);
+}
+
+bool HttpResponseParser::advance(const RecvBuffer& buffer, std::size_t& pos)
+{
+    const std::string_view data = buffer.view();
+    while (pos < data.size() && !m_complete) {
+        switch (m_state) {
+        case State::Head: {
+            if (m_headSize == 0) {
+                const std::size_t end = data.find("\r\n\r\n", pos);
+                if (end != std::string_view::npos) {
+                    const std::size_t size = end + 4 - pos;
+                    if (size > m_limits.maxHeaderSize) return fail();
+                    pos += size;
+                    if (!parseHead(buffer, data.substr(pos - size, size))) return false;
+                    break;
+                }
+                m_head = RecvBufferPool::acquire();
+            }
+
+            // the head continues in a later buffer; collect it, searching only the new bytes and the 3 before them
+            const std::size_t take = std::min(data.size() - pos, m_limits.maxHeaderSize - m_headSize);
+            std::memcpy(m_head.writableData() + m_headSize, data.data() + pos, take);
+            const std::string_view collected(m_head.data(), m_headSize + take);
+            const std::size_t end = collected.find("\r\n\r\n", m_headSize >= 3 ? m_headSize - 3 : 0);
+            if (end == std::string_view::npos) {
+                if (collected.size() == m_limits.maxHeaderSize) return fail();
+                m_headSize = collected.size();
+                pos += take;
+                break;
+            }
+            pos += end + 4 - m_headSize;
+            m_head.resize(end + 4);
+            m_headSize = 0;
+            const RecvBuffer head = std::move(m_head);
+            if (!parseHead(head, head.view())) return false;
+            break;
+        }
+        case State::Body:
+        case State::ChunkData: {
+            const std::size_t take = std::min(m_remaining, data.size() - pos);
+            addBody(buffer, pos, take);
+            pos += take;
+            m_remaining -= take;
+            if (m_remaining != 0) break;
+            if (m_state == State::Body) {
+                complete();
+            } else {
+                m_state = State::ChunkDataEnd;
+                m_crlfSeen = 0;
+            }
+            break;
+        }
+        case State::ChunkDataEnd:
+            if (data[pos] != "\r\n"[m_crlfSeen]) return fail();
+            ++pos;
+            if (++m_crlfSeen == 2) m_state = State::ChunkSize;
+            break;
+        case State::ChunkSize: {
+            std::string_view line;
+            if (!readLine(data, pos, line)) return !failed();
+            std::size_t size = 0;
+            bool tooLarge = false;
+            const bool valid = parseChunkSize(line, m_limits.maxBodySize, size, tooLarge);
+            m_line.clear();
+            if (!valid || m_bodySize + size > m_limits.maxBodySize) return fail();
+            m_remaining = size;
+            m_state = size == 0 ? State::Trailer : State::ChunkData;
+            break;
+        }
+        case State::Trailer: {
+            // trailer fields are skipped, up to the empty line
+            std::string_view line;
+            if (!readLine(data, pos, line)) return !failed();
+            const bool last = line.empty();
+            m_line.clear();
+            if (last) complete();
+            break;
+        }
+        case State::UntilClose:
+            if (m_bodySize + data.size() - pos > m_limits.maxBodySize) return fail();
+            addBody(buffer, pos, data.size() - pos);
+            pos = data.size();
+            break;
+        case State::Failed:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HttpResponseParser::parseHead(const RecvBuffer& holder, std::string_view head)
+{
+    HttpClientResponse& response = m_response;
+    response.headers.clear();
+
+    // status-line = HTTP-version SP status-code SP [ reason-phrase ]
+    const std::size_t lineEnd = head.find("\r\n");
+    const std::string_view line = head.substr(0, lineEnd);
+    if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || (line[7] != '0' && line[7] != '1') || line[8] != ' ') {
+        return fail();
+    }
+    int status = 0;
+    for (const char c : line.substr(9, 3)) {
+        if (c < '0' || c > '9') return fail();
+        status = status * 10 + (c - '0');
+    }
+    if (status < 100 || (line.size() > 12 && line[12] != ' ')) return fail();
+    if (parseFields(head, lineEnd + 2, m_limits.maxHeaders, response.headers) != FieldsResult::Ok) return fail();
+
+    // interim responses (100 Continue, 103 Early Hints) precede the final one and are dropped
+    if (status < 200 && status != 101) return true;
+
+    if (m_expected.empty()) return fail();
+    const bool toHead = m_expected.front();
+    m_expected.pop_front();
+
+    response.status = status;
+    response.minorVersion = line[7] - '0';
+    response.reason = line.size() > 13 ? line.substr(13) : std::string_view();
+    keep(holder);
+
+    bool hasLength = false;
+    std::size_t length = 0;
+    bool chunked = false;
+    bool transferCoded = false;
+    std::string_view connection;
+    for (const auto& header : response.headers) {
+        if (httpEqualsIgnoreCase(header.name, "Content-Length")) {
+            std::size_t value = 0;
+            if (!parseDecimal(header.value, value) || (hasLength && value != length)) return fail();
+            hasLength = true;
+            length = value;
+        } else if (httpEqualsIgnoreCase(header.name, "Transfer-Encoding")) {
+            // framed by chunked if it is the last coding; the others are left to the caller
+            transferCoded = true;
+            const std::size_t comma = header.value.rfind(',');
+            chunked = httpEqualsIgnoreCase(trimWhitespace(header.value.substr(comma + 1)), "chunked");
+        } else if (httpEqualsIgnoreCase(header.name, "Connection")) {
+            connection = header.value;
+        }
+    }
+    // both at once point at response splitting (RFC 9112, section 6.3)
+    if (hasLength && transferCoded) return fail();
+    response.keepAlive = response.minorVersion == 1 ? !httpHasToken(connection, "close")
+                                                    : httpHasToken(connection, "keep-alive");
+
+    // RFC 9110, section 6.4.1: no content for HEAD, 1xx, 204 and 304, whatever the headers say
+    if (toHead || status < 200 || status == 204 || status == 304 || (hasLength && length == 0)) {
+        complete();
+    } else if (hasLength) {
+        if (length > m_limits.maxBodySize) return fail();
+        m_remaining = length;
+        m_state = State::Body;
+    } else if (chunked) {
+        m_state = State::ChunkSize;
+    } else {
+        m_state = State::UntilClose;
+        response.keepAlive = false;
+    }
+    return true;
+}
+
+bool HttpResponseParser::readLine(std::string_view data, std::size_t& pos, std::string_view& line)
+{
+    const std::size_t newline = data.find('\n', pos);
+    if (newline == std::string_view::npos) {
+        if (m_line.size() + data.size() - pos > maxChunkLine) return fail();
+        m_line.append(data.substr(pos));
+        pos = data.size();
+        return false;
+    }
+    line = data.substr(pos, newline - pos);
+    pos = newline + 1;
+    if (!m_line.empty()) {
+        m_line.append(line);
+        line = m_line;
+    }
+    if (line.empty() || line.back() != '\r' || line.size() > maxChunkLine) return fail();
+    line.remove_suffix(1);
+    return true;
+}
+
+void HttpResponseParser::addBody(const RecvBuffer& buffer, std::size_t pos, std::size_t size)
+{
+    if (size == 0) return;
+    keep(buffer);
+    m_bodySize += size;
+    const char* const bytes = buffer.data() + pos;
+    auto& body = m_response.body;
+    // chunks that sit back to back in one buffer make a single segment
+    if (!body.empty() && body.back().data() + body.back().size() == bytes) {
+        body.back() = std::string_view(body.back().data(), body.back().size() + size);
+    } else {
+        body.emplace_back(bytes, size);
+    }
+}
+
+void HttpResponseParser::keep(const RecvBuffer& buffer)
+{
+    auto& buffers = m_response.m_buffers;
+    if (buffers.empty() || buffers.back().data() != buffer.data()) buffers.push_back(buffer);
+}
+
+void HttpResponseParser::complete()
+{
+    m_complete = true;
+    m_state = State::Head;
+}
+
+bool HttpResponseParser::fail()
+{
+    m_state = State::Failed;
+    m_head = {};
+    m_headSize = 0;
+    return false;
+}
+
+HttpClientResponse HttpResponseParser::takeResponse()
+{
+    HttpClientResponse response = std::move(m_response);
+    m_response = {};
+    m_complete = false;
+    m_bodySize = 0;
+    return response;
+}
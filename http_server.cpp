@@ -0,0 +1,260 @@
+#include "http_server.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <map>
+
+namespace
+{
+void appendResponse(std::string& out, const HttpResponse& response, bool keepAlive, int minorVersion,
+                    bool headRequest)
+{
+    out += "HTTP/1.1 ";
+    appendNumber(out, response.status);
+    out += ' ';
+    out += httpReasonPhrase(response.status);
+    out += "\r\n";
+    for (const auto& [name, value] : response.headers) {
+        out += name;
+        out += ": ";
+        out += value;
+        out += "\r\n";
+    }
+    // RFC 9110, section 6.4.1: no content for 1xx, 204 and 304
+    const bool hasContent = response.status >= 200 && response.status != 204 && response.status != 304;
+    if (hasContent) {
+        out += "Content-Length: ";
+        appendNumber(out, response.body.size());
+        out += "\r\n";
+    }
+    if (!keepAlive) out += "Connection: close\r\n";
+    else if (minorVersion == 0) out += "Connection: keep-alive\r\n";
+    out += "\r\n";
+    if (hasContent && !headRequest) out += response.body;
+}
+} // namespace
+
+std::string_view httpReasonPhrase(int status)
+{
+    switch (status) {
+    case 100: return "Continue";
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 303: return "See Other";
+    case 304: return "Not Modified";
+    case 307: return "Temporary Redirect";
+    case 308: return "Permanent Redirect";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 413: return "Content Too Large";
+    case 414: return "URI Too Long";
+    case 415: return "Unsupported Media Type";
+    case 426: return "Upgrade Required";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Unknown";
+    }
+}
+
+void HttpRouter::add(std::string method, std::string path, HttpHandler handler)
+{
+    const bool prefix = !path.empty() && path.back() == '*';
+    if (prefix) path.pop_back();
+    m_routes.push_back({std::move(path), prefix, {std::move(method), std::move(handler)}});
+}
+
+void HttpRouter::compile()
+{
+    struct BuildNode {
+        std::map<char, uint32_t> children;
+        int32_t exact{-1};
+        int32_t prefix{-1};
+    };
+    std::vector<BuildNode> build(1);
+    m_targets.clear();
+    for (const auto& pending : m_routes) {
+        uint32_t node = 0;
+        for (const char byte : pending.path) {
+            const auto it = build[node].children.find(byte);
+            if (it != build[node].children.end()) {
+                node = it->second;
+                continue;
+            }
+            const auto child = (uint32_t)build.size();
+            build.emplace_back();
+            build[node].children.emplace(byte, child);
+            node = child;
+        }
+        int32_t& target = pending.prefix ? build[node].prefix : build[node].exact;
+        if (target < 0) {
+            target = (int32_t)m_targets.size();
+            m_targets.emplace_back();
+        }
+        m_targets[target].push_back(pending.route);
+    }
+
+    // breadth first, so the edges of a node sit next to each other, already sorted by the map
+    m_nodes.assign(build.size(), {});
+    m_edges.clear();
+    std::vector<uint32_t> order{0};
+    order.reserve(build.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        const BuildNode& from = build[order[i]];
+        Node& node = m_nodes[i];
+        node.exact = from.exact;
+        node.prefix = from.prefix;
+        node.firstEdge = (uint32_t)m_edges.size();
+        node.edgeCount = (uint32_t)from.children.size();
+        for (const auto& [byte, child] : from.children) {
+            m_edges.push_back({byte, (uint32_t)order.size()});
+            order.push_back(child);
+        }
+    }
+}
+
+HttpRouter::Match HttpRouter::find(std::string_view method, std::string_view path) const
+{
+    if (m_nodes.empty()) return {};
+
+    uint32_t node = 0;
+    int32_t prefix = m_nodes[0].prefix;
+    bool whole = true;
+    for (const char byte : path) {
+        const Node& current = m_nodes[node];
+        const Edge* first = m_edges.data() + current.firstEdge;
+        const Edge* last = first + current.edgeCount;
+        const Edge* edge = std::lower_bound(first, last, byte, [](const Edge& e, char b) { return e.byte < b; });
+        if (edge == last || edge->byte != byte) {
+            whole = false;
+            break;
+        }
+        node = edge->child;
+        if (m_nodes[node].prefix >= 0) prefix = m_nodes[node].prefix;
+    }
+
+    Match match;
+    const int32_t exact = whole ? m_nodes[node].exact : -1;
+    for (const int32_t target : {exact, prefix}) {
+        if (target < 0) continue;
+        match.pathFound = true;
+        match.handler = findInTarget(target, method);
+        if (match.handler) break;
+    }
+    return match;
+}
+
+const HttpHandler* HttpRouter::findInTarget(int32_t target, std::string_view method) const
+{
+    for (const auto& route : m_targets[target]) {
+        if (route.method.empty() || route.method == method) return &route.handler;
+    }
+    if (method == "HEAD") return findInTarget(target, "GET");
+    return nullptr;
+}
+
+struct HttpServer::Connection {
+    Connection(const TCPConnInfo& connInfo, const HttpParserLimits& limits) : connInfo(connInfo), parser(limits) {}
+
+    const TCPConnInfo connInfo;
+    ScopedEventConnection dataConnection;
+
+    // only touched by the connection's event loop
+    HttpRequestParser parser;
+    HttpResponse response; // reused for every request
+    std::string out;       // responses to the buffer being handled
+    bool closing{false};   // the last response is out; later requests are ignored
+};
+
+HttpServer::HttpServer(TCPConnectionManager& tcpConnMgr, HttpRouter router, HttpServerOptions options)
+    : m_router(std::move(router)), m_options(options),
+      m_server(
+          tcpConnMgr,
+          [this](const TCPConnInfo& connInfo, TCPConnection&) {
+              return std::make_shared<Connection>(connInfo, m_options.limits);
+          },
+          [this](Connection& conn, const RecvBuffer& buffer) { onData(conn, buffer); })
+{
+    m_router.compile();
+}
+
+HttpServer::~HttpServer()
+{
+    m_server.stop();
+}
+
+bool HttpServer::start(const std::string& address, uint16_t port)
+{
+    return m_server.start(address, port, m_options.shards);
+}
+
+std::size_t HttpServer::connectionCount() const
+{
+    return m_server.connectionCount();
+}
+
+void HttpServer::onData(Connection& conn, const RecvBuffer& buffer)
+{
+    if (conn.closing) return;
+
+    bool close = false;
+    const bool ok = conn.parser.feed(buffer.view(), [&](const HttpRequest& request) {
+        if (close) return; // pipelined behind a request that ends the connection
+        respond(conn, request);
+        close = !request.keepAlive;
+    });
+    if (!ok && !close) {
+        const int status = conn.parser.errorStatus();
+        HttpResponse response{.status = status, .headers = {}, .body = std::string(httpReasonPhrase(status))};
+        appendResponse(conn.out, response, false, 1, false);
+        close = true;
+    }
+
+    conn.closing = close;
+    m_server.flush(conn);
+}
+
+void HttpServer::respond(Connection& conn, const HttpRequest& request)
+{
+    HttpResponse& response = conn.response;
+    response.status = 200;
+    response.headers.clear();
+    response.body.clear();
+
+    const auto match = m_router.find(request.method, request.path);
+    if (match.handler) {
+        try {
+            (*match.handler)(request, response);
+        } catch (const std::exception& e) {
+            std::cerr << std::format("handler for {} {} threw: {}\n", request.method, request.path, e.what());
+            response.status = 500;
+            response.headers.clear();
+            response.body.clear();
+        }
+    } else {
+        response.status = match.pathFound ? 405 : 404;
+        response.body = httpReasonPhrase(response.status);
+    }
+
+    appendResponse(conn.out, response, request.keepAlive, request.minorVersion, request.method == "HEAD");
+    ++m_requestsServed;
+}
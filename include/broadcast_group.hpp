@@ -0,0 +1,75 @@
+#ifndef _BROADCAST_GROUP_HEADER_HPP_
+#define _BROADCAST_GROUP_HEADER_HPP_ 1
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_signal.hpp"
+#include "tcp_connection_manager.hpp"
+
+/**
+ * @brief Fan-out of one message to many connections.
+ *
+ * Subscribers are grouped by the event loop owning them. publish() wraps the message in a single shared buffer and
+ * posts one task per loop; each loop appends that buffer to the outbound queues of its subscribers and flushes
+ * them, so the caller's cost depends on the number of loops rather than subscribers, and the sends run on all
+ * loops in parallel. Thread-safe; closed connections unsubscribe themselves.
+ *
+ * A stalled subscriber only grows its own queue; give the group write buffer limits to bound that queue and pick
+ * what happens to the slow subscriber (see SlowConsumerPolicy).
+ */
+class BroadcastGroup
+{
+public:
+    explicit BroadcastGroup(TCPConnectionManager& tcpConnMgr);
+    BroadcastGroup(const BroadcastGroup& other) = delete;
+    ~BroadcastGroup();
+
+    // false if there is no such connection
+    bool subscribe(ConnHandle conn);
+    // leaves a newer connection on the same socket subscribed, unless the handle's generation is 0
+    void unsubscribe(ConnHandle conn);
+    std::size_t size() const;
+
+    // applied to every current and future subscriber
+    void setWriteBufferLimits(const WriteBufferLimits& limits);
+
+    // returns the number of subscribers the message was queued for
+    std::size_t publish(std::string message);
+    std::size_t publish(SharedBuffer message);
+
+private:
+    struct Bucket {
+        explicit Bucket(EventLoop& loop) : loop(loop) {}
+
+        EventLoop& loop;
+        std::mutex mutex;
+        std::unordered_map<SOCKET, std::shared_ptr<TCPConnection>> members;
+    };
+
+    struct Membership {
+        uint32_t generation;
+        std::shared_ptr<Bucket> bucket;
+    };
+
+    // m_mutex held
+    void removeMember(std::unordered_map<SOCKET, Membership>::iterator it);
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+
+    mutable std::mutex m_mutex;
+    // one per event loop that ever had a subscriber; never removed, so publish() can post without holding m_mutex
+    std::vector<std::shared_ptr<Bucket>> m_buckets;
+    std::unordered_map<SOCKET, Membership> m_members;
+    std::optional<WriteBufferLimits> m_writeLimits;
+
+    ScopedEventConnection m_closedConnection;
+};
+
+#endif //!_BROADCAST_GROUP_HEADER_HPP_
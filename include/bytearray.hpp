@@ -2,7 +2,20 @@
 #define _BYTEARRAY_HEADER_HPP_ 1
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <assert.h>
 
@@ -18,9 +31,18 @@ namespace util
     }
 }
 
-// template <class Iter = std::random_access_iterator<char>, class Allocator = std::allocator<char> >
-class ByteArray
+/**
+ * @brief Byte array with small-buffer optimisation.
+ *
+ * Up to InlineCapacity bytes live inside the object itself, so the short headers and tokens most messages are made
+ * of never touch the heap; growing past that moves the bytes to a heap buffer transparently, which then grows by
+ * doubling like std::vector. data() always points at the bytes, inline or not, so element access has no branch.
+ */
+template <std::size_t InlineCapacity>
+class BasicByteArray
 {
+    static_assert(InlineCapacity > 0, "BasicByteArray needs some inline storage");
+
 public:
     using value_type = char;
     using size_type = std::size_t;
@@ -29,277 +51,310 @@ public:
     using const_pointer = const char*;
     using reference = char&;
     using const_reference = const char&;
-    using iterator = std::vector<char>::iterator;
-    using const_iterator = std::vector<char>::const_iterator;
-    using reverse_iterator = std::vector<char>::const_reverse_iterator;
-    using const_reverse_iterator = std::vector<char>::const_reverse_iterator;
+    using iterator = char*;
+    using const_iterator = const char*;
+    using reverse_iterator = std::reverse_iterator<char*>;
+    using const_reverse_iterator = std::reverse_iterator<const char*>;
 
-    ByteArray(ByteArray&& other) = default;
-    ByteArray(const ByteArray& other) = default;
-    ByteArray() = default;
-    ByteArray& operator=(ByteArray&& other) = default;
-    ByteArray& operator=(const ByteArray& other) = default;
+    static constexpr std::size_t inlineCapacity = InlineCapacity;
 
-    ByteArray(std::size_t size, char ch) {}
+    BasicByteArray() = default;
 
-    ByteArray(const char* str, std::size_t size = -1)
+    BasicByteArray(const BasicByteArray& other)
     {
-        if (size != -1) {
-            data_.reserve(size);
-            for (std::size_t i = 0; i < size; i++) data_.emplace_back(str[i]);
+        appendBytes(other.data_, other.size_);
+    }
 
-        } else {
-            for (const char* t = str; *t != '\0'; t++) data_.emplace_back(*t);
+    BasicByteArray(BasicByteArray&& other) noexcept
+    {
+        steal(other);
+    }
+
+    BasicByteArray& operator=(const BasicByteArray& other)
+    {
+        if (this != &other) {
+            size_ = 0;
+            appendBytes(other.data_, other.size_);
         }
+        return *this;
     }
 
-    ByteArray(std::vector<char> ba)
+    BasicByteArray& operator=(BasicByteArray&& other) noexcept
     {
-        this->data_ = std::move(ba);
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
     }
 
-    ByteArray(const std::string& str)
+    ~BasicByteArray()
     {
-        std::copy(str.begin(), str.end(), std::back_inserter(data_));
+        release();
     }
 
-    std::string toStdString() const
+    BasicByteArray(std::size_t size, char ch)
     {
-        std::string rv(data_.begin(), data_.end());
-        return rv;
+        append(size, ch);
     }
 
-    const char* data() const
+    BasicByteArray(const char* str, std::size_t size = -1)
     {
-        return data_.data();
+        appendBytes(str, size != std::size_t(-1) ? size : std::strlen(str));
     }
 
-    char* data()
+    BasicByteArray(const std::vector<char>& ba)
     {
-        return data_.data();
+        appendBytes(ba.data(), ba.size());
     }
 
-    ByteArray& fill(char ch, std::size_t size = -1)
+    BasicByteArray(const std::string& str)
     {
-        data_.reserve(size);
-        for (int i = 0; i < size; ++i) data_.emplace_back(ch);
+        appendBytes(str.data(), str.size());
+    }
 
-        return *this;
+    // true while the bytes fit in the object and no heap buffer is held
+    bool isInline() const
+    {
+        return data_ == buffer_;
+    }
+
+    std::string toStdString() const
+    {
+        return std::string(data_, size_);
+    }
+
+    const char* data() const
+    {
+        return data_;
+    }
+
+    char* data()
+    {
+        return data_;
     }
 
-    ByteArray& append(const ByteArray& other)
+    // every byte set to ch, after resizing to size unless it is -1
+    BasicByteArray& fill(char ch, std::size_t size = -1)
     {
-        data_.insert(data_.end(), other.begin(), other.end());
+        if (size != std::size_t(-1)) resize(size);
+        std::memset(data_, ch, size_);
         return *this;
     }
 
-    ByteArray& append(const std::vector<char>& data)
+    BasicByteArray& append(const BasicByteArray& other)
     {
-        data_.insert(data_.end(), data.begin(), data.end());
+        appendBytes(other.data_, other.size_);
         return *this;
     }
 
-    ByteArray& append(char ch)
+    BasicByteArray& append(const std::vector<char>& data)
     {
-        data_.emplace_back(ch);
+        appendBytes(data.data(), data.size());
         return *this;
     }
 
-    ByteArray& append(std::size_t count, char ch)
+    BasicByteArray& append(char ch)
     {
-        for (int i = 0; i < count; ++i) data_.emplace_back(ch);
+        if (size_ == capacity_) grow(size_ + 1);
+        data_[size_++] = ch;
         return *this;
     }
 
-    ByteArray& append(const char* str)
+    BasicByteArray& append(std::size_t count, char ch)
     {
-        for (const char* t = str; *t != '\0'; t++) data_.emplace_back(*t);
+        std::memset(appendUninitialized(count), ch, count);
         return *this;
     }
 
-    ByteArray& append(const char* str, std::size_t len)
+    BasicByteArray& append(const char* str)
     {
-        for (int i = 0; i < len; ++i) data_.emplace_back(str[i]);
+        appendBytes(str, std::strlen(str));
         return *this;
     }
 
-    ByteArray& append(ByteArray other)
+    BasicByteArray& append(const char* str, std::size_t len)
     {
-        data_.insert(data_.end(), other.begin(), other.end());
+        appendBytes(str, len);
         return *this;
     }
 
     char at(std::size_t i) const
     {
-        return data_.at(i);
+        if (i >= size_) throw std::out_of_range("BasicByteArray::at");
+        return data_[i];
     }
 
     char back() const
     {
-        return data_.back();
+        return data_[size_ - 1];
     }
 
     char& back()
     {
-        return data_.back();
+        return data_[size_ - 1];
     }
 
-    ByteArray::iterator begin()
+    iterator begin()
     {
-        return data_.begin();
+        return data_;
     }
 
-    ByteArray::const_iterator begin() const
+    const_iterator begin() const
     {
-        return data_.begin();
+        return data_;
     }
 
     std::size_t capacity() const
     {
-        return data_.capacity();
+        return capacity_;
     }
 
-    ByteArray::const_iterator cbegin() const
+    const_iterator cbegin() const
     {
-        return data_.cbegin();
+        return data_;
     }
 
-    ByteArray::const_iterator cend() const
+    const_iterator cend() const
     {
-        return data_.cend();
+        return data_ + size_;
     }
 
     void chop(std::size_t n)
     {
-        for (int i = 0; i < n; ++i) data_.pop_back();
+        size_ -= std::min(n, size_);
     }
 
-    ByteArray chopped(std::size_t len) const
+    BasicByteArray chopped(std::size_t len) const
     {
         // The behavior is undefined if len is negative or greater than size().
-        ByteArray rv;
-        for (int i = 0; i < len; ++i) rv.append(data_[i]);
-        return rv;
+        return BasicByteArray(data_, len);
     }
 
     void clear()
     {
-        data_.clear();
+        size_ = 0;
     }
 
-    // int compare(ByteArray bv, Qt::CaseSensitivity cs = Qt::CaseSensitive) const {}
+    // int compare(BasicByteArray bv, Qt::CaseSensitivity cs = Qt::CaseSensitive) const {}
 
-    ByteArray::const_iterator constBegin() const
+    const_iterator constBegin() const
     {
-        return data_.cbegin();
+        return data_;
     }
 
     const char* constData() const
     {
-        return data_.data();
+        return data_;
     }
 
-    ByteArray::const_iterator constEnd() const
+    const_iterator constEnd() const
     {
-        return data_.cend();
+        return data_ + size_;
     }
 
-    bool contains(ByteArray other) const
+    bool contains(const BasicByteArray& other) const
     {
-        return util::contains(this->toStdString(), other.toStdString());
+        return util::contains(view(), other.view());
     }
 
     bool contains(char ch) const
     {
-        const std::string s(1, ch);
-        return util::contains(this->toStdString(), s);
+        return size_ && std::memchr(data_, ch, size_);
     }
 
-    std::size_t count(const ByteArray& bv) const
+    // non-overlapping occurrences of bv
+    std::size_t count(const BasicByteArray& bv) const
     {
-        assert(true && "Not YET IMPLEMENTED");
-        return 0;
+        if (bv.isEmpty()) return size_ + 1;
+        std::size_t rv = 0;
+        for (std::size_t pos = view().find(bv.view()); pos != std::string_view::npos;
+             pos = view().find(bv.view(), pos + bv.size_)) {
+            ++rv;
+        }
+        return rv;
     }
 
     std::size_t count(char ch) const
     {
-        return std::count(data_.begin(), data_.end(), ch);
+        return std::count(begin(), end(), ch);
     }
 
     std::size_t count() const
     {
-        return data_.size();
+        return size_;
     }
 
-    ByteArray::const_reverse_iterator crbegin() const
+    const_reverse_iterator crbegin() const
     {
-        return data_.crbegin();
+        return const_reverse_iterator(cend());
     }
 
-    ByteArray::const_reverse_iterator crend() const
+    const_reverse_iterator crend() const
     {
-        return data_.crend();
+        return const_reverse_iterator(cbegin());
     }
 
-    ByteArray::iterator end()
+    iterator end()
     {
-        return data_.end();
+        return data_ + size_;
     }
 
-    ByteArray::const_iterator end() const
+    const_iterator end() const
     {
-        return data_.end();
+        return data_ + size_;
     }
 
-    bool endsWith(ByteArray bv) const
+    bool endsWith(const BasicByteArray& bv) const
     {
-        std::string s1 = this->toStdString();
-        std::string s2 = bv.toStdString();
-
-        std::reverse(s1.begin(), s1.end());
-        std::reverse(s2.begin(), s2.end());
-
-        return s1.starts_with(s2);
+        return view().ends_with(bv.view());
     }
 
     bool endsWith(char ch) const
     {
-        return data_.back() == ch;
+        return size_ && data_[size_ - 1] == ch;
     }
 
-    ByteArray::iterator erase(ByteArray::const_iterator first, ByteArray::const_iterator last)
+    iterator erase(const_iterator first, const_iterator last)
     {
-        return data_.erase(first, last);
+        const std::size_t pos = first - data_;
+        const std::size_t len = last - first;
+        std::memmove(data_ + pos, data_ + pos + len, size_ - pos - len);
+        size_ -= len;
+        return data_ + pos;
     }
 
     /**
      * @brief The behavior is undefined when n < 0 or n > size().
      *
      * @param n
-     * @return ByteArray
+     * @return BasicByteArray
      */
-    ByteArray first(std::size_t n) const
+    BasicByteArray first(std::size_t n) const
     {
-        if (n > data_.size()) return ByteArray();
-
-        ByteArray rv;
-        for (std::size_t i = 0; i < n; ++i) rv.append(this->at(i));
-
-        return rv;
+        if (n > size_) return BasicByteArray();
+        return BasicByteArray(data_, n);
     }
 
     char front() const
     {
-        return *data_.cbegin();
+        return data_[0];
     }
     char& front()
     {
-        return *data_.begin();
+        return data_[0];
     }
 
-    std::size_t indexOf(ByteArray bv, std::size_t from = 0) const {}
+    // -1 (npos) when not found, as for every search below
+    std::size_t indexOf(const BasicByteArray& bv, std::size_t from = 0) const
+    {
+        return view().find(bv.view(), from);
+    }
 
-    std::size_t indexOf(char ch, std::size_t from = 0) const {}
+    std::size_t indexOf(char ch, std::size_t from = 0) const
+    {
+        return view().find(ch, from);
+    }
 
     /**
      * @brief If i is beyond the end of the array, the array is first extended with space characters to reach this
@@ -307,159 +362,183 @@ public:
      *
      * @param i
      * @param s
-     * @return ByteArray&
+     * @return BasicByteArray&
      */
-    ByteArray& insert(std::size_t i, const char* str)
+    BasicByteArray& insert(std::size_t i, const char* str)
     {
-        std::size_t runningIdx = 0;
-        for (const char* t = str; *t != '\0'; t++) {
-            this->insert(i + runningIdx, *t);
-            runningIdx++;
-        }
+        insertBytes(i, str, std::strlen(str));
         return *this;
     }
 
-    ByteArray& insert(std::size_t i, const ByteArray& other)
+    BasicByteArray& insert(std::size_t i, const BasicByteArray& other)
     {
-        std::size_t runningIdx = 0;
-        for (auto it = other.cbegin(); it != other.cend(); ++it) {
-            this->insert(i + runningIdx, *it);
-            runningIdx++;
-        }
+        insertBytes(i, other.data_, other.size_);
         return *this;
     }
 
-    ByteArray& insert(std::size_t i, std::size_t count, char ch)
+    BasicByteArray& insert(std::size_t i, std::size_t count, char ch)
     {
-        std::size_t runningIdx = 0;
-        for (std::size_t i = 0; i < count; i++) {
-            this->insert(i + runningIdx, ch);
-            runningIdx++;
-        }
+        std::memset(insertGap(i, count), ch, count);
         return *this;
     }
 
-    ByteArray& insert(std::size_t i, char ch)
+    BasicByteArray& insert(std::size_t i, char ch)
     {
-        if (i >= data_.size() - 1) {
-            while (i < data_.size() - 1) { data_.push_back(' '); }
-            data_.push_back(ch);
-        } else {
-            std::size_t idx = 0;
-            auto it = data_.begin();
-            for (; it != data_.end(); ++it) {
-                if (idx == i) break;
-                idx++;
-            }
-            data_.insert(it, ch);
-        }
+        *insertGap(i, 1) = ch;
         return *this;
     }
 
-    ByteArray& insert(std::size_t i, const char* data, std::size_t len)
+    BasicByteArray& insert(std::size_t i, const char* data, std::size_t len)
     {
-        std::size_t runningIdx = 0;
-        for (std::size_t i = 0; i < len; i++) {
-            this->insert(i + runningIdx, data[i]);
-            runningIdx++;
-        }
+        insertBytes(i, data, len);
         return *this;
     }
 
     bool isEmpty() const
     {
-        return data_.empty();
+        return size_ == 0;
     }
 
     bool isLower() const
     {
-        for (auto it = data_.begin(); it != data_.end(); ++it) {
-            if (!std::islower(*it)) return false;
+        for (auto it = begin(); it != end(); ++it) {
+            if (!std::islower((unsigned char)*it)) return false;
         }
         return true;
     }
 
+    // empty and holding no heap buffer; the data pointer itself is never null
     bool isNull() const
     {
-        const char* p = data_.data();
-        if (!p) return true;
-        return false;
+        return size_ == 0 && isInline();
     }
 
     bool isUpper() const
     {
-        for (auto it = data_.begin(); it != data_.end(); ++it) {
-            if (!std::isupper(*it)) return false;
+        for (auto it = begin(); it != end(); ++it) {
+            if (!std::isupper((unsigned char)*it)) return false;
         }
         return true;
     }
 
-    bool isValidUtf8() const {}
+    // rejects overlong forms, surrogates and code points past U+10FFFF
+    bool isValidUtf8() const
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(data_);
+        const auto* end = p + size_;
+        while (p != end) {
+            const unsigned char lead = *p++;
+            if (lead < 0x80) continue;
 
-    ByteArray last(std::size_t n) const {}
+            std::size_t trailing;
+            std::uint32_t cp;
+            if ((lead & 0xE0) == 0xC0) trailing = 1, cp = lead & 0x1F;
+            else if ((lead & 0xF0) == 0xE0) trailing = 2, cp = lead & 0x0F;
+            else if ((lead & 0xF8) == 0xF0) trailing = 3, cp = lead & 0x07;
+            else return false;
 
-    std::size_t lastIndexOf(ByteArray bv, std::size_t from) const {}
-    std::size_t lastIndexOf(char ch, std::size_t from = -1) const {}
-    std::size_t lastIndexOf(ByteArray bv) const {}
+            if (std::size_t(end - p) < trailing) return false;
+            for (std::size_t i = 0; i < trailing; ++i, ++p) {
+                if ((*p & 0xC0) != 0x80) return false;
+                cp = (cp << 6) | (*p & 0x3F);
+            }
 
-    ByteArray left(std::size_t len) const {}
-    ByteArray leftJustified(std::size_t width, char fill = ' ', bool truncate = false) const {}
+            static constexpr std::uint32_t minimum[] = {0, 0x80, 0x800, 0x10000};
+            if (cp < minimum[trailing] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        }
+        return true;
+    }
 
-    std::size_t length() const
+    /**
+     * @brief The behavior is undefined when n < 0 or n > size().
+     */
+    BasicByteArray last(std::size_t n) const
+    {
+        if (n > size_) return BasicByteArray();
+        return BasicByteArray(data_ + size_ - n, n);
+    }
+
+    std::size_t lastIndexOf(const BasicByteArray& bv, std::size_t from) const
+    {
+        return view().rfind(bv.view(), from);
+    }
+
+    std::size_t lastIndexOf(char ch, std::size_t from = -1) const
     {
-        return data_.size();
+        return view().rfind(ch, from);
     }
 
-    ByteArray mid(std::size_t pos, std::size_t len = -1) const
+    std::size_t lastIndexOf(const BasicByteArray& bv) const
     {
-        if (len != -1) return this->sliced(pos, len);
+        return view().rfind(bv.view());
+    }
 
-        ByteArray rv;
-        for (std::size_t i = pos; i < this->size(); i++) rv.append(this->at(i));
+    // the whole array if len is past the end
+    BasicByteArray left(std::size_t len) const
+    {
+        return BasicByteArray(data_, std::min(len, size_));
+    }
+
+    BasicByteArray leftJustified(std::size_t width, char fill = ' ', bool truncate = false) const
+    {
+        if (size_ >= width) return truncate ? left(width) : *this;
+        BasicByteArray rv(*this);
+        rv.append(width - size_, fill);
         return rv;
     }
 
-    ByteArray& prepend(char ch)
+    std::size_t length() const
+    {
+        return size_;
+    }
+
+    BasicByteArray mid(std::size_t pos, std::size_t len = -1) const
+    {
+        if (len != std::size_t(-1)) return this->sliced(pos, len);
+        return this->sliced(pos);
+    }
+
+    BasicByteArray& prepend(char ch)
     {
         return this->insert(0, ch);
     }
 
-    ByteArray& prepend(std::size_t count, char ch)
+    BasicByteArray& prepend(std::size_t count, char ch)
     {
         return this->insert(0, count, ch);
     }
 
-    ByteArray& prepend(const char* str)
+    BasicByteArray& prepend(const char* str)
     {
         return this->insert(0, str);
     }
 
-    ByteArray& prepend(const char* str, std::size_t len)
+    BasicByteArray& prepend(const char* str, std::size_t len)
     {
         return this->insert(0, str, len);
     }
 
-    ByteArray& prepend(const ByteArray& other)
+    BasicByteArray& prepend(const BasicByteArray& other)
     {
         return this->insert(0, other);
     }
 
-    void push_back(const ByteArray& other)
+    void push_back(const BasicByteArray& other)
     {
-        data_.insert(data_.end(), other.begin(), other.end());
+        appendBytes(other.data_, other.size_);
     }
 
     void push_back(char ch)
     {
-        data_.push_back(ch);
+        append(ch);
     }
 
     void push_back(const char* str)
     {
-        for (const char* t = str; *t != '\0'; t++) data_.emplace_back(*t);
+        appendBytes(str, std::strlen(str));
     }
 
-    void push_front(const ByteArray& other)
+    void push_front(const BasicByteArray& other)
     {
         this->insert(0, other);
     }
@@ -474,14 +553,14 @@ public:
         this->insert(0, str);
     }
 
-    ByteArray::reverse_iterator rbegin()
+    reverse_iterator rbegin()
     {
-        return data_.rbegin();
+        return reverse_iterator(end());
     }
 
-    ByteArray::const_reverse_iterator rbegin() const
+    const_reverse_iterator rbegin() const
     {
-        return data_.rbegin();
+        return const_reverse_iterator(end());
     }
 
     /**
@@ -491,66 +570,127 @@ public:
      *
      * @param pos
      * @param len
-     * @return ByteArray&
+     * @return BasicByteArray&
      */
-    ByteArray& remove(std::size_t pos, std::size_t len)
+    BasicByteArray& remove(std::size_t pos, std::size_t len)
     {
-        if (pos > this->size()) return *this;
-
-        if (pos + len > this->size()) {
-            for (std::size_t i = pos; i < this->size(); ++i) data_.pop_back();
+        if (pos > size_) return *this;
 
+        if (len > size_ - pos) {
+            size_ = pos;
             return *this;
         }
 
-        ByteArray rv;
-        for (std::size_t i = 0; i < pos; ++i) rv.append(this->at(i));
-        for (std::size_t i = pos + len; i < this->size(); ++i) rv.append(this->at(i));
-
-        data_ = std::move(rv.data_);
-
+        erase(data_ + pos, data_ + pos + len);
         return *this;
     }
 
-    // ByteArray& removeIf(Predicate pred) {}
+    // BasicByteArray& removeIf(Predicate pred) {}
 
-    ByteArray::reverse_iterator rend()
+    reverse_iterator rend()
     {
-        return data_.rend();
+        return reverse_iterator(begin());
     }
 
-    ByteArray::const_reverse_iterator rend() const
+    const_reverse_iterator rend() const
     {
-        return data_.crend();
+        return const_reverse_iterator(begin());
     }
 
-    ByteArray repeated(std::size_t times) const
+    BasicByteArray repeated(std::size_t times) const
     {
-        ByteArray rv;
-        for (int i = 0; i < times; ++i) { rv << data_; }
+        BasicByteArray rv;
+        rv.reserve(size_ * times);
+        for (std::size_t i = 0; i < times; ++i) rv.appendBytes(data_, size_);
 
         return rv;
     }
 
-    ByteArray& replace(std::size_t pos, std::size_t len, ByteArray after) {}
-    ByteArray& replace(std::size_t pos, std::size_t len, const char* after, std::size_t alen) {}
-    ByteArray& replace(char before, ByteArray after) {}
-    ByteArray& replace(const char* before, std::size_t bsize, const char* after, std::size_t asize) {}
-    ByteArray& replace(ByteArray before, ByteArray after) {}
-    ByteArray& replace(char before, char after) {}
+    // len bytes at pos replaced by after; a len past the end replaces up to the end
+    BasicByteArray& replace(std::size_t pos, std::size_t len, const BasicByteArray& after)
+    {
+        return replace(pos, len, after.data_, after.size_);
+    }
+
+    BasicByteArray& replace(std::size_t pos, std::size_t len, const char* after, std::size_t alen)
+    {
+        if (pos > size_) return *this;
+        if (alen && after >= data_ && after < data_ + size_) {
+            // replacing with part of itself, which the edit would move or overwrite
+            const BasicByteArray copy(after, alen);
+            return replace(pos, len, copy.data_, copy.size_);
+        }
+
+        len = std::min(len, size_ - pos);
+        if (alen > len) insertGap(pos + len, alen - len);
+        else erase(data_ + pos + alen, data_ + pos + len);
+        std::memcpy(data_ + pos, after, alen);
+        return *this;
+    }
+
+    BasicByteArray& replace(char before, const BasicByteArray& after)
+    {
+        return replace(&before, 1, after.data_, after.size_);
+    }
+
+    // every occurrence of before; an empty before leaves the array unchanged
+    BasicByteArray& replace(const char* before, std::size_t bsize, const char* after, std::size_t asize)
+    {
+        if (bsize == 0) return *this;
+
+        const std::string_view str = view();
+        const std::string_view pattern(before, bsize);
+        std::size_t previous = 0;
+        std::size_t current = str.find(pattern);
+        if (current == std::string_view::npos) return *this;
+
+        BasicByteArray rv;
+        for (; current != std::string_view::npos; current = str.find(pattern, previous)) {
+            rv.appendBytes(data_ + previous, current - previous);
+            rv.appendBytes(after, asize);
+            previous = current + bsize;
+        }
+        rv.appendBytes(data_ + previous, size_ - previous);
+        return *this = std::move(rv);
+    }
+
+    BasicByteArray& replace(const BasicByteArray& before, const BasicByteArray& after)
+    {
+        return replace(before.data_, before.size_, after.data_, after.size_);
+    }
+
+    BasicByteArray& replace(char before, char after)
+    {
+        std::replace(begin(), end(), before, after);
+        return *this;
+    }
 
     void reserve(std::size_t size)
     {
-        data_.reserve(size);
+        if (size > capacity_) reallocate(size);
     }
 
+    // new bytes are zeroed
     void resize(std::size_t size)
     {
-        data_.resize(size);
+        if (size > size_) std::memset(appendUninitialized(size - size_), 0, size - size_);
+        else size_ = size;
+    }
+
+    // the whole array if len is past the start
+    BasicByteArray right(std::size_t len) const
+    {
+        len = std::min(len, size_);
+        return BasicByteArray(data_ + size_ - len, len);
     }
 
-    ByteArray right(std::size_t len) const {}
-    ByteArray rightJustified(std::size_t width, char fill = ' ', bool truncate = false) const {}
+    BasicByteArray rightJustified(std::size_t width, char fill = ' ', bool truncate = false) const
+    {
+        if (size_ >= width) return truncate ? left(width) : *this;
+        BasicByteArray rv(width - size_, fill);
+        rv.appendBytes(data_, size_);
+        return rv;
+    }
 
     /**
      * @brief Represent the whole number n as text.
@@ -566,212 +706,306 @@ public:
      * ba.setNum(n);           // ba == "63
      * ba.setNum(n, 16);       // ba == "3f"
      */
-    ByteArray& setNum(int n, int base = 10) {}
-    ByteArray& setNum(short n, int base = 10) {}
-    ByteArray& setNum(long n, int base = 10) {}
-    ByteArray& setNum(float n, char format = 'g', int precision = 6) {}
-    ByteArray& setNum(double n, char format = 'g', int precision = 6) {}
+    BasicByteArray& setNum(int n, int base = 10)
+    {
+        return setInteger(n, base);
+    }
+
+    BasicByteArray& setNum(short n, int base = 10)
+    {
+        return setInteger(n, base);
+    }
+
+    BasicByteArray& setNum(long n, int base = 10)
+    {
+        return setInteger(n, base);
+    }
 
     /**
-     * @brief Set the Raw Data object
+     * @brief Represent n as text in format 'e', 'E', 'f', 'g' or 'G' (as printf), with precision digits.
      *
-     * Resets the ByteArray to use the first size bytes of the data array. The bytes ARE copied.
+     * Any other format is taken as 'g'.
      */
-    ByteArray& setRawData(const char* data, std::size_t size)
+    BasicByteArray& setNum(float n, char format = 'g', int precision = 6)
     {
-        data_.clear();
+        return setNum(double(n), format, precision);
+    }
 
-        for (std::size_t i = 0; i < size; ++i) data_.emplace_back(data[i]);
+    BasicByteArray& setNum(double n, char format = 'g', int precision = 6)
+    {
+        char spec[] = "%.*g";
+        if (format == 'e' || format == 'E' || format == 'f' || format == 'g' || format == 'G') spec[3] = format;
 
+        const int len = std::snprintf(nullptr, 0, spec, precision, n);
+        size_ = 0;
+        // snprintf writes a terminating zero past the len bytes
+        reserve(len + 1);
+        std::snprintf(appendUninitialized(len), len + 1, spec, precision, n);
         return *this;
     }
 
-    void shrink_to_fit()
+    /**
+     * @brief Set the Raw Data object
+     *
+     * Resets the BasicByteArray to use the first size bytes of the data array. The bytes ARE copied.
+     */
+    BasicByteArray& setRawData(const char* data, std::size_t size)
     {
-        data_.shrink_to_fit();
+        size_ = 0;
+        appendBytes(data, size);
+        return *this;
     }
 
-    ByteArray simplified() const {}
-
-    std::size_t size() const
+    // back into the inline buffer if the bytes fit again
+    void shrink_to_fit()
     {
-        return data_.size();
+        if (!isInline() && capacity_ > size_) reallocate(size_);
     }
 
-    ByteArray sliced(std::size_t pos, std::size_t n) const
+    // trimmed, with each internal run of whitespace replaced by a single space
+    BasicByteArray simplified() const
     {
-        ByteArray rv;
-
-        if (pos + n > this->size()) return ByteArray();
-
-        for (std::size_t i = pos; i < pos + n; ++i) rv.append(this->at(i));
-
+        BasicByteArray rv;
+        rv.reserve(size_);
+        for (const char* p = data_; p != data_ + size_;) {
+            if (!std::isspace((unsigned char)*p)) {
+                rv.append(*p++);
+                continue;
+            }
+            while (p != data_ + size_ && std::isspace((unsigned char)*p)) ++p;
+            if (!rv.isEmpty() && p != data_ + size_) rv.append(' ');
+        }
         return rv;
     }
 
-    ByteArray sliced(std::size_t pos) const
+    std::size_t size() const
     {
-        ByteArray rv;
-
-        if (pos > this->size()) return ByteArray();
-
-        for (std::size_t i = pos; i < data_.size(); ++i) rv.append(this->at(i));
+        return size_;
+    }
 
-        return rv;
+    BasicByteArray sliced(std::size_t pos, std::size_t n) const
+    {
+        if (pos > size_ || n > size_ - pos) return BasicByteArray();
+        return BasicByteArray(data_ + pos, n);
     }
 
-    // TODO: push_back here is not correct
-    std::vector<ByteArray> split(char sep) const
+    BasicByteArray sliced(std::size_t pos) const
     {
-        std::vector<ByteArray> rv;
+        if (pos > size_) return BasicByteArray();
+        return BasicByteArray(data_ + pos, size_ - pos);
+    }
 
-        std::string str = this->toStdString();
+    std::vector<BasicByteArray> split(char sep) const
+    {
+        std::vector<BasicByteArray> rv;
 
-        std::size_t current, previous = 0;
-        current = str.find_first_of(sep);
-        while (current != std::string::npos) {
-            rv.push_back(str.substr(previous, current - previous));
+        const std::string_view str = view();
+        std::size_t previous = 0;
+        for (std::size_t current = str.find(sep); current != std::string_view::npos; current = str.find(sep, previous)) {
+            rv.emplace_back(data_ + previous, current - previous);
             previous = current + 1;
-            current = str.find_first_of(sep, previous);
         }
-        rv.push_back(str.substr(previous, current - previous));
+        rv.emplace_back(data_ + previous, size_ - previous);
 
         return rv;
     }
 
     void squeeze()
     {
-        data_.shrink_to_fit();
+        shrink_to_fit();
     }
 
-    bool startsWith(ByteArray bv) const
+    bool startsWith(const BasicByteArray& bv) const
     {
-        return this->toStdString().starts_with(bv.toStdString());
+        return view().starts_with(bv.view());
     }
 
     bool startsWith(char ch) const
     {
-        const std::string s(1, ch);
-        return this->toStdString().starts_with(s);
+        return size_ && data_[0] == ch;
     }
 
-    void swap(ByteArray& other)
+    void swap(BasicByteArray& other)
     {
-        std::swap(this->data_, other.data_);
+        BasicByteArray tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
     }
 
-    // ByteArray toBase64(ByteArray::Base64Options options = Base64Encoding) const {}
+    // BasicByteArray toBase64(BasicByteArray::Base64Options options = Base64Encoding) const {}
     // CFDataRef toCFData() const {}W
-    double toDouble(bool* ok = nullptr) const {}
-    float toFloat(bool* ok = nullptr) const {}
-    ByteArray toHex(char separator = '\0') const {}
-    int toInt(bool* ok = nullptr, int base = 10) const {}
-    long toLong(bool* ok = nullptr, int base = 10) const {}
-    uint64_t toLongLong(bool* ok = nullptr, int base = 10) const {}
+    /**
+     * @brief The number the array holds, ignoring surrounding whitespace; 0 if it holds anything else.
+     *
+     * *ok, when given, tells whether the conversion succeeded. Integers are read in base 2 through 36.
+     */
+    double toDouble(bool* ok = nullptr) const
+    {
+        return toNumber<double>(ok);
+    }
+
+    float toFloat(bool* ok = nullptr) const
+    {
+        return toNumber<float>(ok);
+    }
 
-    ByteArray toLower() const
+    // two lowercase hex digits per byte, separated by separator unless it is '\0'
+    BasicByteArray toHex(char separator = '\0') const
     {
-        ByteArray rv;
-        for (const auto& val : data_) rv.append(std::tolower(val));
+        static constexpr char digits[] = "0123456789abcdef";
+        BasicByteArray rv;
+        if (size_ == 0) return rv;
+        rv.reserve(separator ? size_ * 3 - 1 : size_ * 2);
+        for (std::size_t i = 0; i < size_; ++i) {
+            if (separator && i) rv.append(separator);
+            rv.append(digits[(unsigned char)data_[i] >> 4]);
+            rv.append(digits[(unsigned char)data_[i] & 0xF]);
+        }
         return rv;
     }
 
-    // NSData* toNSData() const {}
-    ByteArray toPercentEncoding(const ByteArray& exclude = ByteArray(), const ByteArray& include = ByteArray(),
-                                char percent = '%') const
+    int toInt(bool* ok = nullptr, int base = 10) const
     {
+        return toNumber<int>(ok, base);
     }
 
-    // CFDataRef toRawCFData() const {}
-    // NSData* toRawNSData() const {}
-    short toShort(bool* ok = nullptr, int base = 10) const {}
-    uint32_t toULong(bool* ok = nullptr, int base = 10) const {}
-    uint64_t toULongLong(bool* ok = nullptr, int base = 10) const {}
+    long toLong(bool* ok = nullptr, int base = 10) const
+    {
+        return toNumber<long>(ok, base);
+    }
 
-    ByteArray toUpper() const
+    int64_t toLongLong(bool* ok = nullptr, int base = 10) const
     {
-        ByteArray rv;
-        for (const auto& val : data_) rv.append(std::toupper(val));
-        return rv;
+        return toNumber<int64_t>(ok, base);
     }
 
-    ByteArray trimmed() const
+    BasicByteArray toLower() const
     {
-        ByteArray rv;
-        for (const auto& val : data_) {
-            if (!std::isspace(val)) { rv.append(val); }
+        BasicByteArray rv(*this);
+        for (auto& val : rv) val = (char)std::tolower((unsigned char)val);
+        return rv;
+    }
+
+    // NSData* toNSData() const {}
+    /**
+     * @brief URI percent-encoding (RFC 3986).
+     *
+     * Letters, digits and "-._~" are kept, as are the bytes in exclude; everything else, and the bytes in include,
+     * become percent followed by two uppercase hex digits.
+     */
+    BasicByteArray toPercentEncoding(const BasicByteArray& exclude = BasicByteArray(),
+                                     const BasicByteArray& include = BasicByteArray(), char percent = '%') const
+    {
+        static constexpr char digits[] = "0123456789ABCDEF";
+        BasicByteArray rv;
+        rv.reserve(size_);
+        for (const char ch : *this) {
+            const bool unreserved = std::isalnum((unsigned char)ch) || ch == '-' || ch == '.' || ch == '_' || ch == '~';
+            if ((unreserved || exclude.contains(ch)) && !include.contains(ch)) {
+                rv.append(ch);
+                continue;
+            }
+            rv.append(percent);
+            rv.append(digits[(unsigned char)ch >> 4]);
+            rv.append(digits[(unsigned char)ch & 0xF]);
         }
+        return rv;
+    }
 
-        while (std::isspace(rv.data_.back())) rv.data_.pop_back();
+    // CFDataRef toRawCFData() const {}
+    // NSData* toRawNSData() const {}
+    short toShort(bool* ok = nullptr, int base = 10) const
+    {
+        return toNumber<short>(ok, base);
+    }
+
+    uint32_t toULong(bool* ok = nullptr, int base = 10) const
+    {
+        return toNumber<uint32_t>(ok, base);
+    }
+
+    uint64_t toULongLong(bool* ok = nullptr, int base = 10) const
+    {
+        return toNumber<uint64_t>(ok, base);
+    }
 
+    BasicByteArray toUpper() const
+    {
+        BasicByteArray rv(*this);
+        for (auto& val : rv) val = (char)std::toupper((unsigned char)val);
         return rv;
     }
 
-    void truncate(std::size_t pos)
+    // without leading and trailing whitespace
+    BasicByteArray trimmed() const
     {
-        if (pos >= data_.size()) return;
+        const char* first = data_;
+        const char* last = data_ + size_;
+        while (first != last && std::isspace((unsigned char)*first)) ++first;
+        while (last != first && std::isspace((unsigned char)last[-1])) --last;
+        return BasicByteArray(first, last - first);
+    }
 
-        std::vector<char> tmp;
-        for (std::size_t i = 0; i < pos; i++) tmp.push_back(this->at(i));
-        data_ = std::move(tmp);
+    void truncate(std::size_t pos)
+    {
+        if (pos < size_) size_ = pos;
     }
 
     bool operator!=(const std::string& str) const
     {
-        return this->toStdString() != str;
+        return view() != str;
     }
 
-    ByteArray& operator+=(const ByteArray& other)
+    BasicByteArray& operator+=(const BasicByteArray& other)
     {
-        data_.insert(data_.end(), other.begin(), other.end());
+        appendBytes(other.data_, other.size_);
         return *this;
     }
 
-    ByteArray& operator+=(char ch)
+    BasicByteArray& operator+=(char ch)
     {
-        data_.emplace_back(ch);
-        return *this;
+        return append(ch);
     }
 
-    ByteArray& operator+=(const char* str)
+    BasicByteArray& operator+=(const char* str)
     {
-        for (const char* t = str; *t != '\0'; t++) data_.emplace_back(*t);
+        appendBytes(str, std::strlen(str));
         return *this;
     }
 
     bool operator<(const std::string& str) const
     {
-        return this->toStdString() < str;
+        return view() < str;
     }
 
     bool operator<=(const std::string& str) const
     {
-        return this->toStdString() <= str;
+        return view() <= str;
     }
 
-    ByteArray& operator=(const char* str)
+    BasicByteArray& operator=(const char* str)
     {
-        this->data_.clear();
-        for (const char* t = str; *t != '\0'; t++) data_.emplace_back(*t);
+        size_ = 0;
+        appendBytes(str, std::strlen(str));
         return *this;
     }
 
     bool operator==(const std::string& str) const
     {
-        return this->toStdString() == str;
+        return view() == str;
     }
 
     bool operator>(const std::string& str) const
     {
-        return this->toStdString() > str;
+        return view() > str;
     }
 
     bool operator>=(const std::string& str) const
     {
-        return this->toStdString() >= str;
+        return view() >= str;
     }
 
-    // auto operator<=>(const ByteArray&) const = default;
+    // auto operator<=>(const BasicByteArray&) const = default;
 
     char& operator[](std::size_t i)
     {
@@ -783,29 +1017,152 @@ public:
         return data_[i];
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const ByteArray& other)
+    friend std::ostream& operator<<(std::ostream& os, const BasicByteArray& other)
     {
-        for (std::size_t i = 0; i < other.data_.size(); i++) os << other.data_[i];
-        return os;
+        return os.write(other.data_, other.size_);
     }
 
-    ByteArray& operator<<(const ByteArray& other)
+    BasicByteArray& operator<<(const BasicByteArray& other)
     {
-        data_.insert(data_.end(), other.begin(), other.end());
+        appendBytes(other.data_, other.size_);
         return *this;
     }
 
-    ByteArray& operator<<(const std::vector<char>& data)
+    BasicByteArray& operator<<(const std::vector<char>& data)
     {
-        data_.insert(data_.end(), data.begin(), data.end());
+        appendBytes(data.data(), data.size());
         return *this;
     }
 
 private:
-    std::vector<char> data_;
+    std::string_view view() const
+    {
+        return std::string_view(data_, size_);
+    }
+
+    template <typename T>
+    BasicByteArray& setInteger(T n, int base)
+    {
+        if (base < 2 || base > 36) base = 10;
+        // the longest is a sign and one binary digit per bit
+        char digits[sizeof(T) * 8 + 1];
+        const char* end = std::to_chars(digits, digits + sizeof(digits), n, base).ptr;
+        return setRawData(digits, end - digits);
+    }
+
+    // the whole trimmed array must be the number
+    template <typename T>
+    T toNumber(bool* ok, int base = 10) const
+    {
+        const char* first = data_;
+        const char* last = data_ + size_;
+        while (first != last && std::isspace((unsigned char)*first)) ++first;
+        while (last != first && std::isspace((unsigned char)last[-1])) --last;
+
+        T value{};
+        std::from_chars_result result{first, std::errc::invalid_argument};
+        if constexpr (std::is_floating_point_v<T>) result = std::from_chars(first, last, value);
+        else if (base >= 2 && base <= 36) result = std::from_chars(first, last, value, base);
+
+        const bool converted = result.ec == std::errc() && result.ptr == last && first != last;
+        if (ok) *ok = converted;
+        return converted ? value : T{};
+    }
+
+    void release()
+    {
+        if (!isInline()) delete[] data_;
+    }
+
+    // takes other's bytes, its heap buffer if it has one; other is left empty and inline
+    void steal(BasicByteArray& other)
+    {
+        if (other.isInline()) {
+            std::memcpy(buffer_, other.buffer_, other.size_);
+            data_ = buffer_;
+            capacity_ = InlineCapacity;
+        } else {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            other.data_ = other.buffer_;
+            other.capacity_ = InlineCapacity;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    // moves the bytes to a buffer of exactly capacity bytes, the inline one if they fit
+    void reallocate(std::size_t capacity)
+    {
+        char* data = capacity <= InlineCapacity ? buffer_ : new char[capacity];
+        if (data == data_) return;
+        std::memcpy(data, data_, size_);
+        release();
+        data_ = data;
+        capacity_ = std::max(capacity, InlineCapacity);
+    }
+
+    void grow(std::size_t minCapacity)
+    {
+        reallocate(std::max(minCapacity, capacity_ * 2));
+    }
+
+    // n more bytes at the end, left for the caller to write
+    char* appendUninitialized(std::size_t n)
+    {
+        if (n > capacity_ - size_) {
+            if (n > std::size_t(-1) / 2 - size_) throw std::length_error("BasicByteArray");
+            grow(size_ + n);
+        }
+        char* p = data_ + size_;
+        size_ += n;
+        return p;
+    }
+
+    void appendBytes(const char* bytes, std::size_t n)
+    {
+        if (n == 0) return;
+        if (n > capacity_ - size_ && bytes >= data_ && bytes < data_ + size_) {
+            // appending part of itself, which is about to move
+            const std::size_t offset = bytes - data_;
+            grow(size_ + n);
+            bytes = data_ + offset;
+        }
+        std::memcpy(appendUninitialized(n), bytes, n);
+    }
+
+    // opens n bytes at pos, after padding with spaces up to pos
+    char* insertGap(std::size_t pos, std::size_t n)
+    {
+        if (pos > size_) std::memset(appendUninitialized(pos - size_), ' ', pos - size_);
+        appendUninitialized(n);
+        std::memmove(data_ + pos + n, data_ + pos, size_ - n - pos);
+        return data_ + pos;
+    }
+
+    void insertBytes(std::size_t pos, const char* bytes, std::size_t n)
+    {
+        if (n == 0) return;
+        if (bytes >= data_ && bytes < data_ + size_) {
+            // inserting part of itself, which the gap would move or overwrite
+            const BasicByteArray copy(bytes, n);
+            std::memcpy(insertGap(pos, n), copy.data_, n);
+            return;
+        }
+        std::memcpy(insertGap(pos, n), bytes, n);
+    }
+
+private:
+    char* data_{buffer_}; // buffer_ while inline
+    std::size_t size_{0};
+    std::size_t capacity_{InlineCapacity};
+    char buffer_[InlineCapacity];
     // bool isBinary_ {false};
 };
 
+// 40 inline bytes make the whole array one 64-byte cache line
+using ByteArray = BasicByteArray<40>;
+
 } // namespace rmg
 
-#endif //!_BYTEARRAY_HEADER_HPP_
\ No newline at end of file
+#endif //!_BYTEARRAY_HEADER_HPP_
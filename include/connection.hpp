@@ -2,21 +2,23 @@
 #define _CONNECTION_HEADER_HPP_ 1
 #pragma once
 
-#include <boost/signals2.hpp>
+#include "event_signal.hpp"
+#include "recv_buffer.hpp"
 
 class Connection
 {
 public:
     virtual ~Connection()
     {
-        this->newDataArrived.disconnect_all_slots();
+        this->newDataArrived.disconnectAll();
     };
 
     virtual void stop() = 0;
     virtual bool write(const std::string& msg) = 0;
     virtual void startReadingData() = 0;
 
-    boost::signals2::signal<void(std::vector<char>)> newDataArrived;
+    // the buffer is shared by every slot; keep a copy of the handle to hold on to the bytes
+    EventSignal<const RecvBuffer&> newDataArrived;
 };
 
 #endif //!_CONNECTION_HEADER_HPP_
\ No newline at end of file
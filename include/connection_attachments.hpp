@@ -0,0 +1,138 @@
+#ifndef _CONNECTION_ATTACHMENTS_HEADER_HPP_
+#define _CONNECTION_ATTACHMENTS_HEADER_HPP_ 1
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "event_signal.hpp"
+#include "recv_buffer.hpp"
+#include "tcp_connection_manager.hpp"
+
+/**
+ * @brief Per-connection state of a protocol layer, fed with the connection's receive buffers.
+ *
+ * attach() creates the state and connects it to the connection's data signal; closed connections detach
+ * themselves. State needs a `const TCPConnInfo connInfo` and a `ScopedEventConnection dataConnection`. The data
+ * slot shares the state, so a buffer being handled keeps it alive through a detach. Thread-safe.
+ */
+template <typename State>
+class ConnectionAttachments
+{
+public:
+    using StatePtr = std::shared_ptr<State>;
+
+    // onDetached runs for every state detached, once its data slot is disconnected
+    explicit ConnectionAttachments(TCPConnectionManager& tcpConnMgr, std::function<void(const StatePtr&)> onDetached = {})
+        : m_tcpConnMgr(tcpConnMgr), m_onDetached(std::move(onDetached))
+    {
+        m_closedConnection = m_tcpConnMgr.connectionClosed.connect([this](TCPConnInfo connInfo) { detach(connInfo); });
+    }
+    ConnectionAttachments(const ConnectionAttachments& other) = delete;
+    ~ConnectionAttachments() { clear(); }
+
+    // Creates the state with makeState(const TCPConnInfo&, TCPConnection&); onData(State&, const RecvBuffer&)
+    // then runs on the connection's event loop for every receive buffer. False if there is no such connection;
+    // a connection already attached keeps its state.
+    template <typename MakeState, typename OnData>
+    bool attach(ConnHandle handle, MakeState&& makeState, OnData&& onData)
+    {
+        const auto conn = m_tcpConnMgr.getConnectionDirect(handle);
+        if (!conn) return false;
+        const TCPConnInfo connInfo = conn->connInfo();
+
+        StatePtr stale;
+        {
+            std::lock_guard lock(m_mutex);
+            const auto it = m_states.find(connInfo.sockfd);
+            if (it != m_states.end()) {
+                if (it->second->connInfo.generation == connInfo.generation) return true;
+                // an earlier connection on the descriptor whose connectionClosed hasn't come through yet
+                stale = std::move(it->second);
+                m_states.erase(it);
+            }
+
+            StatePtr state = makeState(connInfo, *conn);
+            state->dataConnection = conn->newDataArrived.connect(
+                [state, onData = std::forward<OnData>(onData)](const RecvBuffer& buffer) { onData(*state, buffer); });
+            m_states.emplace(connInfo.sockfd, std::move(state));
+        }
+        if (stale) release(stale);
+
+        // Closed between the lookup and now: its connectionClosed may have come before the state. Checked
+        // without holding m_mutex, which the connectionClosed slot takes.
+        if (m_tcpConnMgr.getConnectionDirect(connInfo) != conn) {
+            detach(connInfo);
+            return false;
+        }
+        return true;
+    }
+
+    // the detached state, or nullptr if the handle had none
+    StatePtr detach(ConnHandle handle)
+    {
+        StatePtr state;
+        {
+            std::lock_guard lock(m_mutex);
+            const auto it = m_states.find(handle.sockfd());
+            if (it == m_states.end() || !matches(*it->second, handle)) return nullptr;
+            state = std::move(it->second);
+            m_states.erase(it);
+        }
+        release(state);
+        return state;
+    }
+
+    StatePtr find(ConnHandle handle) const
+    {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_states.find(handle.sockfd());
+        return it != m_states.end() && matches(*it->second, handle) ? it->second : nullptr;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_states.size();
+    }
+
+    // Detaches everything and stops following closes. For owners to call first thing in their destructor, so no
+    // data slot runs into a half-destroyed owner.
+    void clear()
+    {
+        m_closedConnection.disconnect();
+        std::unordered_map<SOCKET, StatePtr> states;
+        {
+            std::lock_guard lock(m_mutex);
+            states.swap(m_states);
+        }
+        for (const auto& [sockfd, state] : states) release(state);
+    }
+
+private:
+    // a handle of generation 0 matches whichever connection has the descriptor
+    static bool matches(const State& state, ConnHandle handle)
+    {
+        return handle.generation() == 0 || handle.generation() == state.connInfo.generation;
+    }
+
+    void release(const StatePtr& state)
+    {
+        state->dataConnection.disconnect();
+        if (m_onDetached) m_onDetached(state);
+    }
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    const std::function<void(const StatePtr&)> m_onDetached;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<SOCKET, StatePtr> m_states;
+
+    ScopedEventConnection m_closedConnection;
+};
+
+#endif //!_CONNECTION_ATTACHMENTS_HEADER_HPP_
@@ -0,0 +1,106 @@
+#ifndef _CONNECTION_REGISTRY_HEADER_HPP_
+#define _CONNECTION_REGISTRY_HEADER_HPP_ 1
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "tcp_util.hpp"
+
+class TCPConnection;
+
+/**
+ * @brief Connections indexed by socket, with lookups that take no lock.
+ *
+ * Descriptors index a two-level table directly; pages of slots are allocated on first use and kept until the
+ * registry goes away. A slot holds an immutable entry owning the connection. Writers (insert/erase) swap entries
+ * under one mutex and retire the old ones; readers only announce themselves on a per-thread counter stripe while
+ * they copy the shared_ptr out.
+ *
+ * Retired entries are reclaimed in two phases: each batch waits for the readers counted under the previous
+ * epoch to leave, so a reader is never held up and a writer never waits. Descriptors beyond the table (or odd
+ * Windows handle values) fall back to a map under a mutex.
+ */
+class ConnectionRegistry
+{
+public:
+    using Value = std::shared_ptr<TCPConnection>;
+    // generation that matches every entry
+    static constexpr uint32_t anyGeneration = 0;
+
+    ConnectionRegistry();
+    ConnectionRegistry(const ConnectionRegistry& other) = delete;
+    ~ConnectionRegistry();
+
+    // false if sockfd is already registered
+    bool insert(SOCKET sockfd, uint32_t generation, Value conn);
+    // The removed connection, or nullptr. Lookups and erase only match an entry registered under the given
+    // generation, so a stale handle misses the connection that reused its descriptor.
+    Value erase(SOCKET sockfd, uint32_t generation = anyGeneration);
+
+    Value find(SOCKET sockfd, uint32_t generation = anyGeneration) const;
+    bool contains(SOCKET sockfd, uint32_t generation = anyGeneration) const;
+
+    std::vector<Value> snapshot() const;
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        Value conn;
+        uint32_t generation{0};
+
+        bool matches(uint32_t wanted) const { return wanted == anyGeneration || wanted == generation; }
+    };
+
+    static constexpr std::size_t pageBits = 10;
+    static constexpr std::size_t pageSize = std::size_t(1) << pageBits;
+    static constexpr std::size_t pageCount = 1024; // descriptors below 1M live in the table
+    static constexpr std::size_t stripeCount = 64;
+
+    struct Page {
+        std::array<std::atomic<Entry*>, pageSize> slots{};
+    };
+
+    // readers in flight, per epoch parity; one cache line per stripe so readers on different threads don't share
+    struct alignas(64) ReaderStripe {
+        std::atomic<uint32_t> count[2]{};
+    };
+
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const ConnectionRegistry& registry);
+        ReadGuard(const ReadGuard& other) = delete;
+        ~ReadGuard();
+
+    private:
+        std::atomic<uint32_t>& m_count;
+    };
+
+    static bool inTable(SOCKET sockfd);
+    std::atomic<Entry*>* slotFor(SOCKET sockfd) const;
+
+    // both need m_writeMutex
+    void retire(Entry* entry);
+    void reclaim();
+
+private:
+    std::array<std::atomic<Page*>, pageCount> m_pages{};
+    mutable std::array<ReaderStripe, stripeCount> m_readers{};
+    std::atomic<uint64_t> m_epoch{0};
+    std::atomic<std::size_t> m_size{0};
+
+    mutable std::mutex m_writeMutex;
+    std::vector<Entry*> m_retiring; // retired since the last epoch flip
+    std::vector<Entry*> m_waiting;  // retired before it; freed once the previous epoch's readers are gone
+
+    mutable std::mutex m_overflowMutex;
+    std::unordered_map<SOCKET, Entry> m_overflow;
+};
+
+#endif //!_CONNECTION_REGISTRY_HEADER_HPP_
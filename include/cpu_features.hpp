@@ -0,0 +1,35 @@
+#ifndef _CPU_FEATURES_HEADER_HPP_
+#define _CPU_FEATURES_HEADER_HPP_ 1
+#pragma once
+
+// Runtime CPU feature checks for the SIMD kernels, which are compiled for their instruction set function by
+// function and only called where the check passes.
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics without a flag; GCC and Clang need the function marked
+#define SIMD_AVX2_TARGET
+#else
+#define SIMD_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+inline bool cpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5));
+#else
+    // also checks that the OS saves the AVX registers
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // x86-64
+
+#endif //!_CPU_FEATURES_HEADER_HPP_
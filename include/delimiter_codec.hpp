@@ -0,0 +1,151 @@
+#ifndef _DELIMITER_CODEC_HEADER_HPP_
+#define _DELIMITER_CODEC_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "connection_attachments.hpp"
+#include "event_signal.hpp"
+#include "simd_kernel.hpp"
+#include "tcp_connection_manager.hpp"
+
+/**
+ * @brief Finds every occurrence of one byte in a block, 16 or 32 bytes per compare.
+ *
+ * The kernel is picked once at runtime: AVX2 where the CPU and OS support it, SSE2 on any other x86-64, memchr
+ * elsewhere. Matches come out of the compare as a bitmask, so dense delimiters cost one bit scan each instead of a
+ * call per record.
+ */
+class DelimiterScanner
+{
+public:
+    using Kernel = SimdKernel;
+
+    explicit DelimiterScanner(char delimiter, Kernel kernel = bestSimdKernel());
+
+    // appends the offset of every delimiter in data to positions
+    void findAll(std::string_view data, std::vector<std::size_t>& positions) const;
+    Kernel kernel() const { return m_kernel; }
+
+private:
+    using FindFn = void (*)(const char* data, std::size_t size, char delimiter, std::vector<std::size_t>& positions);
+
+    char m_delimiter;
+    Kernel m_kernel;
+    FindFn m_find;
+};
+
+struct DelimiterCodecOptions {
+    char delimiter{'\n'};
+    bool trimCarriageReturn{false}; // drop a '\r' in front of the delimiter, for CRLF-terminated lines
+    std::size_t maxRecordSize{64 * 1024}; // a longer record closes the connection
+};
+
+/**
+ * @brief Incremental splitter for delimiter-terminated records.
+ *
+ * Every byte is scanned once: the unterminated tail of a chunk is kept aside and the next chunk is scanned from
+ * its own start, so a record spread over many reads costs no re-scanning. Records within a chunk are views into it;
+ * only the record completing a kept tail is copied. Not thread-safe.
+ */
+class DelimiterDecoder
+{
+public:
+    explicit DelimiterDecoder(DelimiterCodecOptions options = {},
+                              DelimiterScanner::Kernel kernel = bestSimdKernel());
+
+    // Calls onBatch(std::span<const std::string_view>) once with every record completed by data, if there is any;
+    // the views are only valid during the call. False once a record grows past the limit; the decoder then
+    // stays failed.
+    template <typename OnBatch>
+    bool feed(std::string_view data, OnBatch&& onBatch);
+
+    // bytes of the unterminated record kept from earlier chunks
+    std::size_t pendingBytes() const { return m_partial.size(); }
+    bool failed() const { return m_failed; }
+
+private:
+    // fills m_records from data; false if a record is too long
+    bool split(std::string_view data);
+    // after the batch was delivered: the unterminated end of the chunk becomes the pending record
+    void keepTail();
+
+private:
+    DelimiterCodecOptions m_options;
+    DelimiterScanner m_scanner;
+    bool m_failed{false};
+
+    std::string m_partial;
+    std::string_view m_tail;
+    bool m_tailComplete{false}; // m_tail replaces m_partial rather than extending it
+
+    // reused for every chunk, so steady-state decoding doesn't allocate
+    std::vector<std::size_t> m_positions;
+    std::vector<std::string_view> m_records;
+};
+
+/**
+ * @brief Delimiter-separated records (lines by default) on top of TCPConnectionManager.
+ *
+ * Attached connections get their received bytes split into records, emitted as one batch per receive buffer
+ * through recordsArrived on the connection's event loop. Thread-safe; closed connections detach themselves.
+ */
+class DelimiterCodec
+{
+public:
+    explicit DelimiterCodec(TCPConnectionManager& tcpConnMgr, DelimiterCodecOptions options = {});
+    DelimiterCodec(const DelimiterCodec& other) = delete;
+    ~DelimiterCodec();
+
+    // the views are only valid during the call
+    EventSignal<const TCPConnInfo&, std::span<const std::string_view>> recordsArrived;
+
+    // false if there is no such connection; attach before the peer sends, or bytes received earlier are lost
+    bool attach(ConnHandle conn);
+    void detach(ConnHandle conn);
+    std::size_t attachedCount() const;
+
+    // Writes the records, each followed by the delimiter, as one message. False if a record contains the
+    // delimiter, there is no such connection, or its slow-consumer policy refused the message.
+    bool send(ConnHandle conn, std::string_view record);
+    bool send(ConnHandle conn, std::span<const std::string_view> records);
+
+    uint64_t recordsDelivered() const { return m_recordsDelivered; }
+    uint64_t batchesDelivered() const { return m_batchesDelivered; }
+
+private:
+    struct Attachment;
+
+    // on the connection's event loop, for every receive buffer
+    void onData(Attachment& attachment, const RecvBuffer& buffer);
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    const DelimiterCodecOptions m_options;
+
+    ConnectionAttachments<Attachment> m_attachments;
+
+    std::atomic<uint64_t> m_recordsDelivered{0};
+    std::atomic<uint64_t> m_batchesDelivered{0};
+};
+
+template <typename OnBatch>
+bool DelimiterDecoder::feed(std::string_view data, OnBatch&& onBatch)
+{
+    if (m_failed) return false;
+    if (!split(data)) {
+        m_failed = true;
+        return false;
+    }
+    if (!m_records.empty()) onBatch(std::span<const std::string_view>(m_records));
+    keepTail();
+    return true;
+}
+
+#endif //!_DELIMITER_CODEC_HEADER_HPP_
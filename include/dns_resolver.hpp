@@ -0,0 +1,113 @@
+#ifndef _DNS_RESOLVER_HEADER_HPP_
+#define _DNS_RESOLVER_HEADER_HPP_ 1
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct DNSResolverStats {
+    uint64_t cacheHits{0};   // answered from the cache, including cached failures
+    uint64_t cacheMisses{0}; // had to wait for a query
+    uint64_t coalesced{0};   // misses that joined a query already in flight for the same name
+    uint64_t queries{0};     // lookups actually handed to the backend
+};
+
+/**
+ * @brief Asynchronous name resolution with a TTL cache.
+ *
+ * Lookups run on a small pool of worker threads, never on the caller's or an event loop's thread. Answers,
+ * including failures (negative caching), are kept in a sharded cache for a fixed TTL, since getaddrinfo doesn't
+ * report record TTLs. Concurrent lookups of the same name share a single backend query.
+ *
+ * Results contain every IPv4 and IPv6 address, families interleaved starting with IPv6 (RFC 8305).
+ */
+class DNSResolver
+{
+public:
+    using Addresses = std::vector<std::string>;
+    // an empty result means the name couldn't be resolved
+    using Callback = std::function<void(const Addresses& addresses)>;
+    // resolves one name synchronously; called from the worker threads
+    using Backend = std::function<Addresses(const std::string& host)>;
+
+    static constexpr std::chrono::milliseconds defaultTtl{60000};
+    static constexpr std::chrono::milliseconds defaultNegativeTtl{5000};
+
+    // an empty backend resolves through getaddrinfo
+    explicit DNSResolver(std::size_t numWorkers = 2, std::chrono::milliseconds ttl = defaultTtl,
+                         std::chrono::milliseconds negativeTtl = defaultNegativeTtl, Backend backend = {});
+    DNSResolver(const DNSResolver& other) = delete;
+    ~DNSResolver();
+
+    // Stops the workers; queued lookups complete with an empty result.
+    void stop();
+
+    // The callback runs on the calling thread for cached names and IP literals, on a worker thread otherwise.
+    void resolve(const std::string& host, Callback callback);
+    std::future<Addresses> resolve(const std::string& host);
+
+    // Replaces the backend for future queries and drops everything cached so far. Queries already made to the
+    // old backend still answer their callers, but their results aren't cached.
+    void setBackend(Backend backend);
+    void clearCache();
+    DNSResolverStats stats() const;
+
+    static Backend systemBackend();
+    // Stub for tests: "address name [aliases...]" lines of an /etc/hosts-style file, read once.
+    static Backend hostsFileBackend(const std::string& path);
+
+private:
+    struct CacheEntry {
+        Addresses addresses;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, CacheEntry> cache;
+        // callbacks waiting for the query in flight for a name
+        std::unordered_map<std::string, std::vector<Callback>> inFlight;
+    };
+
+    static constexpr std::size_t shardCount = 16;
+
+    Shard& shardFor(const std::string& host);
+    void workerLoop(std::stop_token st);
+    // epoch is the backend epoch the query started in
+    void complete(const std::string& host, const Addresses& addresses, uint64_t epoch);
+
+private:
+    const std::chrono::milliseconds m_ttl;
+    const std::chrono::milliseconds m_negativeTtl;
+
+    mutable std::mutex m_backendMutex;
+    Backend m_backend;
+    // bumped by setBackend() before it clears the cache, so answers of the replaced backend are not stored
+    std::atomic<uint64_t> m_backendEpoch{0};
+
+    std::array<Shard, shardCount> m_shards;
+
+    std::mutex m_queueMutex;
+    std::condition_variable_any m_queueCv;
+    std::deque<std::string> m_queue;
+
+    std::atomic<bool> m_stopped{false};
+    std::atomic<uint64_t> m_cacheHits{0};
+    std::atomic<uint64_t> m_cacheMisses{0};
+    std::atomic<uint64_t> m_coalesced{0};
+    std::atomic<uint64_t> m_queries{0};
+
+    std::vector<std::jthread> m_workers;
+};
+
+#endif //!_DNS_RESOLVER_HEADER_HPP_
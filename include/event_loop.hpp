@@ -0,0 +1,164 @@
+#ifndef _EVENT_LOOP_HEADER_HPP_
+#define _EVENT_LOOP_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tcp_util.hpp"
+
+/**
+ * @brief Single-threaded I/O loop owning a set of sockets.
+ *
+ * One thread waits on every socket registered with the loop and calls the socket's handler when it becomes
+ * readable or writable. Registrations and cross-thread work are handed to the loop through post(), so the
+ * handler table is only ever touched by the loop thread and handlers never race with their own removal.
+ *
+ * The base class owns the thread and the task queue; the backends decide how the loop waits for the kernel.
+ */
+class EventLoop
+{
+public:
+    enum Events : uint32_t
+    {
+        Readable = 1 << 0,
+        Writable = 1 << 1,
+        Error = 1 << 2,        // hang-up or socket error, reported together with Readable
+        EdgeTriggered = 1 << 3 // registration flag only; ignored by the poll() fallback
+    };
+
+    using Handler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+    using TimerId = uint64_t;
+
+    // Entry of the loop's retire queue, embedded in whatever owns a socket; see retire().
+    class Retirable
+    {
+    public:
+        virtual ~Retirable() = default;
+
+    protected:
+        friend class EventLoop;
+        // on the loop thread, once the socket has been unregistered
+        virtual void retired() = 0;
+
+    private:
+        SOCKET m_retiredSocket{INVALID_SOCKET};
+        Retirable* m_nextRetired{nullptr};
+    };
+
+    EventLoop() = default;
+    EventLoop(const EventLoop& other) = delete;
+    virtual ~EventLoop() = default;
+
+    void start();
+    void stop();
+
+    // Runs task on the loop thread. Once the loop has been stopped the task runs on the calling thread, one such
+    // task at a time.
+    void post(Task task);
+
+    // Runs task on the loop thread once delay has passed. Timers of a stopped loop never fire.
+    TimerId runAfter(std::chrono::milliseconds delay, Task task);
+    void cancelTimer(TimerId timerId);
+
+    void add(SOCKET sockfd, uint32_t events, Handler handler);
+    void modify(SOCKET sockfd, uint32_t events);
+    void remove(SOCKET sockfd);
+
+    // Lock-free and allocation-free from any thread: once the tasks posted before it have run, the loop
+    // unregisters sockfd and calls item.retired(), for everything retired by then in one batch and in order. item
+    // must stay alive until then. Once the loop has been stopped this runs on the calling thread.
+    void retire(SOCKET sockfd, Retirable& item);
+
+    bool isInLoopThread() const;
+    std::size_t watchedSockets() const;
+
+protected:
+    virtual void run(std::stop_token st) = 0;
+    virtual void wakeUp() = 0;
+
+    virtual void addDirect(SOCKET sockfd, uint32_t events, Handler handler) = 0;
+    virtual void modifyDirect(SOCKET sockfd, uint32_t events) = 0;
+    virtual void removeDirect(SOCKET sockfd) = 0;
+
+    // also drains the retire queue
+    void runPendingTasks();
+    // runs the timers that are due; returns the milliseconds until the next one, or -1 if there is none
+    int runDueTimers();
+
+protected:
+    std::atomic<std::size_t> m_watchedSockets{0};
+
+private:
+    // empties the retire queue, oldest item first
+    Retirable* takeRetired();
+    void runRetired(Retirable* ordered);
+
+private:
+    std::atomic<bool> m_running{false};
+
+    std::mutex m_tasksMutex;
+    std::vector<Task> m_tasks;
+    // Once stopped, tasks and retired items run on whichever thread hands them in; this serialises them, as the
+    // loop thread did. Recursive, as a task may post or retire in turn.
+    std::recursive_mutex m_stoppedMutex;
+
+    // intrusive stack of retired items, newest first; producers push with a CAS, the loop takes all of them at once
+    std::atomic<Retirable*> m_retired{nullptr};
+
+    // only accessed from the loop thread
+    using TimerKey = std::pair<std::chrono::steady_clock::time_point, TimerId>;
+    std::map<TimerKey, Task> m_timers;
+    std::unordered_map<TimerId, std::chrono::steady_clock::time_point> m_timerDeadlines;
+    std::atomic<TimerId> m_nextTimerId{1};
+
+    std::jthread m_thread;
+};
+
+/**
+ * @brief Readiness reactor: epoll on Linux, WSAPoll/poll elsewhere.
+ */
+class ReactorLoop : public EventLoop
+{
+public:
+    ReactorLoop();
+    ~ReactorLoop() override;
+
+protected:
+    void run(std::stop_token st) override;
+    void wakeUp() override;
+
+    void addDirect(SOCKET sockfd, uint32_t events, Handler handler) override;
+    void modifyDirect(SOCKET sockfd, uint32_t events) override;
+    void removeDirect(SOCKET sockfd) override;
+
+private:
+    void dispatch(SOCKET sockfd, uint32_t events);
+
+private:
+    SOCKET m_wakeFd{INVALID_SOCKET};
+#ifdef __linux__
+    int m_epollFd{-1};
+#else
+    std::vector<WSAPOLLFD> m_pollFds;
+    bool m_pollFdsDirty{true};
+#endif
+
+    struct Registration {
+        uint32_t events;
+        Handler handler;
+    };
+
+    // only accessed from the loop thread
+    std::unordered_map<SOCKET, Registration> m_handlers;
+};
+
+#endif //!_EVENT_LOOP_HEADER_HPP_
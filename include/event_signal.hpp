@@ -0,0 +1,269 @@
+#ifndef _EVENT_SIGNAL_HEADER_HPP_
+#define _EVENT_SIGNAL_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace detail
+{
+struct SignalSlotBase {
+    // mutable: the slot may sit inside an immutable slot list
+    mutable std::atomic<bool> connected{true};
+};
+
+struct SignalCoreBase {
+    virtual ~SignalCoreBase() = default;
+    virtual void disconnect(const SignalSlotBase* slot) = 0;
+};
+
+/**
+ * Pointer to an immutable T that readers follow without a lock (RCU-style). Writers build a replacement under a
+ * mutex and retire the old value; the cell lets go of retired values at the next writer that sees no reader, or
+ * when it is destroyed. Values are shared_ptr-owned, so a writer can hand out pointers into them.
+ */
+template <typename T>
+class RcuCell
+{
+public:
+    class Reader
+    {
+    public:
+        explicit Reader(const RcuCell& cell) : m_readers(cell.m_readers)
+        {
+            m_readers.fetch_add(1, std::memory_order_seq_cst);
+            m_value = cell.m_value.load(std::memory_order_seq_cst);
+        }
+        Reader(const Reader& other) = delete;
+        ~Reader() { m_readers.fetch_sub(1, std::memory_order_release); }
+
+        const T* get() const { return m_value; }
+
+    private:
+        std::atomic<std::size_t>& m_readers;
+        const T* m_value{nullptr};
+    };
+
+    RcuCell() = default;
+    RcuCell(const RcuCell& other) = delete;
+
+    bool empty() const { return m_value.load(std::memory_order_acquire) == nullptr; }
+
+    // edit(current, next) fills in the replacement and returns false to leave the cell as it is; a null next
+    // clears it. Runs under the writer mutex, so current stays valid.
+    template <typename Edit>
+    void update(Edit&& edit)
+    {
+        std::lock_guard lock(m_writeMutex);
+        std::shared_ptr<T> next;
+        if (!edit(std::as_const(m_current), next)) return;
+        m_value.store(next.get(), std::memory_order_seq_cst);
+        if (m_current) m_retired.push_back(std::move(m_current));
+        m_current = std::move(next);
+
+        // every reader that could still see a retired value started before the store above
+        if (m_readers.load(std::memory_order_seq_cst) == 0) m_retired.clear();
+    }
+
+    // calls f(current) under the writer mutex
+    template <typename F>
+    auto inspect(F&& f) const
+    {
+        std::lock_guard lock(m_writeMutex);
+        return f(m_current.get());
+    }
+
+private:
+    std::atomic<const T*> m_value{nullptr}; // m_current, for the readers
+    mutable std::atomic<std::size_t> m_readers{0};
+    mutable std::mutex m_writeMutex;
+    std::shared_ptr<const T> m_current;
+    std::vector<std::shared_ptr<const T>> m_retired;
+};
+} // namespace detail
+
+/**
+ * @brief Handle to a slot connected to an EventSignal. Copyable; outliving the signal is fine.
+ */
+class EventConnection
+{
+public:
+    EventConnection() = default;
+    EventConnection(std::weak_ptr<detail::SignalCoreBase> core, std::weak_ptr<detail::SignalSlotBase> slot)
+        : m_core(std::move(core)), m_slot(std::move(slot))
+    {}
+
+    void disconnect()
+    {
+        const auto slot = m_slot.lock();
+        if (!slot) return;
+        if (const auto core = m_core.lock()) core->disconnect(slot.get());
+    }
+
+    bool connected() const
+    {
+        const auto slot = m_slot.lock();
+        return slot && slot->connected.load(std::memory_order_acquire);
+    }
+
+private:
+    std::weak_ptr<detail::SignalCoreBase> m_core;
+    std::weak_ptr<detail::SignalSlotBase> m_slot;
+};
+
+/**
+ * @brief Disconnects its slot when it goes out of scope.
+ */
+class ScopedEventConnection
+{
+public:
+    ScopedEventConnection() = default;
+    ScopedEventConnection(EventConnection connection) : m_connection(std::move(connection)) {}
+    ScopedEventConnection(const ScopedEventConnection& other) = delete;
+    ScopedEventConnection(ScopedEventConnection&& other) noexcept = default;
+    ~ScopedEventConnection() { m_connection.disconnect(); }
+
+    ScopedEventConnection& operator=(const ScopedEventConnection& other) = delete;
+    ScopedEventConnection& operator=(ScopedEventConnection&& other) noexcept
+    {
+        if (this != &other) {
+            m_connection.disconnect();
+            m_connection = std::move(other.m_connection);
+            other.m_connection = {};
+        }
+        return *this;
+    }
+
+    void disconnect() { m_connection.disconnect(); }
+    bool connected() const { return m_connection.connected(); }
+
+private:
+    EventConnection m_connection;
+};
+
+/**
+ * @brief Multicast callback list with lock-free emission.
+ *
+ * Slots live in an immutable list behind a detail::RcuCell: emitting follows it without taking a lock, connect()
+ * and disconnect() publish a modified copy. A slot connected to an empty signal is stored in the list itself, so
+ * emitting to the usual single subscriber goes straight from the list to its std::function; later lists point
+ * into that first one to reach it.
+ *
+ * As with signals2, slots connected during an emission are not called by it, and a slot disconnected during
+ * an emission is skipped unless it is already running.
+ */
+template <typename... Args>
+class EventSignal
+{
+public:
+    using Slot = std::function<void(Args...)>;
+
+    EventSignal() : m_core(std::make_shared<Core>()) {}
+    EventSignal(const EventSignal& other) = delete;
+    EventSignal& operator=(const EventSignal& other) = delete;
+
+    EventConnection connect(Slot slot)
+    {
+        std::shared_ptr<SlotState> state;
+        m_core->slots.update([&](const std::shared_ptr<const SlotList>& current, std::shared_ptr<SlotList>& next) {
+            next = std::make_shared<SlotList>();
+            if (!current) {
+                next->first.emplace(std::move(slot));
+                state = std::shared_ptr<SlotState>(next, &*next->first);
+                return true;
+            }
+            forEachSlot(current, [&](std::shared_ptr<SlotState> other) { next->rest.push_back(std::move(other)); });
+            state = std::make_shared<SlotState>(std::move(slot));
+            next->rest.push_back(state);
+            return true;
+        });
+        return EventConnection(m_core, state);
+    }
+
+    void disconnectAll() { m_core->disconnectAll(); }
+
+    bool empty() const { return m_core->slots.empty(); }
+
+    std::size_t slotCount() const
+    {
+        return m_core->slots.inspect(
+            [](const SlotList* list) { return list ? (list->first ? 1 : 0) + list->rest.size() : 0; });
+    }
+
+    void operator()(Args... args) const
+    {
+        const typename detail::RcuCell<SlotList>::Reader reader(m_core->slots);
+        const SlotList* list = reader.get();
+        if (!list) return;
+
+        if (list->first) call(*list->first, args...);
+        for (const auto& slot : list->rest) call(*slot, args...);
+    }
+
+private:
+    struct SlotState : detail::SignalSlotBase {
+        explicit SlotState(Slot fn) : fn(std::move(fn)) {}
+        Slot fn;
+    };
+
+    // first is only engaged in a list made by connecting to an empty signal, and rest is then empty; the
+    // aliasing pointers later lists hold to it keep just that small list alive
+    struct SlotList {
+        mutable std::optional<SlotState> first;
+        std::vector<std::shared_ptr<SlotState>> rest;
+    };
+
+    // every slot in list, in connection order
+    template <typename F>
+    static void forEachSlot(const std::shared_ptr<const SlotList>& list, F&& f)
+    {
+        if (list->first) f(std::shared_ptr<SlotState>(list, &*list->first));
+        for (const auto& state : list->rest) f(state);
+    }
+
+    struct Core : detail::SignalCoreBase {
+        detail::RcuCell<SlotList> slots;
+
+        void disconnect(const detail::SignalSlotBase* slot) override
+        {
+            slots.update([slot](const std::shared_ptr<const SlotList>& current, std::shared_ptr<SlotList>& next) {
+                if (!current) return false;
+                forEachSlot(current, [&](std::shared_ptr<SlotState> state) {
+                    if (state.get() == slot) {
+                        state->connected.store(false, std::memory_order_release);
+                        return;
+                    }
+                    if (!next) next = std::make_shared<SlotList>();
+                    next->rest.push_back(std::move(state));
+                });
+                return true;
+            });
+        }
+
+        void disconnectAll()
+        {
+            slots.update([](const std::shared_ptr<const SlotList>& current, std::shared_ptr<SlotList>&) {
+                if (!current) return false;
+                forEachSlot(current, [](const std::shared_ptr<SlotState>& state) {
+                    state->connected.store(false, std::memory_order_release);
+                });
+                return true;
+            });
+        }
+    };
+
+    static void call(const SlotState& slot, Args&... args)
+    {
+        if (slot.connected.load(std::memory_order_acquire)) slot.fn(args...);
+    }
+
+    std::shared_ptr<Core> m_core;
+};
+
+#endif //!_EVENT_SIGNAL_HEADER_HPP_
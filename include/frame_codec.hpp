@@ -0,0 +1,202 @@
+#ifndef _FRAME_CODEC_HEADER_HPP_
+#define _FRAME_CODEC_HEADER_HPP_ 1
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "connection_attachments.hpp"
+#include "event_signal.hpp"
+#include "recv_buffer.hpp"
+#include "tcp_connection_manager.hpp"
+
+/**
+ * @brief One complete message received through a FrameCodec.
+ *
+ * A frame that arrived within one receive buffer is a view into that pooled buffer and keeps it alive; only frames
+ * spanning buffers are copied, into a pooled buffer of their own when they fit one. Copying a Frame never copies
+ * the bytes.
+ */
+class Frame
+{
+public:
+    Frame() = default;
+
+    const char* data() const { return m_view.data(); }
+    std::size_t size() const { return m_view.size(); }
+    bool empty() const { return m_view.empty(); }
+    const char* begin() const { return m_view.data(); }
+    const char* end() const { return m_view.data() + m_view.size(); }
+    std::string_view view() const { return m_view; }
+    // true if the frame spanned receive buffers and was copied together
+    bool assembled() const { return m_assembled; }
+
+private:
+    friend class FrameDecoder;
+
+    RecvBuffer m_buffer;                        // the pooled buffer the bytes live in, or
+    std::shared_ptr<const std::string> m_large; // the copy of a spanning frame larger than a pooled buffer
+    std::string_view m_view;
+    bool m_assembled{false};
+};
+
+/**
+ * @brief Incremental parser for length-prefixed frames: a 4-byte big-endian length, then that many bytes.
+ *
+ * Fed the receive buffers of one connection in order, it delivers every frame as soon as its last byte arrives,
+ * however TCP split or merged them. Each connection needs a decoder of its own, used from its event loop.
+ */
+class FrameDecoder
+{
+public:
+    static constexpr std::size_t headerSize = 4;
+
+    explicit FrameDecoder(std::size_t maxFrameSize);
+
+    // Calls onFrame(const Frame&) for every frame completed by buffer. False once a header announces a frame
+    // above the limit; the stream can't be resynchronised after that, so the decoder stays failed.
+    template <typename OnFrame>
+    bool feed(const RecvBuffer& buffer, OnFrame&& onFrame);
+
+    // body bytes still missing from the frame being assembled; 0 between frames
+    std::size_t missingBytes() const { return m_inBody ? m_frameSize - m_filled : 0; }
+    bool failed() const { return m_failed; }
+
+private:
+    // starts assembling a frame of m_frameSize bytes that continues in the next buffer
+    void beginAssembly();
+    char* assemblyData();
+    Frame finishAssembly();
+
+private:
+    std::size_t m_maxFrameSize;
+    bool m_failed{false};
+
+    char m_header[headerSize]{};
+    std::size_t m_headerFilled{0};
+
+    bool m_inBody{false};
+    std::size_t m_frameSize{0};
+    std::size_t m_filled{0}; // body bytes already copied into the assembly buffer
+    RecvBuffer m_assembly;
+    std::shared_ptr<std::string> m_largeAssembly;
+};
+
+struct FrameCodecOptions {
+    std::size_t maxFrameSize{16 * 1024 * 1024}; // a larger length prefix closes the connection
+    // While at least this many body bytes of a frame are outstanding, SO_RCVLOWAT is raised so the loop isn't
+    // woken for every segment of a large frame; 0 leaves SO_RCVLOWAT alone.
+    std::size_t lowWatermarkThreshold{64 * 1024};
+    std::size_t maxLowWatermark{256 * 1024}; // the kernel caps SO_RCVLOWAT at half the receive buffer anyway
+};
+
+/**
+ * @brief Length-prefixed message framing on top of TCPConnectionManager.
+ *
+ * send() prefixes each message with its length; connections attached to the codec get their received bytes
+ * reassembled into frames, emitted through frameArrived on the connection's event loop. Thread-safe; closed
+ * connections detach themselves.
+ */
+class FrameCodec
+{
+public:
+    explicit FrameCodec(TCPConnectionManager& tcpConnMgr, FrameCodecOptions options = {});
+    FrameCodec(const FrameCodec& other) = delete;
+    ~FrameCodec();
+
+    EventSignal<const TCPConnInfo&, const Frame&> frameArrived;
+
+    // false if there is no such connection; attach before the peer sends, or bytes received earlier are lost.
+    // Accepted connections start reading after the newConnection slots have run, so attaching there is in time.
+    bool attach(ConnHandle conn);
+    void detach(ConnHandle conn);
+    std::size_t attachedCount() const;
+
+    // the header and payload as one message, e.g. for BroadcastGroup::publish
+    static std::string encode(std::string_view payload);
+    // false if there is no such connection, or its slow-consumer policy refused the frame
+    bool send(ConnHandle conn, std::string_view payload);
+
+    // frames delivered without copying, and frames that had to be assembled from several buffers
+    uint64_t framesInPlace() const { return m_framesInPlace; }
+    uint64_t framesAssembled() const { return m_framesAssembled; }
+
+private:
+    struct Attachment;
+
+    // on the connection's event loop, for every receive buffer
+    void onData(Attachment& attachment, const RecvBuffer& buffer);
+    void updateLowWatermark(Attachment& attachment);
+    // once the attachment is detached
+    static void resetLowWatermark(const std::shared_ptr<Attachment>& attachment);
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    const FrameCodecOptions m_options;
+
+    ConnectionAttachments<Attachment> m_attachments;
+
+    std::atomic<uint64_t> m_framesInPlace{0};
+    std::atomic<uint64_t> m_framesAssembled{0};
+};
+
+template <typename OnFrame>
+bool FrameDecoder::feed(const RecvBuffer& buffer, OnFrame&& onFrame)
+{
+    if (m_failed) return false;
+
+    const char* pos = buffer.data();
+    const char* const end = pos + buffer.size();
+    while (pos < end) {
+        if (!m_inBody) {
+            if (m_headerFilled == 0 && std::size_t(end - pos) >= headerSize) {
+                std::memcpy(m_header, pos, headerSize); // the usual case: the whole header in this buffer
+                pos += headerSize;
+            } else {
+                const std::size_t n = std::min(headerSize - m_headerFilled, std::size_t(end - pos));
+                std::memcpy(m_header + m_headerFilled, pos, n);
+                m_headerFilled += n;
+                pos += n;
+                if (m_headerFilled < headerSize) break;
+            }
+            m_headerFilled = 0;
+            m_frameSize = (std::size_t(uint8_t(m_header[0])) << 24) | (std::size_t(uint8_t(m_header[1])) << 16) |
+                          (std::size_t(uint8_t(m_header[2])) << 8) | std::size_t(uint8_t(m_header[3]));
+            if (m_frameSize > m_maxFrameSize) {
+                m_failed = true;
+                return false;
+            }
+
+            if (std::size_t(end - pos) >= m_frameSize) {
+                // complete within this buffer: handed out as a view, no copy
+                Frame frame;
+                frame.m_buffer = buffer;
+                frame.m_view = std::string_view(pos, m_frameSize);
+                pos += m_frameSize;
+                onFrame(static_cast<const Frame&>(frame));
+                continue;
+            }
+            m_inBody = true;
+            m_filled = 0;
+            beginAssembly();
+        }
+
+        const std::size_t n = std::min(m_frameSize - m_filled, std::size_t(end - pos));
+        std::memcpy(assemblyData() + m_filled, pos, n);
+        m_filled += n;
+        pos += n;
+        if (m_filled < m_frameSize) break;
+
+        m_inBody = false;
+        const Frame frame = finishAssembly();
+        onFrame(frame);
+    }
+    return true;
+}
+
+#endif //!_FRAME_CODEC_HEADER_HPP_
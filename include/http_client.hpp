@@ -0,0 +1,87 @@
+#ifndef _HTTP_CLIENT_HEADER_HPP_
+#define _HTTP_CLIENT_HEADER_HPP_ 1
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "http_parser.hpp"
+#include "tcp_connection_manager.hpp"
+
+struct HttpClientRequest {
+    std::string method{"GET"};
+    std::string target{"/"};
+    std::vector<std::pair<std::string, std::string>> headers; // Host and Content-Length are added
+    std::string body;
+    std::chrono::milliseconds timeout{0}; // from submission to the end of the response; 0 means the client's default
+};
+
+struct HttpClientResult {
+    // 0, or ETIMEDOUT, a connect error, ECONNRESET if the connection was lost, EPROTO for a malformed response,
+    // ECANCELED if the client went away first
+    int error{0};
+    HttpClientResponse response;
+};
+
+// runs exactly once per request, on an event loop or, for requests that fail right away, the calling thread
+using HttpResponseCallback = std::function<void(HttpClientResult result)>;
+
+struct HttpClientOptions {
+    std::size_t maxConnectionsPerHost{8};
+    std::size_t maxPipelineDepth{8}; // requests in flight on one connection; 1 turns pipelining off
+    std::chrono::milliseconds timeout{10000};
+    std::chrono::milliseconds connectTimeout{TCPConnectionManager::defaultConnectTimeout};
+    HttpParserLimits limits{.maxHeaderSize = 16 * 1024, .maxBodySize = 64 * 1024 * 1024, .maxHeaders = 64};
+};
+
+struct HttpClientStats {
+    uint64_t connectionsOpened{0};
+    uint64_t requestsSent{0};      // retries included
+    uint64_t pipelinedRequests{0}; // sent while earlier requests on the connection were still unanswered
+    uint64_t retries{0};
+    uint64_t timeouts{0};
+};
+
+/**
+ * @brief HTTP/1.1 client keeping a pool of keep-alive connections per host and port.
+ *
+ * A request goes to an idle pooled connection, or waits for a new one while the host has fewer than
+ * maxConnectionsPerHost. Once the pool is full, idempotent requests are pipelined onto the least busy connection;
+ * a non-idempotent one only ever goes out on an idle connection, and nothing is pipelined behind it (RFC 9112,
+ * section 9.3.2). Requests handed to a connection together leave in one write.
+ *
+ * Responses are parsed on the connection's event loop by HttpResponseParser and handed over without copying the
+ * body. A request that misses its deadline fails with ETIMEDOUT; if it was already sent, its connection is closed,
+ * as HTTP/1.1 can't abandon a response and keep the connection. Idempotent requests whose connection is lost
+ * before any of their response arrived are retried once on another connection.
+ */
+class HttpClient
+{
+public:
+    explicit HttpClient(TCPConnectionManager& tcpConnMgr, HttpClientOptions options = {});
+    HttpClient(const HttpClient& other) = delete;
+    // Closes the pooled connections; outstanding requests fail with ECANCELED, those already sent once their
+    // connection's event loop has seen the close, which may be after the client is gone.
+    ~HttpClient();
+
+    // host is a name, resolved through the manager's resolver, or an IP literal
+    void request(const std::string& host, uint16_t port, HttpClientRequest request, HttpResponseCallback callback);
+    std::future<HttpClientResult> request(const std::string& host, uint16_t port, HttpClientRequest request);
+
+    // pooled connections of every host, including those still connecting
+    std::size_t connectionCount() const;
+    HttpClientStats stats() const;
+
+private:
+    // shared with the timers and loop tasks of the requests, which may run after the client is destroyed
+    class Pool;
+    std::shared_ptr<Pool> m_pool;
+};
+
+#endif //!_HTTP_CLIENT_HEADER_HPP_
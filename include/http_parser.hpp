@@ -0,0 +1,223 @@
+#ifndef _HTTP_PARSER_HEADER_HPP_
+#define _HTTP_PARSER_HEADER_HPP_ 1
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "message_reassembler.hpp"
+#include "recv_buffer.hpp"
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// ASCII case-insensitive, as header names and most header values are compared
+bool httpEqualsIgnoreCase(std::string_view a, std::string_view b);
+// true if the comma-separated header value lists token, e.g. "close" in "Connection: keep-alive, close"
+bool httpHasToken(std::string_view value, std::string_view token);
+
+/**
+ * @brief A parsed HTTP/1.x request. Every view points into the receive buffer the request arrived in, or into the
+ * parser for requests that spanned buffers; they are only valid while the request is being handled.
+ */
+struct HttpRequest {
+    std::string_view method;
+    std::string_view target; // as sent, e.g. "/search?q=tcp"
+    std::string_view path;   // target up to the '?'
+    std::string_view query;  // after the '?', empty if there is none
+    int minorVersion{1};     // HTTP/1.<minorVersion>
+    std::vector<HttpHeader> headers;
+    std::string_view body; // chunked bodies are decoded
+    bool keepAlive{true};
+
+    // the first header called name, or an empty view
+    std::string_view header(std::string_view name) const;
+};
+
+struct HttpParserLimits {
+    std::size_t maxHeaderSize{16 * 1024}; // request line and headers; answered with 431
+    std::size_t maxBodySize{1024 * 1024}; // answered with 413
+    std::size_t maxHeaders{64};
+};
+
+/**
+ * @brief A parsed HTTP/1.x response. It holds on to the receive buffers its views point into, so it stays valid for
+ * as long as it is kept, and the body is never copied: one that spans buffers is a list of segments.
+ */
+struct HttpClientResponse {
+    int status{0};
+    std::string_view reason;
+    int minorVersion{1};
+    std::vector<HttpHeader> headers;
+    std::vector<std::string_view> body; // segments in order; chunked bodies are decoded
+    bool keepAlive{true};
+
+    std::string_view header(std::string_view name) const;
+    std::size_t bodySize() const;
+    // the segments joined into one string
+    std::string bodyString() const;
+
+private:
+    friend class HttpResponseParser;
+    std::vector<RecvBuffer> m_buffers;
+};
+
+/**
+ * @brief Incremental HTTP/1.1 request parser for one connection.
+ *
+ * Fed the connection's receive buffers in order, it hands out every complete request, so pipelined requests
+ * arriving together come out of one call. Requests within a buffer are parsed in place; a request that spans
+ * buffers is collected by a MessageReassembler, and the parser only scans the new bytes for the end of the header
+ * block and tracks chunked bodies chunk by chunk.
+ */
+class HttpRequestParser
+{
+public:
+    explicit HttpRequestParser(HttpParserLimits limits = {});
+
+    // Calls onRequest(const HttpRequest&) for every request completed by buffer. False once the input is not
+    // HTTP the parser accepts; errorStatus() is then the status to answer with, and the parser stays failed.
+    template <typename OnRequest>
+    bool feed(std::string_view buffer, OnRequest&& onRequest);
+
+    bool failed() const { return m_errorStatus != 0; }
+    int errorStatus() const { return m_errorStatus; }
+    // bytes of a request that is still incomplete
+    std::size_t pendingBytes() const { return m_input.size(); }
+
+private:
+    using Result = ParseResult;
+    enum class BodyFraming { None, Length, Chunked };
+
+    // parses the request at the start of window; consumed is its size when Complete
+    Result parse(std::string_view window, std::size_t& consumed);
+    bool parseHead(std::string_view head);
+    Result parseChunks(std::string_view window);
+    Result fail(int status);
+    // forgets the per-request state, before the next request is parsed
+    void reset();
+
+private:
+    const HttpParserLimits m_limits;
+    int m_errorStatus{0};
+
+    MessageReassembler m_input;
+
+    HttpRequest m_request;
+    const char* m_parsedBase{nullptr}; // the window m_request's views point into
+    std::size_t m_headScanned{0};      // bytes already searched for the end of the header block
+    std::size_t m_headEnd{0};          // 0 until the header block is complete
+    BodyFraming m_framing{BodyFraming::None};
+    std::size_t m_contentLength{0};
+
+    // chunked bodies
+    std::size_t m_chunkPos{0}; // next chunk-size line (or trailer line), relative to the request
+    bool m_inTrailer{false};
+    std::string m_chunkedBody;
+};
+
+template <typename OnRequest>
+bool HttpRequestParser::feed(std::string_view buffer, OnRequest&& onRequest)
+{
+    if (failed()) return false;
+
+    return m_input.feed(
+        buffer, [this](std::string_view window, std::size_t& consumed) { return parse(window, consumed); },
+        [&]() {
+            onRequest(static_cast<const HttpRequest&>(m_request));
+            reset();
+        });
+}
+
+/**
+ * @brief Incremental HTTP/1.1 response parser for one client connection.
+ *
+ * Responses come out in the order their requests were registered with expectResponse(), which is also how the
+ * parser learns that a response to HEAD has no body. Body bytes stay in the receive buffers they arrived in; only
+ * a status line and headers that straddle two buffers are copied, into a pooled block of their own. Bodies are
+ * delimited by Content-Length, chunked transfer coding, or the end of the connection (see finish()). Interim 1xx
+ * responses are skipped. One parser per connection, fed from its event loop only.
+ */
+class HttpResponseParser
+{
+public:
+    // maxHeaderSize is capped at RecvBufferPool::blockSize
+    explicit HttpResponseParser(HttpParserLimits limits = {});
+
+    // registers the request the next unclaimed response answers; a response nobody expects is an error
+    void expectResponse(bool toHead);
+
+    // Calls onResponse(HttpClientResponse&&) for every response completed by buffer. False once the input is not
+    // HTTP the parser accepts; the parser stays failed.
+    template <typename OnResponse>
+    bool feed(const RecvBuffer& buffer, OnResponse&& onResponse);
+    // The peer closed the connection, which completes a body that runs until then. False if a response was cut off.
+    template <typename OnResponse>
+    bool finish(OnResponse&& onResponse);
+
+    bool failed() const { return m_state == State::Failed; }
+    // bytes of the next response have arrived, so its request may have been processed
+    bool responseStarted() const { return m_state != State::Head || m_headSize != 0; }
+    std::size_t expectedResponses() const { return m_expected.size(); }
+
+private:
+    enum class State { Head, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailer, UntilClose, Failed };
+
+    // consumes buffer from pos until it runs out or completes a response
+    bool advance(const RecvBuffer& buffer, std::size_t& pos);
+    // head is the status line and headers, inside holder
+    bool parseHead(const RecvBuffer& holder, std::string_view head);
+    // a CRLF-terminated line of chunked framing, collected in m_line if it spans buffers
+    bool readLine(std::string_view data, std::size_t& pos, std::string_view& line);
+    void addBody(const RecvBuffer& buffer, std::size_t pos, std::size_t size);
+    void keep(const RecvBuffer& buffer);
+    void complete();
+    bool fail();
+    HttpClientResponse takeResponse();
+
+private:
+    HttpParserLimits m_limits;
+    State m_state{State::Head};
+    std::deque<bool> m_expected; // per request sent and not answered: whether it was a HEAD
+
+    HttpClientResponse m_response;
+    bool m_complete{false};
+    RecvBuffer m_head;         // a head that continues in a later buffer
+    std::size_t m_headSize{0}; // its bytes so far
+    std::size_t m_remaining{0}; // of the Content-Length body or the current chunk
+    std::size_t m_bodySize{0};
+    std::string m_line;
+    std::size_t m_crlfSeen{0}; // of the CRLF after chunk data
+};
+
+template <typename OnResponse>
+bool HttpResponseParser::feed(const RecvBuffer& buffer, OnResponse&& onResponse)
+{
+    if (failed()) return false;
+
+    std::size_t pos = 0;
+    while (pos < buffer.size()) {
+        if (!advance(buffer, pos)) return false;
+        if (m_complete) onResponse(takeResponse());
+    }
+    return true;
+}
+
+template <typename OnResponse>
+bool HttpResponseParser::finish(OnResponse&& onResponse)
+{
+    if (m_state == State::UntilClose) {
+        complete();
+        onResponse(takeResponse());
+        return true;
+    }
+    if (responseStarted()) return fail();
+    return !failed();
+}
+
+#endif //!_HTTP_PARSER_HEADER_HPP_
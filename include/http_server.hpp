@@ -0,0 +1,127 @@
+#ifndef _HTTP_SERVER_HEADER_HPP_
+#define _HTTP_SERVER_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "http_parser.hpp"
+#include "protocol_server.hpp"
+
+struct HttpResponse {
+    int status{200};
+    std::vector<std::pair<std::string, std::string>> headers; // Content-Length and Connection are added
+    std::string body;
+
+    void setHeader(std::string name, std::string value) { headers.emplace_back(std::move(name), std::move(value)); }
+};
+
+// "OK" for 200 and so on; "Unknown" for codes without a standard phrase
+std::string_view httpReasonPhrase(int status);
+
+// runs on the connection's event loop; fills in the response, which starts out as an empty 200
+using HttpHandler = std::function<void(const HttpRequest& request, HttpResponse& response)>;
+
+/**
+ * @brief Maps method and path to a handler.
+ *
+ * Paths match exactly, or as a prefix when they end in '*' (e.g. "/static/" plus the star); the longest match
+ * wins, exact matches before prefixes. compile() flattens the routes into a byte trie with the edges of each node
+ * stored together, so a lookup is one walk down the request path without allocating or hashing.
+ */
+class HttpRouter
+{
+public:
+    struct Match {
+        const HttpHandler* handler{nullptr};
+        bool pathFound{false}; // the path matched, but no route for the method: 405 rather than 404
+    };
+
+    // an empty method matches every method; HEAD falls back to GET routes
+    void add(std::string method, std::string path, HttpHandler handler);
+    // builds the trie; routes added later take effect with the next compile()
+    void compile();
+
+    Match find(std::string_view method, std::string_view path) const;
+
+private:
+    struct Route {
+        std::string method;
+        HttpHandler handler;
+    };
+    struct Node {
+        uint32_t firstEdge{0};
+        uint32_t edgeCount{0};
+        int32_t exact{-1};  // index into m_targets of the routes for exactly this path
+        int32_t prefix{-1}; // ... and of those for paths starting with it
+    };
+    struct Edge {
+        char byte;
+        uint32_t child;
+    };
+
+    struct PendingRoute {
+        std::string path;
+        bool prefix;
+        Route route;
+    };
+
+    const HttpHandler* findInTarget(int32_t target, std::string_view method) const;
+
+private:
+    std::vector<PendingRoute> m_routes;
+
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges; // sorted by byte within each node
+    std::vector<std::vector<Route>> m_targets;
+};
+
+struct HttpServerOptions {
+    HttpParserLimits limits;
+    std::size_t shards{1}; // see TCPServer::start
+};
+
+/**
+ * @brief HTTP/1.1 server on top of TCPServer.
+ *
+ * Requests are parsed incrementally from the receive buffers (see HttpRequestParser) and handled on the event loop
+ * of their connection. Pipelined requests are answered in order, and all responses to one receive buffer leave in
+ * a single write. Connections are kept alive unless the request asks otherwise; malformed requests get an error
+ * status and the connection is closed once it is sent.
+ */
+class HttpServer
+{
+public:
+    HttpServer(TCPConnectionManager& tcpConnMgr, HttpRouter router, HttpServerOptions options = {});
+    HttpServer(const HttpServer& other) = delete;
+    ~HttpServer();
+
+    // false if no listener could be opened
+    bool start(const std::string& address, uint16_t port);
+
+    std::size_t connectionCount() const;
+    uint64_t requestsServed() const { return m_requestsServed; }
+
+private:
+    struct Connection;
+
+    // on the connection's event loop, for every receive buffer
+    void onData(Connection& conn, const RecvBuffer& buffer);
+    // appends the response to conn's output
+    void respond(Connection& conn, const HttpRequest& request);
+
+private:
+    HttpRouter m_router;
+    const HttpServerOptions m_options;
+    ProtocolServer<Connection> m_server;
+
+    std::atomic<uint64_t> m_requestsServed{0};
+};
+
+#endif //!_HTTP_SERVER_HEADER_HPP_
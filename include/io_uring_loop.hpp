@@ -0,0 +1,161 @@
+#ifndef _IO_URING_LOOP_HEADER_HPP_
+#define _IO_URING_LOOP_HEADER_HPP_ 1
+#pragma once
+
+#ifdef __linux__
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include "event_loop.hpp"
+
+/**
+ * @brief Completion-driven loop on top of a raw io_uring instance.
+ *
+ * Besides the readiness interface of EventLoop (emulated with one-shot IORING_OP_POLL_ADD, re-armed after every
+ * dispatch so it behaves level-triggered like the reactor) the loop offers the completion-based operations the
+ * connection manager uses on its hot paths:
+ *  - multishot accept on listening sockets,
+ *  - multishot recv into a buffer ring provided to the kernel, so idle sockets pin no memory,
+ *  - sends queued from any thread, gathered into one IORING_OP_SENDMSG per socket (up to IOV_MAX messages) and
+ *    submitted in one io_uring_enter per loop iteration.
+ */
+class IoUringLoop : public EventLoop
+{
+public:
+    using AcceptHandler = std::function<void(SOCKET newSockFd)>;
+    // data == nullptr signals the end of the stream: size == 0 on orderly shutdown, -errno on error
+    using RecvHandler = std::function<void(const char* data, int size)>;
+
+    explicit IoUringLoop(unsigned entries = 4096, unsigned bufferCount = 1024, unsigned bufferSize = 4096);
+    ~IoUringLoop() override;
+
+    // false when the kernel refused to create the ring or the buffer ring (e.g. io_uring disabled by policy)
+    bool valid() const;
+
+    void acceptMultishot(SOCKET listenSockFd, AcceptHandler handler);
+    void recvMultishot(SOCKET sockfd, RecvHandler handler);
+    // thread-safe; messages to one socket go out in order, partial sends are resumed
+    void send(SOCKET sockfd, OutboundMessage data);
+    // Thread-safe close marker: onSent runs on the loop once every message sent to sockfd so far has completed (or
+    // a send failed); later sends to it are dropped. Never runs if the socket is removed first.
+    void closeAfterSends(SOCKET sockfd, Task onSent);
+
+protected:
+    void run(std::stop_token st) override;
+    void wakeUp() override;
+
+    void addDirect(SOCKET sockfd, uint32_t events, Handler handler) override;
+    void modifyDirect(SOCKET sockfd, uint32_t events) override;
+    void removeDirect(SOCKET sockfd) override;
+
+private:
+    enum class Op : uint8_t
+    {
+        Wake = 1,
+        Poll,
+        Accept,
+        Recv,
+        Send,
+        Cancel
+    };
+
+    // the message header of a gathered send; must stay put until the kernel completes it
+    struct SendBatch {
+        msghdr header{};
+        std::vector<iovec> buffers;
+    };
+
+    struct OrphanedSend {
+        std::deque<OutboundMessage> queue;
+        std::unique_ptr<SendBatch> batch;
+    };
+
+    struct SocketState {
+        uint32_t generation{0};
+        uint32_t pollEvents{0};
+        Handler pollHandler;
+        AcceptHandler acceptHandler;
+        RecvHandler recvHandler;
+        std::deque<OutboundMessage> sendQueue;
+        std::size_t sendOffset{0};
+        std::unique_ptr<SendBatch> sendBatch;
+        Task closeMarker; // see closeAfterSends()
+        bool closeMarked{false};
+        bool pollArmed{false};
+        bool acceptArmed{false};
+        bool recvArmed{false};
+        bool sendInFlight{false};
+    };
+
+    static uint64_t makeUserData(Op op, uint32_t generation, SOCKET sockfd);
+
+    io_uring_sqe* getSqe();
+    // timeoutMs bounds the wait for minComplete completions; -1 waits indefinitely
+    int submit(unsigned minComplete, int timeoutMs = -1);
+    void reapCompletions();
+    void handleCompletion(const io_uring_cqe& cqe);
+
+    SocketState* stateFor(SOCKET sockfd, uint32_t generation);
+    SocketState& registerSocket(SOCKET sockfd);
+    void cancel(Op op, SOCKET sockfd, uint32_t generation);
+
+    void armWakeRead();
+    void armPoll(SOCKET sockfd, SocketState& state);
+    void armAccept(SOCKET sockfd, SocketState& state);
+    void armRecv(SOCKET sockfd, SocketState& state);
+    void armSend(SOCKET sockfd, SocketState& state);
+    // runs the close marker once nothing is queued or in flight any more
+    void checkCloseMarker(SocketState& state);
+
+    void recycleBuffer(uint16_t bufferId);
+
+private:
+    int m_ringFd{-1};
+    int m_wakeFd{-1};
+    uint64_t m_wakeValue{0};
+    uint32_t m_nextGeneration{1};
+
+    // submission queue
+    void* m_sqRing{nullptr};
+    std::size_t m_sqRingSize{0};
+    unsigned* m_sqHead{nullptr};
+    unsigned* m_sqTail{nullptr};
+    unsigned* m_sqMask{nullptr};
+    unsigned* m_sqArray{nullptr};
+    io_uring_sqe* m_sqes{nullptr};
+    std::size_t m_sqesSize{0};
+    unsigned m_sqEntries{0};
+    unsigned m_sqLocalTail{0};
+    unsigned m_toSubmit{0};
+
+    // completion queue
+    void* m_cqRing{nullptr};
+    std::size_t m_cqRingSize{0};
+    unsigned* m_cqHead{nullptr};
+    unsigned* m_cqTail{nullptr};
+    unsigned* m_cqMask{nullptr};
+    io_uring_cqe* m_cqes{nullptr};
+
+    // provided receive buffers (buffer group 0)
+    io_uring_buf_ring* m_bufRing{nullptr};
+    std::size_t m_bufRingSize{0};
+    char* m_buffers{nullptr};
+    unsigned m_bufferCount{0};
+    unsigned m_bufferSize{0};
+    uint16_t m_bufRingTail{0};
+
+    // only accessed from the loop thread
+    std::unordered_map<SOCKET, SocketState> m_sockets;
+    // sends still owned by the kernel after their socket was removed, keyed by user_data
+    std::unordered_map<uint64_t, OrphanedSend> m_orphanedSends;
+};
+
+#endif // __linux__
+
+#endif //!_IO_URING_LOOP_HEADER_HPP_
@@ -0,0 +1,121 @@
+#ifndef _KV_SERVER_HEADER_HPP_
+#define _KV_SERVER_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "kv_store.hpp"
+#include "message_reassembler.hpp"
+#include "protocol_server.hpp"
+
+struct RespParserLimits {
+    std::size_t maxArgs{1024 * 1024};
+    std::size_t maxBulkSize{SlabAllocator::maxChunkSize};
+    std::size_t maxInlineSize{64 * 1024}; // an inline command line, or a *<count> / $<size> line
+};
+
+/**
+ * @brief Incremental parser for RESP commands, as Redis clients send them.
+ *
+ * Commands are arrays of bulk strings ("*2\r\n$3\r\nGET\r\n$1\r\nk\r\n"), or inline lines of space-separated words
+ * as typed into telnet. Commands within a buffer are parsed in place, so the arguments point into the receive
+ * buffer; a command that spans buffers is collected by a MessageReassembler first, and parsing resumes where the
+ * previous buffer left off.
+ */
+class RespParser
+{
+public:
+    explicit RespParser(RespParserLimits limits = {});
+
+    // Calls onCommand(const std::vector<std::string_view>& args) for every complete command, args[0] being its
+    // name; the views are only valid during the call. False once the input is malformed; error() then says why,
+    // and the parser stays failed.
+    template <typename OnCommand>
+    bool feed(std::string_view buffer, OnCommand&& onCommand);
+
+    bool failed() const { return !m_error.empty(); }
+    const std::string& error() const { return m_error; }
+    std::size_t pendingBytes() const { return m_input.size(); }
+
+private:
+    using Result = ParseResult;
+
+    // Parses the command at the start of window into m_args; consumed is its size when Complete. After NeedMore
+    // the next call must pass the same command with more bytes appended, and picks up where this one stopped.
+    Result parse(std::string_view window, std::size_t& consumed);
+    Result fail(std::string error);
+
+private:
+    const RespParserLimits m_limits;
+    std::string m_error;
+    MessageReassembler m_input;
+    std::vector<std::string_view> m_args;
+
+    // progress on an incomplete command, relative to its first byte
+    std::size_t m_parsed{0};   // bytes already parsed: whole arguments, or the inline line searched so far
+    int64_t m_argCount{-1};    // from the "*<count>" line; -1 until it has been read
+    std::vector<std::pair<std::size_t, std::size_t>> m_argSpans; // offset and size of every argument parsed
+};
+
+template <typename OnCommand>
+bool RespParser::feed(std::string_view buffer, OnCommand&& onCommand)
+{
+    if (failed()) return false;
+
+    return m_input.feed(
+        buffer, [this](std::string_view window, std::size_t& consumed) { return parse(window, consumed); },
+        [&]() {
+            if (!m_args.empty()) onCommand(static_cast<const std::vector<std::string_view>&>(m_args));
+        });
+}
+
+struct KvServerOptions {
+    RespParserLimits limits;
+    std::size_t shards{1}; // see TCPServer::start
+};
+
+/**
+ * @brief Redis-compatible key-value cache on top of TCPServer and a KvStore.
+ *
+ * Speaks the RESP subset a cache needs: GET, SET, DEL, EXISTS, MGET, MSET, INCR, INCRBY, DECR, DBSIZE, FLUSHALL,
+ * PING, ECHO and QUIT, plus empty replies to the CONFIG and COMMAND queries redis-benchmark and redis-cli start
+ * with. Commands are executed on the connection's event loop as they are parsed, values are copied from the
+ * store straight into the reply, and the replies to all commands of one receive buffer leave in a single write,
+ * so pipelined clients cost one syscall per batch.
+ */
+class KvServer
+{
+public:
+    KvServer(TCPConnectionManager& tcpConnMgr, KvStore& store, KvServerOptions options = {});
+    KvServer(const KvServer& other) = delete;
+    ~KvServer();
+
+    // false if no listener could be opened
+    bool start(const std::string& address, uint16_t port);
+
+    std::size_t connectionCount() const;
+    uint64_t commandsServed() const { return m_commandsServed; }
+
+private:
+    struct Connection;
+
+    // on the connection's event loop, for every receive buffer
+    void onData(Connection& conn, const RecvBuffer& buffer);
+    // appends the reply to conn's output
+    void execute(Connection& conn, const std::vector<std::string_view>& args);
+
+private:
+    KvStore& m_store;
+    const KvServerOptions m_options;
+    ProtocolServer<Connection> m_server;
+
+    std::atomic<uint64_t> m_commandsServed{0};
+};
+
+#endif //!_KV_SERVER_HEADER_HPP_
@@ -0,0 +1,197 @@
+#ifndef _KV_STORE_HEADER_HPP_
+#define _KV_STORE_HEADER_HPP_ 1
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+class SlabPagePool;
+
+/**
+ * @brief Fixed-size chunk allocator in the style of memcached's slabs.
+ *
+ * Sizes are rounded up to one of a few dozen classes, 1.25x apart. A class carves 1 MiB pages into chunks; every
+ * page keeps its freed chunks on an intrusive free list, so allocating is a pop or a pointer bump and values never
+ * fragment the heap. Pages come from a SlabPagePool, and a page whose chunks are all free goes back to it, so
+ * memory isn't tied to the size class that first used it. Not thread-safe.
+ */
+class SlabAllocator
+{
+public:
+    static constexpr std::size_t pageSize = 1024 * 1024;
+    static constexpr std::size_t minChunkSize = 48;
+    // every page starts with its bookkeeping; the largest chunk is the rest of the page
+    static constexpr std::size_t pageHeaderSize = 64;
+    static constexpr std::size_t maxChunkSize = pageSize - pageHeaderSize;
+
+    // with a pool of its own; memoryLimit bounds the pages reserved, 0 means no limit
+    explicit SlabAllocator(std::size_t memoryLimit = 0);
+    // pages are shared with the other allocators on pool; those still holding chunks when the allocator goes away
+    // are only freed with the pool
+    explicit SlabAllocator(SlabPagePool& pool);
+    SlabAllocator(const SlabAllocator& other) = delete;
+    ~SlabAllocator();
+
+    // nullptr once the pool is out of pages, or for sizes above maxChunkSize
+    void* allocate(std::size_t size);
+    void deallocate(void* chunk);
+    // the size allocate(size) actually hands out
+    std::size_t chunkSize(std::size_t size) const;
+
+    std::size_t usedBytes() const { return m_usedBytes; }
+    std::size_t reservedBytes() const { return m_pageCount * pageSize; }
+
+private:
+    struct Page;
+
+    struct SizeClass {
+        std::size_t chunkSize;
+        Page* partial{nullptr}; // pages of the class with a chunk left
+    };
+
+    // index of the smallest class holding size bytes
+    std::size_t classFor(std::size_t size) const;
+    static Page* pageOf(void* chunk);
+    static void link(SizeClass& sizeClass, Page* page);
+    static void unlink(SizeClass& sizeClass, Page* page);
+
+private:
+    std::unique_ptr<SlabPagePool> m_ownPool;
+    SlabPagePool& m_pool;
+    std::vector<SizeClass> m_classes;
+    std::size_t m_pageCount{0};
+    std::size_t m_usedBytes{0};
+};
+
+/**
+ * @brief Budget of SlabAllocator pages, shared by any number of allocators.
+ *
+ * Pages are taken from the heap on demand, up to the limit, and handed back and forth between the allocators
+ * from then on; they are only freed with the pool. Thread-safe.
+ */
+class SlabPagePool
+{
+public:
+    // memoryLimit bounds the pages taken from the heap; 0 means no limit
+    explicit SlabPagePool(std::size_t memoryLimit = 0);
+    SlabPagePool(const SlabPagePool& other) = delete;
+    ~SlabPagePool();
+
+    // a page of SlabAllocator::pageSize bytes, aligned to its size; nullptr once the limit is reached
+    void* acquire();
+    void release(void* page);
+
+    // pages taken from the heap, in use or not
+    std::size_t reservedBytes() const;
+
+private:
+    const std::size_t m_memoryLimit;
+    mutable std::mutex m_mutex;
+    std::vector<void*> m_pages;
+    std::vector<void*> m_freePages;
+};
+
+struct KvStoreOptions {
+    std::size_t shards{16};
+    std::size_t memoryLimit{1024ull * 1024 * 1024}; // one page budget for all shards; 0 means no limit
+    std::size_t maxItemSize{SlabAllocator::maxChunkSize}; // key and value together
+};
+
+struct KvStoreStats {
+    std::size_t items{0};
+    std::size_t usedBytes{0};     // chunks holding items
+    std::size_t reservedBytes{0}; // slab pages
+};
+
+/**
+ * @brief In-memory key-value table, sharded to keep lock hold times short under many event loops.
+ *
+ * Each shard is an open-addressing table with linear probing over (hash, item) slots, so a lookup walks adjacent
+ * slots and only touches an item once the hashes match; deletes shift the following slots back instead of leaving
+ * tombstones. Key and value live together in one chunk from the shard's SlabAllocator; the shards' allocators
+ * share one SlabPagePool, so memory goes wherever the values do. Thread-safe.
+ */
+class KvStore
+{
+public:
+    explicit KvStore(KvStoreOptions options = {});
+    KvStore(const KvStore& other) = delete;
+    ~KvStore();
+
+    // Calls onValue(std::string_view) with the shard locked, so the value can be copied straight into a reply;
+    // false if there is no such key.
+    template <typename OnValue>
+    bool get(std::string_view key, OnValue&& onValue) const;
+    bool contains(std::string_view key) const;
+
+    // false if the item is above maxItemSize or the store is out of memory; an existing value is then kept
+    bool set(std::string_view key, std::string_view value);
+    bool erase(std::string_view key);
+    // Adds delta to a value holding a decimal integer, a missing key counting as 0. False if the value isn't an
+    // integer, the sum overflows or there is no memory; result is only set on success.
+    bool increment(std::string_view key, int64_t delta, int64_t& result);
+    void clear();
+
+    std::size_t size() const;
+    KvStoreStats stats() const;
+
+private:
+    struct Item {
+        uint32_t keySize;
+        uint32_t valueSize;
+
+        char* key() { return reinterpret_cast<char*>(this + 1); }
+        const char* key() const { return reinterpret_cast<const char*>(this + 1); }
+        std::string_view value() const { return {key() + keySize, valueSize}; }
+        std::size_t size() const { return sizeof(Item) + keySize + valueSize; }
+    };
+
+    struct Slot {
+        uint64_t hash;
+        Item* item; // nullptr for an empty slot
+    };
+
+    struct Shard {
+        explicit Shard(SlabPagePool& pages) : slab(pages) {}
+
+        mutable std::mutex mutex;
+        SlabAllocator slab;
+        std::vector<Slot> slots; // a power of two in size
+        std::size_t items{0};
+    };
+
+    static uint64_t hashOf(std::string_view key);
+    // the slot comes from the low bits of the hash; the shard from the high bits of a multiplicative remix
+    Shard& shardFor(uint64_t hash) const
+    {
+        return *m_shards[((hash * 0x9E3779B97F4A7C15ull) >> 40) % m_shards.size()];
+    }
+
+    // the shard's mutex held by the callers of these
+    static std::size_t findSlot(const Shard& shard, uint64_t hash, std::string_view key); // slots.size() if absent
+    bool store(Shard& shard, uint64_t hash, std::string_view key, std::string_view value);
+    static void removeSlot(Shard& shard, std::size_t index);
+    static void grow(Shard& shard);
+
+private:
+    const KvStoreOptions m_options;
+    SlabPagePool m_pages; // outlives the shards
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
+
+template <typename OnValue>
+bool KvStore::get(std::string_view key, OnValue&& onValue) const
+{
+    const uint64_t hash = hashOf(key);
+    const Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    const std::size_t index = findSlot(shard, hash, key);
+    if (index == shard.slots.size()) return false;
+    onValue(shard.slots[index].item->value());
+    return true;
+}
+
+#endif //!_KV_STORE_HEADER_HPP_
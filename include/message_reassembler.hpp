@@ -0,0 +1,68 @@
+#ifndef _MESSAGE_REASSEMBLER_HEADER_HPP_
+#define _MESSAGE_REASSEMBLER_HEADER_HPP_ 1
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+enum class ParseResult
+{
+    Complete,
+    NeedMore,
+    Error
+};
+
+/**
+ * @brief The receive-buffer side of a parser that parses messages in place.
+ *
+ * Messages that sit whole in a buffer are parsed where they lie. One that spans buffers is collected here until
+ * its last byte arrives, and whatever follows it in that buffer is parsed in place again. Not thread-safe; a
+ * connection's buffers all arrive on its event loop.
+ */
+class MessageReassembler
+{
+public:
+    // parse(std::string_view window, std::size_t& consumed) parses the message at the start of window, setting
+    // consumed to its size when it returns Complete; after NeedMore it is called with the same message and more
+    // bytes appended. onMessage() runs after every Complete, while the window is still valid. False on Error.
+    template <typename Parse, typename OnMessage>
+    bool feed(std::string_view buffer, Parse&& parse, OnMessage&& onMessage);
+
+    // bytes of a message that is still incomplete
+    std::size_t size() const { return m_pending.size(); }
+
+private:
+    std::string m_pending; // an incomplete message, copied out of the buffers it arrived in
+};
+
+template <typename Parse, typename OnMessage>
+bool MessageReassembler::feed(std::string_view buffer, Parse&& parse, OnMessage&& onMessage)
+{
+    std::size_t consumed = 0;
+    if (!m_pending.empty()) {
+        const std::size_t before = m_pending.size();
+        m_pending.append(buffer);
+        const ParseResult result = parse(std::string_view(m_pending), consumed);
+        if (result == ParseResult::Error) return false;
+        if (result == ParseResult::NeedMore) return true;
+        onMessage();
+        // the pending bytes alone were an incomplete message, so it ended inside this buffer
+        buffer.remove_prefix(consumed - before);
+        m_pending.clear();
+    }
+
+    while (!buffer.empty()) {
+        const ParseResult result = parse(buffer, consumed);
+        if (result == ParseResult::Error) return false;
+        if (result == ParseResult::NeedMore) {
+            m_pending.assign(buffer);
+            return true;
+        }
+        onMessage();
+        buffer.remove_prefix(consumed);
+    }
+    return true;
+}
+
+#endif //!_MESSAGE_REASSEMBLER_HEADER_HPP_
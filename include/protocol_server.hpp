@@ -0,0 +1,75 @@
+#ifndef _PROTOCOL_SERVER_HEADER_HPP_
+#define _PROTOCOL_SERVER_HEADER_HPP_ 1
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include "connection_attachments.hpp"
+#include "tcp_server.hpp"
+
+/**
+ * @brief The connection handling that request/response protocols on top of TCPServer have in common.
+ *
+ * Every accepted client gets a State attached (see ConnectionAttachments), fed with its receive buffers on its
+ * event loop. Besides what ConnectionAttachments needs, State has a `std::string out` for the replies to the
+ * buffer being handled and a `bool closing` that ends the connection once they are sent; flush() does both, so
+ * everything answered for one buffer leaves in a single write. Owners call stop() first thing in their
+ * destructor, so no data slot runs into a half-destroyed owner.
+ */
+template <typename State>
+class ProtocolServer
+{
+public:
+    using StatePtr = typename ConnectionAttachments<State>::StatePtr;
+
+    // makeState(const TCPConnInfo&, TCPConnection&) and onData(State&, const RecvBuffer&) as for
+    // ConnectionAttachments::attach
+    template <typename MakeState, typename OnData>
+    ProtocolServer(TCPConnectionManager& tcpConnMgr, MakeState makeState, OnData onData)
+        : m_tcpConnMgr(tcpConnMgr), m_server(tcpConnMgr), m_connections(tcpConnMgr)
+    {
+        m_clientConnection = m_server.clientConnected.connect(
+            [this, makeState = std::move(makeState), onData = std::move(onData)](TCPConnInfo connInfo) {
+                m_connections.attach(connInfo, makeState, onData);
+            });
+    }
+    ProtocolServer(const ProtocolServer& other) = delete;
+    ~ProtocolServer() { stop(); }
+
+    // false if no listener could be opened
+    bool start(const std::string& address, uint16_t port, std::size_t shards)
+    {
+        return m_server.start(address, port, shards);
+    }
+
+    // stops attaching new clients and detaches the current ones
+    void stop()
+    {
+        m_clientConnection.disconnect();
+        m_connections.clear();
+    }
+
+    // on the connection's event loop, once the buffer is handled
+    void flush(State& state)
+    {
+        if (!state.out.empty()) {
+            m_tcpConnMgr.write(state.connInfo, std::move(state.out));
+            state.out.clear();
+        }
+        if (state.closing) m_tcpConnMgr.closeConnAfterWrites(state.connInfo);
+    }
+
+    StatePtr find(ConnHandle handle) const { return m_connections.find(handle); }
+    std::size_t connectionCount() const { return m_connections.size(); }
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    TCPServer m_server;
+
+    ConnectionAttachments<State> m_connections;
+
+    ScopedEventConnection m_clientConnection;
+};
+
+#endif //!_PROTOCOL_SERVER_HEADER_HPP_
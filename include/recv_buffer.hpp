@@ -0,0 +1,138 @@
+#ifndef _RECV_BUFFER_HEADER_HPP_
+#define _RECV_BUFFER_HEADER_HPP_ 1
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Reference-counted handle to a pooled receive buffer.
+ *
+ * The connection manager reads straight into a buffer taken from RecvBufferPool and hands the same buffer to every
+ * newDataArrived slot. Copying the handle only bumps the reference count, so a slot can keep the bytes without
+ * copying them; the buffer goes back to the pool when the last handle is dropped.
+ *
+ * The conversion to std::vector<char> copies the bytes, so it has to be asked for; a slot taking the old
+ * std::vector<char> signature would pay for one copy on every receive.
+ */
+class RecvBuffer
+{
+public:
+    using const_iterator = const char*;
+
+    // header in front of the bytes of a pooled block; only the pool creates them
+    struct Block {
+        std::atomic<uint32_t> refs{1};
+        uint32_t size{0};
+
+        char* bytes() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    RecvBuffer() = default;
+    RecvBuffer(const RecvBuffer& other) noexcept;
+    RecvBuffer(RecvBuffer&& other) noexcept;
+    RecvBuffer& operator=(const RecvBuffer& other) noexcept;
+    RecvBuffer& operator=(RecvBuffer&& other) noexcept;
+    ~RecvBuffer();
+
+    const char* data() const { return m_block ? m_block->bytes() : nullptr; }
+    std::size_t size() const { return m_block ? m_block->size : 0; }
+    bool empty() const { return size() == 0; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size(); }
+    char operator[](std::size_t index) const { return data()[index]; }
+    std::string_view view() const { return {data(), size()}; }
+
+    explicit operator std::vector<char>() const { return std::vector<char>(begin(), end()); }
+
+    // Only for the reader filling a freshly acquired buffer, before anyone else holds a handle to it.
+    char* writableData() { return m_block->bytes(); }
+    std::size_t capacity() const;
+    void resize(std::size_t size) { m_block->size = (uint32_t)size; }
+
+private:
+    friend class RecvBufferPool;
+
+    explicit RecvBuffer(Block* block) : m_block(block) {}
+    void release();
+
+    Block* m_block{nullptr};
+};
+
+struct RecvBufferPoolStats {
+    uint64_t allocations{0}; // blocks taken from the heap
+    uint64_t liveBlocks{0};  // blocks currently allocated, in use or cached
+};
+
+/**
+ * @brief Fixed-size block pool behind RecvBuffer.
+ *
+ * Every thread keeps a small cache of free blocks, so the event loop thread that reads a buffer and drops it
+ * again once the slots have run never touches a lock or the heap. Caches that overflow spill into a shared
+ * depot, which also refills threads that run dry; only an empty depot falls back to the heap.
+ */
+class RecvBufferPool
+{
+public:
+    static constexpr std::size_t blockSize = 16 * 1024;
+
+    // an empty buffer with blockSize bytes of capacity
+    static RecvBuffer acquire();
+    static RecvBufferPoolStats stats();
+
+private:
+    friend class RecvBuffer;
+
+    static void recycle(RecvBuffer::Block* block);
+};
+
+inline RecvBuffer::RecvBuffer(const RecvBuffer& other) noexcept : m_block(other.m_block)
+{
+    if (m_block) m_block->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline RecvBuffer::RecvBuffer(RecvBuffer&& other) noexcept : m_block(other.m_block)
+{
+    other.m_block = nullptr;
+}
+
+inline RecvBuffer& RecvBuffer::operator=(const RecvBuffer& other) noexcept
+{
+    if (this != &other) {
+        if (other.m_block) other.m_block->refs.fetch_add(1, std::memory_order_relaxed);
+        release();
+        m_block = other.m_block;
+    }
+    return *this;
+}
+
+inline RecvBuffer& RecvBuffer::operator=(RecvBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_block = other.m_block;
+        other.m_block = nullptr;
+    }
+    return *this;
+}
+
+inline RecvBuffer::~RecvBuffer()
+{
+    release();
+}
+
+inline std::size_t RecvBuffer::capacity() const
+{
+    return m_block ? RecvBufferPool::blockSize : 0;
+}
+
+inline void RecvBuffer::release()
+{
+    if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) RecvBufferPool::recycle(m_block);
+    m_block = nullptr;
+}
+
+#endif //!_RECV_BUFFER_HEADER_HPP_
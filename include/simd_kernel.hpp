@@ -0,0 +1,14 @@
+#ifndef _SIMD_KERNEL_HEADER_HPP_
+#define _SIMD_KERNEL_HEADER_HPP_ 1
+#pragma once
+
+// Instruction sets the SIMD kernels (DelimiterScanner, WebSocketMasker) come in; see cpu_features.hpp for the
+// runtime checks behind them.
+enum class SimdKernel { Scalar, Sse2, Avx2 };
+
+// AVX2 where the CPU and OS support it, SSE2 on any other x86-64, scalar elsewhere; decided once
+SimdKernel bestSimdKernel();
+bool simdKernelAvailable(SimdKernel kernel);
+const char* simdKernelName(SimdKernel kernel);
+
+#endif //!_SIMD_KERNEL_HEADER_HPP_
@@ -2,45 +2,179 @@
 #define _TCP_CONNECTION_HEADER_HPP_ 1
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
-
-#include <winsock2.h>
+#include <type_traits>
 
 #include "connection.hpp"
+#include "event_loop.hpp"
+#include "tcp_util.hpp"
 
 class TCPConnectionManager;
 
 //will use later
 struct TCPKeepAliveInfo {};
 
+/**
+ * @brief Socket and generation of a connection, packed into 64 bits.
+ *
+ * The manager hands out a new generation whenever it registers a connection, so a handle kept after the
+ * connection closed doesn't reach a later connection that got the same descriptor. Generation 0 matches whatever
+ * connection is on the socket. Windows socket handles fit in the low 32 bits, like descriptors do elsewhere.
+ */
+class ConnHandle
+{
+public:
+    constexpr ConnHandle() = default;
+    constexpr ConnHandle(SOCKET sockfd, uint32_t generation)
+        : m_value((uint64_t(generation) << 32) | uint32_t(sockfd))
+    {}
+
+    constexpr SOCKET sockfd() const { return (SOCKET)(uint32_t)m_value; }
+    constexpr uint32_t generation() const { return uint32_t(m_value >> 32); }
+    constexpr uint64_t value() const { return m_value; }
+
+    auto operator<=>(const ConnHandle& other) const = default;
+
+private:
+    uint64_t m_value{0};
+};
+
+template <>
+struct std::hash<ConnHandle> {
+    std::size_t operator()(const ConnHandle& handle) const noexcept { return std::hash<uint64_t>{}(handle.value()); }
+};
+
 struct TCPConnInfo 
 {
     SOCKET sockfd {};
-    std::string peerIP;
+    IPAddress peerIP;
     uint16_t peerPort;
+    uint32_t generation{0}; // filled in when the manager registers the connection
+
+    ConnHandle handle() const { return {sockfd, generation}; }
+    operator ConnHandle() const { return handle(); }
 
     //for std::set in tcp_server
     auto operator<=>(const TCPConnInfo& other) const = default;
 };
+static_assert(std::is_trivially_copyable_v<TCPConnInfo>);
 
-class TCPConnection : public Connection
+// what happens to a write that would take a connection's outbound queue above its high-water mark
+enum class SlowConsumerPolicy
+{
+    Buffer,     // keep everything; only the watermark signals fire
+    DropOldest, // drop the oldest unsent messages until the queue fits again
+    DropNewest, // drop the new message
+    Disconnect, // close the connection
+    Conflate    // keep only the newest unsent message (latest value wins)
+};
+
+struct WriteBufferLimits {
+    std::size_t highWaterMark{0}; // queued bytes; 0 means unlimited
+    std::size_t lowWaterMark{0};  // onWriteBufferLow fires once the queue has drained to this
+    SlowConsumerPolicy policy{SlowConsumerPolicy::Buffer};
+};
+
+// progress of a file transfer; called on the connection's event loop after every slice
+using SendFileProgress = std::function<void(uint64_t sent, uint64_t total)>;
+// error is 0 when the whole range was sent, otherwise an errno value (ECANCELED if the connection closed first)
+using SendFileCompletion = std::function<void(uint64_t sent, int error)>;
+
+class TCPConnection : public Connection, private EventLoop::Retirable
 {
 public:
-    TCPConnection(TCPConnectionManager& tcpMgr, TCPConnInfo data);
+    TCPConnection(TCPConnectionManager& tcpMgr, EventLoop& eventLoop, TCPConnInfo data);
     TCPConnection(const TCPConnection& other) = delete;
 
     virtual ~TCPConnection();
     virtual void stop() override;
     virtual bool write(const std::string& msg) override;
     virtual void startReadingData() override;
+    // Streams length bytes of fd, starting at offset, with sendfile() from the event loop. The caller keeps fd open
+    // until completion runs. Queued in order with write(); returns false if the connection is gone.
+    bool sendFile(int fd, uint64_t offset, uint64_t length, SendFileProgress progress = {},
+                  SendFileCompletion completion = {});
 
     TCPConnInfo& connInfo();
 
+    // High fires on the writing thread when a write takes the outbound queue above the high-water mark, low on the
+    // event loop once the queue has drained to the low-water mark again. Both get the bytes queued at that point.
+    EventSignal<std::size_t> onWriteBufferHigh;
+    EventSignal<std::size_t> onWriteBufferLow;
+
+    // new connections start with TCPConnectionManager::defaultWriteBufferLimits()
+    void setWriteBufferLimits(const WriteBufferLimits& limits);
+    WriteBufferLimits writeBufferLimits();
+    // bytes written but not yet handed to the kernel; file transfers don't count
+    std::size_t queuedBytes();
+
+    // the loop owning this socket; all reads and the final close happen on its thread
+    EventLoop& eventLoop() const;
+    // closes the socket exactly once, no matter how many times it is called
+    void closeSocket();
+    bool socketClosed() const;
+
+    // data waiting to be sent; filled by any thread, drained by the owning event loop
+    struct OutboundQueue {
+        std::mutex mutex;
+        std::deque<OutboundMessage> messages;
+        std::size_t offset{0};    // bytes of messages.front() already sent
+        std::size_t queuedBytes{0};
+        bool flushPending{false}; // a flush is posted, or the loop waits for the socket to become writable
+        bool sending{false};      // the loop is sending straight from the queued messages; they must stay put
+        WriteBufferLimits limits;
+        bool aboveHighWater{false};
+        bool trimPending{false};  // the policy has to drop messages as soon as the send in progress returns
+        bool writeWatched{false}; // Writable interest registered with the loop; only touched by the loop thread
+        // close marker from closeConnAfterWrites(): the loop closes the connection once the queue has drained;
+        // nothing is queued behind it
+        bool closeMarked{false};
+
+        // MSG_ZEROCOPY bookkeeping, only touched by the loop thread
+        enum class ZeroCopy : uint8_t { Untried, On, Unsupported } zeroCopy{ZeroCopy::Untried};
+        uint32_t zeroCopyNextSeq{0};               // the kernel numbers zero-copy sends per socket, from 0
+        std::optional<uint32_t> frontZeroCopySeq;  // last zero-copy send that included messages.front()
+        // fully sent messages the kernel may still read from, with the number of their last send
+        std::deque<std::pair<uint32_t, OutboundMessage>> zeroCopyPending;
+
+        struct FileTransfer {
+            int fd;
+            uint64_t offset;
+            uint64_t remaining;
+            uint64_t total;
+            uint64_t position; // number of messages queued before this transfer
+            SendFileProgress progress;
+            SendFileCompletion completion;
+        };
+        std::deque<FileTransfer> files;
+        uint64_t messagesQueued{0};
+        uint64_t messagesSent{0};
+    };
+    OutboundQueue& outbound();
+
 protected:
     TCPConnInfo connInfo_{};
 
+private:
+    friend class TCPConnectionManager;
+
+    // Hands the socket to the owning loop's retire queue; self keeps the connection alive until the loop has
+    // unregistered and closed it.
+    void retire(std::shared_ptr<TCPConnection> self);
+    void retired() override;
+
 private:
     TCPConnectionManager& m_tcpMgr;
+    EventLoop& m_eventLoop;
+    std::atomic<bool> m_socketClosed{false};
+    OutboundQueue m_outbound;
+    std::shared_ptr<TCPConnection> m_retiredSelf;
 };
 
 #endif //!_TCP_CONNECTION_HEADER_HPP_
\ No newline at end of file
@@ -2,87 +2,317 @@
 #define _TCP_CONNECTION_MANAGER_HEADER_HPP_ 1
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-#include <boost/signals2.hpp>
-
+#include "connection_registry.hpp"
+#include "dns_resolver.hpp"
+#include "event_loop.hpp"
 #include "tcp_connection.hpp"
 
+/**
+ * @brief Routes an event to the slots registered for one socket, e.g. new connections to their listener's owner.
+ *
+ * Slots are indexed by socket in a hash map published copy-on-write, so sendTo() is one lookup and an EventSignal
+ * emission, without a lock, however many sockets are registered. Adding the first slot of a socket or dropping a
+ * socket copies the map; further slots only touch that socket's signal.
+ */
 class TargetedSignal
 {
 public:
-    void connect(const SOCKET socket, std::function<void(TCPConnInfo)> slotFunc)
+    using Slot = std::function<void(TCPConnInfo)>;
+
+    EventConnection connect(const SOCKET socket, Slot slotFunc)
+    {
+        std::shared_ptr<EventSignal<TCPConnInfo>> signal;
+        m_slots.update([&](const std::shared_ptr<const SlotMap>& current, std::shared_ptr<SlotMap>& next) {
+            if (current) {
+                if (const auto it = current->find(socket); it != current->end()) {
+                    signal = it->second;
+                    return false;
+                }
+            }
+            signal = std::make_shared<EventSignal<TCPConnInfo>>();
+            next = current ? std::make_shared<SlotMap>(*current) : std::make_shared<SlotMap>();
+            next->emplace(socket, signal);
+            return true;
+        });
+        return signal->connect(std::move(slotFunc));
+    }
+
+    // drops every slot registered for socket, e.g. once its listener is closed
+    void disconnect(const SOCKET socket)
     {
-        slots.push_back({socket, slotFunc});
+        m_slots.update([&](const std::shared_ptr<const SlotMap>& current, std::shared_ptr<SlotMap>& next) {
+            if (!current) return false;
+            const auto it = current->find(socket);
+            if (it == current->end()) return false;
+            it->second->disconnectAll();
+            if (current->size() > 1) {
+                next = std::make_shared<SlotMap>(*current);
+                next->erase(socket);
+            }
+            return true;
+        });
     }
 
-    void sendTo(const SOCKET targetSocket, TCPConnInfo tcpConnInfo)
+    void sendTo(const SOCKET targetSocket, TCPConnInfo tcpConnInfo) const
     {
-        for (const auto& ts : slots) {
-            if (ts.socket == targetSocket) { ts.slot(tcpConnInfo); }
-        }
+        const detail::RcuCell<SlotMap>::Reader reader(m_slots);
+        if (!reader.get()) return;
+        const auto it = reader.get()->find(targetSocket);
+        if (it != reader.get()->end()) (*it->second)(std::move(tcpConnInfo));
     }
 
 private:
-    struct SocketSlot {
-        SOCKET socket;
-        std::function<void(TCPConnInfo)> slot;
-    };
+    using SlotMap = std::unordered_map<SOCKET, std::shared_ptr<EventSignal<TCPConnInfo>>>;
+
+    detail::RcuCell<SlotMap> m_slots;
+};
+
+// how the event loops talk to the kernel; chosen once, when the manager is constructed
+enum class IOBackend
+{
+    Reactor, // readiness notifications (epoll on Linux, WSAPoll elsewhere) followed by recv/accept/send calls
+    IoUring  // Linux only: multishot accept/recv into provided buffers, batched sends; falls back to Reactor
+};
+
+struct AcceptStats {
+    uint64_t accepted{0};         // connections accepted since the manager was created
+    uint64_t backlogOverflows{0}; // wakeups that found a listen queue full, i.e. the kernel was dropping SYNs
+    double acceptsPerSecond{0};   // accept rate since the previous call to acceptStats()
+};
 
-    std::vector<SocketSlot> slots;
+struct ZeroCopyStats {
+    uint64_t sends{0};     // send calls made with MSG_ZEROCOPY
+    uint64_t completed{0}; // of those, reported done through the error queue
+    uint64_t copied{0};    // completed sends the kernel had to copy after all, e.g. over loopback
+};
+
+// bytes thrown away by the slow-consumer policies, per policy
+struct SlowConsumerStats {
+    uint64_t droppedOldestBytes{0};
+    uint64_t droppedNewestBytes{0};
+    uint64_t conflatedBytes{0};
+    uint64_t disconnectedBytes{0}; // queued or being written when a connection was closed for being slow
+    uint64_t disconnects{0};
 };
 
 class TCPConnectionManager
 {
 public:
-    boost::signals2::signal<void(TCPConnInfo)> newConnection;
-    boost::signals2::signal<void(TCPConnInfo)> connectionClosed;
+    // None of these is emitted while the manager holds a lock of its own, so slots may call straight back into it.
+    // accepted connections start reading once these slots have run, so nothing they attach misses data
+    EventSignal<TCPConnInfo> newConnection;
+    // one emission per drained accept batch, after newConnection has fired for each connection in it
+    EventSignal<const std::vector<TCPConnInfo>&> newConnectionBatch;
+    EventSignal<TCPConnInfo> connectionClosed;
     TargetedSignal newConnectionOnListeningSocket;
 
 public:
-    TCPConnectionManager();
+    // numEventLoops == 0 starts one event loop per hardware thread
+    explicit TCPConnectionManager(std::size_t numEventLoops = 0, IOBackend backend = IOBackend::Reactor);
     ~TCPConnectionManager();
     void stop();
 
     static std::string dnsLookup(const std::string& host, uint16_t ipVersion = 0); 
+    // every A and AAAA record of host, families interleaved starting with IPv6 (RFC 8305, section 4)
+    static std::vector<std::string> dnsLookupAll(const std::string& host);
 
     TCPConnInfo openConnection(const std::string& destAddress, uint16_t destPort); 
     TCPConnInfo openConnection(const std::string& destAddress, uint16_t destPort,
                                                   const std::string& sourceAddress, uint16_t sourcePort);
 
-    bool write(TCPConnInfo connData, const std::string& msg);
+    // error is 0 on success, otherwise the socket error (ETIMEDOUT when the timeout expired, ECANCELED on stop())
+    using ConnectCallback = std::function<void(TCPConnInfo connInfo, int error)>;
+    static constexpr std::chrono::milliseconds defaultConnectTimeout{5000};
+
+    // Non-blocking connect driven by the event loops; the calling thread never waits for the handshake. The
+    // callback runs on the loop that owns the new connection, or on the calling thread when the outcome is known
+    // right away: immediate failures, a call after stop(), and a connect() that succeeds at once (common on
+    // loopback).
+    void openConnectionAsync(const std::string& destAddress, uint16_t destPort, ConnectCallback callback,
+                             std::chrono::milliseconds timeout = defaultConnectTimeout);
+    // as above; a default TCPConnInfo (sockfd == 0) signals failure, like openConnection
+    std::future<TCPConnInfo> openConnectionAsync(const std::string& destAddress, uint16_t destPort,
+                                                 std::chrono::milliseconds timeout = defaultConnectTimeout);
+
+    // Happy eyeballs: resolves host through resolver() and connects to every address of it, starting a new attempt each attemptDelay (or as soon as
+    // one fails) until one succeeds. The first connection wins, the other attempts are cancelled or closed.
+    static constexpr std::chrono::milliseconds defaultAttemptDelay{250};
+    void openConnectionByName(const std::string& host, uint16_t destPort, ConnectCallback callback,
+                              std::chrono::milliseconds timeout = defaultConnectTimeout,
+                              std::chrono::milliseconds attemptDelay = defaultAttemptDelay);
+    std::future<TCPConnInfo> openConnectionByName(const std::string& host, uint16_t destPort,
+                                                  std::chrono::milliseconds timeout = defaultConnectTimeout,
+                                                  std::chrono::milliseconds attemptDelay = defaultAttemptDelay);
+    // the race itself, over addresses that are already resolved; tried in the given order
+    void openConnectionToAny(std::vector<std::string> destAddresses, uint16_t destPort, ConnectCallback callback,
+                             std::chrono::milliseconds timeout = defaultConnectTimeout,
+                             std::chrono::milliseconds attemptDelay = defaultAttemptDelay);
+
+    // Thread-safe and non-blocking: msg is appended to the connection's outbound queue and sent by the owning
+    // event loop. Returns false if there is no such connection (or only a newer one on the same socket), or the
+    // connection's slow-consumer policy refused msg (DropNewest, Disconnect). A TCPConnInfo converts to its handle.
+    bool write(ConnHandle conn, const std::string& msg);
+    // as above, without copying msg
+    bool write(ConnHandle conn, std::string&& msg);
+    // as above; the buffer is shared, not copied, so the same one can be queued on many connections
+    bool write(ConnHandle conn, SharedBuffer msg);
+    // see TCPConnection::sendFile; the transfer keeps its place among the writes to the connection
+    bool sendFile(ConnHandle conn, int fd, uint64_t offset, uint64_t length, SendFileProgress progress = {},
+                  SendFileCompletion completion = {});
+
+    // Opt-in MSG_ZEROCOPY for messages of at least threshold bytes; smaller ones keep being copied, which is
+    // cheaper for them. A message is held until the kernel reports through the socket's error queue that it no
+    // longer reads from it, also past the close of its connection. Thresholds below minZeroCopyThreshold are
+    // raised to it, which keeps short strings, stored inside the queue itself, off this path. Linux with the
+    // Reactor backend only; returns false where it isn't available.
+    static constexpr std::size_t defaultZeroCopyThreshold = 32 * 1024;
+    static constexpr std::size_t minZeroCopyThreshold = 4 * 1024;
+    bool setZeroCopy(bool enabled, std::size_t threshold = defaultZeroCopyThreshold);
+    ZeroCopyStats zeroCopyStats() const;
+
+    // Outbound queue limits for connections created from now on; see TCPConnection::setWriteBufferLimits. The
+    // policies apply to the Reactor backend, whose queues the manager owns.
+    void setDefaultWriteBufferLimits(const WriteBufferLimits& limits);
+    WriteBufferLimits defaultWriteBufferLimits() const;
+    SlowConsumerStats slowConsumerStats() const;
     TCPConnInfo openListenSocket(const std::string& ipAddr, uint16_t port);
+    // One SO_REUSEPORT listener per event loop (shards == 0 means eventLoopCount()), all bound to ipAddr:port.
+    // The kernel spreads incoming connections over the listeners and every accepted connection stays on the
+    // loop that accepted it. With port 0 every listener joins the ephemeral port the first one was given. Returns
+    // an empty vector if any of the listeners can't be opened; the ones opened before it are closed again.
+    std::vector<TCPConnInfo> openListenSockets(const std::string& ipAddr, uint16_t port, std::size_t shards = 0);
 
-    std::weak_ptr<TCPConnection> getConnection(const TCPConnInfo& connInfo) const;
+    // throws std::out_of_range if there is no connection on the socket, or it belongs to another generation
+    std::weak_ptr<TCPConnection> getConnection(ConnHandle conn) const;
+    std::size_t connectionCount() const;
     void startReadingData(const TCPConnInfo& connInfo);
-    void closeConn(const TCPConnInfo connData);
+    // a no-op for handles whose connection is already closed; connectionClosed gets the registered TCPConnInfo
+    void closeConn(ConnHandle conn);
+    // Closes the connection once everything written to it so far has been handed to the kernel, e.g. after the last
+    // response of a protocol that ends with the server's reply. Later writes to it are dropped. False if there is
+    // no such connection.
+    bool closeConnAfterWrites(ConnHandle conn);
+
+    std::size_t eventLoopCount() const;
+    IOBackend ioBackend() const;
+    DNSResolver& resolver();
+    AcceptStats acceptStats();
 
 private:
-    void checkForConnections(std::stop_token token, const TCPConnInfo& connInfo);
-    void readDataFromSocket(std::stop_token token, TCPConnInfo connInfo) const;
+    friend class BroadcastGroup;
+    template <typename State>
+    friend class ConnectionAttachments;
+    friend class FrameCodec;
+    friend class DelimiterCodec;
+    friend class HttpClient;
+    friend class HttpServer;
+    friend class KvServer;
+    friend class TCPConnection;
+    friend class WebSocketServer;
+
+    struct PendingConnect;
+    struct ConnectRace;
+
+    // nullptr when the callback already ran, i.e. the connect completed or failed immediately
+    std::shared_ptr<PendingConnect> startConnect(const std::string& destAddress, uint16_t destPort,
+                                                 ConnectCallback callback, std::chrono::milliseconds timeout);
+    void completeConnect(const std::shared_ptr<PendingConnect>& pending, int error);
+
+    void startNextAttempt(const std::shared_ptr<ConnectRace>& race);
+    void onAttemptDone(const std::shared_ptr<ConnectRace>& race, const TCPConnInfo& connInfo, int error);
+    // hands a connected socket to its event loop and starts reading; returns the registered info
+    TCPConnInfo registerConnectedSocket(const TCPConnInfo& connInfo, EventLoop& loop);
+
+    // sharded listeners live on a given loop and keep their connections there; others use nextEventLoop()
+    TCPConnInfo openListenSocket(const std::string& ipAddr, uint16_t port, EventLoop& loop, bool sharded);
+
+    // both run on the event loop owning the socket, whenever it becomes readable
+    void checkForConnections(const TCPConnInfo& connInfo, EventLoop* shardLoop);
+    void readDataFromSocket(const TCPConnInfo& connInfo);
+
+    void registerAcceptedConnections(SOCKET listenSockFd, const std::vector<TCPConnInfo>& batch,
+                                     EventLoop* shardLoop);
+    void deliverData(TCPConnection& conn, const RecvBuffer& buffer) const;
+    // copies data into pooled buffers first (io_uring hands out its own provided buffers)
+    void deliverData(TCPConnection& conn, const char* data, int size) const;
+    // runs on the owning loop; sends the outbound queue, IOV_MAX messages per call, until it is empty or the
+    // socket is full, in which case it waits for the socket to become writable
+    void flushOutbound(const std::shared_ptr<TCPConnection>& conn);
+    // appends to the connection's outbound queue, applying its slow-consumer policy; flushes right away when
+    // called on the owning loop. False if the policy refused msg.
+    bool enqueueOutbound(const std::shared_ptr<TCPConnection>& conn, OutboundMessage msg);
+    // applies DropOldest/Conflate; out.mutex held and no send in progress
+    void trimOutbound(TCPConnection::OutboundQueue& out);
+    // runs on the owning loop when the socket reports an error; releases messages the kernel is done with
+    void reapZeroCopyCompletions(TCPConnection& conn);
+    void reapZeroCopyCompletions(SOCKET sockfd, std::deque<std::pair<uint32_t, OutboundMessage>>& pending);
+    // runs on the owning loop right before the socket is closed; cancels file transfers, keeps zero-copy buffers
+    void retireOutbound(TCPConnection& conn);
+    // polls a closed connection's socket on its loop until the kernel has released its zero-copy buffers
+    struct ZeroCopyLinger;
+    void lingerZeroCopy(EventLoop& loop, const std::shared_ptr<ZeroCopyLinger>& linger);
+    // closes the socket and drops the buffers; a socket still holding some is reset so the kernel lets go of them
+    void releaseZeroCopyLinger(const std::shared_ptr<ZeroCopyLinger>& linger);
+
+    EventLoop& nextEventLoop();
 
     //functions only to be used for m_connections - thread-safe
-    void addConnection(SOCKET sockfd, std::shared_ptr<TCPConnection> conn);
-    void removeConnection(SOCKET sockfd);
-    bool hasConnection(SOCKET sockfd) const;
-    std::shared_ptr<TCPConnection> getConnectionDirect(SOCKET sockfd) const;
+    // gives the connection the next generation before it is published; returns its info with that generation
+    TCPConnInfo addConnection(std::shared_ptr<TCPConnection> conn);
+    // the removed connection; of several threads removing the same one, only one gets it
+    std::shared_ptr<TCPConnection> removeConnection(ConnHandle conn);
+    bool hasConnection(ConnHandle conn) const;
+    std::shared_ptr<TCPConnection> getConnectionDirect(ConnHandle conn) const;
 
 private:
-    bool m_finish{false};
+    std::atomic<bool> m_finish{false};
     bool m_printReceivedData{false};
 
-    mutable std::recursive_mutex m_connectionsMutex;
-    mutable std::mutex m_connThreadsMutex;
+    // looked up on every read and write, without a lock
+    ConnectionRegistry m_connections;
+    std::atomic<uint32_t> m_nextGeneration{1}; // 0 is the wildcard generation and never handed out
+
+    // outbound connects still waiting for the handshake, so stop() can cancel them
+    std::mutex m_pendingConnectsMutex;
+    std::unordered_map<SOCKET, std::shared_ptr<PendingConnect>> m_pendingConnects;
+
+    // fixed set of I/O threads owning every socket; connections are spread round-robin
+    IOBackend m_backend{IOBackend::Reactor};
+    std::vector<std::unique_ptr<EventLoop>> m_eventLoops;
+    std::atomic<std::size_t> m_nextEventLoop{0};
+
+    std::atomic<uint64_t> m_acceptedCount{0};
+    std::atomic<uint64_t> m_backlogOverflows{0};
+    std::mutex m_acceptStatsMutex;
+    std::chrono::steady_clock::time_point m_acceptStatsTime{std::chrono::steady_clock::now()};
+    uint64_t m_acceptStatsCount{0};
+
+    std::atomic<std::size_t> m_zeroCopyThreshold{0}; // 0: zero-copy sends disabled
+    std::atomic<uint64_t> m_zeroCopySends{0};
+    std::atomic<uint64_t> m_zeroCopyCompleted{0};
+    std::atomic<uint64_t> m_zeroCopyCopied{0};
+    std::mutex m_zeroCopyLingersMutex;
+    std::vector<std::shared_ptr<ZeroCopyLinger>> m_zeroCopyLingers;
 
-    std::jthread m_connThreadsCleaner;
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    std::pair<bool, SOCKET> m_threadFinished = {false, -1};
+    mutable std::mutex m_writeLimitsMutex;
+    WriteBufferLimits m_defaultWriteLimits;
+    std::atomic<uint64_t> m_droppedOldestBytes{0};
+    std::atomic<uint64_t> m_droppedNewestBytes{0};
+    std::atomic<uint64_t> m_conflatedBytes{0};
+    std::atomic<uint64_t> m_disconnectedBytes{0};
+    std::atomic<uint64_t> m_slowDisconnects{0};
 
-    std::unordered_map<SOCKET, std::shared_ptr<TCPConnection>> m_connections;
-    std::unordered_map<SOCKET, std::jthread> m_connThreads;
-    //std::unordered_map<SOCKET, std::jthread> m_checkForConnectionsThreads;
+    // last member: its workers are joined before anything their callbacks use goes away
+    DNSResolver m_resolver;
 };
 
 #endif //!_TCP_HANDLER_HEADER_HPP_
\ No newline at end of file
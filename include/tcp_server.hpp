@@ -2,37 +2,58 @@
 #define _TCP_SERVER_HEADER_HPP_ 1
 #pragma once
 
-#include <set>
+#include <algorithm>
+#include <vector>
 
+#include "broadcast_group.hpp"
 #include "tcp_connection_manager.hpp"
 class TCPServer
 {
 public:
-    TCPServer(TCPConnectionManager& tcpConnMgr) : m_tcpConnMgr(tcpConnMgr) {}
+    TCPServer(TCPConnectionManager& tcpConnMgr) : m_tcpConnMgr(tcpConnMgr), m_clients(tcpConnMgr) {}
 
-    void start(const std::string& sourceAddress, uint16_t sourcePort)
+    // every accepted client, on the loop that accepted it; protocol layers attach to the connection here
+    EventSignal<TCPConnInfo> clientConnected;
+
+    // shards > 1 opens that many SO_REUSEPORT listeners (0: one per event loop) so accepts run on every loop;
+    // false if none of them could be opened
+    bool start(const std::string& sourceAddress, uint16_t sourcePort, std::size_t shards = 1)
     {
-        m_listenSockInfo = m_tcpConnMgr.openListenSocket(sourceAddress, sourcePort);
-        m_tcpConnMgr.newConnectionOnListeningSocket.connect(
-                    m_listenSockInfo.sockfd,
-                    [&](TCPConnInfo conn) { 
-                m_connections.emplace(conn);
-            });
-        m_tcpConnMgr.connectionClosed.connect([&](TCPConnInfo conn) { 
-                m_connections.erase(conn);
-            });
+        if (shards == 1) {
+            m_listenSockInfos = {m_tcpConnMgr.openListenSocket(sourceAddress, sourcePort)};
+        } else {
+            m_listenSockInfos = m_tcpConnMgr.openListenSockets(sourceAddress, sourcePort, shards);
+        }
+        for (const auto& listenSockInfo : m_listenSockInfos) {
+            m_listenerConnections.emplace_back(m_tcpConnMgr.newConnectionOnListeningSocket.connect(
+                listenSockInfo.sockfd, [this](TCPConnInfo conn) {
+                    m_clients.subscribe(conn);
+                    clientConnected(conn);
+                }));
+        }
+        return std::any_of(m_listenSockInfos.begin(), m_listenSockInfos.end(),
+                           [](const TCPConnInfo& info) { return info.sockfd != 0; });
     }
 
+    std::size_t shardCount() const { return m_listenSockInfos.size(); }
+    // sockfd is 0 for listeners that couldn't be opened
+    const std::vector<TCPConnInfo>& listenSockets() const { return m_listenSockInfos; }
+    std::size_t clientCount() const { return m_clients.size(); }
+
+    // bounds what a stalled client can queue up, so it can't hold back or exhaust memory for the others
+    void setClientWriteBufferLimits(const WriteBufferLimits& limits) { m_clients.setWriteBufferLimits(limits); }
+
+    // serialised once and sent by every event loop in parallel; closed clients drop out of the group by themselves
     void broadcast(const std::string& message) {
-        for (const auto& conn : m_connections) { 
-            m_tcpConnMgr.write(conn, message);
-        }
+        m_clients.publish(message);
     }
 
 private:
-    TCPConnectionManager&   m_tcpConnMgr;
-    TCPConnInfo             m_listenSockInfo;
-    std::set<TCPConnInfo>   m_connections;
+    TCPConnectionManager&    m_tcpConnMgr;
+    std::vector<TCPConnInfo> m_listenSockInfos;
+    BroadcastGroup           m_clients;
+    // disconnected before m_clients goes away, so accepts racing the destructor don't reach a dead group
+    std::vector<ScopedEventConnection> m_listenerConnections;
 };
 
 #endif
\ No newline at end of file
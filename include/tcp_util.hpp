@@ -2,35 +2,294 @@
 #define _TCP_UTIL_HEADER_HPP_ 1
 #pragma once
 
+#include <array>
+#include <charconv>
+#include <compare>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
 
+#ifdef _WIN32
+#include <io.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
-inline int makeSockAddr(const std::string& ipAddr, uint16_t port, sockaddr& addr)
+#include <cerrno>
+
+// Winsock names used throughout the code base, mapped onto their BSD socket counterparts
+using SOCKET = int;
+using WSAPOLLFD = pollfd;
+
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+inline int closesocket(SOCKET sockfd)
+{
+    return ::close(sockfd);
+}
+
+inline int WSAGetLastError()
+{
+    return errno;
+}
+
+inline int WSAPoll(WSAPOLLFD* fds, unsigned long count, int timeout)
+{
+    return ::poll(fds, count, timeout);
+}
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Winsock never raises SIGPIPE
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// one buffer of a gathered send
+#ifdef _WIN32
+using IoVec = WSABUF;
+
+inline IoVec makeIoVec(const char* data, std::size_t size)
+{
+    return {(ULONG)size, (CHAR*)data};
+}
+#else
+using IoVec = iovec;
+
+inline IoVec makeIoVec(const char* data, std::size_t size)
+{
+    return {(void*)data, size};
+}
+#endif
+
+// immutable, reference-counted payload; lets one buffer sit in the outbound queues of many connections
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+// one entry of an outbound queue: either owned by the queue or a shared buffer
+class OutboundMessage
+{
+public:
+    OutboundMessage(std::string data) : m_owned(std::move(data)) {}
+    OutboundMessage(SharedBuffer data) : m_shared(std::move(data)) {}
+
+    const char* data() const { return m_shared ? m_shared->data() : m_owned.data(); }
+    std::size_t size() const { return m_shared ? m_shared->size() : m_owned.size(); }
+
+private:
+    std::string m_owned;
+    SharedBuffer m_shared;
+};
+
+// appends the decimal digits of value to a message being built, without the temporary of std::to_string
+template <typename Number>
+void appendNumber(std::string& out, Number value)
+{
+    char digits[24];
+    out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+// Sends count buffers with a single call (writev semantics, but without SIGPIPE). Returns the number of bytes
+// sent, which may be less than their total, or SOCKET_ERROR.
+inline long long sendVectored(SOCKET sockfd, IoVec* buffers, int count)
+{
+#ifdef _WIN32
+    DWORD sent = 0;
+    if (WSASend(sockfd, buffers, (DWORD)count, &sent, 0, NULL, NULL) == SOCKET_ERROR) return SOCKET_ERROR;
+    return sent;
+#else
+    msghdr msg{};
+    msg.msg_iov = buffers;
+    msg.msg_iovlen = count;
+    return sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+#endif
+}
+
+// Sends up to count bytes of file fd, starting at offset, without moving the file position. sendfile() keeps the
+// data out of user space; where it isn't available (other platforms, or fd isn't a regular file) the chunk is read
+// into a buffer and sent from there. Returns the bytes sent, 0 at the end of the file, or SOCKET_ERROR.
+inline long long sendFileChunk(SOCKET sockfd, int fd, uint64_t offset, std::size_t count)
+{
+#ifdef __linux__
+    off_t fileOffset = (off_t)offset;
+    const ssize_t res = ::sendfile(sockfd, fd, &fileOffset, count);
+    if (res >= 0 || (errno != EINVAL && errno != ENOSYS)) return res;
+#endif
+    char buffer[64 * 1024];
+    if (count > sizeof(buffer)) count = sizeof(buffer);
+#ifdef _WIN32
+    if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) return SOCKET_ERROR;
+    const int read = _read(fd, buffer, (unsigned)count);
+#else
+    const ssize_t read = ::pread(fd, buffer, count, (off_t)offset);
+#endif
+    if (read <= 0) return read;
+    return send(sockfd, buffer, (int)read, MSG_NOSIGNAL);
+}
+
+// addr is large enough for either family; addrLen receives the size to pass to bind()/connect()
+inline int makeSockAddr(const std::string& ipAddr, uint16_t port, sockaddr_storage& addr, socklen_t& addrLen)
 {
     memset(&addr, 0, sizeof(addr)); // Clear memory
 
-    if (ipAddr.find(".") == -1) {
+    if (ipAddr.find(":") != std::string::npos) { // also catches IPv4-mapped addresses such as ::ffff:10.0.0.1
         sockaddr_in6* ipv6 = (sockaddr_in6*)&addr;
         ipv6->sin6_family = AF_INET6;
-        if (inet_pton(AF_INET6, ipAddr.c_str(), &ipv6->sin6_addr) == 0) { return -1; }
+        if (inet_pton(AF_INET6, ipAddr.c_str(), &ipv6->sin6_addr) != 1) { return -1; }
         ipv6->sin6_port = htons(port);
+        addrLen = sizeof(sockaddr_in6);
 
         return 0;
     }
     sockaddr_in* ipv4 = (sockaddr_in*)&addr;
-    memset(&addr, 0, sizeof(addr));
     ipv4->sin_family = AF_INET;
-    if (inet_pton(AF_INET, ipAddr.c_str(), &ipv4->sin_addr) == 0) { return -1; }
+    if (inet_pton(AF_INET, ipAddr.c_str(), &ipv4->sin_addr) != 1) { return -1; }
     ipv4->sin_port = htons(port);
+    addrLen = sizeof(sockaddr_in);
 
     return 0;
 }
 
+// textual address and host-order port of an IPv4 or IPv6 socket address, e.g. as filled in by accept()
+inline bool fromSockAddr(const sockaddr_storage& addr, std::string& ipAddr, uint16_t& port)
+{
+    char buffer[INET6_ADDRSTRLEN];
+    if (addr.ss_family == AF_INET) {
+        const sockaddr_in* ipv4 = (const sockaddr_in*)&addr;
+        if (!inet_ntop(AF_INET, &ipv4->sin_addr, buffer, sizeof(buffer))) return false;
+        port = ntohs(ipv4->sin_port);
+    } else if (addr.ss_family == AF_INET6) {
+        const sockaddr_in6* ipv6 = (const sockaddr_in6*)&addr;
+        if (!inet_ntop(AF_INET6, &ipv6->sin6_addr, buffer, sizeof(buffer))) return false;
+        port = ntohs(ipv6->sin6_port);
+    } else {
+        return false;
+    }
+    ipAddr = buffer;
+    return true;
+}
+
+/**
+ * @brief IPv4 or IPv6 address in binary form; text is only produced by toString().
+ *
+ * Trivially copyable and compared bytewise. Converts implicitly from text (unparsable text gives an empty address),
+ * so code that passes addresses around as strings keeps working.
+ */
+class IPAddress
+{
+public:
+    IPAddress() = default;
+    IPAddress(const char* text)
+    {
+        if (!text) return;
+        if (std::strchr(text, ':')) {
+            if (inet_pton(AF_INET6, text, m_bytes.data()) == 1) m_family = 6;
+        } else if (inet_pton(AF_INET, text, m_bytes.data()) == 1) {
+            m_family = 4;
+        }
+        if (!m_family) m_bytes = {};
+    }
+    IPAddress(const std::string& text) : IPAddress(text.c_str()) {}
+
+    static IPAddress fromSockAddr(const sockaddr_storage& addr)
+    {
+        IPAddress ip;
+        if (addr.ss_family == AF_INET) {
+            std::memcpy(ip.m_bytes.data(), &((const sockaddr_in*)&addr)->sin_addr, 4);
+            ip.m_family = 4;
+        } else if (addr.ss_family == AF_INET6) {
+            std::memcpy(ip.m_bytes.data(), &((const sockaddr_in6*)&addr)->sin6_addr, 16);
+            ip.m_family = 6;
+        }
+        return ip;
+    }
+
+    // AF_INET, AF_INET6, or 0 for an empty address
+    int family() const { return m_family == 4 ? AF_INET : m_family == 6 ? AF_INET6 : 0; }
+    bool empty() const { return m_family == 0; }
+
+    std::string toString() const
+    {
+        char buffer[INET6_ADDRSTRLEN];
+        if (empty() || !inet_ntop(family(), (void*)m_bytes.data(), buffer, sizeof(buffer))) return {};
+        return buffer;
+    }
+
+    auto operator<=>(const IPAddress& other) const = default;
+
+private:
+    std::array<uint8_t, 16> m_bytes{};
+    uint8_t m_family{0}; // 4, 6, or 0 when empty
+};
+
+inline bool fromSockAddr(const sockaddr_storage& addr, IPAddress& ipAddr, uint16_t& port)
+{
+    if (addr.ss_family == AF_INET) port = ntohs(((const sockaddr_in*)&addr)->sin_port);
+    else if (addr.ss_family == AF_INET6) port = ntohs(((const sockaddr_in6*)&addr)->sin6_port);
+    else return false;
+    ipAddr = IPAddress::fromSockAddr(addr);
+    return true;
+}
+
+inline bool setNonBlocking(SOCKET sockfd)
+{
+#ifdef _WIN32
+    u_long mode = 1; // 1 = non-blocking, 0 = blocking
+    return ioctlsocket(sockfd, FIONBIO, &mode) == 0;
+#else
+    const int flags = fcntl(sockfd, F_GETFL, 0);
+    return flags != -1 && fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+// Bytes that must be queued before the socket reports readable; 1 is the default. Linux also honours it for
+// poll/epoll readiness; Windows doesn't support it and returns false.
+inline bool setReceiveLowWatermark(SOCKET sockfd, int bytes)
+{
+    return setsockopt(sockfd, SOL_SOCKET, SO_RCVLOWAT, (const char*)&bytes, sizeof(bytes)) == 0;
+}
+
+// true when the last socket call failed only because it would have blocked
+inline bool lastErrorWouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// true when a non-blocking connect() was started and completes in the background
+inline bool lastErrorInProgress()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
 inline void printErrorMessage()
 {
     int errCode = WSAGetLastError();
+#ifdef _WIN32
     char* msgBuffer = nullptr;
 
     FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL, errCode, 0, (LPSTR)&msgBuffer,
@@ -38,6 +297,9 @@ inline void printErrorMessage()
 
     std::cerr << "Error " << errCode << ": " << (msgBuffer ? msgBuffer : "Unknown error") << std::endl;
     LocalFree(msgBuffer);
+#else
+    std::cerr << "Error " << errCode << ": " << strerror(errCode) << std::endl;
+#endif
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,254 @@
+#ifndef _WEBSOCKET_HEADER_HPP_
+#define _WEBSOCKET_HEADER_HPP_ 1
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "broadcast_group.hpp"
+#include "http_parser.hpp"
+#include "protocol_server.hpp"
+#include "simd_kernel.hpp"
+
+enum class WebSocketOpcode : uint8_t
+{
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+// RFC 6455 close codes used by the server
+namespace WebSocketClose
+{
+constexpr uint16_t Normal = 1000;
+constexpr uint16_t GoingAway = 1001;
+constexpr uint16_t ProtocolError = 1002;
+constexpr uint16_t MessageTooBig = 1009;
+} // namespace WebSocketClose
+
+/**
+ * @brief XORs payloads with the 4-byte masking key of client frames, 16 or 32 bytes per instruction.
+ *
+ * The key is rotated to the payload offset once and broadcast into a vector register, so the loop is a load, an
+ * XOR and a store per 16 or 32 bytes. The kernel is picked once at runtime, as for DelimiterScanner; the scalar
+ * one works a 64-bit word at a time.
+ */
+class WebSocketMasker
+{
+public:
+    using Kernel = SimdKernel;
+    using Key = std::array<uint8_t, 4>;
+
+    explicit WebSocketMasker(Kernel kernel = bestSimdKernel());
+
+    // dst[i] = src[i] ^ key[(offset + i) % 4]; dst may be src
+    void apply(char* dst, const char* src, std::size_t size, Key key, std::size_t offset = 0) const;
+    Kernel kernel() const { return m_kernel; }
+
+private:
+    using ApplyFn = void (*)(char* dst, const char* src, std::size_t size, uint32_t pattern);
+
+    Kernel m_kernel;
+    ApplyFn m_apply;
+};
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key: base64 of the SHA-1 of the key and the RFC 6455 GUID
+std::string websocketAcceptKey(std::string_view clientKey);
+
+// bytes of the header of a frame with a payload of size bytes
+std::size_t websocketHeaderSize(std::size_t size, bool masked);
+// Appends one frame to out, header and payload in a single reservation. Server frames go unmasked; clients pass
+// their masking key, and the payload is masked while it is copied.
+void appendWebSocketFrame(std::string& out, WebSocketOpcode opcode, std::string_view payload, bool fin = true,
+                          const WebSocketMasker::Key* key = nullptr);
+std::string encodeWebSocketFrame(WebSocketOpcode opcode, std::string_view payload, bool fin = true);
+
+/**
+ * @brief Incremental WebSocket frame parser for one connection.
+ *
+ * Masked payloads are copied out of the receive buffers into one buffer per message, which also reassembles
+ * fragments, and unmasked there while the bytes are still in cache; control frames may arrive between the
+ * fragments. Unmasked frames (server to client) that sit whole in one buffer are handed out in place. Used from
+ * the connection's event loop only.
+ */
+class WebSocketDecoder
+{
+public:
+    // masked: whether frames must be masked (the server side) or must not be (the client side)
+    explicit WebSocketDecoder(std::size_t maxMessageSize = 1024 * 1024, bool masked = true,
+                              WebSocketMasker::Kernel kernel = bestSimdKernel());
+
+    // Calls onMessage(WebSocketOpcode, std::string_view payload) for every complete message, with Text or Binary,
+    // and for every control frame; the payload is only valid during the call. False once the peer broke the
+    // protocol; closeCode() is then the code to close with, and the decoder stays failed.
+    template <typename OnMessage>
+    bool feed(std::string_view data, OnMessage&& onMessage);
+
+    bool failed() const { return m_closeCode != 0; }
+    uint16_t closeCode() const { return m_closeCode; }
+
+private:
+    struct FrameHeader {
+        bool fin;
+        WebSocketOpcode opcode;
+        bool masked;
+        WebSocketMasker::Key key;
+        uint64_t length;
+    };
+
+    // size of the header starting with these two bytes
+    static std::size_t headerSize(uint8_t first, uint8_t second);
+    // header has headerSize() bytes; false if it breaks the protocol
+    bool parseHeader(const uint8_t* header);
+    // the bytes of the current frame's payload at the start of data, at most its remainder; true once it is whole
+    bool consumePayload(std::string_view data, std::size_t& consumed);
+    bool fail(uint16_t code);
+
+private:
+    const std::size_t m_maxMessageSize;
+    const bool m_masked;
+    const WebSocketMasker m_masker;
+    uint16_t m_closeCode{0};
+
+    // a header split over buffers
+    std::array<uint8_t, 14> m_header{};
+    std::size_t m_headerSize{0};
+
+    bool m_inFrame{false};
+    FrameHeader m_frame{};
+    uint64_t m_payloadRead{0};
+
+    std::string m_message; // fragments of the data message in progress, unmasked
+    WebSocketOpcode m_messageOpcode{WebSocketOpcode::Text};
+    bool m_inMessage{false};
+    std::string m_control; // payload of the control frame in progress
+};
+
+template <typename OnMessage>
+bool WebSocketDecoder::feed(std::string_view data, OnMessage&& onMessage)
+{
+    if (failed()) return false;
+
+    while (!data.empty()) {
+        if (!m_inFrame) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+            if (m_headerSize == 0 && data.size() >= 2 && data.size() >= headerSize(bytes[0], bytes[1])) {
+                // the whole header is here; parsed in place
+                const std::size_t size = headerSize(bytes[0], bytes[1]);
+                if (!parseHeader(bytes)) return false;
+                data.remove_prefix(size);
+            } else {
+                const std::size_t need = m_headerSize < 2 ? 2 : headerSize(m_header[0], m_header[1]);
+                const std::size_t take = std::min(need - m_headerSize, data.size());
+                std::memcpy(m_header.data() + m_headerSize, data.data(), take);
+                m_headerSize += take;
+                data.remove_prefix(take);
+                if (m_headerSize < 2 || m_headerSize < headerSize(m_header[0], m_header[1])) continue;
+                m_headerSize = 0;
+                if (!parseHeader(m_header.data())) return false;
+            }
+
+            // an unmasked data frame that is whole in this buffer needs no copy
+            const WebSocketOpcode opcode = m_frame.opcode;
+            if (!m_frame.masked && m_frame.fin &&
+                (opcode == WebSocketOpcode::Text || opcode == WebSocketOpcode::Binary) &&
+                m_frame.length <= data.size()) {
+                const std::size_t length = (std::size_t)m_frame.length;
+                m_inFrame = false;
+                m_inMessage = false;
+                onMessage(opcode, data.substr(0, length));
+                data.remove_prefix(length);
+                continue;
+            }
+        }
+
+        std::size_t consumed = 0;
+        const bool whole = consumePayload(data, consumed);
+        data.remove_prefix(consumed);
+        if (!whole) continue;
+        m_inFrame = false;
+
+        if ((uint8_t)m_frame.opcode >= 0x8) {
+            onMessage(m_frame.opcode, std::string_view(m_control));
+            m_control.clear();
+        } else if (m_frame.fin) {
+            m_inMessage = false;
+            onMessage(m_messageOpcode, std::string_view(m_message));
+            m_message.clear(); // keeps the capacity for the next message
+        }
+    }
+    return true;
+}
+
+struct WebSocketServerOptions {
+    std::string path{"/"}; // the only path upgraded; empty accepts any
+    std::size_t maxMessageSize{1024 * 1024};
+    HttpParserLimits handshakeLimits{.maxHeaderSize = 8 * 1024, .maxBodySize = 0, .maxHeaders = 64};
+    std::size_t shards{1}; // see TCPServer::start
+};
+
+/**
+ * @brief WebSocket (RFC 6455) endpoint on top of TCPServer.
+ *
+ * A new connection starts as HTTP: the upgrade request is parsed by HttpRequestParser and answered with 101
+ * Switching Protocols, or with an error status and a close. From then on it carries frames, parsed on its event
+ * loop by WebSocketDecoder. Pings are answered with pongs and a Close from the client is echoed before the
+ * connection is closed.
+ *
+ * Server frames are encoded straight into the string that goes into the outbound queue. broadcast() encodes a
+ * frame once and shares the buffer between every session through a BroadcastGroup.
+ */
+class WebSocketServer
+{
+public:
+    // on the session's event loop, once the handshake is answered
+    EventSignal<TCPConnInfo> sessionOpened;
+    // a whole Text or Binary message; the payload is only valid during the call
+    EventSignal<const TCPConnInfo&, WebSocketOpcode, std::string_view> messageArrived;
+    EventSignal<const TCPConnInfo&, std::string_view> pongArrived;
+
+    WebSocketServer(TCPConnectionManager& tcpConnMgr, WebSocketServerOptions options = {});
+    WebSocketServer(const WebSocketServer& other) = delete;
+    ~WebSocketServer();
+
+    // false if no listener could be opened
+    bool start(const std::string& address, uint16_t port);
+
+    // Frames are queued from the session's event loop, so none can follow its Close frame. False if there is no
+    // open session on the handle, or it is closing.
+    bool send(ConnHandle session, std::string_view payload, WebSocketOpcode opcode = WebSocketOpcode::Text);
+    bool ping(ConnHandle session, std::string_view payload = {});
+    // sends a Close frame; the connection closes when the client answers it
+    bool close(ConnHandle session, uint16_t code = WebSocketClose::Normal, std::string_view reason = {});
+    // returns the number of sessions the message was queued for
+    std::size_t broadcast(std::string_view payload, WebSocketOpcode opcode = WebSocketOpcode::Text);
+
+    std::size_t sessionCount() const;
+
+private:
+    struct Session;
+
+    std::shared_ptr<Session> findOpen(ConnHandle handle) const;
+    // on the session's event loop
+    void onData(Session& session, const RecvBuffer& buffer);
+    void handshake(Session& session, const HttpRequest& request);
+    void onFrame(Session& session, WebSocketOpcode opcode, std::string_view payload);
+    // the Close frame and a close once it is out
+    void closeWith(Session& session, uint16_t code, std::string_view reason);
+
+private:
+    TCPConnectionManager& m_tcpConnMgr;
+    const WebSocketServerOptions m_options;
+    BroadcastGroup m_sessions; // open sessions only
+    ProtocolServer<Session> m_server;
+};
+
+#endif //!_WEBSOCKET_HEADER_HPP_
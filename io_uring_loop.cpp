@@ -0,0 +1,525 @@
+#include "io_uring_loop.hpp"
+
+#ifdef __linux__
+
+#include <iostream>
+#include <format>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace
+{
+int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMs)
+{
+    if (timeoutMs < 0 || !(flags & IORING_ENTER_GETEVENTS)) {
+        return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    __kernel_timespec ts{.tv_sec = timeoutMs / 1000, .tv_nsec = (timeoutMs % 1000) * 1000000LL};
+    io_uring_getevents_arg arg{};
+    arg.ts = (uint64_t)&ts;
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG, &arg,
+                        sizeof(arg));
+}
+
+int ioUringRegister(int ringFd, unsigned opcode, void* arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, count);
+}
+
+uint32_t toPollMask(uint32_t events)
+{
+    uint32_t mask = 0;
+    if (events & EventLoop::Readable) mask |= POLLIN | POLLRDHUP;
+    if (events & EventLoop::Writable) mask |= POLLOUT;
+    return mask;
+}
+
+uint32_t fromPollMask(uint32_t mask)
+{
+    uint32_t events = 0;
+    if (mask & (POLLIN | POLLRDHUP)) events |= EventLoop::Readable;
+    if (mask & POLLOUT) events |= EventLoop::Writable;
+    if (mask & (POLLHUP | POLLERR)) events |= EventLoop::Error | EventLoop::Readable;
+    return events;
+}
+} // namespace
+
+IoUringLoop::IoUringLoop(unsigned entries, unsigned bufferCount, unsigned bufferSize)
+    : m_bufferCount(bufferCount), m_bufferSize(bufferSize)
+{
+    io_uring_params params{};
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    m_ringFd = ioUringSetup(entries, &params);
+    if (m_ringFd < 0 && errno == EINVAL) { // kernels before 5.19 don't know COOP_TASKRUN
+        params = {};
+        m_ringFd = ioUringSetup(entries, &params);
+    }
+    if (m_ringFd < 0) {
+        std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    if (!(params.features & IORING_FEAT_EXT_ARG)) { // needed for timer deadlines; every kernel with multishot has it
+        std::cerr << "io_uring_enter doesn't support timeouts on this kernel" << std::endl;
+        ::close(m_ringFd);
+        m_ringFd = -1;
+        return;
+    }
+
+    m_sqEntries = params.sq_entries;
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                    IORING_OFF_SQ_RING);
+    m_cqRing = singleMmap ? m_sqRing
+                          : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 m_ringFd, IORING_OFF_CQ_RING);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd,
+                                 IORING_OFF_SQES);
+    if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED) {
+        std::cerr << "couldn't map io_uring queues" << std::endl;
+        return;
+    }
+
+    char* sq = (char*)m_sqRing;
+    m_sqHead = (unsigned*)(sq + params.sq_off.head);
+    m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+    m_sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    m_sqArray = (unsigned*)(sq + params.sq_off.array);
+    m_sqLocalTail = *m_sqTail;
+
+    char* cq = (char*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + params.cq_off.head);
+    m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+    m_cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // the kernel picks a free buffer for every completed recv; the ring size has to be a power of two
+    m_bufRingSize = m_bufferCount * sizeof(io_uring_buf);
+    void* bufRing = mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (bufRing == MAP_FAILED) {
+        std::cerr << "couldn't allocate io_uring buffer ring" << std::endl;
+        return;
+    }
+    m_bufRing = (io_uring_buf_ring*)bufRing;
+    m_buffers = new char[(std::size_t)m_bufferCount * m_bufferSize];
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = (uint64_t)m_bufRing;
+    reg.ring_entries = m_bufferCount;
+    reg.bgid = 0;
+    if (ioUringRegister(m_ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::cerr << "couldn't register io_uring buffer ring: " << strerror(errno) << std::endl;
+        munmap(m_bufRing, m_bufRingSize);
+        m_bufRing = nullptr;
+        return;
+    }
+    for (unsigned i = 0; i < m_bufferCount; ++i) recycleBuffer((uint16_t)i);
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+IoUringLoop::~IoUringLoop()
+{
+    stop();
+    if (m_wakeFd >= 0) ::close(m_wakeFd);
+    if (m_ringFd >= 0) ::close(m_ringFd); // cancels whatever is still in flight
+    if (m_bufRing) munmap(m_bufRing, m_bufRingSize);
+    delete[] m_buffers;
+    if (m_sqes && m_sqes != MAP_FAILED) munmap(m_sqes, m_sqesSize);
+    if (m_cqRing && m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing && m_sqRing != MAP_FAILED) munmap(m_sqRing, m_sqRingSize);
+}
+
+bool IoUringLoop::valid() const
+{
+    return m_ringFd >= 0 && m_bufRing && m_wakeFd >= 0;
+}
+
+uint64_t IoUringLoop::makeUserData(Op op, uint32_t generation, SOCKET sockfd)
+{
+    return ((uint64_t)op << 56) | ((uint64_t)(generation & 0xFFFFFF) << 32) | (uint32_t)sockfd;
+}
+
+io_uring_sqe* IoUringLoop::getSqe()
+{
+    if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+        submit(0); // queue full: hand what we have to the kernel first
+        if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) return nullptr;
+    }
+
+    const unsigned index = m_sqLocalTail & *m_sqMask;
+    io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    ++m_sqLocalTail;
+    ++m_toSubmit;
+    return sqe;
+}
+
+int IoUringLoop::submit(unsigned minComplete, int timeoutMs)
+{
+    __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+    const int res =
+        ioUringEnter(m_ringFd, m_toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, timeoutMs);
+    if (res > 0) m_toSubmit -= std::min<unsigned>(m_toSubmit, res);
+    return res;
+}
+
+void IoUringLoop::reapCompletions()
+{
+    unsigned head = *m_cqHead;
+    while (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe cqe = m_cqes[head & *m_cqMask];
+        __atomic_store_n(m_cqHead, ++head, __ATOMIC_RELEASE);
+        handleCompletion(cqe);
+    }
+}
+
+IoUringLoop::SocketState* IoUringLoop::stateFor(SOCKET sockfd, uint32_t generation)
+{
+    const auto it = m_sockets.find(sockfd);
+    if (it == m_sockets.end() || it->second.generation != generation) return nullptr; // completion of a removed socket
+    return &it->second;
+}
+
+IoUringLoop::SocketState& IoUringLoop::registerSocket(SOCKET sockfd)
+{
+    auto [it, inserted] = m_sockets.try_emplace(sockfd);
+    if (inserted) {
+        it->second.generation = m_nextGeneration++ & 0xFFFFFF;
+        if (it->second.generation == 0) it->second.generation = m_nextGeneration++ & 0xFFFFFF;
+        ++m_watchedSockets;
+    }
+    return it->second;
+}
+
+void IoUringLoop::cancel(Op op, SOCKET sockfd, uint32_t generation)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(op, generation, sockfd);
+    sqe->user_data = makeUserData(Op::Cancel, 0, 0);
+}
+
+void IoUringLoop::armWakeRead()
+{
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wakeFd;
+    sqe->addr = (uint64_t)&m_wakeValue;
+    sqe->len = sizeof(m_wakeValue);
+    sqe->user_data = makeUserData(Op::Wake, 0, 0);
+}
+
+void IoUringLoop::armPoll(SOCKET sockfd, SocketState& state)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = sockfd;
+    sqe->poll32_events = toPollMask(state.pollEvents);
+    sqe->user_data = makeUserData(Op::Poll, state.generation, sockfd);
+    state.pollArmed = true;
+}
+
+void IoUringLoop::armAccept(SOCKET sockfd, SocketState& state)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = sockfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = makeUserData(Op::Accept, state.generation, sockfd);
+    state.acceptArmed = true;
+}
+
+void IoUringLoop::armRecv(SOCKET sockfd, SocketState& state)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sockfd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = makeUserData(Op::Recv, state.generation, sockfd);
+    state.recvArmed = true;
+}
+
+void IoUringLoop::armSend(SOCKET sockfd, SocketState& state)
+{
+    if (state.sendInFlight || state.sendQueue.empty()) return;
+
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+
+    // everything queued since the last send goes out in one request
+    if (!state.sendBatch) state.sendBatch = std::make_unique<SendBatch>();
+    SendBatch& batch = *state.sendBatch;
+    batch.buffers.clear();
+    std::size_t offset = state.sendOffset;
+    for (const auto& msg : state.sendQueue) {
+        if ((int)batch.buffers.size() == IOV_MAX) break;
+        batch.buffers.push_back({(void*)(msg.data() + offset), msg.size() - offset});
+        offset = 0;
+    }
+    batch.header = {};
+    batch.header.msg_iov = batch.buffers.data();
+    batch.header.msg_iovlen = batch.buffers.size();
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sockfd;
+    sqe->addr = (uint64_t)&batch.header;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(Op::Send, state.generation, sockfd);
+    state.sendInFlight = true;
+}
+
+void IoUringLoop::recycleBuffer(uint16_t bufferId)
+{
+    // indexed by hand: in C++ the header's flex-array wrapper has a one-byte empty member that shifts bufs[]
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(m_bufRing) + (m_bufRingTail & (m_bufferCount - 1));
+    buf->addr = (uint64_t)(m_buffers + (std::size_t)bufferId * m_bufferSize);
+    buf->len = m_bufferSize;
+    buf->bid = bufferId;
+    __atomic_store_n(&m_bufRing->tail, ++m_bufRingTail, __ATOMIC_RELEASE);
+}
+
+void IoUringLoop::acceptMultishot(SOCKET listenSockFd, AcceptHandler handler)
+{
+    post([this, listenSockFd, handler = std::move(handler)]() mutable {
+        SocketState& state = registerSocket(listenSockFd);
+        if (state.acceptArmed) return;
+        state.acceptHandler = std::move(handler);
+        armAccept(listenSockFd, state);
+    });
+}
+
+void IoUringLoop::recvMultishot(SOCKET sockfd, RecvHandler handler)
+{
+    post([this, sockfd, handler = std::move(handler)]() mutable {
+        SocketState& state = registerSocket(sockfd);
+        if (state.recvArmed) return;
+        state.recvHandler = std::move(handler);
+        armRecv(sockfd, state);
+    });
+}
+
+void IoUringLoop::send(SOCKET sockfd, OutboundMessage data)
+{
+    // goes through the task queue so it stays ordered with the registration and removal of the socket; all
+    // sends queued during one iteration reach the kernel with a single io_uring_enter
+    post([this, sockfd, data = std::move(data)]() mutable {
+        const auto it = m_sockets.find(sockfd);
+        if (it == m_sockets.end() || it->second.closeMarked) return;
+        it->second.sendQueue.emplace_back(std::move(data));
+        armSend(sockfd, it->second);
+    });
+}
+
+void IoUringLoop::closeAfterSends(SOCKET sockfd, Task onSent)
+{
+    // through the task queue like send(), so the marker lands behind every message posted before it
+    post([this, sockfd, onSent = std::move(onSent)]() mutable {
+        const auto it = m_sockets.find(sockfd);
+        if (it == m_sockets.end() || it->second.closeMarked) return;
+        it->second.closeMarked = true;
+        it->second.closeMarker = std::move(onSent);
+        checkCloseMarker(it->second);
+    });
+}
+
+void IoUringLoop::checkCloseMarker(SocketState& state)
+{
+    if (!state.closeMarker || state.sendInFlight || !state.sendQueue.empty()) return;
+    // the marker may close the socket; its removal is queued, so the state outlives this call
+    const Task onSent = std::move(state.closeMarker);
+    state.closeMarker = nullptr;
+    onSent();
+}
+
+void IoUringLoop::addDirect(SOCKET sockfd, uint32_t events, Handler handler)
+{
+    SocketState& state = registerSocket(sockfd);
+    if (state.pollHandler) return;
+    state.pollEvents = events;
+    state.pollHandler = std::move(handler);
+    armPoll(sockfd, state);
+}
+
+void IoUringLoop::modifyDirect(SOCKET sockfd, uint32_t events)
+{
+    const auto it = m_sockets.find(sockfd);
+    if (it == m_sockets.end() || !it->second.pollHandler || it->second.pollEvents == events) return;
+    SocketState& state = it->second;
+    state.pollEvents = events;
+    if (!state.pollArmed) return; // re-armed with the new mask after the running dispatch
+
+    // update the armed poll in place; if it already fired the dispatch re-arms with the new mask
+    io_uring_sqe* sqe = getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(Op::Poll, state.generation, sockfd);
+    sqe->len = IORING_POLL_UPDATE_EVENTS;
+    sqe->poll32_events = toPollMask(events);
+    sqe->user_data = makeUserData(Op::Cancel, 0, 0);
+}
+
+void IoUringLoop::removeDirect(SOCKET sockfd)
+{
+    const auto it = m_sockets.find(sockfd);
+    if (it == m_sockets.end()) return;
+    SocketState& state = it->second;
+
+    if (state.pollArmed) cancel(Op::Poll, sockfd, state.generation);
+    if (state.acceptArmed) cancel(Op::Accept, sockfd, state.generation);
+    if (state.recvArmed) cancel(Op::Recv, sockfd, state.generation);
+    if (state.sendInFlight) {
+        // the kernel may still read from the queued messages; a moved deque keeps its elements in place
+        m_orphanedSends.emplace(makeUserData(Op::Send, state.generation, sockfd),
+                                OrphanedSend{std::move(state.sendQueue), std::move(state.sendBatch)});
+    }
+
+    m_sockets.erase(it);
+    --m_watchedSockets;
+
+    // the caller usually closes the socket next, so the cancellations must reach the kernel before that
+    submit(0);
+}
+
+void IoUringLoop::handleCompletion(const io_uring_cqe& cqe)
+{
+    const Op op = (Op)(cqe.user_data >> 56);
+    const uint32_t generation = (cqe.user_data >> 32) & 0xFFFFFF;
+    const SOCKET sockfd = (SOCKET)(cqe.user_data & 0xFFFFFFFF);
+
+    switch (op) {
+    case Op::Wake: armWakeRead(); return;
+    case Op::Cancel: return;
+
+    case Op::Poll: {
+        SocketState* state = stateFor(sockfd, generation);
+        if (!state) return;
+        state->pollArmed = false;
+        if (cqe.res < 0) {
+            if (cqe.res != -ECANCELED) std::cerr << std::format("poll failed on socket {}\n", sockfd);
+            return;
+        }
+        state->pollHandler(fromPollMask(cqe.res));
+        // handlers only unregister through post(), so the state is still valid here
+        if (!state->pollArmed && state->pollEvents) armPoll(sockfd, *state);
+        return;
+    }
+
+    case Op::Accept: {
+        SocketState* state = stateFor(sockfd, generation);
+        if (!state) {
+            if (cqe.res >= 0) ::close(cqe.res);
+            return;
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) state->acceptArmed = false;
+        if (cqe.res >= 0) {
+            state->acceptHandler(cqe.res);
+        } else if (cqe.res != -ECANCELED) {
+            std::cerr << "accept error: " << strerror(-cqe.res) << std::endl;
+        }
+        if (!state->acceptArmed && cqe.res != -ECANCELED) armAccept(sockfd, *state);
+        return;
+    }
+
+    case Op::Recv: {
+        SocketState* state = stateFor(sockfd, generation);
+        const bool hasBuffer = cqe.flags & IORING_CQE_F_BUFFER;
+        const uint16_t bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if (state && !(cqe.flags & IORING_CQE_F_MORE)) state->recvArmed = false;
+
+        if (state && cqe.res > 0 && hasBuffer) {
+            state->recvHandler(m_buffers + (std::size_t)bufferId * m_bufferSize, cqe.res);
+        } else if (state && (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED))) {
+            state->recvHandler(nullptr, cqe.res);
+            return;
+        }
+        if (hasBuffer) recycleBuffer(bufferId);
+        // multishot recv stops when it runs out of buffers; they were just handed back, so start over
+        if (state && !state->recvArmed && cqe.res != -ECANCELED) armRecv(sockfd, *state);
+        return;
+    }
+
+    case Op::Send: {
+        SocketState* state = stateFor(sockfd, generation);
+        if (!state) {
+            m_orphanedSends.erase(cqe.user_data);
+            return;
+        }
+        state->sendInFlight = false;
+        if (cqe.res < 0) {
+            // the receive side notices the broken connection and closes it
+            state->sendQueue.clear();
+            state->sendOffset = 0;
+            checkCloseMarker(*state);
+            return;
+        }
+        // a short send stops somewhere inside the batch; the next one resumes from there
+        std::size_t sent = (std::size_t)cqe.res;
+        while (sent > 0) {
+            const std::size_t left = state->sendQueue.front().size() - state->sendOffset;
+            if (sent < left) {
+                state->sendOffset += sent;
+                break;
+            }
+            sent -= left;
+            state->sendOffset = 0;
+            state->sendQueue.pop_front();
+        }
+        armSend(sockfd, *state);
+        checkCloseMarker(*state);
+        return;
+    }
+    }
+}
+
+void IoUringLoop::wakeUp()
+{
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto res = ::write(m_wakeFd, &one, sizeof(one));
+}
+
+void IoUringLoop::run(std::stop_token st)
+{
+    armWakeRead();
+    while (!st.stop_requested()) {
+        runPendingTasks();
+        if (st.stop_requested()) break;
+
+        // one syscall submits everything queued since the last iteration and waits for the next completion
+        const int timeout = runDueTimers();
+        if (submit(1, timeout) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+            std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        reapCompletions();
+    }
+    runPendingTasks();
+    submit(0);
+}
+
+#endif // __linux__
@@ -0,0 +1,52 @@
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string>
+
+#include "kv_server.hpp"
+
+namespace
+{
+// the whole of text as an integer in [min, max]
+template <typename Integer>
+bool parseArgument(const char* text, Integer min, Integer max, Integer& value)
+{
+    const char* end = text + std::strlen(text);
+    const auto [last, error] = std::from_chars(text, end, value);
+    return error == std::errc() && last == end && value >= min && value <= max;
+}
+} // namespace
+
+// In-memory key-value cache speaking the Redis protocol, e.g. for redis-benchmark or redis-cli:
+//     KV_Server [port] [memory limit in MiB]
+int main(int argc, char* argv[])
+{
+    uint16_t port = 6379;
+    std::size_t memoryMiB = 1024;
+    if (argc > 3 || (argc > 1 && !parseArgument<uint16_t>(argv[1], 1, 65535, port)) ||
+        (argc > 2 && !parseArgument<std::size_t>(argv[2], 1, std::size_t(-1) / (1024 * 1024), memoryMiB))) {
+        std::cerr << "usage: KV_Server [port 1-65535] [memory limit in MiB, at least 1]\n";
+        return 1;
+    }
+
+    TCPConnectionManager manager;
+    KvStore store({.shards = 64, .memoryLimit = memoryMiB * 1024 * 1024, .maxItemSize = SlabAllocator::maxChunkSize});
+    // one SO_REUSEPORT listener per event loop, so accepts are spread over all of them
+    KvServer server(manager, store, {.limits = {}, .shards = 0});
+    if (!server.start("0.0.0.0", port)) {
+        std::cerr << std::format("could not listen on port {}\n", port);
+        return 1;
+    }
+    std::cout << std::format("KV server listening on port {} with {} event loops and {} MiB; 'q' or end of input "
+                             "quits\n",
+                             port, manager.eventLoopCount(), memoryMiB);
+
+    while (std::cin && std::cin.get() != 'q') {}
+
+    const KvStoreStats stats = store.stats();
+    std::cout << std::format("{} commands served; {} items in {} KiB of {} KiB reserved\n", server.commandsServed(),
+                             stats.items, stats.usedBytes / 1024, stats.reservedBytes / 1024);
+    manager.stop();
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include "kv_server.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <limits>
+
+namespace
+{
+bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return (x >= 'a' && x <= 'z' ? x - 32 : x) == (y >= 'a' && y <= 'z' ? y - 32 : y);
+           });
+}
+
+void appendInteger(std::string& out, int64_t value)
+{
+    out += ':';
+    appendNumber(out, value);
+    out += "\r\n";
+}
+
+void appendBulk(std::string& out, std::string_view value)
+{
+    out += '$';
+    appendNumber(out, value.size());
+    out += "\r\n";
+    out += value;
+    out += "\r\n";
+}
+
+void appendArrayHeader(std::string& out, std::size_t size)
+{
+    out += '*';
+    appendNumber(out, size);
+    out += "\r\n";
+}
+
+void appendArityError(std::string& out, std::string_view command)
+{
+    out += "-ERR wrong number of arguments for '";
+    for (const char c : command) out += char(c >= 'A' && c <= 'Z' ? c + 32 : c);
+    out += "' command\r\n";
+}
+
+constexpr std::string_view nullBulk = "$-1\r\n";
+constexpr std::string_view ok = "+OK\r\n";
+constexpr std::string_view outOfMemory = "-OOM value too large or out of memory\r\n";
+constexpr std::string_view notAnInteger = "-ERR value is not an integer or out of range\r\n";
+} // namespace
+
+RespParser::RespParser(RespParserLimits limits) : m_limits(limits) {}
+
+RespParser::Result RespParser::fail(std::string error)
+{
+    m_error = std::move(error);
+    return Result::Error;
+}
+
+RespParser::Result RespParser::parse(std::string_view window, std::size_t& consumed)
+{
+    if (window[0] != '*') {
+        // inline command: one line of words; only the bytes that arrived since the last call are searched
+        const std::size_t newline = window.find('\n', m_parsed);
+        if (newline == std::string_view::npos) {
+            m_parsed = window.size();
+            return window.size() > m_limits.maxInlineSize ? fail("too big inline request") : Result::NeedMore;
+        }
+        m_args.clear();
+        std::string_view line = window.substr(0, newline);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        for (std::size_t pos = 0; pos < line.size();) {
+            const std::size_t start = line.find_first_not_of(" \t", pos);
+            if (start == std::string_view::npos) break;
+            const std::size_t end = std::min(line.find_first_of(" \t", start), line.size());
+            if (m_args.size() == m_limits.maxArgs) return fail("too many arguments");
+            m_args.push_back(line.substr(start, end - start));
+            pos = end;
+        }
+        consumed = newline + 1;
+        m_parsed = 0;
+        return Result::Complete;
+    }
+
+    // the number after a '*' or '$' up to its CRLF, starting at pos
+    std::size_t pos = m_parsed;
+    auto readNumber = [&](int64_t& value) {
+        const std::size_t cr = window.find('\r', pos + 1);
+        if (cr == std::string_view::npos || cr + 1 == window.size()) {
+            return window.size() - pos > m_limits.maxInlineSize ? fail("too big length line") : Result::NeedMore;
+        }
+        const auto [end, error] = std::from_chars(window.data() + pos + 1, window.data() + cr, value);
+        if (error != std::errc() || end != window.data() + cr || window[cr + 1] != '\n') {
+            return fail(window[pos] == '*' ? "invalid multibulk length" : "invalid bulk length");
+        }
+        pos = cr + 2;
+        return Result::Complete;
+    };
+
+    if (m_argCount < 0) {
+        int64_t count = 0;
+        if (const Result result = readNumber(count); result != Result::Complete) return result;
+        if (count > (int64_t)m_limits.maxArgs) return fail("invalid multibulk length");
+        // "*0" and "*-1" are empty commands, which are skipped
+        m_argCount = std::max<int64_t>(count, 0);
+        m_argSpans.reserve(std::min<int64_t>(m_argCount, 1024));
+        m_parsed = pos;
+    }
+    while ((int64_t)m_argSpans.size() < m_argCount) {
+        if (pos == window.size()) return Result::NeedMore;
+        if (window[pos] != '$') return fail(std::format("expected '$', got '{}'", window[pos]));
+        int64_t size = 0;
+        // a length line without its bulk string is read again with the rest of the argument
+        if (const Result result = readNumber(size); result != Result::Complete) return result;
+        if (size < 0 || size > (int64_t)m_limits.maxBulkSize) return fail("invalid bulk length");
+        if (window.size() - pos < (std::size_t)size + 2) return Result::NeedMore;
+        if (window[pos + size] != '\r' || window[pos + size + 1] != '\n') return fail("bulk string not terminated");
+        m_argSpans.emplace_back(pos, (std::size_t)size);
+        pos += (std::size_t)size + 2;
+        m_parsed = pos;
+    }
+
+    // the views are made only now, as an incomplete command's bytes move when more of them arrive
+    m_args.clear();
+    for (const auto& [offset, size] : m_argSpans) m_args.push_back(window.substr(offset, size));
+    consumed = pos;
+    m_parsed = 0;
+    m_argCount = -1;
+    m_argSpans.clear();
+    return Result::Complete;
+}
+
+struct KvServer::Connection {
+    Connection(const TCPConnInfo& connInfo, const RespParserLimits& limits) : connInfo(connInfo), parser(limits) {}
+
+    const TCPConnInfo connInfo;
+    ScopedEventConnection dataConnection;
+
+    // only touched by the connection's event loop
+    RespParser parser;
+    std::string out;     // replies to the buffer being handled
+    bool closing{false}; // QUIT or a protocol error; later commands are ignored
+};
+
+KvServer::KvServer(TCPConnectionManager& tcpConnMgr, KvStore& store, KvServerOptions options)
+    : m_store(store), m_options(options),
+      m_server(
+          tcpConnMgr,
+          [this](const TCPConnInfo& connInfo, TCPConnection&) {
+              return std::make_shared<Connection>(connInfo, m_options.limits);
+          },
+          [this](Connection& conn, const RecvBuffer& buffer) { onData(conn, buffer); })
+{
+}
+
+KvServer::~KvServer()
+{
+    m_server.stop();
+}
+
+bool KvServer::start(const std::string& address, uint16_t port)
+{
+    return m_server.start(address, port, m_options.shards);
+}
+
+std::size_t KvServer::connectionCount() const
+{
+    return m_server.connectionCount();
+}
+
+void KvServer::onData(Connection& conn, const RecvBuffer& buffer)
+{
+    if (conn.closing) return;
+
+    uint64_t commands = 0;
+    const bool ok = conn.parser.feed(buffer.view(), [&](const std::vector<std::string_view>& args) {
+        if (conn.closing) return; // pipelined behind a QUIT
+        execute(conn, args);
+        ++commands;
+    });
+    if (!ok && !conn.closing) {
+        conn.out += "-ERR Protocol error: ";
+        conn.out += conn.parser.error();
+        conn.out += "\r\n";
+        conn.closing = true;
+    }
+    m_commandsServed += commands;
+
+    m_server.flush(conn);
+}
+
+void KvServer::execute(Connection& conn, const std::vector<std::string_view>& args)
+{
+    std::string& out = conn.out;
+    const std::string_view command = args[0];
+    const std::size_t argc = args.size();
+    auto is = [&](std::string_view name) { return equalsIgnoreCase(command, name); };
+
+    if (is("GET")) {
+        if (argc != 2) return appendArityError(out, command);
+        if (!m_store.get(args[1], [&](std::string_view value) { appendBulk(out, value); })) out += nullBulk;
+    } else if (is("SET")) {
+        // no expiry or NX/XX; a cache client that needs them gets a clear error
+        if (argc < 3) return appendArityError(out, command);
+        if (argc > 3) out += "-ERR syntax error\r\n";
+        else out += m_store.set(args[1], args[2]) ? ok : outOfMemory;
+    } else if (is("MGET")) {
+        if (argc < 2) return appendArityError(out, command);
+        appendArrayHeader(out, argc - 1);
+        for (std::size_t i = 1; i < argc; ++i) {
+            if (!m_store.get(args[i], [&](std::string_view value) { appendBulk(out, value); })) out += nullBulk;
+        }
+    } else if (is("MSET")) {
+        if (argc < 3 || argc % 2 == 0) return appendArityError(out, command);
+        bool stored = true;
+        for (std::size_t i = 1; i < argc; i += 2) stored = m_store.set(args[i], args[i + 1]) && stored;
+        out += stored ? ok : outOfMemory;
+    } else if (is("DEL") || is("EXISTS")) {
+        if (argc < 2) return appendArityError(out, command);
+        const bool erase = is("DEL");
+        int64_t count = 0;
+        for (std::size_t i = 1; i < argc; ++i) count += erase ? m_store.erase(args[i]) : m_store.contains(args[i]);
+        appendInteger(out, count);
+    } else if (is("INCR") || is("DECR") || is("INCRBY") || is("DECRBY")) {
+        const bool by = is("INCRBY") || is("DECRBY");
+        if (argc != (by ? 3u : 2u)) return appendArityError(out, command);
+        int64_t delta = 1;
+        if (by) {
+            const auto [end, error] = std::from_chars(args[2].data(), args[2].data() + args[2].size(), delta);
+            if (error != std::errc() || end != args[2].data() + args[2].size()) {
+                out += notAnInteger;
+                return;
+            }
+        }
+        if (is("DECR") || is("DECRBY")) {
+            if (delta == std::numeric_limits<int64_t>::min()) {
+                out += notAnInteger;
+                return;
+            }
+            delta = -delta;
+        }
+        int64_t result = 0;
+        if (m_store.increment(args[1], delta, result)) appendInteger(out, result);
+        else out += notAnInteger;
+    } else if (is("PING")) {
+        if (argc > 2) return appendArityError(out, command);
+        if (argc == 2) appendBulk(out, args[1]);
+        else out += "+PONG\r\n";
+    } else if (is("ECHO")) {
+        if (argc != 2) return appendArityError(out, command);
+        appendBulk(out, args[1]);
+    } else if (is("DBSIZE")) {
+        appendInteger(out, (int64_t)m_store.size());
+    } else if (is("FLUSHALL") || is("FLUSHDB")) {
+        m_store.clear();
+        out += ok;
+    } else if (is("QUIT")) {
+        out += ok;
+        conn.closing = true;
+    } else if (is("CONFIG") || is("COMMAND")) {
+        // what redis-benchmark and redis-cli ask for first; nothing to configure here
+        appendArrayHeader(out, 0);
+    } else {
+        // echoed in a one-line reply, so without line breaks
+        std::string name(command.substr(0, 128));
+        std::replace_if(name.begin(), name.end(), [](char c) { return c == '\r' || c == '\n'; }, ' ');
+        out += std::format("-ERR unknown command '{}'\r\n", name);
+    }
+}
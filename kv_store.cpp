@@ -0,0 +1,346 @@
+#include "kv_store.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+
+namespace
+{
+// Each shard holds whole pages, at least one for every size class it stores. With fewer pages than this per shard
+// most shards couldn't take a value of a new size, so small memory limits get fewer shards.
+constexpr std::size_t minPagesPerShard = 8;
+} // namespace
+
+struct SlabAllocator::Page {
+    std::size_t sizeClass;
+    std::size_t used;  // chunks handed out
+    void* freeList;    // chunks given back
+    char* cursor;      // the part of the page never handed out starts here
+    char* end;
+    Page* prev{nullptr};
+    Page* next{nullptr};
+    bool partial{false}; // on its class's partial list
+};
+
+SlabAllocator::SlabAllocator(std::size_t memoryLimit) : SlabAllocator(*new SlabPagePool(memoryLimit))
+{
+    m_ownPool.reset(&m_pool);
+}
+
+SlabAllocator::SlabAllocator(SlabPagePool& pool) : m_pool(pool)
+{
+    static_assert(sizeof(Page) <= pageHeaderSize);
+    // 1.25x apart, multiples of 8 so the item headers stay aligned; the last class is the rest of a page
+    for (std::size_t size = minChunkSize; size < maxChunkSize; size = (size * 5 / 4 + 7) & ~std::size_t(7)) {
+        m_classes.push_back({size});
+    }
+    m_classes.push_back({maxChunkSize});
+}
+
+SlabAllocator::~SlabAllocator() = default;
+
+std::size_t SlabAllocator::classFor(std::size_t size) const
+{
+    return std::lower_bound(m_classes.begin(), m_classes.end(), size,
+                            [](const SizeClass& c, std::size_t s) { return c.chunkSize < s; }) -
+           m_classes.begin();
+}
+
+std::size_t SlabAllocator::chunkSize(std::size_t size) const
+{
+    const std::size_t index = classFor(size);
+    return index < m_classes.size() ? m_classes[index].chunkSize : 0;
+}
+
+SlabAllocator::Page* SlabAllocator::pageOf(void* chunk)
+{
+    // pages are aligned to their size, and the header is at the start
+    return reinterpret_cast<Page*>(reinterpret_cast<uintptr_t>(chunk) & ~uintptr_t(pageSize - 1));
+}
+
+void SlabAllocator::link(SizeClass& sizeClass, Page* page)
+{
+    page->prev = nullptr;
+    page->next = sizeClass.partial;
+    if (page->next) page->next->prev = page;
+    sizeClass.partial = page;
+    page->partial = true;
+}
+
+void SlabAllocator::unlink(SizeClass& sizeClass, Page* page)
+{
+    if (page->prev) page->prev->next = page->next;
+    else sizeClass.partial = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->partial = false;
+}
+
+void* SlabAllocator::allocate(std::size_t size)
+{
+    const std::size_t index = classFor(size);
+    if (index == m_classes.size()) return nullptr;
+    SizeClass& sizeClass = m_classes[index];
+
+    Page* page = sizeClass.partial;
+    if (!page) {
+        void* memory = m_pool.acquire();
+        if (!memory) return nullptr;
+        char* chunks = static_cast<char*>(memory) + pageHeaderSize;
+        page = new (memory) Page{index, 0, nullptr, chunks, chunks + maxChunkSize / sizeClass.chunkSize * sizeClass.chunkSize};
+        link(sizeClass, page);
+        ++m_pageCount;
+    }
+
+    void* chunk = page->freeList;
+    if (chunk) {
+        std::memcpy(&page->freeList, chunk, sizeof(void*));
+    } else {
+        chunk = page->cursor;
+        page->cursor += sizeClass.chunkSize;
+    }
+    ++page->used;
+    if (!page->freeList && page->cursor == page->end) unlink(sizeClass, page); // full
+    m_usedBytes += sizeClass.chunkSize;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void* chunk)
+{
+    Page* page = pageOf(chunk);
+    SizeClass& sizeClass = m_classes[page->sizeClass];
+    m_usedBytes -= sizeClass.chunkSize;
+
+    if (--page->used == 0) {
+        // back to the pool, where any class or allocator can pick it up
+        if (page->partial) unlink(sizeClass, page);
+        --m_pageCount;
+        m_pool.release(page);
+        return;
+    }
+    std::memcpy(chunk, &page->freeList, sizeof(void*));
+    page->freeList = chunk;
+    if (!page->partial) link(sizeClass, page);
+}
+
+SlabPagePool::SlabPagePool(std::size_t memoryLimit) : m_memoryLimit(memoryLimit) {}
+
+SlabPagePool::~SlabPagePool()
+{
+    for (void* page : m_pages) ::operator delete(page, std::align_val_t(SlabAllocator::pageSize));
+}
+
+void* SlabPagePool::acquire()
+{
+    std::lock_guard lock(m_mutex);
+    if (!m_freePages.empty()) {
+        void* page = m_freePages.back();
+        m_freePages.pop_back();
+        return page;
+    }
+    if (m_memoryLimit && (m_pages.size() + 1) * SlabAllocator::pageSize > m_memoryLimit) return nullptr;
+    m_pages.reserve(m_pages.size() + 1);
+    m_freePages.reserve(m_pages.size() + 1); // so release() never allocates
+    return m_pages.emplace_back(::operator new(SlabAllocator::pageSize, std::align_val_t(SlabAllocator::pageSize)));
+}
+
+void SlabPagePool::release(void* page)
+{
+    std::lock_guard lock(m_mutex);
+    m_freePages.push_back(page);
+}
+
+std::size_t SlabPagePool::reservedBytes() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_pages.size() * SlabAllocator::pageSize;
+}
+
+KvStore::KvStore(KvStoreOptions options) : m_options(options), m_pages(options.memoryLimit)
+{
+    std::size_t shards = std::max<std::size_t>(1, m_options.shards);
+    if (m_options.memoryLimit) {
+        shards = std::clamp<std::size_t>(m_options.memoryLimit / (minPagesPerShard * SlabAllocator::pageSize), 1, shards);
+    }
+    for (std::size_t i = 0; i < shards; ++i) m_shards.push_back(std::make_unique<Shard>(m_pages));
+}
+
+KvStore::~KvStore() = default;
+
+uint64_t KvStore::hashOf(std::string_view key)
+{
+    return std::hash<std::string_view>{}(key);
+}
+
+std::size_t KvStore::findSlot(const Shard& shard, uint64_t hash, std::string_view key)
+{
+    const std::size_t capacity = shard.slots.size();
+    if (capacity == 0) return 0;
+    const std::size_t mask = capacity - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = shard.slots[i];
+        if (!slot.item) return capacity;
+        if (slot.hash == hash && slot.item->keySize == key.size() &&
+            std::memcmp(slot.item->key(), key.data(), key.size()) == 0) {
+            return i;
+        }
+    }
+}
+
+void KvStore::grow(Shard& shard)
+{
+    std::vector<Slot> old(std::max<std::size_t>(16, shard.slots.size() * 2), Slot{0, nullptr});
+    old.swap(shard.slots);
+    const std::size_t mask = shard.slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (!slot.item) continue;
+        std::size_t i = slot.hash & mask;
+        while (shard.slots[i].item) i = (i + 1) & mask;
+        shard.slots[i] = slot;
+    }
+}
+
+bool KvStore::store(Shard& shard, uint64_t hash, std::string_view key, std::string_view value)
+{
+    const std::size_t size = sizeof(Item) + key.size() + value.size();
+    if (size > m_options.maxItemSize) return false;
+
+    std::size_t index = findSlot(shard, hash, key);
+    const bool found = index < shard.slots.size();
+    if (found) {
+        Item* item = shard.slots[index].item;
+        // a value of about the same size overwrites the old one in its chunk
+        if (shard.slab.chunkSize(item->size()) == shard.slab.chunkSize(size)) {
+            std::memmove(item->key() + item->keySize, value.data(), value.size());
+            item->valueSize = (uint32_t)value.size();
+            return true;
+        }
+    } else if ((shard.items + 1) * 4 > shard.slots.size() * 3) {
+        grow(shard);
+    }
+
+    auto* item = static_cast<Item*>(shard.slab.allocate(size));
+    if (!item) return false;
+    item->keySize = (uint32_t)key.size();
+    item->valueSize = (uint32_t)value.size();
+    std::memcpy(item->key(), key.data(), key.size());
+    std::memcpy(item->key() + key.size(), value.data(), value.size());
+
+    if (found) {
+        Item* old = shard.slots[index].item;
+        shard.slab.deallocate(old);
+        shard.slots[index].item = item;
+        return true;
+    }
+    const std::size_t mask = shard.slots.size() - 1;
+    for (index = hash & mask; shard.slots[index].item; index = (index + 1) & mask) {}
+    shard.slots[index] = {hash, item};
+    ++shard.items;
+    return true;
+}
+
+void KvStore::removeSlot(Shard& shard, std::size_t index)
+{
+    Item* item = shard.slots[index].item;
+    shard.slab.deallocate(item);
+    --shard.items;
+
+    // backward shift: move later entries of the probe run into the hole unless that would put them before their
+    // home slot, so lookups never need tombstones
+    const std::size_t mask = shard.slots.size() - 1;
+    std::size_t hole = index;
+    for (std::size_t next = (hole + 1) & mask; shard.slots[next].item; next = (next + 1) & mask) {
+        const std::size_t home = shard.slots[next].hash & mask;
+        const bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable) {
+            shard.slots[hole] = shard.slots[next];
+            hole = next;
+        }
+    }
+    shard.slots[hole].item = nullptr;
+}
+
+bool KvStore::contains(std::string_view key) const
+{
+    return get(key, [](std::string_view) {});
+}
+
+bool KvStore::set(std::string_view key, std::string_view value)
+{
+    const uint64_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    return store(shard, hash, key, value);
+}
+
+bool KvStore::erase(std::string_view key)
+{
+    const uint64_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    const std::size_t index = findSlot(shard, hash, key);
+    if (index == shard.slots.size()) return false;
+    removeSlot(shard, index);
+    return true;
+}
+
+bool KvStore::increment(std::string_view key, int64_t delta, int64_t& result)
+{
+    const uint64_t hash = hashOf(key);
+    Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+
+    int64_t current = 0;
+    const std::size_t index = findSlot(shard, hash, key);
+    if (index < shard.slots.size()) {
+        const std::string_view value = shard.slots[index].item->value();
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), current);
+        if (value.empty() || error != std::errc() || end != value.data() + value.size()) return false;
+    }
+    if ((delta > 0 && current > std::numeric_limits<int64_t>::max() - delta) ||
+        (delta < 0 && current < std::numeric_limits<int64_t>::min() - delta)) {
+        return false;
+    }
+
+    char digits[24];
+    const char* end = std::to_chars(digits, digits + sizeof(digits), current + delta).ptr;
+    if (!store(shard, hash, key, std::string_view(digits, end - digits))) return false;
+    result = current + delta;
+    return true;
+}
+
+void KvStore::clear()
+{
+    for (const auto& shard : m_shards) {
+        std::lock_guard lock(shard->mutex);
+        for (Slot& slot : shard->slots) {
+            if (slot.item) shard->slab.deallocate(slot.item);
+        }
+        shard->slots.clear();
+        shard->items = 0;
+    }
+}
+
+std::size_t KvStore::size() const
+{
+    std::size_t items = 0;
+    for (const auto& shard : m_shards) {
+        std::lock_guard lock(shard->mutex);
+        items += shard->items;
+    }
+    return items;
+}
+
+KvStoreStats KvStore::stats() const
+{
+    KvStoreStats stats;
+    for (const auto& shard : m_shards) {
+        std::lock_guard lock(shard->mutex);
+        stats.items += shard->items;
+        stats.usedBytes += shard->slab.usedBytes();
+    }
+    stats.reservedBytes = m_pages.reservedBytes();
+    return stats;
+}
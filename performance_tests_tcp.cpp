@@ -6,10 +6,27 @@
 #include <future>
 #include <numeric>
 #include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 #include <format>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
 
+#include <boost/signals2.hpp>
+
+#include "bytearray.hpp"
+#include "delimiter_codec.hpp"
+#include "http_client.hpp"
+#include "http_server.hpp"
+#include "kv_server.hpp"
 #include "tcp_connection_manager.hpp"
 #include "tcp_server.hpp"
+#include "websocket.hpp"
 
 // Performance testing framework
 class PerformanceTest {
@@ -41,8 +58,25 @@ public:
     }
 };
 
-// Test connection establishment performance
-void test_connection_performance() {
+// Heap allocations made by threads that opted in, for the allocations-per-operation figures
+std::atomic<std::size_t> g_allocations{0};
+thread_local bool t_count_allocations = false;
+
+void* operator new(std::size_t size) {
+    if (t_count_allocations) ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+const char* backendName(IOBackend backend) {
+    return backend == IOBackend::IoUring ? "io_uring" : "reactor";
+}
+
+// Test connection establishment performance; shards > 1 accepts on that many SO_REUSEPORT listeners
+void test_connection_performance(std::size_t shards = 1) {
     TCPConnectionManager manager;
     std::atomic<int> successful_connections{0};
     std::atomic<int> failed_connections{0};
@@ -54,8 +88,9 @@ void test_connection_performance() {
     });
     
     // Create server
-    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13000);
-    if (serverInfo.sockfd == 0) {
+    TCPServer server(manager);
+    server.start("127.0.0.1", 13000, shards);
+    if (server.shardCount() == 0) {
         std::cerr << "Failed to create server for performance test" << std::endl;
         return;
     }
@@ -63,44 +98,38 @@ void test_connection_performance() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     
     const int num_connections = 1000;
-    std::cout << std::format("Testing {} connection establishments...", num_connections) << std::endl;
+    std::cout << std::format("Testing {} connection establishments on {} listener shard(s), {} event loops...",
+        num_connections, server.shardCount(), manager.eventLoopCount()) << std::endl;
     
+    manager.acceptStats(); // starts a fresh accept rate window
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    // Create connections in batches to avoid overwhelming the system
-    const int batch_size = 50;
-    for (int batch = 0; batch < num_connections / batch_size; ++batch) {
-        std::vector<std::future<void>> futures;
-        
-        for (int i = 0; i < batch_size; ++i) {
-            futures.push_back(std::async(std::launch::async, [&]() {
-                auto conn_start = std::chrono::high_resolution_clock::now();
-                
-                TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13000);
-                
-                auto conn_end = std::chrono::high_resolution_clock::now();
-                auto conn_duration = std::chrono::duration_cast<std::chrono::microseconds>(conn_end - conn_start);
-                
-                if (clientInfo.sockfd != 0) {
-                    std::lock_guard<std::mutex> lock(times_mutex);
-                    connection_times.push_back(conn_duration.count() / 1000.0); // Convert to milliseconds
-                } else {
-                    ++failed_connections;
-                }
-            }));
-        }
-        
-        // Wait for batch to complete
-        for (auto& future : futures) {
-            future.wait();
-        }
-        
-        // Small delay between batches
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // every connect is started from this thread; the event loops finish the handshakes
+    std::atomic<int> completed_connects{0};
+    for (int i = 0; i < num_connections; ++i) {
+        auto conn_start = std::chrono::high_resolution_clock::now();
+        manager.openConnectionAsync("127.0.0.1", 13000, [&, conn_start](TCPConnInfo clientInfo, int error) {
+            auto conn_end = std::chrono::high_resolution_clock::now();
+            auto conn_duration = std::chrono::duration_cast<std::chrono::microseconds>(conn_end - conn_start);
+            
+            if (!error) {
+                std::lock_guard<std::mutex> lock(times_mutex);
+                connection_times.push_back(conn_duration.count() / 1000.0); // Convert to milliseconds
+            } else {
+                ++failed_connections;
+            }
+            ++completed_connects;
+        });
+    }
+    
+    // Wait for every connect to complete or time out
+    while (completed_connects < num_connections) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
     
     auto end_time = std::chrono::high_resolution_clock::now();
     auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    const AcceptStats accept_stats = manager.acceptStats();
     
     std::this_thread::sleep_for(std::chrono::milliseconds(500)); // Let connections settle
     
@@ -112,6 +141,9 @@ void test_connection_performance() {
         (double)successful_connections.load() / num_connections * 100.0) << std::endl;
     std::cout << std::format("  Connections per second: {:.1f}", 
         (double)successful_connections.load() / (total_duration.count() / 1000.0)) << std::endl;
+
+    std::cout << std::format("  Accepts per second (server side): {:.1f}", accept_stats.acceptsPerSecond) << std::endl;
+    std::cout << std::format("  Backlog overflows: {}", accept_stats.backlogOverflows) << std::endl;
     
     PerformanceTest::print_statistics("Connection Times (ms)", connection_times);
     
@@ -119,8 +151,8 @@ void test_connection_performance() {
 }
 
 // Test data throughput performance
-void test_data_throughput() {
-    TCPConnectionManager manager;
+void test_data_throughput(IOBackend backend = IOBackend::Reactor) {
+    TCPConnectionManager manager(0, backend);
     std::atomic<int> bytes_sent{0};
     std::atomic<int> bytes_received{0};
     std::atomic<int> messages_received{0};
@@ -131,7 +163,7 @@ void test_data_throughput() {
         auto connPtr = manager.getConnection(conn).lock();
         if (connPtr) {
             serverConn = connPtr;
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                 bytes_received += data.size();
                 ++messages_received;
             });
@@ -156,8 +188,8 @@ void test_data_throughput() {
     const int num_messages = 1000;
     std::string test_message(message_size, 'A');
     
-    std::cout << std::format("Testing data throughput: {} messages of {} bytes each...", 
-        num_messages, message_size) << std::endl;
+    std::cout << std::format("Testing data throughput: {} messages of {} bytes each ({} backend)...", 
+        num_messages, message_size, backendName(manager.ioBackend())) << std::endl;
     
     auto start_time = std::chrono::high_resolution_clock::now();
     
@@ -174,11 +206,11 @@ void test_data_throughput() {
         }
     }
     
-    // Wait for all messages to be received
+    // Wait for all messages to be received; TCP may deliver several messages in one read, so count bytes
     auto timeout = std::chrono::seconds(10);
     auto wait_start = std::chrono::high_resolution_clock::now();
     
-    while (messages_received < num_messages && 
+    while (bytes_received < bytes_sent && 
            std::chrono::high_resolution_clock::now() - wait_start < timeout) {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
@@ -204,6 +236,337 @@ void test_data_throughput() {
     manager.stop();
 }
 
+// Test small-message throughput with several producers writing to one connection
+void test_small_message_throughput(IOBackend backend = IOBackend::Reactor) {
+    TCPConnectionManager manager(0, backend);
+    std::atomic<std::size_t> bytes_received{0};
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) { bytes_received += data.size(); });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13070);
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13070);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    if (clientInfo.sockfd == 0) {
+        std::cerr << "Failed to establish client connection for small message test" << std::endl;
+        manager.stop();
+        return;
+    }
+
+    const int producers = 4;
+    const int messages_per_producer = 50000;
+    const std::string message(64, 'S');
+    const std::size_t total_bytes = (std::size_t)producers * messages_per_producer * message.size();
+
+    std::cout << std::format("Testing small-message throughput: {} producers x {} messages of {} bytes ({} backend)...",
+        producers, messages_per_producer, message.size(), backendName(manager.ioBackend())) << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < messages_per_producer; ++i) manager.write(clientInfo, message);
+        });
+    }
+    for (auto& t : threads) t.join();
+    auto enqueue_time = std::chrono::high_resolution_clock::now();
+
+    auto timeout = std::chrono::seconds(30);
+    while (bytes_received < total_bytes && std::chrono::high_resolution_clock::now() - start_time < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    auto enqueue_duration = std::chrono::duration_cast<std::chrono::milliseconds>(enqueue_time - start_time);
+
+    std::cout << std::format("Small-Message Throughput Results:") << std::endl;
+    std::cout << std::format("  Producers done after: {} ms", enqueue_duration.count()) << std::endl;
+    std::cout << std::format("  Total time: {} ms", total_duration.count()) << std::endl;
+    std::cout << std::format("  Bytes received: {}/{}", bytes_received.load(), total_bytes) << std::endl;
+    if (total_duration.count() > 0) {
+        std::cout << std::format("  Messages per second: {:.1f}",
+            (double)bytes_received.load() / message.size() / (total_duration.count() / 1000.0)) << std::endl;
+    }
+
+    manager.stop();
+}
+
+// Test bulk send cost with and without MSG_ZEROCOPY: CPU time per GB sent
+void test_zero_copy_throughput(bool zeroCopy) {
+    TCPConnectionManager manager(0);
+    const bool enabled = zeroCopy && manager.setZeroCopy(true);
+    std::atomic<std::size_t> bytes_received{0};
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) { bytes_received += data.size(); });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13080);
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13080);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    if (clientInfo.sockfd == 0) {
+        std::cerr << "Failed to establish client connection for zero-copy test" << std::endl;
+        manager.stop();
+        return;
+    }
+
+    const std::size_t message_size = 1024 * 1024;
+    const int num_messages = 512;
+    const std::size_t total_bytes = message_size * num_messages;
+
+    std::cout << std::format("Testing bulk send: {} messages of {} bytes, zero-copy {}...",
+        num_messages, message_size, enabled ? "on" : "off") << std::endl;
+
+    const std::clock_t cpu_start = std::clock();
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < num_messages; ++i) manager.write(clientInfo, std::string(message_size, 'Z'));
+
+    auto timeout = std::chrono::seconds(60);
+    while (bytes_received < total_bytes && std::chrono::high_resolution_clock::now() - start_time < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    const double cpu_seconds = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    const double gigabytes = (double)bytes_received.load() / (1024.0 * 1024.0 * 1024.0);
+    const ZeroCopyStats stats = manager.zeroCopyStats();
+
+    std::cout << std::format("Bulk Send Results (zero-copy {}):", enabled ? "on" : "off") << std::endl;
+    std::cout << std::format("  Total time: {} ms", total_duration.count()) << std::endl;
+    std::cout << std::format("  Bytes received: {}/{}", bytes_received.load(), total_bytes) << std::endl;
+    if (gigabytes > 0) {
+        std::cout << std::format("  CPU per GB sent: {:.3f} s (sender and receiver, whole process)",
+            cpu_seconds / gigabytes) << std::endl;
+    }
+    if (enabled) {
+        std::cout << std::format("  Zero-copy sends: {}, completed: {}, copied by the kernel: {}",
+            stats.sends, stats.completed, stats.copied) << std::endl;
+    }
+
+    manager.stop();
+}
+
+// Test streaming a file to a client: read into strings and write() vs sendFile()
+void test_file_streaming(bool useSendFile) {
+    const std::string file_path = "file_streaming_perf.bin";
+    const std::size_t file_size = 256 * 1024 * 1024;
+    {
+        std::ofstream file(file_path, std::ios::binary);
+        const std::string block(1024 * 1024, 'F');
+        for (std::size_t written = 0; written < file_size; written += block.size()) file << block;
+    }
+
+    TCPConnectionManager manager(0);
+    std::atomic<std::size_t> bytes_received{0};
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) { bytes_received += data.size(); });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13090);
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13090);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    if (clientInfo.sockfd == 0 || !file) {
+        std::cerr << "Failed to set up file streaming test" << std::endl;
+        if (file) std::fclose(file);
+        manager.stop();
+        std::remove(file_path.c_str());
+        return;
+    }
+
+    std::cout << std::format("Testing file streaming of {} MB with {}...", file_size / (1024 * 1024),
+        useSendFile ? "sendFile" : "read + write") << std::endl;
+
+    const std::clock_t cpu_start = std::clock();
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    if (useSendFile) {
+        manager.sendFile(clientInfo, fileno(file), 0, file_size);
+    } else {
+        std::string chunk(1024 * 1024, '\0');
+        std::size_t read;
+        while ((read = std::fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+            manager.write(clientInfo, std::string(chunk.data(), read));
+        }
+    }
+
+    auto timeout = std::chrono::seconds(60);
+    while (bytes_received < file_size && std::chrono::high_resolution_clock::now() - start_time < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    const double cpu_seconds = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    const double gigabytes = (double)bytes_received.load() / (1024.0 * 1024.0 * 1024.0);
+
+    std::cout << std::format("File Streaming Results ({}):", useSendFile ? "sendFile" : "read + write") << std::endl;
+    std::cout << std::format("  Total time: {} ms", total_duration.count()) << std::endl;
+    std::cout << std::format("  Bytes received: {}/{}", bytes_received.load(), file_size) << std::endl;
+    if (gigabytes > 0) {
+        std::cout << std::format("  CPU per GB sent: {:.3f} s (sender and receiver, whole process)",
+            cpu_seconds / gigabytes) << std::endl;
+    }
+
+    manager.stop();
+    std::fclose(file);
+    std::remove(file_path.c_str());
+}
+
+// Test connection lookups and writes from many threads at once
+void test_registry_contention(int num_writers) {
+    TCPConnectionManager manager(2);
+    std::atomic<std::size_t> bytes_received{0};
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) { bytes_received += data.size(); });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13110);
+    std::vector<std::future<TCPConnInfo>> connects;
+    for (int i = 0; i < num_writers; ++i) connects.push_back(manager.openConnectionAsync("127.0.0.1", 13110));
+    std::vector<TCPConnInfo> clients;
+    for (auto& connect : connects) {
+        TCPConnInfo clientInfo = connect.get();
+        if (clientInfo.sockfd) clients.push_back(clientInfo);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if (clients.size() != (std::size_t)num_writers) {
+        std::cerr << "Failed to establish every client connection for registry contention test" << std::endl;
+        manager.stop();
+        return;
+    }
+
+    // lookups alone: the registry is the only state the threads share
+    const int lookups_per_thread = 200000;
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_writers; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!go) std::this_thread::yield();
+            for (int i = 0; i < lookups_per_thread; ++i) {
+                if (!manager.getConnection(clients[t]).lock()) break;
+            }
+        });
+    }
+    auto start_time = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& thread : threads) thread.join();
+    const double lookup_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    // small writes, each looking its connection up first
+    const int writes_per_thread = 20000;
+    const std::string message(16, 'W');
+    threads.clear();
+    go = false;
+    for (int t = 0; t < num_writers; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!go) std::this_thread::yield();
+            for (int i = 0; i < writes_per_thread; ++i) manager.write(clients[t], message);
+        });
+    }
+    start_time = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& thread : threads) thread.join();
+    const double write_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    const std::size_t total_bytes = (std::size_t)num_writers * writes_per_thread * message.size();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (bytes_received < total_bytes && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::cout << std::format("Registry Contention Results ({} threads):", num_writers) << std::endl;
+    std::cout << std::format("  Lookups per second: {:.0f}", num_writers * lookups_per_thread / lookup_seconds) << std::endl;
+    std::cout << std::format("  Writes queued per second: {:.0f}", num_writers * writes_per_thread / write_seconds) << std::endl;
+    std::cout << std::format("  Bytes received: {}/{}", bytes_received.load(), total_bytes) << std::endl;
+
+    manager.stop();
+}
+
+// Connections opened and closed as fast as num_threads threads can; closes go through the loops' retire queues
+void test_connection_churn(int num_threads) {
+    TCPConnectionManager manager;
+    std::atomic<int> server_closed{0};
+    manager.connectionClosed.connect([&](TCPConnInfo) { ++server_closed; });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13120);
+    if (!serverInfo.sockfd) {
+        std::cerr << "Failed to create server for connection churn test" << std::endl;
+        return;
+    }
+
+    // the per-connection log lines would cost more than the connections themselves
+    std::clog.setstate(std::ios::failbit);
+
+    const auto duration = std::chrono::seconds(2);
+    std::atomic<bool> done{false};
+    std::atomic<int> opened{0};
+    std::atomic<int> failed{0};
+    std::vector<std::vector<double>> close_times(num_threads);
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!done) {
+                const TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13120);
+                if (!clientInfo.sockfd) {
+                    ++failed;
+                    continue;
+                }
+                ++opened;
+                const auto close_start = std::chrono::high_resolution_clock::now();
+                manager.closeConn(clientInfo);
+                close_times[t].push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::high_resolution_clock::now() - close_start).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(duration);
+    done = true;
+    for (auto& thread : threads) thread.join();
+    const double churn_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    // the accepted side closes once it sees the client's FIN; everything is reclaimed when only the listener is left
+    const auto drain_start = std::chrono::high_resolution_clock::now();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (manager.connectionCount() > 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double drain_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - drain_start).count();
+    std::clog.clear();
+
+    std::vector<double> all_close_times;
+    for (const auto& times : close_times) all_close_times.insert(all_close_times.end(), times.begin(), times.end());
+
+    std::cout << std::format("Connection Churn Results ({} threads, {} event loops):", num_threads,
+        manager.eventLoopCount()) << std::endl;
+    std::cout << std::format("  Connections opened and closed: {} ({} failed)", opened.load(), failed.load()) << std::endl;
+    std::cout << std::format("  Churn rate: {:.0f} connections/s", opened / churn_seconds) << std::endl;
+    std::cout << std::format("  Connections left after churn: {}; drained in {:.1f} ms", manager.connectionCount() - 1,
+        drain_ms) << std::endl;
+    std::cout << std::format("  connectionClosed emissions: {}", server_closed.load()) << std::endl;
+    PerformanceTest::print_statistics("closeConn (us)", all_close_times);
+
+    manager.stop();
+}
+
 // Test concurrent client performance
 void test_concurrent_clients() {
     TCPConnectionManager manager;
@@ -215,7 +578,7 @@ void test_concurrent_clients() {
         ++total_connections;
         auto connPtr = manager.getConnection(conn).lock();
         if (connPtr) {
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                 ++total_messages_received;
             });
         }
@@ -289,7 +652,7 @@ void test_concurrent_clients() {
 }
 
 // Test server broadcast performance
-void test_broadcast_performance() {
+void test_broadcast_performance(int num_clients = 50) {
     TCPConnectionManager manager;
     std::atomic<int> connected_clients{0};
     std::atomic<int> total_broadcasts_received{0};
@@ -300,51 +663,57 @@ void test_broadcast_performance() {
     
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     
-    const int num_clients = 50;
     std::vector<TCPConnInfo> clients;
     
     std::cout << std::format("Setting up {} clients for broadcast test...", num_clients) << std::endl;
     
     // Connect clients and set up data reception
-    for (int i = 0; i < num_clients; ++i) {
-        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13030);
+    std::vector<std::future<TCPConnInfo>> connects;
+    for (int i = 0; i < num_clients; ++i) connects.push_back(manager.openConnectionAsync("127.0.0.1", 13030));
+    for (auto& connect : connects) {
+        TCPConnInfo clientInfo = connect.get();
         if (clientInfo.sockfd != 0) {
             clients.push_back(clientInfo);
             ++connected_clients;
             
             auto connPtr = manager.getConnection(clientInfo).lock();
             if (connPtr) {
-                connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+                connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                     ++total_broadcasts_received;
                 });
             }
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
     }
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // Let all connections stabilize
+    // Let all connections stabilize
+    for (int i = 0; i < 100 && server.clientCount() < (std::size_t)connected_clients.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
     
     const int num_broadcasts = 100;
     std::cout << std::format("Broadcasting {} messages to {} clients...", num_broadcasts, connected_clients.load()) << std::endl;
     
     auto start_time = std::chrono::high_resolution_clock::now();
+    std::chrono::nanoseconds caller_time{0};
     
     // Send broadcasts
     for (int i = 0; i < num_broadcasts; ++i) {
         std::string message = std::format("Broadcast_Message_{:04d}", i);
+        auto call_start = std::chrono::high_resolution_clock::now();
         server.broadcast(message);
+        caller_time += std::chrono::high_resolution_clock::now() - call_start;
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
     
     // Wait for all broadcasts to be received
-    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+    int expected_total = num_broadcasts * connected_clients.load();
+    for (int i = 0; i < 40 && total_broadcasts_received.load() < expected_total; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
     
     auto end_time = std::chrono::high_resolution_clock::now();
     auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
     
-    int expected_total = num_broadcasts * connected_clients.load();
-    
     std::cout << std::format("Broadcast Performance Results:") << std::endl;
     std::cout << std::format("  Total time: {} ms", total_duration.count()) << std::endl;
     std::cout << std::format("  Connected clients: {}", connected_clients.load()) << std::endl;
@@ -352,6 +721,9 @@ void test_broadcast_performance() {
     std::cout << std::format("  Total messages received: {}/{}", total_broadcasts_received.load(), expected_total) << std::endl;
     std::cout << std::format("  Broadcast efficiency: {:.1f}%", 
         (double)total_broadcasts_received.load() / expected_total * 100.0) << std::endl;
+    // what broadcast() costs the calling thread; the fan-out itself runs on the event loops
+    std::cout << std::format("  Caller time per broadcast: {:.1f} us",
+        std::chrono::duration<double, std::micro>(caller_time).count() / num_broadcasts) << std::endl;
     
     if (total_duration.count() > 0) {
         std::cout << std::format("  Broadcast rate: {:.1f} broadcasts/second", 
@@ -363,6 +735,763 @@ void test_broadcast_performance() {
     manager.stop();
 }
 
+// Test broadcast latency of healthy clients while one client has stopped reading
+void test_slow_consumer_isolation(bool withStalledClient) {
+    TCPConnectionManager manager;
+    TCPServer server(manager);
+    server.setClientWriteBufferLimits({.highWaterMark = 256 * 1024, .lowWaterMark = 64 * 1024,
+                                       .policy = SlowConsumerPolicy::DropOldest});
+    server.start("127.0.0.1", 13100);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // enough in total to fill the kernel buffers of the stalled client several times over
+    const std::size_t message_size = 4096;
+    const int num_clients = 50;
+    std::vector<double> latencies;
+    std::mutex latencies_mutex;
+    // one reassembly buffer per client, only touched by the client's event loop
+    std::vector<std::string> pending(num_clients);
+
+    std::vector<std::future<TCPConnInfo>> connects;
+    for (int i = 0; i < num_clients; ++i) connects.push_back(manager.openConnectionAsync("127.0.0.1", 13100));
+    int connected = 0;
+    for (int i = 0; i < num_clients; ++i) {
+        TCPConnInfo clientInfo = connects[i].get();
+        auto connPtr = clientInfo.sockfd ? manager.getConnection(clientInfo).lock() : nullptr;
+        if (!connPtr) continue;
+        ++connected;
+        connPtr->newDataArrived.connect([&, i](const RecvBuffer& data) {
+            const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            pending[i].append(data.begin(), data.end());
+            std::size_t pos = 0;
+            for (; pos + message_size <= pending[i].size(); pos += message_size) {
+                const long long sent = std::stoll(pending[i].substr(pos, 20));
+                std::lock_guard lock(latencies_mutex);
+                latencies.push_back((now - sent) / 1000.0);
+            }
+            pending[i].erase(0, pos);
+        });
+    }
+
+    // a client that connects and never reads, with a small receive buffer so it backs up quickly
+    SOCKET stalled = INVALID_SOCKET;
+    if (withStalledClient) {
+        stalled = socket(AF_INET, SOCK_STREAM, 0);
+        const int small_buffer = 8 * 1024;
+        setsockopt(stalled, SOL_SOCKET, SO_RCVBUF, (const char*)&small_buffer, sizeof(small_buffer));
+        sockaddr_storage addr{};
+        socklen_t addr_len = 0;
+        makeSockAddr("127.0.0.1", 13100, addr, addr_len);
+        connect(stalled, (sockaddr*)&addr, addr_len);
+    }
+    const std::size_t expected_clients = connected + (withStalledClient ? 1 : 0);
+    for (int i = 0; i < 100 && server.clientCount() < expected_clients; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    const int num_broadcasts = 2000;
+    std::cout << std::format("Broadcasting {} messages of {} bytes to {} healthy clients {}...", num_broadcasts,
+        message_size, connected, withStalledClient ? "and one stalled client" : "only") << std::endl;
+
+    for (int i = 0; i < num_broadcasts; ++i) {
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::string message = std::format("{:020d}", now);
+        message.resize(message_size, 'L');
+        server.broadcast(message);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    std::lock_guard lock(latencies_mutex);
+    std::cout << std::format("Slow Consumer Isolation Results ({}):", withStalledClient ? "stalled client" : "baseline") << std::endl;
+    std::cout << std::format("  Messages received by healthy clients: {}/{}", latencies.size(),
+        (std::size_t)num_broadcasts * connected) << std::endl;
+    if (!latencies.empty()) {
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        std::cout << std::format("  Latency p50: {:.3f} ms, p99: {:.3f} ms, max: {:.3f} ms", sorted[sorted.size() / 2],
+            sorted[sorted.size() * 99 / 100], sorted.back()) << std::endl;
+    }
+    std::cout << std::format("  Bytes dropped for the slow client: {}",
+        manager.slowConsumerStats().droppedOldestBytes) << std::endl;
+
+    manager.stop();
+    if (stalled != INVALID_SOCKET) closesocket(stalled);
+}
+
+// Microbenchmark: emitting a received buffer through EventSignal vs boost::signals2
+void test_signal_dispatch(int num_slots) {
+    const int num_emissions = 5000000;
+    RecvBuffer buffer = RecvBufferPool::acquire();
+    buffer.resize(512);
+    std::atomic<std::size_t> sink{0};
+
+    auto time_emissions = [&](auto&& emit) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_emissions; ++i) emit();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now() - start);
+        return (double)elapsed.count() / num_emissions;
+    };
+
+    boost::signals2::signal<void(const RecvBuffer&)> boost_signal;
+    EventSignal<const RecvBuffer&> event_signal;
+    for (int i = 0; i < num_slots; ++i) {
+        boost_signal.connect([&](const RecvBuffer& data) { sink.fetch_add(data.size(), std::memory_order_relaxed); });
+        event_signal.connect([&](const RecvBuffer& data) { sink.fetch_add(data.size(), std::memory_order_relaxed); });
+    }
+
+    std::cout << std::format("Emitting {} times to {} slot(s)...", num_emissions, num_slots) << std::endl;
+    const double boost_ns = time_emissions([&]() { boost_signal(buffer); });
+    const double event_ns = time_emissions([&]() { event_signal(buffer); });
+
+    std::cout << std::format("Signal Dispatch Results ({} slot(s)):", num_slots) << std::endl;
+    std::cout << std::format("  boost::signals2: {:.1f} ns per emission", boost_ns) << std::endl;
+    std::cout << std::format("  EventSignal:     {:.1f} ns per emission", event_ns) << std::endl;
+    std::cout << std::format("  Speedup: {:.1f}x", boost_ns / event_ns) << std::endl;
+    std::cout << std::format("  Slot calls: {}", sink.load() / buffer.size()) << std::endl;
+}
+
+// Microbenchmark: routing an accepted connection to its listener's slot with many listeners registered
+void test_listener_dispatch(int num_listeners) {
+    const int num_dispatches = 2000000;
+    TargetedSignal signal;
+    std::atomic<int> calls{0};
+    for (int i = 0; i < num_listeners; ++i) signal.connect((SOCKET)(1000 + i), [&](TCPConnInfo) { ++calls; });
+
+    const TCPConnInfo conn{.sockfd = 1, .peerIP = "127.0.0.1", .peerPort = 8080};
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_dispatches; ++i) signal.sendTo((SOCKET)(1000 + i % num_listeners), conn);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now() - start);
+
+    std::cout << std::format("Listener Dispatch Results ({} listeners):", num_listeners) << std::endl;
+    std::cout << std::format("  {:.1f} ns per dispatch, {} slot calls", (double)elapsed.count() / num_dispatches,
+        calls.load()) << std::endl;
+}
+
+// Microbenchmark: splitting a line feed read in 16 KiB chunks, naive std::find against the SIMD decoder
+void test_delimiter_scan(std::size_t mean_record_size) {
+    const std::size_t input_size = 64 * 1024 * 1024;
+    const std::size_t chunk_size = RecvBufferPool::blockSize;
+    const int passes = 5;
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<std::size_t> record_size(0, 2 * mean_record_size);
+    std::string input;
+    input.reserve(input_size + 2 * mean_record_size + 1);
+    while (input.size() < input_size) {
+        input.append(record_size(rng), 'x');
+        input.push_back('\n');
+    }
+
+    // best of several passes, in GB/s
+    auto measure = [&](auto&& split) {
+        double best = 0;
+        std::size_t records = 0;
+        for (int pass = 0; pass < passes; ++pass) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            records = split();
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - start);
+            best = std::max(best, (double)input.size() / (double)elapsed.count());
+        }
+        return std::pair(best, records);
+    };
+
+    // what applications did by hand: find each delimiter, carry the partial record over in a string
+    const auto naive = measure([&]() {
+        std::size_t records = 0;
+        std::string partial;
+        std::vector<std::string_view> batch;
+        for (std::size_t pos = 0; pos < input.size(); pos += chunk_size) {
+            const char* it = input.data() + pos;
+            const char* const end = input.data() + std::min(pos + chunk_size, input.size());
+            batch.clear();
+            // only the chunk's first record can complete the carried one; partial is left alone after that, so
+            // the view into it stays valid
+            bool carried = !partial.empty();
+            for (const char* next; (next = std::find(it, end, '\n')) != end; it = next + 1) {
+                if (carried) {
+                    partial.append(it, next);
+                    batch.emplace_back(partial);
+                    carried = false;
+                } else {
+                    batch.emplace_back(it, next - it);
+                }
+            }
+            records += batch.size();
+            if (!batch.empty()) partial.clear();
+            partial.append(it, end);
+        }
+        return records;
+    });
+
+    std::cout << std::format("Delimiter Scan Results ({} MiB, mean record {} bytes):", input.size() >> 20,
+        mean_record_size) << std::endl;
+    std::cout << std::format("  std::find loop: {:.2f} GB/s ({} records)", naive.first, naive.second) << std::endl;
+    for (auto kernel : {DelimiterScanner::Kernel::Scalar, DelimiterScanner::Kernel::Sse2, DelimiterScanner::Kernel::Avx2}) {
+        if (!simdKernelAvailable(kernel)) continue;
+        const auto decoded = measure([&]() {
+            std::size_t records = 0;
+            DelimiterDecoder decoder({}, kernel);
+            for (std::size_t pos = 0; pos < input.size(); pos += chunk_size) {
+                decoder.feed(std::string_view(input).substr(pos, chunk_size),
+                    [&](std::span<const std::string_view> batch) { records += batch.size(); });
+            }
+            return records;
+        });
+        std::cout << std::format("  DelimiterDecoder ({}): {:.2f} GB/s ({} records), {:.1f}x", simdKernelName(kernel),
+            decoded.first, decoded.second, decoded.first / naive.first) << std::endl;
+    }
+}
+
+// wrk-style load: num_connections keep-alive connections, each keeping pipeline_depth requests in flight for a
+// fixed time; requests per second and latency percentiles, measured on the client side
+void test_http_throughput(int num_connections, int pipeline_depth, uint16_t port) {
+    TCPConnectionManager server_manager;
+    HttpRouter router;
+    router.add("GET", "/plaintext", [](const HttpRequest&, HttpResponse& response) {
+        response.setHeader("Content-Type", "text/plain");
+        response.body = "Hello, World!";
+    });
+    HttpServer server(server_manager, std::move(router), HttpServerOptions{.limits = {}, .shards = 0});
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start HTTP server for throughput test" << std::endl;
+        return;
+    }
+
+    // the per-connection log lines would distort the result
+    std::clog.setstate(std::ios::failbit);
+
+    using Clock = std::chrono::steady_clock;
+    const std::string request = "GET /plaintext HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: load\r\n\r\n";
+    const auto duration = std::chrono::seconds(3);
+
+    // one per connection; only touched by its event loop once the first requests are out
+    struct LoadConnection {
+        TCPConnInfo info;
+        std::mutex mutex;
+        std::deque<Clock::time_point> in_flight;
+        int matched{0}; // bytes of the "\r\n\r\n" ending a response head seen so far
+        std::vector<double> latencies_us;
+    };
+    TCPConnectionManager client_manager;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> responses{0};
+    std::vector<std::unique_ptr<LoadConnection>> connections;
+    for (int i = 0; i < num_connections; ++i) {
+        auto conn = std::make_unique<LoadConnection>();
+        conn->info = client_manager.openConnection("127.0.0.1", port);
+        auto tcp_conn = conn->info.sockfd ? client_manager.getConnection(conn->info).lock() : nullptr;
+        if (!tcp_conn) continue;
+        tcp_conn->newDataArrived.connect([&, c = conn.get()](const RecvBuffer& data) {
+            // the responses carry no body containing CRLF, so each head terminator is one response
+            int completed = 0;
+            for (const char byte : data) {
+                const char expected = (c->matched & 1) ? '\n' : '\r';
+                c->matched = byte == expected ? c->matched + 1 : (byte == '\r' ? 1 : 0);
+                if (c->matched == 4) {
+                    c->matched = 0;
+                    ++completed;
+                }
+            }
+            if (!completed) return;
+            const auto now = Clock::now();
+            std::lock_guard lock(c->mutex);
+            for (int i = 0; i < completed && !c->in_flight.empty(); ++i) {
+                c->latencies_us.push_back(std::chrono::duration<double, std::micro>(now - c->in_flight.front()).count());
+                c->in_flight.pop_front();
+            }
+            responses += completed;
+            if (!running) return;
+            std::string batch;
+            batch.reserve(request.size() * completed);
+            for (int i = 0; i < completed; ++i) {
+                batch += request;
+                c->in_flight.push_back(now);
+            }
+            client_manager.write(c->info, std::move(batch));
+        });
+        connections.push_back(std::move(conn));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const auto start = Clock::now();
+    for (auto& conn : connections) {
+        std::string batch;
+        {
+            std::lock_guard lock(conn->mutex);
+            for (int i = 0; i < pipeline_depth; ++i) {
+                batch += request;
+                conn->in_flight.push_back(Clock::now());
+            }
+        }
+        client_manager.write(conn->info, std::move(batch));
+    }
+    std::this_thread::sleep_for(duration);
+    running = false;
+    const uint64_t total = responses.load();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    client_manager.stop();
+    std::clog.clear();
+
+    std::vector<double> latencies;
+    for (auto& conn : connections) {
+        std::lock_guard lock(conn->mutex);
+        latencies.insert(latencies.end(), conn->latencies_us.begin(), conn->latencies_us.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, (std::size_t)(p * latencies.size()))];
+    };
+
+    std::cout << std::format("HTTP Throughput Results ({} connections, pipeline depth {}, {} server loops):",
+        connections.size(), pipeline_depth, server_manager.eventLoopCount()) << std::endl;
+    std::cout << std::format("  Requests: {} in {:.2f} s = {:.0f} req/s", total, seconds, total / seconds) << std::endl;
+    std::cout << std::format("  Latency p50: {:.1f} us, p99: {:.1f} us, max: {:.1f} us", percentile(0.50),
+        percentile(0.99), latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    std::cout << std::format("  Served by the server: {}", server.requestsServed()) << std::endl;
+
+    server_manager.stop();
+}
+
+// Closed loop of HttpClient requests, concurrency of them in flight at all times. keep_alive = false sends
+// Connection: close with every request, which turns the client into the connect-per-request baseline.
+void test_http_client(int num_requests, int concurrency, HttpClientOptions options, bool keep_alive, uint16_t port) {
+    TCPConnectionManager server_manager;
+    HttpRouter router;
+    router.add("GET", "/plaintext", [](const HttpRequest&, HttpResponse& response) {
+        response.setHeader("Content-Type", "text/plain");
+        response.body = "Hello, World!";
+    });
+    HttpServer server(server_manager, std::move(router));
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start HTTP server for client test" << std::endl;
+        return;
+    }
+
+    // the per-connection log lines would distort the result
+    std::clog.setstate(std::ios::failbit);
+
+    using Clock = std::chrono::steady_clock;
+    TCPConnectionManager client_manager;
+    HttpClient client(client_manager, options);
+    HttpClientRequest request{.target = "/plaintext", .headers = {}, .body = {}};
+    if (!keep_alive) request.headers.emplace_back("Connection", "close");
+
+    std::mutex latencies_mutex;
+    std::vector<double> latencies_us;
+    latencies_us.reserve(num_requests);
+    std::atomic<int> issued{0};
+    std::atomic<int> completed{0};
+    std::atomic<int> failed{0};
+    std::function<void()> issue = [&]() {
+        if (issued++ >= num_requests) return;
+        const auto sent = Clock::now();
+        client.request("127.0.0.1", port, request, [&, sent](HttpClientResult result) {
+            const double latency = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+            if (result.error || result.response.status != 200) ++failed;
+            {
+                std::lock_guard lock(latencies_mutex);
+                latencies_us.push_back(latency);
+            }
+            ++completed;
+            issue();
+        });
+    };
+
+    const auto start = Clock::now();
+    for (int i = 0; i < concurrency; ++i) issue();
+    const auto deadline = start + std::chrono::seconds(60);
+    while (completed < num_requests && Clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const auto stats = client.stats();
+    std::clog.clear();
+
+    std::vector<double> latencies;
+    {
+        std::lock_guard lock(latencies_mutex);
+        latencies = latencies_us;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, (std::size_t)(p * latencies.size()))];
+    };
+
+    std::cout << std::format("HTTP Client Results ({} in flight, {}, up to {} connections, pipeline depth {}):",
+        concurrency, keep_alive ? "pooled keep-alive" : "connect per request", options.maxConnectionsPerHost,
+        options.maxPipelineDepth) << std::endl;
+    std::cout << std::format("  Requests: {} ({} failed) in {:.2f} s = {:.0f} req/s", completed.load(), failed.load(),
+        seconds, completed / seconds) << std::endl;
+    std::cout << std::format("  Latency p50: {:.1f} us, p99: {:.1f} us, max: {:.1f} us", percentile(0.50),
+        percentile(0.99), latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    std::cout << std::format("  Connections opened: {}, requests pipelined: {}", stats.connectionsOpened,
+        stats.pipelinedRequests) << std::endl;
+
+    client_manager.stop();
+    server_manager.stop();
+}
+
+// KvStore against the std::unordered_map<std::string, std::string> behind one mutex that a hand-rolled cache uses:
+// nanoseconds per set and get on a million 64-byte values
+void test_kv_store() {
+    const std::size_t num_keys = 1000000;
+    const std::size_t num_gets = 5000000;
+    std::vector<std::string> keys;
+    keys.reserve(num_keys);
+    for (std::size_t i = 0; i < num_keys; ++i) keys.push_back(std::format("user:{:08d}", i));
+    const std::string value(64, 'v');
+    std::mt19937 rng(5);
+    std::vector<uint32_t> order(num_gets);
+    for (auto& index : order) index = rng() % num_keys;
+
+    using Clock = std::chrono::steady_clock;
+    auto ns_per = [](Clock::time_point start, std::size_t ops) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    };
+
+    std::mutex map_mutex;
+    std::unordered_map<std::string, std::string> map;
+    auto start = Clock::now();
+    for (const auto& key : keys) {
+        std::lock_guard lock(map_mutex);
+        map[key] = value;
+    }
+    const double map_set = ns_per(start, num_keys);
+    std::size_t map_bytes = 0;
+    start = Clock::now();
+    for (const uint32_t index : order) {
+        std::lock_guard lock(map_mutex);
+        const auto it = map.find(keys[index]);
+        if (it != map.end()) map_bytes += it->second.size();
+    }
+    const double map_get = ns_per(start, num_gets);
+
+    KvStore store;
+    start = Clock::now();
+    for (const auto& key : keys) store.set(key, value);
+    const double store_set = ns_per(start, num_keys);
+    std::size_t store_bytes = 0;
+    start = Clock::now();
+    for (const uint32_t index : order) store.get(keys[index], [&](std::string_view found) { store_bytes += found.size(); });
+    const double store_get = ns_per(start, num_gets);
+    const KvStoreStats stats = store.stats();
+
+    std::cout << std::format("KV Store Results ({} keys, {}-byte values, {} random gets):", num_keys, value.size(),
+        num_gets) << std::endl;
+    std::cout << std::format("  std::unordered_map + mutex: set {:.0f} ns, get {:.0f} ns", map_set, map_get) << std::endl;
+    std::cout << std::format("  KvStore: set {:.0f} ns, get {:.0f} ns; {:.0f} slab bytes per item ({} MiB reserved)",
+        store_set, store_get, (double)stats.usedBytes / stats.items, stats.reservedBytes >> 20) << std::endl;
+    if (map_bytes != store_bytes) std::cerr << "KvStore and std::unordered_map returned different values" << std::endl;
+}
+
+// memtier-style load against KvServer: num_connections connections keeping pipeline_depth commands in flight for
+// a fixed time, 90% GET and 10% SET of 64-byte values over 100k preloaded keys; commands per second and latency
+void test_kv_server(int num_connections, int pipeline_depth, uint16_t port) {
+    TCPConnectionManager server_manager;
+    KvStore store;
+    const std::size_t num_keys = 100000;
+    const std::string value(64, 'v');
+    for (std::size_t i = 0; i < num_keys; ++i) store.set(std::format("key:{:06d}", i), value);
+    KvServer server(server_manager, store, KvServerOptions{.limits = {}, .shards = 0});
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start KV server for throughput test" << std::endl;
+        return;
+    }
+
+    // the per-connection log lines would distort the result
+    std::clog.setstate(std::ios::failbit);
+
+    // a ring of encoded commands, each with the number of CRLFs its reply has: 2 for a GET hit, 1 for +OK
+    struct Command {
+        std::string bytes;
+        int crlfs;
+    };
+    std::vector<Command> commands;
+    std::mt19937 rng(3);
+    for (int i = 0; i < 4096; ++i) {
+        const std::string key = std::format("key:{:06d}", rng() % num_keys);
+        if (rng() % 10 == 0) {
+            commands.push_back({std::format("*3\r\n$3\r\nSET\r\n${}\r\n{}\r\n${}\r\n{}\r\n", key.size(), key,
+                value.size(), value), 1});
+        } else {
+            commands.push_back({std::format("*2\r\n$3\r\nGET\r\n${}\r\n{}\r\n", key.size(), key), 2});
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto duration = std::chrono::seconds(3);
+    struct LoadConnection {
+        TCPConnInfo info;
+        std::mutex mutex;
+        std::deque<std::pair<Clock::time_point, int>> in_flight; // sent at, CRLFs still expected
+        std::size_t next{0};                                      // into commands
+        bool after_cr{false};
+        std::vector<double> latencies_us;
+    };
+    TCPConnectionManager client_manager;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> replies{0};
+    // appends the next count commands to batch; conn's mutex held
+    auto next_commands = [&](LoadConnection& c, int count, std::string& batch, Clock::time_point now) {
+        for (int i = 0; i < count; ++i) {
+            const Command& command = commands[c.next++ % commands.size()];
+            batch += command.bytes;
+            c.in_flight.emplace_back(now, command.crlfs);
+        }
+    };
+    std::vector<std::unique_ptr<LoadConnection>> connections;
+    for (int i = 0; i < num_connections; ++i) {
+        auto conn = std::make_unique<LoadConnection>();
+        conn->info = client_manager.openConnection("127.0.0.1", port);
+        auto tcp_conn = conn->info.sockfd ? client_manager.getConnection(conn->info).lock() : nullptr;
+        if (!tcp_conn) continue;
+        conn->next = i * 97;
+        tcp_conn->newDataArrived.connect([&, c = conn.get()](const RecvBuffer& data) {
+            const auto now = Clock::now();
+            std::lock_guard lock(c->mutex);
+            int completed = 0;
+            // the values hold no CRLF, so counting them finds the end of each reply
+            for (const char byte : data) {
+                if (c->after_cr && byte == '\n' && !c->in_flight.empty() && --c->in_flight.front().second == 0) {
+                    c->latencies_us.push_back(std::chrono::duration<double, std::micro>(now - c->in_flight.front().first).count());
+                    c->in_flight.pop_front();
+                    ++completed;
+                }
+                c->after_cr = byte == '\r';
+            }
+            if (!completed) return;
+            replies += completed;
+            if (!running) return;
+            std::string batch;
+            next_commands(*c, completed, batch, now);
+            client_manager.write(c->info, std::move(batch));
+        });
+        connections.push_back(std::move(conn));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const auto start = Clock::now();
+    for (auto& conn : connections) {
+        std::string batch;
+        {
+            std::lock_guard lock(conn->mutex);
+            next_commands(*conn, pipeline_depth, batch, Clock::now());
+        }
+        client_manager.write(conn->info, std::move(batch));
+    }
+    std::this_thread::sleep_for(duration);
+    running = false;
+    const uint64_t total = replies.load();
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    client_manager.stop();
+    std::clog.clear();
+
+    std::vector<double> latencies;
+    for (auto& conn : connections) {
+        std::lock_guard lock(conn->mutex);
+        latencies.insert(latencies.end(), conn->latencies_us.begin(), conn->latencies_us.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, (std::size_t)(p * latencies.size()))];
+    };
+
+    std::cout << std::format("KV Server Results ({} connections, pipeline depth {}, {} server loops):",
+        connections.size(), pipeline_depth, server_manager.eventLoopCount()) << std::endl;
+    std::cout << std::format("  Commands: {} in {:.2f} s = {:.0f} ops/s", total, seconds, total / seconds) << std::endl;
+    std::cout << std::format("  Latency p50: {:.1f} us, p99: {:.1f} us, max: {:.1f} us", percentile(0.50),
+        percentile(0.99), latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    std::cout << std::format("  Served by the server: {}, keys: {}", server.commandsServed(), store.size()) << std::endl;
+
+    server_manager.stop();
+}
+
+// XOR unmasking of client frames: a byte loop against each WebSocketMasker kernel, and the whole decoder
+void test_websocket_unmask(std::size_t frame_size) {
+    const std::size_t input_size = 64 * 1024 * 1024;
+    const int passes = 5;
+    const WebSocketMasker::Key key{0x37, 0xfa, 0x21, 0x3d};
+
+    std::string payload(input_size, '\0');
+    for (std::size_t i = 0; i < payload.size(); ++i) payload[i] = char(i * 131);
+    std::string output(payload.size(), '\0');
+
+    // best of several passes, in GB/s of payload
+    auto measure = [&](auto&& run) {
+        double best = 0;
+        for (int pass = 0; pass < passes; ++pass) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            run();
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - start);
+            best = std::max(best, (double)payload.size() / (double)elapsed.count());
+        }
+        return best;
+    };
+
+    // what decoders commonly do: one byte at a time, the key index taken modulo 4
+    const double naive = measure([&]() {
+        for (std::size_t pos = 0; pos < payload.size(); pos += frame_size) {
+            const std::size_t size = std::min(frame_size, payload.size() - pos);
+            for (std::size_t i = 0; i < size; ++i) output[pos + i] = char(payload[pos + i] ^ key[i % 4]);
+        }
+    });
+
+    // masked client frames cut into receive-buffer-sized pieces, as the decoder sees them
+    std::string frames;
+    frames.reserve(payload.size() + (payload.size() / frame_size + 1) * 14);
+    for (std::size_t pos = 0; pos < payload.size(); pos += frame_size) {
+        appendWebSocketFrame(frames, WebSocketOpcode::Binary, std::string_view(payload).substr(pos, frame_size), true, &key);
+    }
+
+    std::cout << std::format("WebSocket Unmask Results ({} MiB, {}-byte frames):", payload.size() >> 20, frame_size)
+              << std::endl;
+    std::cout << std::format("  byte loop: {:.2f} GB/s", naive) << std::endl;
+    for (auto kernel : {WebSocketMasker::Kernel::Scalar, WebSocketMasker::Kernel::Sse2, WebSocketMasker::Kernel::Avx2}) {
+        if (!simdKernelAvailable(kernel)) continue;
+        const WebSocketMasker masker(kernel);
+        const double masked = measure([&]() {
+            for (std::size_t pos = 0; pos < payload.size(); pos += frame_size) {
+                masker.apply(output.data() + pos, payload.data() + pos, std::min(frame_size, payload.size() - pos), key);
+            }
+        });
+        std::size_t messages = 0;
+        const double decoded = measure([&]() {
+            WebSocketDecoder decoder(frame_size, true, kernel);
+            messages = 0;
+            for (std::size_t pos = 0; pos < frames.size(); pos += RecvBufferPool::blockSize) {
+                decoder.feed(std::string_view(frames).substr(pos, RecvBufferPool::blockSize),
+                    [&](WebSocketOpcode, std::string_view) { ++messages; });
+            }
+        });
+        std::cout << std::format("  WebSocketMasker ({}): {:.2f} GB/s, {:.1f}x; WebSocketDecoder: {:.2f} GB/s ({} messages)",
+            simdKernelName(kernel), masked, masked / naive, decoded, messages) << std::endl;
+    }
+}
+
+// one frame to num_clients WebSocket sessions: broadcast(), which encodes once and shares the buffer, against a
+// send() per session, which encodes and copies the frame every time
+void test_websocket_broadcast(int num_clients, bool use_broadcast, uint16_t port) {
+    TCPConnectionManager manager;
+    WebSocketServer server(manager);
+    std::mutex sessions_mutex;
+    std::vector<TCPConnInfo> sessions;
+    server.sessionOpened.connect([&](TCPConnInfo session) {
+        std::lock_guard lock(sessions_mutex);
+        sessions.push_back(session);
+    });
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start WebSocket server for broadcast test" << std::endl;
+        return;
+    }
+
+    std::clog.setstate(std::ios::failbit);
+    std::atomic<uint64_t> bytes_received{0};
+    std::vector<std::future<TCPConnInfo>> connects;
+    for (int i = 0; i < num_clients; ++i) connects.push_back(manager.openConnectionAsync("127.0.0.1", port));
+    const std::string upgrade = "GET / HTTP/1.1\r\nHost: bench\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    for (auto& connect : connects) {
+        const TCPConnInfo clientInfo = connect.get();
+        if (clientInfo.sockfd == 0) continue;
+        if (auto conn = manager.getConnection(clientInfo).lock()) {
+            conn->newDataArrived.connect([&](const RecvBuffer& data) { bytes_received += data.size(); });
+        }
+        manager.write(clientInfo, upgrade);
+    }
+    for (int i = 0; i < 200 && server.sessionCount() < connects.size(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    }
+
+    const int num_messages = 200;
+    const std::string payload(128, 'b');
+    const std::size_t frame_size = encodeWebSocketFrame(WebSocketOpcode::Text, payload).size();
+    std::vector<TCPConnInfo> targets;
+    {
+        std::lock_guard lock(sessions_mutex);
+        targets = sessions;
+    }
+    std::cout << std::format("Sending {} {}-byte frames to {} sessions with {}...", num_messages, frame_size,
+        targets.size(), use_broadcast ? "broadcast()" : "send() per session") << std::endl;
+
+    const uint64_t expected = bytes_received.load() + (uint64_t)num_messages * targets.size() * frame_size;
+    std::chrono::nanoseconds caller_time{0};
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_messages; ++i) {
+        const auto call_start = std::chrono::high_resolution_clock::now();
+        if (use_broadcast) {
+            server.broadcast(payload);
+        } else {
+            for (const auto& session : targets) server.send(session, payload);
+        }
+        caller_time += std::chrono::high_resolution_clock::now() - call_start;
+    }
+    for (int i = 0; i < 2000 && bytes_received.load() < expected; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time);
+    std::clog.clear();
+
+    const uint64_t delivered = targets.size() * (uint64_t)num_messages;
+    std::cout << std::format("WebSocket Broadcast Results ({}):", use_broadcast ? "broadcast" : "send per session")
+              << std::endl;
+    std::cout << std::format("  Sessions: {}", targets.size()) << std::endl;
+    std::cout << std::format("  Delivered: {}", bytes_received.load() >= expected ? "all" : "incomplete") << std::endl;
+    std::cout << std::format("  Caller time per message: {:.1f} us",
+        std::chrono::duration<double, std::micro>(caller_time).count() / num_messages) << std::endl;
+    std::cout << std::format("  Frames delivered per second: {:.0f}", delivered / elapsed.count()) << std::endl;
+
+    manager.stop();
+}
+
+// Small messages built the way a protocol layer does: from a payload, with a CRLF appended, then copied into a
+// queue slot. std::vector<char> (ByteArray's former storage) against inline capacities of 23, 40 and 64 bytes.
+template <typename Bytes>
+void measure_small_messages(const char* name, std::size_t message_size) {
+    const std::size_t iterations = 2000000;
+    const std::string payload(message_size - 2, 'p');
+    std::vector<Bytes> queue(64);
+    std::size_t checksum = 0;
+
+    const std::size_t allocations_before = g_allocations.load();
+    t_count_allocations = true;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        if constexpr (std::is_same_v<Bytes, std::vector<char>>) {
+            Bytes message(payload.begin(), payload.end());
+            message.push_back('\r');
+            message.push_back('\n');
+            queue[i % queue.size()] = message;
+        } else {
+            Bytes message(payload.data(), payload.size());
+            message.append("\r\n", 2);
+            queue[i % queue.size()] = message;
+        }
+        checksum += queue[i % queue.size()].size();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    t_count_allocations = false;
+    const std::size_t allocations = g_allocations.load() - allocations_before;
+
+    std::cout << std::format("  {:<24} {:5.2f} allocations/op, {:6.1f} M messages/s", name,
+        (double)allocations / iterations, iterations / elapsed.count() / 1e6) << std::endl;
+    if (checksum != iterations * message_size) std::cerr << "Small message benchmark lost bytes" << std::endl;
+}
+
+void test_bytearray_small_messages(std::size_t message_size) {
+    std::cout << std::format("ByteArray Results ({}-byte messages):", message_size) << std::endl;
+    measure_small_messages<std::vector<char>>("std::vector<char>", message_size);
+    measure_small_messages<rmg::BasicByteArray<23>>("BasicByteArray<23>", message_size);
+    measure_small_messages<rmg::ByteArray>("ByteArray (40 inline)", message_size);
+    measure_small_messages<rmg::BasicByteArray<64>>("BasicByteArray<64>", message_size);
+}
+
 // Test memory usage under load
 void test_memory_usage() {
     std::cout << "\n--- Memory Usage Test ---" << std::endl;
@@ -418,15 +1547,15 @@ void test_memory_usage() {
 }
 
 // Test latency under different loads
-void test_latency_under_load() {
-    TCPConnectionManager manager;
+void test_latency_under_load(IOBackend backend = IOBackend::Reactor) {
+    TCPConnectionManager manager(0, backend);
     std::vector<double> latencies;
     std::mutex latencies_mutex;
     
     manager.newConnection.connect([&](const TCPConnInfo& conn) {
         auto connPtr = manager.getConnection(conn).lock();
         if (connPtr) {
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                 std::string received(data.begin(), data.end());
                 
                 // Parse timestamp from message
@@ -461,7 +1590,8 @@ void test_latency_under_load() {
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
     
     const int num_pings = 1000;
-    std::cout << std::format("Testing latency with {} ping messages...", num_pings) << std::endl;
+    std::cout << std::format("Testing latency with {} ping messages ({} backend)...", num_pings,
+        backendName(manager.ioBackend())) << std::endl;
     
     // Send ping messages with timestamps
     for (int i = 0; i < num_pings; ++i) {
@@ -488,17 +1618,136 @@ void test_latency_under_load() {
     manager.stop();
 }
 
+// Test how many idle connections the event loops can hold
+void test_idle_connections(IOBackend backend = IOBackend::Reactor) {
+    TCPConnectionManager manager(0, backend);
+    std::atomic<int> accepted_connections{0};
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        ++accepted_connections;
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 13060);
+    if (serverInfo.sockfd == 0) {
+        std::cerr << "Failed to create server for idle connection test" << std::endl;
+        return;
+    }
+
+    // both ends live in this process, so every connection costs two descriptors
+    const int num_connections = 10000;
+    std::cout << std::format("Opening up to {} idle connections on {} event loop threads ({} backend)...",
+        num_connections, manager.eventLoopCount(), backendName(manager.ioBackend())) << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    int opened = 0;
+    for (; opened < num_connections; ++opened) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 13060);
+        if (clientInfo.sockfd == 0) break; // most likely out of file descriptors
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::cout << std::format("Idle Connection Results:") << std::endl;
+    std::cout << std::format("  Client connections opened: {}", opened) << std::endl;
+    std::cout << std::format("  Server connections accepted: {}", accepted_connections.load()) << std::endl;
+    std::cout << std::format("  I/O threads: {}", manager.eventLoopCount()) << std::endl;
+    std::cout << std::format("  Total time: {} ms", total_duration.count()) << std::endl;
+
+    manager.stop();
+}
+
 int main() {
     std::cout << "=== TCP Connection Manager Performance Tests ===" << std::endl;
     std::cout << "Running performance tests for TCP connection manager..." << std::endl;
     std::cout << "Note: These tests may take several minutes to complete." << std::endl;
 
-    PerformanceTest::measure_time("Connection Performance", test_connection_performance);
-    PerformanceTest::measure_time("Data Throughput", test_data_throughput);
+    PerformanceTest::measure_time("Connection Performance", []() { test_connection_performance(); });
+    // accept throughput should grow with the number of SO_REUSEPORT shards, up to the number of cores
+    for (std::size_t shards = 2; shards <= std::max(2u, std::thread::hardware_concurrency()); shards *= 2) {
+        PerformanceTest::measure_time(std::format("Connection Performance ({} shards)", shards),
+            [shards]() { test_connection_performance(shards); });
+    }
+    PerformanceTest::measure_time("Data Throughput", []() { test_data_throughput(); });
+    PerformanceTest::measure_time("Small-Message Throughput", []() { test_small_message_throughput(); });
+    // MSG_ZEROCOPY only pays off on real NICs; over loopback the kernel copies anyway (reported as "copied")
+    PerformanceTest::measure_time("Bulk Send (copy)", []() { test_zero_copy_throughput(false); });
+    PerformanceTest::measure_time("Bulk Send (zero-copy)", []() { test_zero_copy_throughput(true); });
+    PerformanceTest::measure_time("File Streaming (read + write)", []() { test_file_streaming(false); });
+    PerformanceTest::measure_time("File Streaming (sendFile)", []() { test_file_streaming(true); });
     PerformanceTest::measure_time("Concurrent Clients", test_concurrent_clients);
-    PerformanceTest::measure_time("Broadcast Performance", test_broadcast_performance);
+    PerformanceTest::measure_time("Registry Contention (64 writers)", []() { test_registry_contention(64); });
+    // open + close throughput; teardown must not serialise the threads closing connections
+    PerformanceTest::measure_time("Connection Churn (4 threads)", []() { test_connection_churn(4); });
+    // the caller's cost per broadcast should stay nearly flat as the number of clients grows
+    for (int clients : {50, 200, 800}) {
+        PerformanceTest::measure_time(std::format("Broadcast Performance ({} clients)", clients),
+            [clients]() { test_broadcast_performance(clients); });
+    }
+    // healthy subscribers' latency must not depend on the slowest one
+    PerformanceTest::measure_time("Slow Consumer Isolation (baseline)", []() { test_slow_consumer_isolation(false); });
+    PerformanceTest::measure_time("Slow Consumer Isolation (stalled client)", []() { test_slow_consumer_isolation(true); });
+    // every received chunk is emitted through newDataArrived; compared with the boost::signals2 it replaced
+    for (int slots : {1, 4}) {
+        PerformanceTest::measure_time(std::format("Signal Dispatch ({} slots)", slots),
+            [slots]() { test_signal_dispatch(slots); });
+    }
+    // the cost of routing an accept to its listener should not grow with the number of listeners
+    for (int listeners : {1, 1000}) {
+        PerformanceTest::measure_time(std::format("Listener Dispatch ({} listeners)", listeners),
+            [listeners]() { test_listener_dispatch(listeners); });
+    }
+    // line framing should keep up with multi-GB/s feeds; short records stress the per-record cost
+    for (std::size_t record_size : {16, 100, 1000}) {
+        PerformanceTest::measure_time(std::format("Delimiter Scan ({}-byte records)", record_size),
+            [record_size]() { test_delimiter_scan(record_size); });
+    }
+    // the HTTP layer on loopback, one request at a time and pipelined like wrk's pipeline script
+    PerformanceTest::measure_time("HTTP Throughput (64 connections)", []() { test_http_throughput(64, 1, 13130); });
+    PerformanceTest::measure_time("HTTP Throughput (64 connections, pipelined x16)",
+        []() { test_http_throughput(64, 16, 13131); });
+    // the client side: pooled keep-alive connections, pipelined onto a few, and a new connection per request
+    PerformanceTest::measure_time("HTTP Client (pooled)", []() {
+        test_http_client(200000, 64, HttpClientOptions{.maxConnectionsPerHost = 64, .maxPipelineDepth = 1}, true, 13140);
+    });
+    PerformanceTest::measure_time("HTTP Client (pipelined)", []() {
+        test_http_client(200000, 64, HttpClientOptions{.maxConnectionsPerHost = 4, .maxPipelineDepth = 16}, true, 13141);
+    });
+    PerformanceTest::measure_time("HTTP Client (connect per request)", []() {
+        test_http_client(10000, 64, HttpClientOptions{.maxConnectionsPerHost = 64, .maxPipelineDepth = 1}, false, 13142);
+    });
+    // a production-like workload: a Redis-protocol cache, one command at a time and pipelined like memtier
+    PerformanceTest::measure_time("KV Store", test_kv_store);
+    PerformanceTest::measure_time("KV Server (64 connections)", []() { test_kv_server(64, 1, 13160); });
+    PerformanceTest::measure_time("KV Server (64 connections, pipelined x16)", []() { test_kv_server(64, 16, 13161); });
+    // client frames are unmasked at memory speed; small frames show the per-frame cost
+    for (std::size_t frame_size : {64, 1024, 65536}) {
+        PerformanceTest::measure_time(std::format("WebSocket Unmask ({}-byte frames)", frame_size),
+            [frame_size]() { test_websocket_unmask(frame_size); });
+    }
+    PerformanceTest::measure_time("WebSocket Broadcast (2000 sessions, broadcast)",
+        []() { test_websocket_broadcast(2000, true, 13150); });
+    PerformanceTest::measure_time("WebSocket Broadcast (2000 sessions, send per session)",
+        []() { test_websocket_broadcast(2000, false, 13151); });
+    // typical header and token sizes; the last one no longer fits the default inline capacity
+    for (std::size_t message_size : {8, 16, 32, 64}) {
+        PerformanceTest::measure_time(std::format("ByteArray Small Messages ({} bytes)", message_size),
+            [message_size]() { test_bytearray_small_messages(message_size); });
+    }
     PerformanceTest::measure_time("Memory Usage", test_memory_usage);
-    PerformanceTest::measure_time("Latency Under Load", test_latency_under_load);
+    PerformanceTest::measure_time("Latency Under Load", []() { test_latency_under_load(); });
+    PerformanceTest::measure_time("Idle Connections", []() { test_idle_connections(); });
+
+    // A/B: the same workloads on the io_uring backend (falls back to the reactor where io_uring is unavailable)
+    PerformanceTest::measure_time("Data Throughput (io_uring)", []() { test_data_throughput(IOBackend::IoUring); });
+    PerformanceTest::measure_time("Small-Message Throughput (io_uring)",
+        []() { test_small_message_throughput(IOBackend::IoUring); });
+    PerformanceTest::measure_time("Latency Under Load (io_uring)",
+        []() { test_latency_under_load(IOBackend::IoUring); });
+    PerformanceTest::measure_time("Idle Connections (io_uring)", []() { test_idle_connections(IOBackend::IoUring); });
 
     std::cout << "\n=== Performance Testing Complete ===" << std::endl;
     std::cout << "All performance tests have been executed." << std::endl;
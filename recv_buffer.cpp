@@ -0,0 +1,125 @@
+#include "recv_buffer.hpp"
+
+#include <mutex>
+#include <new>
+
+namespace
+{
+using Block = RecvBuffer::Block;
+
+constexpr std::size_t threadCacheSize = 64;
+constexpr std::size_t depotSize = 1024;
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_liveBlocks{0};
+
+Block* allocateBlock()
+{
+    ++g_allocations;
+    ++g_liveBlocks;
+    return new (::operator new(sizeof(Block) + RecvBufferPool::blockSize)) Block;
+}
+
+void freeBlock(Block* block)
+{
+    --g_liveBlocks;
+    block->~Block();
+    ::operator delete(block);
+}
+
+struct Depot {
+    std::mutex mutex;
+    std::vector<Block*> blocks;
+};
+
+// never destroyed, so threads that exit after static destruction can still hand their blocks back
+Depot& depot()
+{
+    static Depot* instance = [] {
+        auto* d = new Depot;
+        d->blocks.reserve(depotSize);
+        return d;
+    }();
+    return *instance;
+}
+
+// set once the thread's cache is gone; buffers released later in thread exit go straight to the depot
+thread_local bool t_cacheDestroyed = false;
+
+void returnToDepot(Block* block)
+{
+    Depot& d = depot();
+    std::lock_guard lock(d.mutex);
+    if (d.blocks.size() < depotSize) d.blocks.push_back(block);
+    else freeBlock(block);
+}
+
+struct ThreadCache {
+    std::vector<Block*> blocks;
+
+    ThreadCache() { blocks.reserve(threadCacheSize); }
+    ~ThreadCache()
+    {
+        t_cacheDestroyed = true;
+        Depot& d = depot();
+        std::lock_guard lock(d.mutex);
+        for (Block* block : blocks) {
+            if (d.blocks.size() < depotSize) d.blocks.push_back(block);
+            else freeBlock(block);
+        }
+    }
+};
+
+thread_local ThreadCache t_cache;
+} // namespace
+
+RecvBuffer RecvBufferPool::acquire()
+{
+    auto& cache = t_cache.blocks;
+    if (cache.empty()) {
+        // refill half the cache at once, so a thread that only ever receives takes the lock rarely
+        Depot& d = depot();
+        std::lock_guard lock(d.mutex);
+        while (!d.blocks.empty() && cache.size() < threadCacheSize / 2) {
+            cache.push_back(d.blocks.back());
+            d.blocks.pop_back();
+        }
+    }
+
+    Block* block = nullptr;
+    if (cache.empty()) {
+        block = allocateBlock();
+    } else {
+        block = cache.back();
+        cache.pop_back();
+        block->refs.store(1, std::memory_order_relaxed);
+        block->size = 0;
+    }
+    return RecvBuffer(block);
+}
+
+void RecvBufferPool::recycle(RecvBuffer::Block* block)
+{
+    if (t_cacheDestroyed) {
+        returnToDepot(block);
+        return;
+    }
+
+    auto& cache = t_cache.blocks;
+    if (cache.size() == threadCacheSize) {
+        // a thread that only ever releases (a slot keeping buffers for another thread) spills half its cache
+        Depot& d = depot();
+        std::lock_guard lock(d.mutex);
+        while (cache.size() > threadCacheSize / 2) {
+            if (d.blocks.size() < depotSize) d.blocks.push_back(cache.back());
+            else freeBlock(cache.back());
+            cache.pop_back();
+        }
+    }
+    cache.push_back(block);
+}
+
+RecvBufferPoolStats RecvBufferPool::stats()
+{
+    return {g_allocations.load(), g_liveBlocks.load()};
+}
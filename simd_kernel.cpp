@@ -0,0 +1,39 @@
+#include "simd_kernel.hpp"
+
+#include "cpu_features.hpp"
+
+SimdKernel bestSimdKernel()
+{
+    static const SimdKernel kernel = simdKernelAvailable(SimdKernel::Avx2) ? SimdKernel::Avx2
+                                     : simdKernelAvailable(SimdKernel::Sse2) ? SimdKernel::Sse2
+                                                                             : SimdKernel::Scalar;
+    return kernel;
+}
+
+bool simdKernelAvailable(SimdKernel kernel)
+{
+    switch (kernel) {
+#ifdef SIMD_X86
+    case SimdKernel::Avx2:
+        return cpuSupportsAvx2();
+    case SimdKernel::Sse2:
+        return true; // part of x86-64
+#endif
+    case SimdKernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* simdKernelName(SimdKernel kernel)
+{
+    switch (kernel) {
+    case SimdKernel::Avx2:
+        return "AVX2";
+    case SimdKernel::Sse2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
@@ -3,25 +3,28 @@
 #include <iostream>
 #include <format>
 
-#include <winsock2.h>
-
-#include <boost/signals2.hpp>
-
 #include "tcp_connection_manager.hpp"
 
-TCPConnection::TCPConnection(TCPConnectionManager& tcpMgr, TCPConnInfo data) : m_tcpMgr(tcpMgr), connInfo_(data) {
+TCPConnection::TCPConnection(TCPConnectionManager& tcpMgr, EventLoop& eventLoop, TCPConnInfo data)
+    : connInfo_(data), m_tcpMgr(tcpMgr), m_eventLoop(eventLoop)
+{
+    m_outbound.limits = tcpMgr.defaultWriteBufferLimits();
 }
 
 TCPConnection::~TCPConnection()
 {
     std::clog << std::format("TCP connection closing for socket {}\n", connInfo_.sockfd);
-    stop();
+    this->newDataArrived.disconnectAll();
+    onWriteBufferHigh.disconnectAll();
+    onWriteBufferLow.disconnectAll();
+    closeSocket();
 };
 
 void TCPConnection::stop()
 {
-    this->newDataArrived.disconnect_all_slots();
-    closesocket(connInfo_.sockfd);
+    this->newDataArrived.disconnectAll();
+    // the manager unregisters the socket from its event loop before closing it
+    m_tcpMgr.closeConn(connInfo_);
 }
 
 bool TCPConnection::write(const std::string& msg)
@@ -30,6 +33,12 @@ bool TCPConnection::write(const std::string& msg)
     return m_tcpMgr.write(connInfo_, msg);
 }
 
+bool TCPConnection::sendFile(int fd, uint64_t offset, uint64_t length, SendFileProgress progress,
+                             SendFileCompletion completion)
+{
+    return m_tcpMgr.sendFile(connInfo_, fd, offset, length, std::move(progress), std::move(completion));
+}
+
 void TCPConnection::startReadingData()
 {
     m_tcpMgr.startReadingData(connInfo_);
@@ -38,4 +47,57 @@ void TCPConnection::startReadingData()
 TCPConnInfo& TCPConnection::connInfo()
 {
     return connInfo_;
-}
\ No newline at end of file
+}
+
+void TCPConnection::setWriteBufferLimits(const WriteBufferLimits& limits)
+{
+    std::lock_guard lock(m_outbound.mutex);
+    m_outbound.limits = limits;
+}
+
+WriteBufferLimits TCPConnection::writeBufferLimits()
+{
+    std::lock_guard lock(m_outbound.mutex);
+    return m_outbound.limits;
+}
+
+std::size_t TCPConnection::queuedBytes()
+{
+    std::lock_guard lock(m_outbound.mutex);
+    return m_outbound.queuedBytes;
+}
+
+EventLoop& TCPConnection::eventLoop() const
+{
+    return m_eventLoop;
+}
+
+void TCPConnection::closeSocket()
+{
+    if (m_socketClosed.exchange(true)) return;
+    closesocket(connInfo_.sockfd);
+}
+
+bool TCPConnection::socketClosed() const
+{
+    return m_socketClosed;
+}
+
+void TCPConnection::retire(std::shared_ptr<TCPConnection> self)
+{
+    m_retiredSelf = std::move(self);
+    m_eventLoop.retire(connInfo_.sockfd, *this);
+}
+
+void TCPConnection::retired()
+{
+    // may be the last reference; released when this returns
+    const auto self = std::move(m_retiredSelf);
+    m_tcpMgr.retireOutbound(*this);
+    closeSocket();
+}
+
+TCPConnection::OutboundQueue& TCPConnection::outbound()
+{
+    return m_outbound;
+}
@@ -1,20 +1,90 @@
 #include "tcp_connection_manager.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <string>
 #include <thread>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <format>
 #include <unordered_map>
 
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
+#include "io_uring_loop.hpp"
 #include "tcp_util.hpp"
 
-TCPConnectionManager::TCPConnectionManager() 
+struct TCPConnectionManager::PendingConnect {
+    TCPConnInfo connInfo;
+    EventLoop& loop;
+    ConnectCallback callback;
+    EventLoop::TimerId timer{0}; // guarded by m_pendingConnectsMutex
+    std::atomic<bool> done{false};
+};
+
+struct TCPConnectionManager::ConnectRace {
+    std::vector<std::string> addresses;
+    uint16_t port;
+    std::chrono::milliseconds timeout;
+    std::chrono::milliseconds attemptDelay;
+    ConnectCallback callback;
+
+    std::mutex mutex;
+    std::size_t nextAddress{0};
+    std::size_t attemptsInFlight{0};
+    std::vector<std::shared_ptr<PendingConnect>> attempts;
+    EventLoop* timerLoop{nullptr};
+    EventLoop::TimerId timer{0};
+    int lastError{0};
+    bool done{false};
+
+    // Decides the race under mutex. The attempts' callbacks share the race, so they are handed back to the
+    // caller instead of being kept; holding on to them would keep the race alive forever.
+    std::vector<std::shared_ptr<PendingConnect>> finish()
+    {
+        done = true;
+        if (timerLoop) timerLoop->cancelTimer(timer);
+        timerLoop = nullptr;
+        return std::move(attempts);
+    }
+};
+
+struct TCPConnectionManager::ZeroCopyLinger {
+    SOCKET sockfd;
+    std::deque<std::pair<uint32_t, OutboundMessage>> pending;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+namespace
+{
+// how often a closed connection's socket is checked for zero-copy completions, and for how long at most
+constexpr std::chrono::milliseconds zeroCopyLingerPoll{10};
+constexpr std::chrono::seconds zeroCopyLingerTimeout{10};
+
+std::unique_ptr<EventLoop> makeEventLoop(IOBackend& backend)
+{
+#ifdef __linux__
+    if (backend == IOBackend::IoUring) {
+        auto loop = std::make_unique<IoUringLoop>();
+        if (loop->valid()) return loop;
+        std::cerr << "io_uring is not available; falling back to the reactor backend" << std::endl;
+    }
+#else
+    if (backend == IOBackend::IoUring) std::cerr << "io_uring is only available on Linux; using the reactor backend\n";
+#endif
+    backend = IOBackend::Reactor;
+    return std::make_unique<ReactorLoop>();
+}
+} // namespace
+
+TCPConnectionManager::TCPConnectionManager(std::size_t numEventLoops, IOBackend backend)
+    : m_backend(backend)
 {
+#ifdef _WIN32
     WSADATA wsaData;
     const int res = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (res != 0) {
@@ -22,55 +92,56 @@ TCPConnectionManager::TCPConnectionManager()
         return;
     }
     std::clog << "Winsock initialized.\n";
+#endif
 
-    m_connThreadsCleaner = std::jthread([this]() {
-        while (!m_finish) {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_cv.wait(lock, [this] {
-                return m_threadFinished.first || m_finish;
-            });
-
-            //std::clog << "removing thread for connection " << m_threadFinished.second << std::endl;
-
-            {
-                std::lock_guard<std::mutex> connThreadsLock(m_connThreadsMutex);
-                m_connThreads[m_threadFinished.second].request_stop();
-                m_connThreads.erase(m_threadFinished.second);
-            }
-
-            m_threadFinished = {false, -1};
-        }
-    });
+    if (numEventLoops == 0) numEventLoops = std::max(1u, std::thread::hardware_concurrency());
+    m_eventLoops.reserve(numEventLoops);
+    for (std::size_t i = 0; i < numEventLoops; ++i) {
+        m_eventLoops.emplace_back(makeEventLoop(m_backend));
+        m_eventLoops.back()->start();
+    }
 }
 
 TCPConnectionManager::~TCPConnectionManager()
 {
     stop();
-    m_cv.notify_all();
-    {
-        std::lock_guard<std::mutex> lock(m_connThreadsMutex);
-        for (auto& connThread : m_connThreads) connThread.second.join();
-    }
-    newConnection.disconnect_all_slots();
-    connectionClosed.disconnect_all_slots();
-    //m_connThreads.clear();
+    newConnection.disconnectAll();
+    newConnectionBatch.disconnectAll();
+    connectionClosed.disconnectAll();
+    m_eventLoops.clear();
+#ifdef _WIN32
     WSACleanup();
+#endif
 }
 
 void TCPConnectionManager::stop()
 {
-    m_finish = true; //this stops also the reading threads to clean up their connections
+    m_finish = true;
+    m_resolver.stop();
 
-    {
-        std::lock_guard<std::mutex> lock(m_connThreadsMutex);
-        for (auto& connThread : m_connThreads) connThread.second.request_stop();
+    // startConnect checks m_finish under this lock before registering, so no connect slips in after the snapshot
+    std::unique_lock pendingLock(m_pendingConnectsMutex);
+    const auto pendingConnects = m_pendingConnects;
+    pendingLock.unlock();
+    for (const auto& pending : pendingConnects) completeConnect(pending.second, ECANCELED);
+
+    for (const auto& conn : m_connections.snapshot()) {
+        closeConn(conn->connInfo());
     }
-    std::unique_lock lock(m_connectionsMutex);
-    const auto copyConns = m_connections;
-    lock.unlock();
-    for (auto& conn : copyConns) { 
-        closeConn(conn.second->connInfo());
+
+    // joins the loop threads; the sockets closed above are released while the loops drain their queues
+    for (auto& loop : m_eventLoops) loop->stop();
+
+    // a loop may have registered an accept batch after the snapshot; with the loops stopped these close right here
+    for (const auto& conn : m_connections.snapshot()) {
+        closeConn(conn->connInfo());
     }
+
+    // the timers polling these died with the loops
+    std::unique_lock lingersLock(m_zeroCopyLingersMutex);
+    const auto lingers = m_zeroCopyLingers;
+    lingersLock.unlock();
+    for (const auto& linger : lingers) releaseZeroCopyLinger(linger);
 }
 
 TCPConnInfo TCPConnectionManager::openConnection(const std::string& destAddress, uint16_t destPort)
@@ -86,8 +157,16 @@ TCPConnInfo TCPConnectionManager::openConnection(const std::string& destAddress,
         return {};
     }
 
+    sockaddr_storage addr;
+    socklen_t addrLen = 0;
+    int err = makeSockAddr(destAddress, destPort, addr, addrLen);
+    if (err) {
+        std::cerr << "couldn't create sockAddr" << std::endl;
+        return {};
+    }
+
     // SOCK_STREAM for TCP, SOCK_DGRAM for UDP
-    const SOCKET sockfd = socket(destAddress.find(".") == -1 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    const SOCKET sockfd = socket(addr.ss_family, SOCK_STREAM, 0);
     if (sockfd == INVALID_SOCKET) {
         std::cerr << "couldn't create socket" << std::endl;
         return {};
@@ -100,158 +179,516 @@ TCPConnInfo TCPConnectionManager::openConnection(const std::string& destAddress,
     // }
 
     const int on = !sourceAddress.empty() ? 1 : 0;
-    int err = setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    err = setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
     if (err) {
         std::cerr << "couldn't set SO_REUSEADDR option" << std::endl;
+        closesocket(sockfd);
         return {};
     }
 
     if (!sourceAddress.empty()) {
-        struct sockaddr addr;
-        err = makeSockAddr(sourceAddress, sourcePort, addr);
+        sockaddr_storage sourceAddr;
+        socklen_t sourceAddrLen = 0;
+        err = makeSockAddr(sourceAddress, sourcePort, sourceAddr, sourceAddrLen);
         if (err) {
             std::cerr << "couldn't create sockAddr" << std::endl;
+            closesocket(sockfd);
             return {};
         }
 
-        err = bind(sockfd, &addr, sizeof(addr));
+        err = bind(sockfd, (sockaddr*)&sourceAddr, sourceAddrLen);
         if (err) {
             std::cerr << "couldn't bind source address and port" << std::endl;
+            closesocket(sockfd);
             return {};
         }
     }
 
-    struct sockaddr addr;
-    err = makeSockAddr(destAddress, destPort, addr);
+    err = connect(sockfd, (sockaddr*)&addr, addrLen);
     if (err) {
-        std::cerr << "couldn't create sockAddr" << std::endl;
+        std::cerr << "couldn't connect to destination address and port" << std::endl;
+        closesocket(sockfd);
         return {};
     }
 
-    err = connect(sockfd, &addr, sizeof(addr));
-    if (err || errno == EINPROGRESS) {
-        std::cerr << "couldn't connect to destination address and port" << std::endl;
+    // the connect itself stays blocking (see above); from here on the socket is driven by its event loop
+    if (!setNonBlocking(sockfd)) {
+        std::cerr << "cannot set fd non blocking " << std::endl;
+        closesocket(sockfd);
         return {};
     }
 
     const TCPConnInfo connInfo{.sockfd = sockfd, .peerIP = destAddress, .peerPort = destPort};
-    std::shared_ptr<TCPConnection> conn{new TCPConnection(*this, connInfo)};
+    return registerConnectedSocket(connInfo, nextEventLoop());
+}
+
+TCPConnInfo TCPConnectionManager::registerConnectedSocket(const TCPConnInfo& connInfo, EventLoop& loop)
+{
+    std::shared_ptr<TCPConnection> conn{new TCPConnection(*this, loop, connInfo)};
+    const TCPConnInfo registered = addConnection(conn);
     conn->startReadingData();
-    addConnection(sockfd, std::move(conn));
 
-    std::clog << std::format("New Connection - socket fd: {}; destIp: {}, destPort: {}\n", sockfd,
-                    connInfo.peerIP, connInfo.peerPort);
+    std::clog << std::format("New Connection - socket fd: {}; destIp: {}, destPort: {}\n", registered.sockfd,
+                    registered.peerIP.toString(), registered.peerPort);
+    return registered;
+}
 
-    return connInfo;
+std::future<TCPConnInfo> TCPConnectionManager::openConnectionAsync(const std::string& destAddress, uint16_t destPort,
+                                                                   std::chrono::milliseconds timeout)
+{
+    auto promise = std::make_shared<std::promise<TCPConnInfo>>();
+    auto future = promise->get_future();
+    openConnectionAsync(
+        destAddress, destPort, [promise](TCPConnInfo connInfo, int) { promise->set_value(std::move(connInfo)); },
+        timeout);
+    return future;
 }
 
-void TCPConnectionManager::startReadingData(const TCPConnInfo& connInfo)
+void TCPConnectionManager::openConnectionAsync(const std::string& destAddress, uint16_t destPort,
+                                               ConnectCallback callback, std::chrono::milliseconds timeout)
 {
-    std::lock_guard<std::mutex> lock(m_connThreadsMutex);
-    if (m_connThreads[connInfo.sockfd].joinable()) return;
-    m_connThreads[connInfo.sockfd] = std::jthread([this, connInfo = connInfo](std::stop_token st) {
-        readDataFromSocket(st, connInfo);
-        // connection should be closed it is no longer valid.
-        closeConn(connInfo);
+    startConnect(destAddress, destPort, std::move(callback), timeout);
+}
+
+std::shared_ptr<TCPConnectionManager::PendingConnect> TCPConnectionManager::startConnect(
+    const std::string& destAddress, uint16_t destPort, ConnectCallback callback, std::chrono::milliseconds timeout)
+{
+    // the loops are stopping or gone, and nothing would ever fire the timer
+    if (m_finish) {
+        callback({}, ECANCELED);
+        return nullptr;
+    }
+
+    if (destAddress.empty()) {
+        std::cerr << "Destination address not provided" << std::endl;
+        callback({}, EINVAL);
+        return nullptr;
+    }
+
+    sockaddr_storage addr;
+    socklen_t addrLen = 0;
+    if (makeSockAddr(destAddress, destPort, addr, addrLen)) {
+        std::cerr << "couldn't create sockAddr" << std::endl;
+        callback({}, EINVAL);
+        return nullptr;
+    }
+
+    const SOCKET sockfd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (sockfd == INVALID_SOCKET) {
+        std::cerr << "couldn't create socket" << std::endl;
+        callback({}, WSAGetLastError());
+        return nullptr;
+    }
+    if (!setNonBlocking(sockfd)) {
+        const int error = WSAGetLastError();
+        std::cerr << "cannot set fd non blocking " << std::endl;
+        closesocket(sockfd);
+        callback({}, error);
+        return nullptr;
+    }
+
+    const TCPConnInfo connInfo{.sockfd = sockfd, .peerIP = destAddress, .peerPort = destPort};
+    EventLoop& loop = nextEventLoop();
+
+    if (connect(sockfd, (sockaddr*)&addr, addrLen) == 0) { // loopback connects may complete right away
+        callback(registerConnectedSocket(connInfo, loop), 0);
+        return nullptr;
+    }
+    if (!lastErrorInProgress()) {
+        const int error = WSAGetLastError();
+        closesocket(sockfd);
+        callback({}, error);
+        return nullptr;
+    }
+
+    // the handshake finishes when the socket turns writable; whichever of that and the timer comes first wins
+    // The socket is registered before the timer is armed, both under the lock: completeConnect takes it too, so
+    // it reads the final timer and its remove() is queued behind the add().
+    auto pending = std::make_shared<PendingConnect>(connInfo, loop, std::move(callback));
+    std::unique_lock lock(m_pendingConnectsMutex);
+    if (m_finish) { // stop() ran since the check above and has taken, or is about to take, its snapshot
+        lock.unlock();
+        closesocket(sockfd);
+        pending->callback({}, ECANCELED);
+        return nullptr;
+    }
+    m_pendingConnects.emplace(sockfd, pending);
+    loop.add(sockfd, EventLoop::Writable, [this, pending](uint32_t) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(pending->connInfo.sockfd, SOL_SOCKET, SO_ERROR, (char*)&error, &len) != 0) {
+            error = WSAGetLastError();
+        }
+        completeConnect(pending, error);
     });
+    pending->timer = loop.runAfter(timeout, [this, pending]() { completeConnect(pending, ETIMEDOUT); });
+    return pending;
 }
 
-void TCPConnectionManager::readDataFromSocket(std::stop_token st, TCPConnInfo connData) const
+void TCPConnectionManager::completeConnect(const std::shared_ptr<PendingConnect>& pending, int error)
 {
-    std::unique_ptr<char> buffer(new char[1024]);
-    while (!m_finish && !st.stop_requested()) {
-        WSAPOLLFD fd{};
-        fd.fd = connData.sockfd;
-        fd.events = POLLIN; // Wait for incoming data
+    if (pending->done.exchange(true)) return;
+    EventLoop::TimerId timer = 0;
+    {
+        std::lock_guard lock(m_pendingConnectsMutex);
+        m_pendingConnects.erase(pending->connInfo.sockfd);
+        timer = pending->timer;
+    }
 
-        const int wsaPollRes = WSAPoll(&fd, 1, 2000); // 2 seconds timeout
-        if (wsaPollRes > 0) {
-            // If no error occurs, recv returns the number of bytes received and the buffer pointed to by the
-            // buf parameter will If the connection has been gracefully closed, the return value is zero.
-            // Otherwise, a value of SOCKET_ERROR is returned
-            const int recvRes = recv(connData.sockfd, buffer.get(), 1024, 0);
-            if (recvRes == SOCKET_ERROR) {
-                std::cerr << std::format("receive failed on socket {}; closing connection!\n", connData.sockfd);
-                return;
-            }
+    const SOCKET sockfd = pending->connInfo.sockfd;
+    EventLoop& loop = pending->loop;
+    loop.cancelTimer(timer);
+    loop.remove(sockfd); // the connection registers for reads again below, after this removal has run
 
-            if (recvRes == 0) {
-                std::clog << std::format("connection on socket {} was closed by peer\n", connData.sockfd);
-                return;
-            }
+    if (!error && m_finish) error = ECANCELED;
+    if (error) {
+        loop.post([sockfd]() { closesocket(sockfd); });
+        pending->callback({}, error);
+        return;
+    }
 
-            if (m_printReceivedData) {
-                std::cout << "Number of bytes read: " << recvRes << "; Message: " << std::endl;
-                for (int i = 0; i < recvRes; ++i) std::cout << *(buffer.get() + i);
-                std::cout << std::endl;
-            }
+    pending->callback(registerConnectedSocket(pending->connInfo, loop), 0);
+}
 
-            const auto conn = getConnectionDirect(connData.sockfd);
-            if(!conn) {
-                std::cerr << std::format("socket {} is no longer an active connection", connData.sockfd);
-                return;
+void TCPConnectionManager::startReadingData(const TCPConnInfo& connInfo)
+{
+    const auto conn = getConnectionDirect(connInfo);
+    if (!conn) return;
+
+#ifdef __linux__
+    if (m_backend == IOBackend::IoUring) {
+        // the kernel picks a buffer from the loop's ring for every completion; no recv() calls from user space
+        static_cast<IoUringLoop&>(conn->eventLoop())
+            .recvMultishot(connInfo.sockfd, [this, connInfo = connInfo](const char* data, int size) {
+                const auto conn = getConnectionDirect(connInfo);
+                if (!conn || m_finish) return;
+                if (!data) {
+                    if (size == 0) {
+                        std::clog << std::format("connection on socket {} was closed by peer\n", connInfo.sockfd);
+                    } else {
+                        std::cerr << std::format("receive failed on socket {}; closing connection!\n",
+                                                 connInfo.sockfd);
+                    }
+                    closeConn(connInfo);
+                    return;
+                }
+                deliverData(*conn, data, size);
+            });
+        return;
+    }
+#endif
+
+    conn->eventLoop().add(connInfo.sockfd, EventLoop::Readable, [this, connInfo = connInfo](uint32_t events) {
+        if (events & (EventLoop::Writable | EventLoop::Error)) {
+            if (const auto conn = getConnectionDirect(connInfo)) {
+                // zero-copy completions are reported as socket errors
+                if (events & EventLoop::Error) reapZeroCopyCompletions(*conn);
+                if (events & EventLoop::Writable) flushOutbound(conn);
             }
+        }
+        if (events & EventLoop::Readable) readDataFromSocket(connInfo);
+    });
+}
 
-            std::vector<char> bytes(buffer.get(), buffer.get() + recvRes);
-            conn->newDataArrived(bytes);
-        } else if (wsaPollRes == 0) {
-            // Timeout: This is normal and not an error - just means "nothing happened in 2 seconds"
-        } else {
-            std::cerr << "WSAPoll() failed with error: " << WSAGetLastError() << std::endl;
+void TCPConnectionManager::readDataFromSocket(const TCPConnInfo& connData)
+{
+    // bounded so one busy socket can't starve the others on the same loop; the loop is level-triggered and
+    // comes back for whatever is left
+    constexpr int maxReadsPerWakeup = 16;
+
+    const auto conn = getConnectionDirect(connData);
+    if (!conn) return; // already closed; the loop drops the socket once the pending close runs
+
+    for (int i = 0; i < maxReadsPerWakeup && !m_finish; ++i) {
+        // read straight into a pooled buffer, which is then shared by every slot without another copy
+        RecvBuffer buffer = RecvBufferPool::acquire();
+        // If no error occurs, recv returns the number of bytes received and the buffer pointed to by the
+        // buf parameter will If the connection has been gracefully closed, the return value is zero.
+        // Otherwise, a value of SOCKET_ERROR is returned
+        const int recvRes = recv(connData.sockfd, buffer.writableData(), (int)buffer.capacity(), 0);
+        if (recvRes == SOCKET_ERROR) {
+            if (lastErrorWouldBlock()) return;
+            std::cerr << std::format("receive failed on socket {}; closing connection!\n", connData.sockfd);
+            closeConn(connData);
+            return;
+        }
+
+        if (recvRes == 0) {
+            std::clog << std::format("connection on socket {} was closed by peer\n", connData.sockfd);
+            closeConn(connData);
+            return;
+        }
+
+        buffer.resize(recvRes);
+        deliverData(*conn, buffer);
+
+        if (recvRes < (int)buffer.capacity()) return; // socket drained
+    }
+}
+
+void TCPConnectionManager::deliverData(TCPConnection& conn, const RecvBuffer& buffer) const
+{
+    if (m_printReceivedData) {
+        std::cout << "Number of bytes read: " << buffer.size() << "; Message: " << std::endl;
+        std::cout << buffer.view() << std::endl;
+    }
+
+    conn.newDataArrived(buffer);
+}
+
+void TCPConnectionManager::deliverData(TCPConnection& conn, const char* data, int size) const
+{
+    while (size > 0) {
+        RecvBuffer buffer = RecvBufferPool::acquire();
+        const int chunk = std::min(size, (int)buffer.capacity());
+        std::memcpy(buffer.writableData(), data, chunk);
+        buffer.resize(chunk);
+        deliverData(conn, buffer);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+std::future<TCPConnInfo> TCPConnectionManager::openConnectionByName(const std::string& host, uint16_t destPort,
+                                                                    std::chrono::milliseconds timeout,
+                                                                    std::chrono::milliseconds attemptDelay)
+{
+    auto promise = std::make_shared<std::promise<TCPConnInfo>>();
+    auto future = promise->get_future();
+    openConnectionByName(
+        host, destPort, [promise](TCPConnInfo connInfo, int) { promise->set_value(std::move(connInfo)); }, timeout,
+        attemptDelay);
+    return future;
+}
+
+void TCPConnectionManager::openConnectionByName(const std::string& host, uint16_t destPort, ConnectCallback callback,
+                                                std::chrono::milliseconds timeout,
+                                                std::chrono::milliseconds attemptDelay)
+{
+    // resolution happens on the resolver's workers; the race starts from there once the answer is in
+    m_resolver.resolve(host, [this, host, destPort, callback = std::move(callback), timeout,
+                              attemptDelay](const DNSResolver::Addresses& addresses) {
+        if (addresses.empty()) {
+            std::cerr << std::format("couldn't resolve {}\n", host);
+            callback({}, m_finish ? ECANCELED : EHOSTUNREACH);
             return;
         }
+        openConnectionToAny(addresses, destPort, callback, timeout, attemptDelay);
+    });
+}
+
+void TCPConnectionManager::openConnectionToAny(std::vector<std::string> destAddresses, uint16_t destPort,
+                                               ConnectCallback callback, std::chrono::milliseconds timeout,
+                                               std::chrono::milliseconds attemptDelay)
+{
+    if (destAddresses.empty()) {
+        std::cerr << "Destination address not provided" << std::endl;
+        callback({}, EINVAL);
+        return;
+    }
+
+    if (m_finish) {
+        callback({}, ECANCELED);
+        return;
+    }
+
+    auto race = std::make_shared<ConnectRace>();
+    race->addresses = std::move(destAddresses);
+    race->port = destPort;
+    race->timeout = timeout;
+    race->attemptDelay = attemptDelay;
+    race->callback = std::move(callback);
+    startNextAttempt(race);
+}
+
+void TCPConnectionManager::startNextAttempt(const std::shared_ptr<ConnectRace>& race)
+{
+    std::unique_lock lock(race->mutex);
+    if (race->done || race->nextAddress >= race->addresses.size()) return;
+
+    // whoever starts the next attempt (the stagger timer or a failed attempt) makes the pending timer obsolete
+    if (race->timerLoop) race->timerLoop->cancelTimer(race->timer);
+    race->timerLoop = nullptr;
+
+    const std::string address = race->addresses[race->nextAddress++];
+    const bool moreAddresses = race->nextAddress < race->addresses.size();
+    ++race->attemptsInFlight;
+    lock.unlock();
+
+    auto attempt = startConnect(
+        address, race->port,
+        [this, race](TCPConnInfo connInfo, int error) { onAttemptDone(race, connInfo, error); }, race->timeout);
+
+    lock.lock();
+    if (attempt) {
+        if (race->done) {
+            lock.unlock();
+            completeConnect(attempt, ECANCELED); // lost while it was being started
+            return;
+        }
+        race->attempts.push_back(std::move(attempt));
+    }
+    if (moreAddresses && !race->done && !race->timerLoop) {
+        race->timerLoop = &nextEventLoop();
+        race->timer = race->timerLoop->runAfter(race->attemptDelay, [this, race]() { startNextAttempt(race); });
+    }
+}
+
+void TCPConnectionManager::onAttemptDone(const std::shared_ptr<ConnectRace>& race, const TCPConnInfo& connInfo,
+                                         int error)
+{
+    std::unique_lock lock(race->mutex);
+    --race->attemptsInFlight;
+
+    if (race->done) {
+        lock.unlock();
+        if (!error) closeConn(connInfo); // a slower attempt that still made it
+        return;
+    }
+
+    if (!error) {
+        const auto attempts = race->finish();
+        lock.unlock();
+
+        for (const auto& attempt : attempts) completeConnect(attempt, ECANCELED); // no-op for the winner
+        race->callback(connInfo, 0);
+        return;
+    }
+
+    race->lastError = error;
+    if (m_finish || (race->nextAddress >= race->addresses.size() && race->attemptsInFlight == 0)) {
+        const auto attempts = race->finish();
+        lock.unlock();
+        race->callback({}, m_finish ? ECANCELED : race->lastError);
+        return;
     }
+    lock.unlock();
+
+    // a failed attempt starts the next one right away instead of waiting for the stagger delay
+    startNextAttempt(race);
 }
 
-void TCPConnectionManager::closeConn(const TCPConnInfo connInfo) {
-    //std::clog << "TCPConnectionManager::closeConn for connInfo.sockfd " << connInfo.sockfd << std::endl;
-    if (!hasConnection(connInfo.sockfd)) return;
+void TCPConnectionManager::closeConn(ConnHandle handle) {
+    //std::clog << "TCPConnectionManager::closeConn for socket " << handle.sockfd() << std::endl;
+    // whoever takes the connection out of the registry closes it, so racing closes need no lock of their own
+    auto conn = removeConnection(handle);
+    if (!conn) return;
+
+    const TCPConnInfo connInfo = conn->connInfo();
+    // a listener's slots must not fire for a later socket reusing the descriptor
+    newConnectionOnListeningSocket.disconnect(connInfo.sockfd);
 
-    std::lock_guard lock(m_mutex);
-    removeConnection(connInfo.sockfd);
+    // reported while the socket is still open, so the slots hear of the close before the peer can
     connectionClosed(connInfo);
-    m_threadFinished.first = true;
-    m_threadFinished.second = connInfo.sockfd;
-    m_cv.notify_all();
+
+    // the owning loop unregisters the socket before closing it, so the descriptor can't be reused while watched
+    TCPConnection& retiring = *conn;
+    retiring.retire(std::move(conn));
+}
+
+bool TCPConnectionManager::closeConnAfterWrites(ConnHandle handle)
+{
+    const auto conn = getConnectionDirect(handle);
+    if (!conn) return false;
+
+#ifdef __linux__
+    if (m_backend == IOBackend::IoUring) {
+        // queued behind the sends already posted to the loop, so it runs once the last of them has completed
+        static_cast<IoUringLoop&>(conn->eventLoop()).closeAfterSends(handle.sockfd(), [this, handle]() {
+            closeConn(handle);
+        });
+        return true;
+    }
+#endif
+
+    auto& out = conn->outbound();
+    {
+        std::lock_guard lock(out.mutex);
+        if (out.closeMarked) return true;
+        out.closeMarked = true;
+        if (out.flushPending) return true; // the running flush finds the marker once the queue is empty
+        out.flushPending = true;
+    }
+    conn->eventLoop().post([this, conn]() { flushOutbound(conn); });
+    return true;
 }
 
 TCPConnInfo TCPConnectionManager::openListenSocket(const std::string& hostAddr, uint16_t port)
+{
+    return openListenSocket(hostAddr, port, nextEventLoop(), false);
+}
+
+std::vector<TCPConnInfo> TCPConnectionManager::openListenSockets(const std::string& hostAddr, uint16_t port,
+                                                                 std::size_t shards)
+{
+    if (shards == 0) shards = m_eventLoops.size();
+#ifndef SO_REUSEPORT
+    if (shards > 1) std::cerr << "SO_REUSEPORT is not supported on this platform; opening a single listener\n";
+    shards = 1;
+#endif
+
+    std::vector<TCPConnInfo> listeners;
+    for (std::size_t i = 0; i < shards; ++i) {
+        const TCPConnInfo connInfo =
+            openListenSocket(hostAddr, port, *m_eventLoops[i % m_eventLoops.size()], shards > 1);
+        if (connInfo.sockfd == 0) {
+            // half a group would leave some loops without accepts; all or nothing
+            for (const auto& listener : listeners) closeConn(listener);
+            return {};
+        }
+        listeners.push_back(connInfo);
+        // with port 0 the first listener picks an ephemeral port; the others have to join it there
+        port = connInfo.peerPort;
+    }
+    return listeners;
+}
+
+TCPConnInfo TCPConnectionManager::openListenSocket(const std::string& hostAddr, uint16_t port, EventLoop& loop,
+                                                   bool sharded)
 {
     if (hostAddr.empty()) {
         std::cerr << "No peer address provided" << std::endl;
         return {};
     }
 
+    sockaddr_storage addr;
+    socklen_t addrLen = 0;
+    int err = makeSockAddr(hostAddr, port, addr, addrLen);
+    if (err) {
+        std::cerr << "couldn't create sockAddr" << std::endl;
+        return {};
+    }
+
     // SOCK_STREAM for TCP, SOCK_DGRAM for UDP
-    const SOCKET listenSocket = socket(hostAddr.find(".") == -1 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    const SOCKET listenSocket = socket(addr.ss_family, SOCK_STREAM, 0);
     if (listenSocket == INVALID_SOCKET) {
         std::cerr << "couldn't create socket" << std::endl;
         return {};
     }
 
-    //if (fcntl(listenSocket, F_SETFL, O_NONBLOCK) == -1)  // on UNIX systems
-    u_long mode = 1; // 1 = non-blocking, 0 = blocking
-    if (ioctlsocket(listenSocket, FIONBIO, &mode)) {
+    if (!setNonBlocking(listenSocket)) {
         std::cerr << "cannot set fd non blocking " << std::endl;
+        closesocket(listenSocket);
         return {};
     }
 
     const int on = 1;
-    int err = setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    err = setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
     if (err < 0) {
         std::cerr << "couldn't set option" << std::endl;
         closesocket(listenSocket);
         return {};
     }
 
-    struct sockaddr addr;
-    err = makeSockAddr(hostAddr, port, addr);
-    if (err) {
-        std::cerr << "couldn't create sockAddr" << std::endl;
+#ifdef SO_REUSEPORT
+    if (sharded && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, (const char*)&on, sizeof(on)) < 0) {
+        std::cerr << "couldn't set SO_REUSEPORT option" << std::endl;
+        closesocket(listenSocket);
         return {};
     }
+#endif
 
-    err = bind(listenSocket, &addr, sizeof(addr));
+    err = bind(listenSocket, (sockaddr*)&addr, addrLen);
     if (err < 0) {
         // couldn't bind source address and port;
         //std::cerr << "cannot bind to " << hostAddr << ":" << port << " (" << errno << ", " << strerror(errno)
@@ -268,117 +705,736 @@ TCPConnInfo TCPConnectionManager::openListenSocket(const std::string& hostAddr,
         return {};
     }
 
-    const TCPConnInfo connInfo{.sockfd = listenSocket, .peerIP = hostAddr, .peerPort = port};
-    std::shared_ptr<TCPConnection> conn{new TCPConnection(*this, connInfo)};
-    {
-        std::lock_guard<std::mutex> lock(m_connThreadsMutex);
-        m_connThreads[listenSocket] =
-                    std::jthread([this, connInfo = connInfo](std::stop_token st) { 
-             this->checkForConnections(st, connInfo); 
-         });
+    // port 0 leaves the choice to the kernel; the listener reports the port it got
+    if (port == 0) {
+        sockaddr_storage boundAddr{};
+        socklen_t boundLen = sizeof(boundAddr);
+        IPAddress boundIP;
+        if (getsockname(listenSocket, (sockaddr*)&boundAddr, &boundLen) == 0) {
+            fromSockAddr(boundAddr, boundIP, port);
+        }
     }
 
-    //th.detach(); - no longer needed
+    const TCPConnInfo listenInfo{.sockfd = listenSocket, .peerIP = hostAddr, .peerPort = port};
+    std::shared_ptr<TCPConnection> conn{new TCPConnection(*this, loop, listenInfo)};
+    const TCPConnInfo connInfo = addConnection(std::move(conn));
+
+    EventLoop* shardLoop = sharded ? &loop : nullptr;
+#ifdef __linux__
+    if (m_backend == IOBackend::IoUring) {
+        static_cast<IoUringLoop&>(loop).acceptMultishot(listenSocket, [this, listenSocket, shardLoop](SOCKET newSockFd) {
+            if (m_finish) {
+                closesocket(newSockFd);
+                return;
+            }
+            // multishot accept can't return the peer address, so it is looked up per connection
+            TCPConnInfo newConnInfo{.sockfd = newSockFd, .peerIP = {}, .peerPort = 0};
+            sockaddr_storage addr{};
+            socklen_t size = sizeof(addr);
+            if (getpeername(newSockFd, (sockaddr*)&addr, &size) == 0) {
+                fromSockAddr(addr, newConnInfo.peerIP, newConnInfo.peerPort);
+            }
+            registerAcceptedConnections(listenSocket, {newConnInfo}, shardLoop);
+        });
+    } else
+#endif
+    loop.add(listenSocket, EventLoop::Readable | EventLoop::EdgeTriggered,
+             [this, connInfo, shardLoop](uint32_t) { this->checkForConnections(connInfo, shardLoop); });
+
     std::clog << std::format("New Listening Socket - socket fd: {}; on IP: {}, on Port: {}\n", listenSocket,
-                            connInfo.peerIP, connInfo.peerPort);
-    addConnection(listenSocket, std::move(conn));
+                            connInfo.peerIP.toString(), connInfo.peerPort);
     return connInfo;
 }
 
-void TCPConnectionManager::checkForConnections(std::stop_token st, const TCPConnInfo& connInfo)
+void TCPConnectionManager::checkForConnections(const TCPConnInfo& connInfo, EventLoop* shardLoop)
 {
-    SOCKET listenSockFD = connInfo.sockfd;
-    fd_set set{};
-    
-    while (!m_finish && !st.stop_requested()) {
-        FD_ZERO(&set);              // reset memory 
-        FD_SET(listenSockFD, &set); // add the socket file descriptor to the set
-        timeval timeout = {2, 0};   // 2 seconds timeout
-        const int activity = select(-1 /*ignored*/, &set, NULL, NULL, &timeout);
+    // connections are handed out in batches: newConnectionBatch is emitted once per batch, and each round of
+    // accepts is bounded however deep the backlog is before its connections are registered and start reading
+    constexpr std::size_t maxAcceptBatch = 64;
 
-        if (activity == SOCKET_ERROR) { 
-            std::cerr << "select error " << std::endl; 
-            continue;
-        }
+    const SOCKET listenSockFD = connInfo.sockfd;
+    if (m_finish) return;
 
-        if (activity == 0) continue; // timeout
+#ifdef __linux__
+    // a full accept queue at wakeup means the kernel has been dropping (or will drop) SYNs on this listener
+    tcp_info info{};
+    socklen_t infoLen = sizeof(info);
+    if (getsockopt(listenSockFD, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0 && info.tcpi_sacked > 0 &&
+        info.tcpi_unacked >= info.tcpi_sacked) {
+        ++m_backlogOverflows;
+    }
+#endif
 
-        // If something happened on the socket, then its an incoming connection
-        if (FD_ISSET(listenSockFD, &set)) {
-            struct sockaddr addr;
-            const int err = makeSockAddr(connInfo.peerIP, connInfo.peerPort, addr);
-            if (err) {
-                std::cerr << "couldn't create sockAddr" << std::endl;
+    // the listener is edge-triggered: keep accepting until the backlog is empty or we won't see it again
+    std::vector<TCPConnInfo> batch;
+    batch.reserve(maxAcceptBatch);
+    bool drained = false;
+    while (!drained && !m_finish) {
+        batch.clear();
+        while (batch.size() < maxAcceptBatch) {
+            sockaddr_storage addr{};
+            socklen_t size = sizeof(addr);
+#ifdef __linux__
+            const SOCKET newSockFd = accept4(listenSockFD, (sockaddr*)&addr, &size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+            const SOCKET newSockFd = accept(listenSockFD, (sockaddr*)&addr, &size);
+#endif
+            if (newSockFd == INVALID_SOCKET) {
+                // on errors such as EMFILE the rest of the backlog waits for the next incoming connection
+                if (!lastErrorWouldBlock()) {
+                    std::cerr << "accept error" << std::endl;
+                    printErrorMessage();
+                }
+                drained = true;
+                break;
+            }
+#ifndef __linux__
+            if (!setNonBlocking(newSockFd)) {
+                std::cerr << "cannot set fd non blocking " << std::endl;
+                closesocket(newSockFd);
                 continue;
             }
+#endif
+            TCPConnInfo newConnInfo{.sockfd = newSockFd, .peerIP = {}, .peerPort = 0};
+            if (!fromSockAddr(addr, newConnInfo.peerIP, newConnInfo.peerPort)) {
+                std::cerr << std::format("couldn't read peer address of socket {}\n", newSockFd);
+            }
+            batch.push_back(std::move(newConnInfo));
+        }
+        registerAcceptedConnections(listenSockFD, batch, shardLoop);
+    }
+}
 
-            int size = sizeof(addr);
-            SOCKET newSockFd = accept(listenSockFD, &addr, &size);
-            if (newSockFd == INVALID_SOCKET) {
-                std::cerr << "accept error" << std::endl;
-                continue;
+void TCPConnectionManager::registerAcceptedConnections(SOCKET listenSockFD, const std::vector<TCPConnInfo>& batch,
+                                                       EventLoop* shardLoop)
+{
+    if (batch.empty()) return;
+
+    std::vector<std::shared_ptr<TCPConnection>> newConns;
+    std::vector<TCPConnInfo> registered;
+    newConns.reserve(batch.size());
+    registered.reserve(batch.size());
+    for (const auto& newConnInfo : batch) {
+        EventLoop& loop = shardLoop ? *shardLoop : nextEventLoop();
+        newConns.emplace_back(new TCPConnection(*this, loop, newConnInfo));
+        registered.push_back(addConnection(newConns.back()));
+    }
+    m_acceptedCount += batch.size();
+
+    for (const TCPConnInfo& newConnInfo : registered) {
+        std::clog << std::format("New Connection - socket fd: {}; peerIp: {}, peerPort: {}", newConnInfo.sockfd,
+                                 newConnInfo.peerIP.toString(), newConnInfo.peerPort) << std::endl;
+        //! used to send sth on to the client but SHOULD NOT send anything on the socket. e.g. failure for HTTP expects and HTTP message; 
+        // this is the job of the client; 
+
+        newConnection(newConnInfo);
+        newConnectionOnListeningSocket.sendTo(listenSockFD, newConnInfo);
+    }
+    newConnectionBatch(registered);
+
+    // only now: whatever the slots above attached to the connections sees the first bytes the peer sends
+    for (const auto& newConn : newConns) newConn->startReadingData();
+}
+
+bool TCPConnectionManager::write(ConnHandle handle, const std::string& msg)
+{
+    return write(handle, std::string(msg));
+}
+
+bool TCPConnectionManager::write(ConnHandle handle, std::string&& msg)
+{
+    const auto conn = getConnectionDirect(handle);
+    if (!conn) return false;
+    return enqueueOutbound(conn, std::move(msg));
+}
+
+bool TCPConnectionManager::write(ConnHandle handle, SharedBuffer msg)
+{
+    const auto conn = getConnectionDirect(handle);
+    if (!conn || !msg) return false;
+    return enqueueOutbound(conn, std::move(msg));
+}
+
+bool TCPConnectionManager::enqueueOutbound(const std::shared_ptr<TCPConnection>& conn, OutboundMessage msg)
+{
+#ifdef __linux__
+    if (m_backend == IOBackend::IoUring) {
+        // queued on the owning loop and submitted with everything else in its next io_uring_enter
+        static_cast<IoUringLoop&>(conn->eventLoop()).send(conn->connInfo().sockfd, std::move(msg));
+        return true;
+    }
+#endif
+
+    // Queued; the owning loop gathers everything pending into as few sends as possible. Only the producer that
+    // finds no flush pending schedules one, so a burst of writes costs a single wake-up.
+    auto& out = conn->outbound();
+    const std::size_t size = msg.size();
+    bool accepted = true;
+    bool disconnect = false;
+    bool signalHigh = false;
+    bool scheduleFlush = false;
+    std::size_t queued = 0;
+    {
+        std::lock_guard lock(out.mutex);
+        if (out.closeMarked) return false;
+        const WriteBufferLimits& limits = out.limits;
+        const bool overHighWater = limits.highWaterMark && out.queuedBytes + size > limits.highWaterMark;
+        if (overHighWater && !out.aboveHighWater) {
+            out.aboveHighWater = true;
+            signalHigh = true;
+        }
+
+        if (overHighWater && limits.policy == SlowConsumerPolicy::DropNewest) {
+            m_droppedNewestBytes += size;
+            accepted = false;
+        } else if (overHighWater && limits.policy == SlowConsumerPolicy::Disconnect) {
+            m_disconnectedBytes += out.queuedBytes + size;
+            ++m_slowDisconnects;
+            accepted = false;
+            disconnect = true;
+        } else {
+            out.messages.push_back(std::move(msg));
+            out.queuedBytes += size;
+            ++out.messagesQueued;
+            if (overHighWater) {
+                // messages the loop is sending from can't be touched; it trims as soon as the send returns
+                if (out.sending) {
+                    out.trimPending = true;
+                } else {
+                    trimOutbound(out);
+                }
             }
-            std::clog << std::format("New Connection - socket fd: {}; peerIp: {}, peerPort: {}", newSockFd,
-                                     connInfo.peerIP, connInfo.peerPort) << std::endl;
-            //! used to send sth on to the client but SHOULD NOT send anything on the socket. e.g. failure for HTTP expects and HTTP message; 
-            // this is the job of the client; 
-
-            std::shared_ptr<TCPConnection> newConn{new TCPConnection(*this, connInfo)};
-            newConn->connInfo().sockfd = newSockFd;
-            newConn->startReadingData();
-
-            const TCPConnInfo connInfo = newConn->connInfo();
-            addConnection(newSockFd, std::move(newConn));
-            newConnection(connInfo);
-            newConnectionOnListeningSocket.sendTo(listenSockFD,connInfo);
+            scheduleFlush = !out.flushPending;
+            out.flushPending = true;
         }
+        queued = out.queuedBytes;
+    }
+
+    if (signalHigh) conn->onWriteBufferHigh(queued);
+    if (disconnect) {
+        std::clog << std::format("closing slow consumer on socket {} with {} bytes queued\n",
+                                 conn->connInfo().sockfd, queued);
+        closeConn(conn->connInfo());
     }
+    if (!scheduleFlush) return accepted;
+
+    if (conn->eventLoop().isInLoopThread()) {
+        flushOutbound(conn);
+    } else {
+        conn->eventLoop().post([this, conn]() { flushOutbound(conn); });
+    }
+    return accepted;
 }
 
-bool TCPConnectionManager::write(TCPConnInfo connData, const std::string& msg)
+void TCPConnectionManager::trimOutbound(TCPConnection::OutboundQueue& out)
 {
-    if (!hasConnection(connData.sockfd)) return false;
+    const auto& limits = out.limits;
+    if (limits.policy != SlowConsumerPolicy::DropOldest && limits.policy != SlowConsumerPolicy::Conflate) return;
 
-    // send returns the total number of bytes sent. Otherwise, a value of SOCKET_ERROR is returned
-    const int res = send(connData.sockfd, msg.data(), (int)msg.size(), 0);
-    if (res == SOCKET_ERROR) {
-        std::cerr << "send failed; msg: " << msg << ", error: " << WSAGetLastError() << "\n";
-        printErrorMessage();
-        return false;
+    // a partly sent message has to be finished, or the peer would see a torn one; the newest always stays
+    const std::size_t first = out.offset > 0 ? 1 : 0;
+    while (out.messages.size() > first + 1) {
+        if (limits.policy == SlowConsumerPolicy::DropOldest && out.queuedBytes <= limits.highWaterMark) break;
+
+        const std::size_t size = out.messages[first].size();
+        // file transfers count the messages queued before them; this one no longer is
+        const uint64_t dropped = out.messagesSent + first;
+        for (auto& file : out.files) {
+            if (file.position > dropped) --file.position;
+        }
+        out.messages.erase(out.messages.begin() + first);
+        --out.messagesQueued;
+        out.queuedBytes -= size;
+        (limits.policy == SlowConsumerPolicy::DropOldest ? m_droppedOldestBytes : m_conflatedBytes) += size;
+    }
+}
+
+bool TCPConnectionManager::sendFile(ConnHandle handle, int fd, uint64_t offset, uint64_t length,
+                                    SendFileProgress progress, SendFileCompletion completion)
+{
+    const auto conn = getConnectionDirect(handle);
+    if (!conn) return false;
+
+    if (m_backend != IOBackend::Reactor) {
+        std::cerr << "sendFile needs the reactor backend\n";
+        if (completion) completion(0, EOPNOTSUPP);
+        return true;
     }
+
+    auto& out = conn->outbound();
+    {
+        std::lock_guard lock(out.mutex);
+        if (out.closeMarked) return false;
+        out.files.push_back({fd, offset, length, length, out.messagesQueued, std::move(progress),
+                             std::move(completion)});
+        if (out.flushPending) return true;
+        out.flushPending = true;
+    }
+    conn->eventLoop().post([this, conn]() { flushOutbound(conn); });
     return true;
 }
 
-void TCPConnectionManager::addConnection(SOCKET sockfd, std::shared_ptr<TCPConnection> conn)
+void TCPConnectionManager::flushOutbound(const std::shared_ptr<TCPConnection>& conn)
+{
+    if (conn->socketClosed()) return; // the descriptor may already belong to a new connection
+
+    using ZeroCopy = TCPConnection::OutboundQueue::ZeroCopy;
+    const SOCKET sockfd = conn->connInfo().sockfd;
+    auto& out = conn->outbound();
+    const auto watchWritable = [&](bool watch) {
+        if (out.writeWatched == watch) return;
+        out.writeWatched = watch;
+        conn->eventLoop().modify(sockfd, watch ? EventLoop::Readable | EventLoop::Writable : EventLoop::Readable);
+    };
+    const std::size_t zeroCopyThreshold = m_zeroCopyThreshold;
+    std::vector<IoVec> buffers;
+    buffers.reserve(64);
+    // file data sent per call; beyond it the flush goes to the back of the loop's queue, so a large transfer
+    // doesn't hold up the other sockets of the loop
+    constexpr uint64_t fileBudget = 1024 * 1024;
+    uint64_t fileBytesSent = 0;
+
+    for (;;) {
+        // Only this thread pops, and deque::push_back keeps references valid, so the buffers and the file
+        // transfer stay usable after the lock is released for the send.
+        std::size_t total = 0;
+        bool zeroCopy = false;
+        bool drained = false;
+        bool closeMarked = false;
+        TCPConnection::OutboundQueue::FileTransfer* file = nullptr;
+        {
+            std::lock_guard lock(out.mutex);
+            buffers.clear();
+            // messages queued before the next file transfer go first, those queued after it wait for its end
+            uint64_t messagesAhead = UINT64_MAX;
+            if (!out.files.empty()) {
+                messagesAhead = out.files.front().position - out.messagesSent;
+                if (messagesAhead == 0) file = &out.files.front();
+            }
+            std::size_t offset = out.offset;
+            for (const auto& message : out.messages) {
+                if (file || buffers.size() == messagesAhead) break;
+                const std::size_t size = message.size() - offset;
+                // a large message goes out on its own, by reference; the small ones before it are copied
+                if (zeroCopyThreshold && size >= zeroCopyThreshold && out.zeroCopy != ZeroCopy::Unsupported) {
+                    if (buffers.empty()) {
+                        buffers.push_back(makeIoVec(message.data() + offset, size));
+                        total = size;
+                        zeroCopy = true;
+                    }
+                    break;
+                }
+                if ((int)buffers.size() == IOV_MAX) break;
+                buffers.push_back(makeIoVec(message.data() + offset, size));
+                total += size;
+                offset = 0;
+            }
+            if (buffers.empty() && !file) {
+                out.flushPending = false;
+                watchWritable(false);
+                drained = true;
+                closeMarked = out.closeMarked;
+            }
+            out.sending = !file && !drained;
+        }
+        if (drained) {
+            // the close marker is the last entry; nothing can have been queued behind it
+            if (closeMarked) closeConn(conn->connInfo());
+            return;
+        }
+
+        if (file) {
+            if (fileBytesSent >= fileBudget) {
+                conn->eventLoop().post([this, conn]() { flushOutbound(conn); });
+                return;
+            }
+            const std::size_t slice = (std::size_t)std::min<uint64_t>(file->remaining, 256 * 1024);
+            const long long sent = slice ? sendFileChunk(sockfd, file->fd, file->offset, slice) : 0;
+            if (sent == SOCKET_ERROR && lastErrorWouldBlock()) {
+                watchWritable(true);
+                return;
+            }
+            if (sent > 0) {
+                file->offset += sent;
+                file->remaining -= sent;
+                fileBytesSent += sent;
+                if (file->progress) file->progress(file->total - file->remaining, file->total);
+            }
+            if (sent <= 0 || file->remaining == 0) {
+                // done, the file ended early, or reading or sending failed; a broken socket is noticed by the
+                // next send or recv
+                const int error = file->remaining == 0 ? 0 : (sent == 0 ? EIO : WSAGetLastError());
+                const uint64_t fileSent = file->total - file->remaining;
+                SendFileCompletion completion = std::move(file->completion);
+                {
+                    std::lock_guard lock(out.mutex);
+                    out.files.pop_front();
+                }
+                if (completion) completion(fileSent, error);
+                continue;
+            }
+            if ((std::size_t)sent < slice) {
+                watchWritable(true);
+                return;
+            }
+            continue;
+        }
+
+        long long sent = SOCKET_ERROR;
+#ifdef __linux__
+        if (zeroCopy && out.zeroCopy == ZeroCopy::Untried) {
+            const int one = 1;
+            if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+                out.zeroCopy = ZeroCopy::On;
+            } else {
+                std::clog << std::format("SO_ZEROCOPY not supported on socket {}; copying instead\n", sockfd);
+                out.zeroCopy = ZeroCopy::Unsupported;
+            }
+        }
+        if (zeroCopy && out.zeroCopy == ZeroCopy::On) {
+            sent = ::send(sockfd, buffers[0].iov_base, buffers[0].iov_len, MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if (sent >= 0) {
+                out.frontZeroCopySeq = out.zeroCopyNextSeq++;
+                ++m_zeroCopySends;
+            } else if (errno == ENOBUFS) {
+                // too many notifications outstanding (optmem limit); copy this one
+                sent = sendVectored(sockfd, buffers.data(), 1);
+            }
+        } else
+#endif
+        {
+            sent = sendVectored(sockfd, buffers.data(), (int)buffers.size());
+        }
+
+        if (sent == SOCKET_ERROR && lastErrorWouldBlock()) {
+            // nothing went out; resumed by the readiness handler below, producers keep queueing meanwhile
+            sent = 0;
+        } else if (sent == SOCKET_ERROR) {
+            std::cerr << std::format("send failed on socket {}; closing connection!\n", sockfd);
+            printErrorMessage();
+            {
+                std::lock_guard lock(out.mutex);
+                if (out.frontZeroCopySeq) {
+                    // an earlier zero-copy send covered part of the front message; the kernel may still read it
+                    out.zeroCopyPending.emplace_back(*out.frontZeroCopySeq, std::move(out.messages.front()));
+                    out.frontZeroCopySeq.reset();
+                }
+                out.messages.clear();
+                out.offset = 0;
+                out.queuedBytes = 0;
+                out.sending = false;
+                out.flushPending = false;
+            }
+            closeConn(conn->connInfo());
+            return;
+        }
+
+        bool signalLow = false;
+        std::size_t queued = 0;
+        {
+            std::lock_guard lock(out.mutex);
+            out.sending = false;
+            out.queuedBytes -= (std::size_t)sent;
+            std::size_t remaining = (std::size_t)sent;
+            while (remaining > 0) {
+                const std::size_t left = out.messages.front().size() - out.offset;
+                if (remaining < left) {
+                    out.offset += remaining;
+                    break;
+                }
+                remaining -= left;
+                out.offset = 0;
+                if (out.frontZeroCopySeq) {
+                    // moving keeps the heap buffer the kernel points at; the threshold keeps short strings, whose
+                    // characters would move with them, off the zero-copy path
+                    out.zeroCopyPending.emplace_back(*out.frontZeroCopySeq, std::move(out.messages.front()));
+                    out.frontZeroCopySeq.reset();
+                }
+                out.messages.pop_front();
+                ++out.messagesSent;
+            }
+
+            if (out.trimPending) {
+                out.trimPending = false;
+                trimOutbound(out);
+            }
+            if (out.aboveHighWater && out.queuedBytes <= out.limits.lowWaterMark) {
+                out.aboveHighWater = false;
+                signalLow = true;
+            }
+            queued = out.queuedBytes;
+        }
+        if (signalLow) conn->onWriteBufferLow(queued);
+
+        if ((std::size_t)sent < total) {
+            // short write: the socket buffer is full
+            watchWritable(true);
+            return;
+        }
+    }
+}
+
+void TCPConnectionManager::reapZeroCopyCompletions(TCPConnection& conn)
+{
+    auto& out = conn.outbound();
+    if (out.zeroCopy != TCPConnection::OutboundQueue::ZeroCopy::On) return;
+    reapZeroCopyCompletions(conn.connInfo().sockfd, out.zeroCopyPending);
+}
+
+void TCPConnectionManager::reapZeroCopyCompletions(SOCKET sockfd,
+                                                   std::deque<std::pair<uint32_t, OutboundMessage>>& pending)
+{
+#ifdef __linux__
+    // each notification covers the range [ee_info, ee_data] of zero-copy sends
+    for (;;) {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return; // EAGAIN: queue drained
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            const bool ipError = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                                 (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!ipError) continue;
+            sock_extended_err err;
+            std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) continue;
+
+            const uint32_t count = err.ee_data - err.ee_info + 1;
+            m_zeroCopyCompleted += count;
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) m_zeroCopyCopied += count;
+            // completions arrive in order, so everything up to ee_data can go
+            while (!pending.empty() && (int32_t)(pending.front().first - err.ee_data) <= 0) pending.pop_front();
+        }
+    }
+#else
+    (void)sockfd;
+    (void)pending;
+#endif
+}
+
+void TCPConnectionManager::retireOutbound(TCPConnection& conn)
+{
+    auto& out = conn.outbound();
+    std::deque<TCPConnection::OutboundQueue::FileTransfer> files;
+    {
+        std::lock_guard lock(out.mutex);
+        files.swap(out.files);
+    }
+    for (auto& file : files) {
+        if (file.completion) file.completion(file.total - file.remaining, ECANCELED);
+    }
+
+    reapZeroCopyCompletions(conn);
+    if (out.frontZeroCopySeq) { // the kernel reads from a message that was only partly sent
+        std::lock_guard lock(out.mutex);
+        out.zeroCopyPending.emplace_back(*out.frontZeroCopySeq, std::move(out.messages.front()));
+        out.messages.pop_front();
+        out.frontZeroCopySeq.reset();
+    }
+    if (out.zeroCopyPending.empty()) return;
+
+#ifdef __linux__
+    // The error queue belongs to the socket, not to the descriptor: a duplicate keeps reporting completions once
+    // the connection's own descriptor is closed. Shutting it down still sends what is queued, then the FIN.
+    const SOCKET sockfd = dup(conn.connInfo().sockfd);
+    if (sockfd != INVALID_SOCKET) {
+        shutdown(sockfd, SHUT_RDWR);
+        auto linger = std::make_shared<ZeroCopyLinger>(sockfd, std::move(out.zeroCopyPending),
+                                                       std::chrono::steady_clock::now() + zeroCopyLingerTimeout);
+        {
+            std::lock_guard lock(m_zeroCopyLingersMutex);
+            m_zeroCopyLingers.push_back(linger);
+        }
+        lingerZeroCopy(conn.eventLoop(), linger);
+        return;
+    }
+#endif
+    // completions can't be waited for; resetting the connection makes the kernel drop the data it still holds
+    const struct linger abort{.l_onoff = 1, .l_linger = 0};
+    setsockopt(conn.connInfo().sockfd, SOL_SOCKET, SO_LINGER, (const char*)&abort, sizeof(abort));
+}
+
+void TCPConnectionManager::lingerZeroCopy(EventLoop& loop, const std::shared_ptr<ZeroCopyLinger>& linger)
+{
+    reapZeroCopyCompletions(linger->sockfd, linger->pending);
+    if (linger->pending.empty() || m_finish || std::chrono::steady_clock::now() >= linger->deadline) {
+        releaseZeroCopyLinger(linger);
+        return;
+    }
+    loop.runAfter(zeroCopyLingerPoll, [this, &loop, linger]() { lingerZeroCopy(loop, linger); });
+}
+
+void TCPConnectionManager::releaseZeroCopyLinger(const std::shared_ptr<ZeroCopyLinger>& linger)
+{
+    {
+        // the loop's timer and stop() may both get here; whoever takes it off the list closes it
+        std::lock_guard lock(m_zeroCopyLingersMutex);
+        const auto it = std::find(m_zeroCopyLingers.begin(), m_zeroCopyLingers.end(), linger);
+        if (it == m_zeroCopyLingers.end()) return;
+        m_zeroCopyLingers.erase(it);
+    }
+    if (!linger->pending.empty()) {
+        std::cerr << std::format("zero-copy sends on socket {} didn't complete; resetting it\n", linger->sockfd);
+        const struct linger abort{.l_onoff = 1, .l_linger = 0};
+        setsockopt(linger->sockfd, SOL_SOCKET, SO_LINGER, (const char*)&abort, sizeof(abort));
+    }
+    closesocket(linger->sockfd);
+    linger->pending.clear();
+}
+
+bool TCPConnectionManager::setZeroCopy(bool enabled, std::size_t threshold)
+{
+#ifdef __linux__
+    if (m_backend == IOBackend::Reactor) {
+        m_zeroCopyThreshold = enabled ? std::max(threshold, minZeroCopyThreshold) : 0;
+        return true;
+    }
+#endif
+    if (enabled) std::cerr << "zero-copy sends need Linux and the reactor backend; copying instead\n";
+    return !enabled;
+}
+
+ZeroCopyStats TCPConnectionManager::zeroCopyStats() const
+{
+    return {.sends = m_zeroCopySends, .completed = m_zeroCopyCompleted, .copied = m_zeroCopyCopied};
+}
+
+void TCPConnectionManager::setDefaultWriteBufferLimits(const WriteBufferLimits& limits)
+{
+    std::lock_guard lock(m_writeLimitsMutex);
+    m_defaultWriteLimits = limits;
+}
+
+WriteBufferLimits TCPConnectionManager::defaultWriteBufferLimits() const
+{
+    std::lock_guard lock(m_writeLimitsMutex);
+    return m_defaultWriteLimits;
+}
+
+SlowConsumerStats TCPConnectionManager::slowConsumerStats() const
+{
+    return {.droppedOldestBytes = m_droppedOldestBytes,
+            .droppedNewestBytes = m_droppedNewestBytes,
+            .conflatedBytes = m_conflatedBytes,
+            .disconnectedBytes = m_disconnectedBytes,
+            .disconnects = m_slowDisconnects};
+}
+
+TCPConnInfo TCPConnectionManager::addConnection(std::shared_ptr<TCPConnection> conn)
+{
+    uint32_t generation = m_nextGeneration++;
+    if (generation == ConnectionRegistry::anyGeneration) generation = m_nextGeneration++; // wrapped around
+
+    TCPConnInfo& connInfo = conn->connInfo();
+    connInfo.generation = generation;
+    const TCPConnInfo registered = connInfo;
+    m_connections.insert(registered.sockfd, generation, std::move(conn));
+    return registered;
+}
+
+std::shared_ptr<TCPConnection> TCPConnectionManager::removeConnection(ConnHandle handle)
+{
+    return m_connections.erase(handle.sockfd(), handle.generation());
+}
+
+bool TCPConnectionManager::hasConnection(ConnHandle handle) const
+{
+    return m_connections.contains(handle.sockfd(), handle.generation());
+}
+
+std::shared_ptr<TCPConnection> TCPConnectionManager::getConnectionDirect(ConnHandle handle) const
+{
+    return m_connections.find(handle.sockfd(), handle.generation());
+}
+
+EventLoop& TCPConnectionManager::nextEventLoop()
 {
-    std::lock_guard lock(m_connectionsMutex);
-    m_connections.emplace(sockfd, std::move(conn));
+    return *m_eventLoops[m_nextEventLoop++ % m_eventLoops.size()];
 }
 
-void TCPConnectionManager::removeConnection(SOCKET sockfd)
+std::size_t TCPConnectionManager::eventLoopCount() const
 {
-    std::lock_guard lock(m_connectionsMutex);
-    m_connections.erase(sockfd);
+    return m_eventLoops.size();
 }
 
-bool TCPConnectionManager::hasConnection(SOCKET sockfd) const
+IOBackend TCPConnectionManager::ioBackend() const
 {
-    std::lock_guard lock(m_connectionsMutex);
-    return m_connections.contains(sockfd);
+    return m_backend;
 }
 
-std::shared_ptr<TCPConnection> TCPConnectionManager::getConnectionDirect(SOCKET sockfd) const
+DNSResolver& TCPConnectionManager::resolver()
 {
-    std::lock_guard lock(m_connectionsMutex);
-    const auto it = m_connections.find(sockfd);
-    return (it != m_connections.end()) ? it->second : nullptr;
+    return m_resolver;
 }
 
-std::weak_ptr<TCPConnection> TCPConnectionManager::getConnection(const TCPConnInfo& connInfo) const
+AcceptStats TCPConnectionManager::acceptStats()
 {
-    std::lock_guard lock(m_connectionsMutex);
+    std::lock_guard lock(m_acceptStatsMutex);
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t accepted = m_acceptedCount;
+    const double seconds = std::chrono::duration<double>(now - m_acceptStatsTime).count();
+
+    AcceptStats stats{.accepted = accepted, .backlogOverflows = m_backlogOverflows};
+    if (seconds > 0) stats.acceptsPerSecond = (accepted - m_acceptStatsCount) / seconds;
 
-    return m_connections.at(connInfo.sockfd);
+    m_acceptStatsTime = now;
+    m_acceptStatsCount = accepted;
+    return stats;
+}
+
+std::weak_ptr<TCPConnection> TCPConnectionManager::getConnection(ConnHandle handle) const
+{
+    auto conn = getConnectionDirect(handle);
+    if (!conn) {
+        throw std::out_of_range(
+            std::format("no connection on socket {} (generation {})", handle.sockfd(), handle.generation()));
+    }
+    return conn;
+}
+
+std::size_t TCPConnectionManager::connectionCount() const
+{
+    return m_connections.size();
+}
+
+std::vector<std::string> TCPConnectionManager::dnsLookupAll(const std::string& host)
+{
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC; // both A and AAAA records
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* res;
+    int status = 0;
+    if ((status = getaddrinfo(host.c_str(), NULL, &hints, &res)) != 0) {
+        std::cerr << "getaddrinfo failed: " << gai_strerror(status) << std::endl;
+        return {};
+    }
+
+    std::vector<std::string> ipv6Addresses;
+    std::vector<std::string> ipv4Addresses;
+    for (auto p = res; p != NULL; p = p->ai_next) {
+        sockaddr_storage addr{};
+        memcpy(&addr, p->ai_addr, std::min<std::size_t>(p->ai_addrlen, sizeof(addr)));
+        std::string ipAddress;
+        uint16_t port = 0;
+        if (!fromSockAddr(addr, ipAddress, port)) continue;
+
+        auto& addresses = p->ai_family == AF_INET6 ? ipv6Addresses : ipv4Addresses;
+        if (std::find(addresses.begin(), addresses.end(), ipAddress) == addresses.end()) {
+            addresses.push_back(std::move(ipAddress));
+        }
+    }
+    freeaddrinfo(res); // free the linked list
+
+    std::vector<std::string> addresses;
+    addresses.reserve(ipv6Addresses.size() + ipv4Addresses.size());
+    for (std::size_t i = 0; i < std::max(ipv6Addresses.size(), ipv4Addresses.size()); ++i) {
+        if (i < ipv6Addresses.size()) addresses.push_back(ipv6Addresses[i]);
+        if (i < ipv4Addresses.size()) addresses.push_back(ipv4Addresses[i]);
+    }
+    return addresses;
 }
 
 std::string TCPConnectionManager::dnsLookup(const std::string& host, uint16_t ipVersion)
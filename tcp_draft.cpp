@@ -26,7 +26,7 @@ int main() {
         auto connPtr = manager.getConnection(conn).lock();
         if (connPtr) {
             serverConn = connPtr;
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                 ++messages_received;
                 std::string received(data.begin(), data.end());
 
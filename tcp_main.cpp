@@ -4,7 +4,7 @@
 
 #include "tcp_server.hpp"
 
-void printingFunction(std::vector<char> buffer) {
+void printingFunction(const RecvBuffer& buffer) {
     std::cout << "[main] ----- Number of bytes read: " << buffer.size() << std::endl;
     std::cout << "[main] ----- Message: ";
 
@@ -3,14 +3,31 @@
 #include <chrono>
 #include <vector>
 #include <atomic>
+#include <algorithm>
 #include <future>
 #include <cassert>
 #include <format>
 #include <random>
+#include <limits>
+#include <map>
 #include <set>
+#include <unordered_map>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 
+#include "bytearray.hpp"
+#include "delimiter_codec.hpp"
+#include "frame_codec.hpp"
+#include "http_client.hpp"
+#include "http_server.hpp"
+#include "kv_server.hpp"
 #include "tcp_connection_manager.hpp"
 #include "tcp_server.hpp"
+#include "websocket.hpp"
 
 // Focused unit tests for edge cases and error conditions
 
@@ -59,6 +76,19 @@ private:
 std::atomic<int> UnitTestFramework::passed_tests{0};
 std::atomic<int> UnitTestFramework::failed_tests{0};
 
+// Heap allocations made by threads that opted in, for the allocation-free receive path test
+std::atomic<std::size_t> g_allocations{0};
+thread_local bool t_count_allocations = false;
+
+void* operator new(std::size_t size) {
+    if (t_count_allocations) ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
 // Test TargetedSignal class specifically
 void test_targeted_signal() {
     std::cout << "\n--- Testing TargetedSignal class ---" << std::endl;
@@ -102,6 +132,31 @@ void test_targeted_signal() {
     UnitTestFramework::assert_equals(1, slot1_calls.load(), "Socket1 calls should remain unchanged");
     UnitTestFramework::assert_equals(1, slot2_calls.load(), "Socket2 calls should remain unchanged");
     UnitTestFramework::assert_equals(0, slot3_calls.load(), "Socket3 calls should remain unchanged");
+
+    // slots can be disconnected one by one or per socket
+    std::atomic<int> extra_calls{0};
+    EventConnection extra = signal.connect(socket1, [&](TCPConnInfo conn) { ++extra_calls; });
+    signal.sendTo(socket1, testConn);
+    extra.disconnect();
+    signal.sendTo(socket1, testConn);
+    UnitTestFramework::assert_true(slot1_calls == 3 && extra_calls == 1, "Disconnected slot should stop receiving");
+
+    signal.disconnect(socket1);
+    signal.sendTo(socket1, testConn);
+    signal.sendTo(socket2, testConn);
+    UnitTestFramework::assert_true(slot1_calls == 3 && slot2_calls == 2, "Disconnected socket should get nothing");
+
+    // registration and dispatch from different threads, with many sockets registered
+    std::atomic<bool> done{false};
+    std::atomic<int> routed{0};
+    std::thread dispatcher([&]() {
+        while (!done) signal.sendTo(socket3, testConn);
+    });
+    for (SOCKET s = 1000; s < 1500; ++s) signal.connect(s, [&](TCPConnInfo conn) { ++routed; });
+    done = true;
+    dispatcher.join();
+    for (SOCKET s = 1000; s < 1500; ++s) signal.sendTo(s, testConn);
+    UnitTestFramework::assert_equals(500, routed.load(), "Every socket should get exactly its own event");
 }
 
 // Test TCPConnInfo comparison operators
@@ -208,9 +263,19 @@ void test_source_binding() {
     // Try to connect with specific source address
     TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 12500, "127.0.0.1", 0);
     UnitTestFramework::assert_true(clientInfo.sockfd != 0, "Client with source binding should connect successfully");
-    
+
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    
+
+    // 192.0.2.1 (TEST-NET-1) is not a local address, so the bind fails; the socket must not leak, which shows as
+    // the next socket getting the same descriptor
+    const SOCKET probe_before = socket(AF_INET, SOCK_STREAM, 0);
+    closesocket(probe_before);
+    TCPConnInfo unbound = manager.openConnection("127.0.0.1", 12500, "192.0.2.1", 0);
+    const SOCKET probe_after = socket(AF_INET, SOCK_STREAM, 0);
+    closesocket(probe_after);
+    UnitTestFramework::assert_true(unbound.sockfd == 0 && probe_after == probe_before,
+                                   "A failed source bind should close its socket");
+
     manager.stop();
 }
 
@@ -358,25 +423,26 @@ void test_data_integrity() {
     std::cout << "\n--- Testing data integrity under load ---" << std::endl;
     
     TCPConnectionManager manager;
+    // TCP merges and splits writes; the codec restores the message boundaries
+    FrameCodec codec(manager);
     std::atomic<int> messages_sent{0};
     std::atomic<int> messages_received{0};
     std::atomic<int> correct_messages{0};
-    
-    std::shared_ptr<TCPConnection> serverConn;
+    std::atomic<int> in_order_messages{0};
     
     manager.newConnection.connect([&](const TCPConnInfo& conn) {
-        auto connPtr = manager.getConnection(conn).lock();
-        if (connPtr) {
-            serverConn = connPtr;
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
-                ++messages_received;
-                std::string received(data.begin(), data.end());
-                
-                // Check if message follows expected pattern
-                if (received.find("Message_") == 0) {
-                    ++correct_messages;
-                }
-            });
+        codec.attach(conn);
+    });
+    codec.frameArrived.connect([&](const TCPConnInfo&, const Frame& frame) {
+        const int index = messages_received++;
+        std::string received(frame.begin(), frame.end());
+        
+        // Check if message follows expected pattern
+        if (received.find("Message_") == 0) {
+            ++correct_messages;
+        }
+        if (received == std::format("Message_{:04d}_TestData", index)) {
+            ++in_order_messages;
         }
     });
     
@@ -386,13 +452,17 @@ void test_data_integrity() {
     
     // Create client
     TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 12540);
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    // the accepted side has to be attached before frames go out
+    for (int i = 0; i < 200 && codec.attachedCount() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UnitTestFramework::assert_equals(1, (int)codec.attachedCount(), "The accepted connection should be attached");
     
     // Send multiple messages rapidly
     const int num_messages = 100;
     for (int i = 0; i < num_messages; ++i) {
         std::string message = std::format("Message_{:04d}_TestData", i);
-        bool sent = manager.write(clientInfo, message);
+        bool sent = codec.send(clientInfo, message);
         if (sent) {
             ++messages_sent;
         }
@@ -414,6 +484,8 @@ void test_data_integrity() {
     // Allow for some message loss in high-load scenarios, but most should get through
     double success_rate = (double)correct_messages.load() / (double)messages_sent.load();
     UnitTestFramework::assert_true(success_rate > 0.8, "Should have >80% message success rate");
+    UnitTestFramework::assert_equals(num_messages, in_order_messages.load(),
+        "Every message should arrive whole, once and in order");
     
     manager.stop();
 }
@@ -531,7 +603,7 @@ void test_thread_management() {
         ++connections_created;
         auto connPtr = manager.getConnection(conn).lock();
         if (connPtr) {
-            connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                 ++data_received_count;
             });
         }
@@ -750,7 +822,7 @@ void test_memory_leak_detection() {
                 ++peak_connections;
                 auto connPtr = manager.getConnection(conn).lock();
                 if (connPtr) {
-                    connPtr->newDataArrived.connect([&](const std::vector<char>& data) {
+                    connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
                         total_data_received += data.size();
                     });
                 }
@@ -833,6 +905,2632 @@ void test_memory_leak_detection() {
     std::cout << "If running under a debugger, check for memory leak reports." << std::endl;
 }
 
+// Test that a fixed set of event loops serves every connection
+void test_event_loop_reactor() {
+    std::cout << "\n--- Testing event loop reactor ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    std::atomic<int> data_received_count{0};
+
+    UnitTestFramework::assert_equals(2, (int)manager.eventLoopCount(), "Manager should run exactly 2 event loops");
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        auto connPtr = manager.getConnection(conn).lock();
+        if (connPtr) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                ++data_received_count;
+            });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14400);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for reactor test");
+
+    const int num_connections = 32;
+    std::vector<TCPConnInfo> clients;
+    for (int i = 0; i < num_connections; ++i) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14400);
+        if (clientInfo.sockfd != 0) clients.push_back(clientInfo);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    for (const auto& client : clients) manager.write(client, "reactor");
+
+    auto wait_start = std::chrono::steady_clock::now();
+    while (data_received_count < num_connections &&
+           std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(2)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    UnitTestFramework::assert_equals(num_connections, (int)clients.size(), "All clients should connect");
+    UnitTestFramework::assert_equals(num_connections, data_received_count.load(),
+        "Every connection should be read by the 2 event loops");
+
+    manager.stop();
+}
+
+void test_io_uring_backend() {
+    std::cout << "\n--- Testing io_uring backend ---" << std::endl;
+
+    TCPConnectionManager manager(2, IOBackend::IoUring);
+    if (manager.ioBackend() != IOBackend::IoUring) {
+        std::cout << "io_uring not available on this system; exercising the reactor fallback" << std::endl;
+    }
+
+    std::atomic<int> connections_accepted{0};
+    std::atomic<std::size_t> bytes_received{0};
+    std::atomic<int> closed_count{0};
+    std::mutex payload_mutex;
+    std::string received_payload;
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        ++connections_accepted;
+        auto connPtr = manager.getConnection(conn).lock();
+        if (connPtr) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                std::lock_guard lock(payload_mutex);
+                received_payload.append(data.begin(), data.end());
+                bytes_received += data.size();
+            });
+        }
+    });
+    manager.connectionClosed.connect([&](const TCPConnInfo&) { ++closed_count; });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14410);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for io_uring test");
+
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14410);
+    UnitTestFramework::assert_true(clientInfo.sockfd != 0, "Client should connect to io_uring server");
+
+    auto wait_start = std::chrono::steady_clock::now();
+    while (connections_accepted < 1 && std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(2)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UnitTestFramework::assert_equals(1, connections_accepted.load(), "Multishot accept should report the client");
+
+    // larger than one provided buffer, so the payload arrives across several completions
+    std::string payload(64 * 1024, '\0');
+    for (std::size_t i = 0; i < payload.size(); ++i) payload[i] = char('a' + i % 26);
+    const int num_writes = 4;
+    for (int i = 0; i < num_writes; ++i) manager.write(clientInfo, payload);
+    // the close waits for the sends queued ahead of it; what comes after is dropped
+    UnitTestFramework::assert_true(manager.closeConnAfterWrites(clientInfo), "Close after writes should be queued");
+    manager.write(clientInfo, "dropped");
+
+    wait_start = std::chrono::steady_clock::now();
+    while (bytes_received < payload.size() * num_writes &&
+           std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    UnitTestFramework::assert_equals((int)payload.size() * num_writes, (int)bytes_received.load(),
+        "Every byte should arrive through the provided buffers");
+    {
+        std::lock_guard lock(payload_mutex);
+        UnitTestFramework::assert_true(received_payload == payload + payload + payload + payload,
+            "Data should arrive in order and intact");
+    }
+
+    wait_start = std::chrono::steady_clock::now();
+    while (closed_count < 2 && std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(2)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UnitTestFramework::assert_equals(2, closed_count.load(), "Peer close should be seen by the multishot recv");
+
+    manager.stop();
+}
+
+void test_reuseport_sharding() {
+    std::cout << "\n--- Testing SO_REUSEPORT listener sharding ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    TCPServer server(manager);
+    std::atomic<int> connections_accepted{0};
+    std::mutex loops_mutex;
+    std::set<const EventLoop*> accepting_loops;
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        ++connections_accepted;
+        auto connPtr = manager.getConnection(conn).lock();
+        if (connPtr) {
+            std::lock_guard lock(loops_mutex);
+            accepting_loops.insert(&connPtr->eventLoop());
+        }
+    });
+
+    server.start("127.0.0.1", 14420, 2);
+    UnitTestFramework::assert_equals(2, (int)server.shardCount(), "Server should open one listener per shard");
+
+    const int num_connections = 64;
+    int opened = 0;
+    for (int i = 0; i < num_connections; ++i) {
+        if (manager.openConnection("127.0.0.1", 14420).sockfd != 0) ++opened;
+    }
+
+    auto wait_start = std::chrono::steady_clock::now();
+    while (connections_accepted < num_connections &&
+           std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(2)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    UnitTestFramework::assert_equals(num_connections, opened, "All clients should connect to the sharded port");
+    UnitTestFramework::assert_equals(num_connections, connections_accepted.load(),
+        "Every connection should be accepted by one of the shards");
+    {
+        std::lock_guard lock(loops_mutex);
+        // the kernel hashes the 4-tuple; 64 connections all landing on one shard is practically impossible
+        UnitTestFramework::assert_equals(2, (int)accepting_loops.size(),
+            "Connections should stay on both accepting loops");
+    }
+
+    // an ephemeral port is picked once, by the first listener, and shared by the rest of the group
+    const std::vector<TCPConnInfo> ephemeral = manager.openListenSockets("127.0.0.1", 0, 2);
+    UnitTestFramework::assert_equals(2, (int)ephemeral.size(), "Both listeners should open on an ephemeral port");
+    if (ephemeral.size() == 2) {
+        UnitTestFramework::assert_true(ephemeral[0].peerPort != 0 && ephemeral[0].peerPort == ephemeral[1].peerPort,
+            "Listeners opened on port 0 should share one port");
+        UnitTestFramework::assert_true(manager.openConnection("127.0.0.1", ephemeral[0].peerPort).sockfd != 0,
+            "Clients should connect to the shared ephemeral port");
+    }
+
+    manager.stop();
+}
+
+void test_batched_accept() {
+    std::cout << "\n--- Testing batched edge-triggered accept ---" << std::endl;
+
+    TCPConnectionManager manager(1);
+    std::atomic<int> connections_accepted{0};
+    std::atomic<int> batched_connections{0};
+    std::atomic<int> batches{0};
+    std::mutex ports_mutex;
+    std::set<uint16_t> accepted_peer_ports;
+    std::atomic<int> wrong_peer_ip{0};
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        ++connections_accepted;
+        if (conn.peerIP != "127.0.0.1") ++wrong_peer_ip;
+        std::lock_guard lock(ports_mutex);
+        accepted_peer_ports.insert(conn.peerPort);
+    });
+    manager.newConnectionBatch.connect([&](const std::vector<TCPConnInfo>& batch) {
+        ++batches;
+        batched_connections += (int)batch.size();
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14430);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for batched accept test");
+
+    // connect while the only loop is busy, so the listener wakes up to a backlog of several connections
+    const int num_connections = 200;
+    std::set<uint16_t> client_ports;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    manager.getConnection(serverInfo).lock()->eventLoop().post([released]() { released.wait(); });
+    for (int i = 0; i < num_connections; ++i) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14430);
+        if (clientInfo.sockfd == 0) continue;
+        sockaddr_storage addr{};
+        socklen_t size = sizeof(addr);
+        getsockname(clientInfo.sockfd, (sockaddr*)&addr, &size);
+        std::string ip;
+        uint16_t port = 0;
+        if (fromSockAddr(addr, ip, port)) client_ports.insert(port);
+    }
+    release.set_value();
+
+    auto wait_start = std::chrono::steady_clock::now();
+    while (connections_accepted < num_connections &&
+           std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(3)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    UnitTestFramework::assert_equals(num_connections, connections_accepted.load(),
+        "Every pending connection should be accepted");
+    UnitTestFramework::assert_equals(num_connections, batched_connections.load(),
+        "Every accepted connection should be part of exactly one batch");
+    UnitTestFramework::assert_true(batches.load() < num_connections,
+        "A backlog of connections should be accepted in batches");
+    UnitTestFramework::assert_equals(0, wrong_peer_ip.load(), "Accepted connections should carry the peer IP");
+    {
+        std::lock_guard lock(ports_mutex);
+        UnitTestFramework::assert_true(accepted_peer_ports == client_ports,
+            "Accepted connections should carry the clients' ports, not the listening port");
+    }
+
+    const AcceptStats stats = manager.acceptStats();
+    UnitTestFramework::assert_equals(num_connections, (int)stats.accepted, "Accept counter should match");
+    UnitTestFramework::assert_true(stats.acceptsPerSecond > 0, "Accept rate should be reported");
+
+    manager.stop();
+}
+
+void test_async_connect() {
+    std::cout << "\n--- Testing asynchronous connect ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    std::atomic<int> connections_accepted{0};
+    manager.newConnection.connect([&](const TCPConnInfo&) { ++connections_accepted; });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14440);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for async connect test");
+
+    // many connects in flight at once, all started from this thread
+    const int num_connections = 500;
+    std::atomic<int> succeeded{0};
+    std::atomic<int> failed{0};
+    for (int i = 0; i < num_connections; ++i) {
+        manager.openConnectionAsync("127.0.0.1", 14440, [&](TCPConnInfo clientInfo, int error) {
+            if (!error && clientInfo.sockfd != 0) ++succeeded;
+            else ++failed;
+        });
+    }
+
+    auto wait_start = std::chrono::steady_clock::now();
+    while ((succeeded + failed < num_connections || connections_accepted < num_connections) &&
+           std::chrono::steady_clock::now() - wait_start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UnitTestFramework::assert_equals(num_connections, succeeded.load(), "Every async connect should succeed");
+    UnitTestFramework::assert_equals(num_connections, connections_accepted.load(),
+        "Every async connect should be accepted");
+
+    // future flavour; the connection is usable right away
+    std::future<TCPConnInfo> future = manager.openConnectionAsync("127.0.0.1", 14440);
+    UnitTestFramework::assert_true(future.wait_for(std::chrono::seconds(2)) == std::future_status::ready,
+        "Future should complete");
+    TCPConnInfo clientInfo = future.get();
+    UnitTestFramework::assert_true(clientInfo.sockfd != 0, "Future should carry the connection");
+    UnitTestFramework::assert_true(manager.write(clientInfo, "async"), "Async connection should be writable");
+
+    // nobody listens here: the error is reported instead of a connection
+    std::promise<int> refused;
+    manager.openConnectionAsync("127.0.0.1", 14441, [&](TCPConnInfo, int error) { refused.set_value(error); });
+    auto refused_future = refused.get_future();
+    UnitTestFramework::assert_true(refused_future.wait_for(std::chrono::seconds(2)) == std::future_status::ready,
+        "Refused connect should complete");
+    UnitTestFramework::assert_true(refused_future.get() != 0, "Refused connect should report an error");
+
+    // a non-routable address either times out or fails right away, but never hangs
+    std::promise<int> unreachable;
+    auto connect_start = std::chrono::steady_clock::now();
+    manager.openConnectionAsync("10.255.255.1", 14442, [&](TCPConnInfo, int error) { unreachable.set_value(error); },
+        std::chrono::milliseconds(200));
+    auto unreachable_future = unreachable.get_future();
+    UnitTestFramework::assert_true(unreachable_future.wait_for(std::chrono::seconds(2)) == std::future_status::ready,
+        "Connect timeout should fire");
+    UnitTestFramework::assert_true(unreachable_future.get() != 0, "Timed out connect should report an error");
+    UnitTestFramework::assert_true(std::chrono::steady_clock::now() - connect_start < std::chrono::seconds(1),
+        "Connect should give up after its timeout");
+
+    manager.stop();
+
+    // no loop is left to run the timer, so a connect after stop() is cancelled right away
+    std::future<TCPConnInfo> after_stop = manager.openConnectionAsync("10.255.255.1", 14442, std::chrono::milliseconds(200));
+    UnitTestFramework::assert_true(after_stop.wait_for(std::chrono::seconds(2)) == std::future_status::ready &&
+                                   after_stop.get().sockfd == 0,
+                                   "A connect after stop() should fail right away");
+}
+
+void test_happy_eyeballs() {
+    std::cout << "\n--- Testing happy eyeballs connect ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    std::atomic<int> server_side_open{0};
+    manager.newConnection.connect([&](const TCPConnInfo&) { ++server_side_open; });
+    manager.connectionClosed.connect([&](const TCPConnInfo& conn) {
+        if (conn.peerPort != 14460 && conn.peerPort != 14461) --server_side_open; // accepted side, not a client
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14460);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for happy eyeballs test");
+
+    auto addresses = TCPConnectionManager::dnsLookupAll("localhost");
+    UnitTestFramework::assert_true(!addresses.empty(), "localhost should resolve to at least one address");
+
+    // localhost may resolve to ::1 first, which nobody listens on; the IPv4 attempt has to win
+    TCPConnInfo byName = manager.openConnectionByName("localhost", 14460).get();
+    UnitTestFramework::assert_true(byName.sockfd != 0, "Connect by name should succeed");
+    UnitTestFramework::assert_true(byName.peerIP == "127.0.0.1", "The listening address should win the race");
+
+    // an IPv4-mapped literal contains dots but still needs an IPv6 socket
+    TCPConnInfo mapped = manager.openConnection("::ffff:127.0.0.1", 14460);
+    UnitTestFramework::assert_true(mapped.sockfd != 0, "An IPv4-mapped address should connect");
+
+    // a black-holed first address must not hold up the working one for longer than the attempt delay
+    std::promise<TCPConnInfo> slow_first;
+    auto connect_start = std::chrono::steady_clock::now();
+    manager.openConnectionToAny({"10.255.255.1", "127.0.0.1"}, 14460,
+        [&](TCPConnInfo connInfo, int) { slow_first.set_value(connInfo); }, std::chrono::seconds(5),
+        std::chrono::milliseconds(100));
+    TCPConnInfo raced = slow_first.get_future().get();
+    UnitTestFramework::assert_true(raced.sockfd != 0 && raced.peerIP == "127.0.0.1",
+        "The reachable address should win over the unreachable one");
+    UnitTestFramework::assert_true(std::chrono::steady_clock::now() - connect_start < std::chrono::seconds(1),
+        "The race should not wait for the unreachable address to time out");
+
+    // several attempts that all succeed: exactly one connection survives
+    TCPConnInfo secondServer = manager.openListenSocket("127.0.0.1", 14461);
+    UnitTestFramework::assert_true(secondServer.sockfd != 0, "Second server should be created");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const int open_before = server_side_open;
+    std::promise<TCPConnInfo> all_good;
+    manager.openConnectionToAny({"127.0.0.1", "127.0.0.1", "127.0.0.1"}, 14461,
+        [&](TCPConnInfo connInfo, int) { all_good.set_value(connInfo); }, std::chrono::seconds(2),
+        std::chrono::milliseconds(0));
+    UnitTestFramework::assert_true(all_good.get_future().get().sockfd != 0, "One of the attempts should win");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    UnitTestFramework::assert_equals(open_before + 1, server_side_open.load(),
+        "Losing attempts should be cancelled or closed");
+
+    // nothing reachable: the last error is reported
+    std::promise<int> none;
+    manager.openConnectionToAny({"127.0.0.1", "127.0.0.1"}, 14462,
+        [&](TCPConnInfo, int error) { none.set_value(error); });
+    UnitTestFramework::assert_true(none.get_future().get() != 0, "Race without a reachable address should fail");
+
+    manager.stop();
+}
+
+void test_dns_resolver() {
+    std::cout << "\n--- Testing asynchronous DNS resolver ---" << std::endl;
+
+    const std::string hosts_path = "dns_resolver_test_hosts";
+    {
+        std::ofstream hosts(hosts_path);
+        hosts << "# test stub\n";
+        hosts << "127.0.0.1   stub.test   alias.test\n";
+        hosts << "::1         stub.test\n";
+        hosts << "127.0.0.2   other.test  # trailing comment\n";
+    }
+
+    // slow backend, so concurrent lookups overlap with the query in flight
+    std::atomic<int> backend_queries{0};
+    auto hosts_backend = DNSResolver::hostsFileBackend(hosts_path);
+    DNSResolver resolver(2, std::chrono::milliseconds(300), std::chrono::milliseconds(300),
+        [&](const std::string& host) {
+            ++backend_queries;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return hosts_backend(host);
+        });
+
+    std::vector<std::future<DNSResolver::Addresses>> lookups;
+    for (int i = 0; i < 20; ++i) lookups.push_back(resolver.resolve(i % 2 ? "stub.test" : "STUB.test"));
+    bool all_match = true;
+    for (auto& lookup : lookups) {
+        all_match &= lookup.get() == DNSResolver::Addresses{"::1", "127.0.0.1"};
+    }
+    UnitTestFramework::assert_true(all_match, "Lookups should return both families, IPv6 first");
+    UnitTestFramework::assert_equals(1, backend_queries.load(), "Concurrent lookups should share one query");
+    UnitTestFramework::assert_equals(19, (int)resolver.stats().coalesced, "19 lookups should be coalesced");
+
+    UnitTestFramework::assert_true(resolver.resolve("alias.test").get() == DNSResolver::Addresses{"127.0.0.1"},
+        "Aliases should resolve");
+    UnitTestFramework::assert_equals(2, backend_queries.load(), "A new name should be queried");
+
+    // answered from the cache on the calling thread
+    const auto hits_before = resolver.stats().cacheHits;
+    UnitTestFramework::assert_true(!resolver.resolve("stub.test").get().empty(), "Cached lookup should succeed");
+    UnitTestFramework::assert_equals(2, backend_queries.load(), "Cached lookup should not query the backend");
+    UnitTestFramework::assert_equals((int)hits_before + 1, (int)resolver.stats().cacheHits, "Cache hit counted");
+
+    // negative caching
+    UnitTestFramework::assert_true(resolver.resolve("missing.test").get().empty(), "Unknown name should fail");
+    UnitTestFramework::assert_true(resolver.resolve("missing.test").get().empty(), "Cached failure should fail");
+    UnitTestFramework::assert_equals(3, backend_queries.load(), "Failures should be cached too");
+
+    // IP literals never reach the backend
+    UnitTestFramework::assert_true(resolver.resolve("10.1.2.3").get() == DNSResolver::Addresses{"10.1.2.3"},
+        "IP literal should resolve to itself");
+    UnitTestFramework::assert_equals(3, backend_queries.load(), "IP literals should not be queried");
+
+    // expiry
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    resolver.resolve("stub.test").get();
+    resolver.resolve("missing.test").get();
+    UnitTestFramework::assert_equals(5, backend_queries.load(), "Expired entries should be queried again");
+
+    // the answer of a backend replaced while its query runs is not cached
+    auto replaced_lookup = resolver.resolve("other.test");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    resolver.setBackend([](const std::string&) { return DNSResolver::Addresses{"127.0.0.9"}; });
+    replaced_lookup.get();
+    UnitTestFramework::assert_true(resolver.resolve("other.test").get() == DNSResolver::Addresses{"127.0.0.9"},
+        "Lookups after setBackend should not see the replaced backend's answers");
+
+    // the manager connects by name through its resolver
+    TCPConnectionManager manager(1);
+    manager.resolver().setBackend(DNSResolver::hostsFileBackend(hosts_path));
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14470);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for resolver test");
+    TCPConnInfo clientInfo = manager.openConnectionByName("stub.test", 14470).get();
+    UnitTestFramework::assert_true(clientInfo.sockfd != 0 && clientInfo.peerIP == "127.0.0.1",
+        "Connect by name should use the resolver");
+    manager.stop();
+
+    resolver.stop();
+    UnitTestFramework::assert_true(resolver.resolve("stub.test").get().empty(),
+        "Lookups after stop should fail instead of hanging");
+    std::remove(hosts_path.c_str());
+}
+
+// Test the per-connection outbound queue: concurrent producers, ordering and a peer that doesn't read
+void test_outbound_queue() {
+    std::cout << "\n--- Testing outbound write queue ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    std::mutex received_mutex;
+    std::string received;
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received.append(data.begin(), data.end());
+            });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14480);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for write queue test");
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14480);
+    UnitTestFramework::assert_true(clientInfo.sockfd != 0, "Client should connect for write queue test");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const int producers = 4;
+    const int messages_per_producer = 2000;
+    std::atomic<int> failed_writes{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < messages_per_producer; ++i) {
+                if (!manager.write(clientInfo, std::format("P{}:{:05d}\n", p, i))) ++failed_writes;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    UnitTestFramework::assert_equals(0, failed_writes.load(), "Concurrent writes should all be queued");
+
+    const std::size_t expected_bytes = (std::size_t)producers * messages_per_producer * 9;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(received_mutex);
+            if (received.size() >= expected_bytes) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    bool in_order = true;
+    std::vector<int> next_seq(producers, 0);
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_equals((int)expected_bytes, (int)received.size(), "Every queued byte should arrive");
+        for (std::size_t pos = 0; pos + 9 <= received.size(); pos += 9) {
+            const int p = received[pos + 1] - '0';
+            const int seq = std::stoi(received.substr(pos + 3, 5));
+            if (received[pos] != 'P' || received[pos + 8] != '\n' || p < 0 || p >= producers || seq != next_seq[p]) {
+                in_order = false;
+                break;
+            }
+            ++next_seq[p];
+        }
+    }
+    UnitTestFramework::assert_true(in_order, "Messages should arrive whole and in per-producer order");
+
+    // a peer that accepts but doesn't read must not block writers
+    const SOCKET slow_listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(slow_listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    makeSockAddr("127.0.0.1", 14481, addr, addr_len);
+    const bool listening = bind(slow_listener, (sockaddr*)&addr, addr_len) == 0 && listen(slow_listener, 1) == 0;
+    UnitTestFramework::assert_true(listening, "Slow peer should listen");
+    if (!listening) {
+        closesocket(slow_listener);
+        manager.stop();
+        return;
+    }
+
+    TCPConnInfo slowInfo = manager.openConnection("127.0.0.1", 14481);
+    UnitTestFramework::assert_true(slowInfo.sockfd != 0, "Client should connect to slow peer");
+    const SOCKET slow_peer = accept(slow_listener, nullptr, nullptr);
+
+    const std::string chunk(1024 * 1024, 'x');
+    const int chunks = 16;
+    const auto write_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < chunks; ++i) manager.write(slowInfo, chunk);
+    const auto write_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - write_start).count();
+    UnitTestFramework::assert_true(write_ms < 500, std::format("Writes to a stalled peer should not block ({} ms)", write_ms));
+
+    // once the peer reads, the queue drains completely
+    std::vector<char> buffer(64 * 1024);
+    std::size_t drained = 0;
+    while (drained < chunk.size() * chunks) {
+        const int res = recv(slow_peer, buffer.data(), (int)buffer.size(), 0);
+        if (res <= 0) break;
+        drained += res;
+    }
+    UnitTestFramework::assert_true(drained == chunk.size() * chunks, "Stalled queue should drain once the peer reads");
+
+    closesocket(slow_peer);
+    closesocket(slow_listener);
+    manager.stop();
+}
+
+// Test opt-in MSG_ZEROCOPY sends: content, ordering with copied messages and completion notifications
+void test_zero_copy_send() {
+    std::cout << "\n--- Testing zero-copy send path ---" << std::endl;
+
+    TCPConnectionManager uring_manager(1, IOBackend::IoUring);
+    UnitTestFramework::assert_true(!uring_manager.setZeroCopy(true) || uring_manager.ioBackend() == IOBackend::Reactor,
+        "Zero-copy should be refused by the io_uring backend");
+    uring_manager.stop();
+
+    TCPConnectionManager manager(2);
+#ifdef __linux__
+    UnitTestFramework::assert_true(manager.setZeroCopy(true, 64 * 1024), "Zero-copy should be available on Linux");
+#endif
+
+    std::mutex received_mutex;
+    std::string received;
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received.append(data.begin(), data.end());
+            });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14490);
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14490);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0 && clientInfo.sockfd != 0, "Zero-copy connection should be established");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // large messages alternate with small ones, which stay on the copy path
+    std::string expected;
+    const int large_messages = 8;
+    for (int i = 0; i < large_messages; ++i) {
+        std::string large(256 * 1024, (char)('a' + i));
+        std::string small = std::format("small_{}", i);
+        expected += large + small;
+        manager.write(clientInfo, std::move(large));
+        manager.write(clientInfo, small);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(received_mutex);
+            if (received.size() >= expected.size()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(received == expected, "Zero-copy and copied messages should arrive intact and in order");
+    }
+
+#ifdef __linux__
+    // notifications can trail the data a little
+    ZeroCopyStats stats = manager.zeroCopyStats();
+    for (int i = 0; i < 100 && stats.completed < stats.sends; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stats = manager.zeroCopyStats();
+    }
+    std::cout << std::format("Zero-copy sends: {}, completed: {}, copied by the kernel: {}",
+        stats.sends, stats.completed, stats.copied) << std::endl;
+    UnitTestFramework::assert_true(stats.sends >= (uint64_t)large_messages, "Large messages should be sent zero-copy");
+    UnitTestFramework::assert_true(stats.sends < (uint64_t)large_messages * 4, "Small messages should not be sent zero-copy");
+    UnitTestFramework::assert_equals((int)stats.sends, (int)stats.completed, "Every zero-copy send should complete");
+
+    // closing right after the writes: the buffers are held, and the completions still counted, past the close
+    for (int i = 0; i < large_messages; ++i) manager.write(clientInfo, std::string(256 * 1024, 'z'));
+    manager.closeConn(clientInfo);
+    for (int i = 0; i < 200 && stats.completed < stats.sends + large_messages; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stats = manager.zeroCopyStats();
+    }
+    UnitTestFramework::assert_equals((int)stats.sends, (int)stats.completed,
+        "Zero-copy sends still in flight at close should complete");
+
+    // the peer resets the connection while a message is only partly sent zero-copy
+    const int small_buffer = 16 * 1024;
+    const int reuse = 1;
+    const SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, (const char*)&small_buffer, sizeof(small_buffer));
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    makeSockAddr("127.0.0.1", 14491, addr, addr_len);
+    const bool listening = bind(listener, (sockaddr*)&addr, addr_len) == 0 && listen(listener, 1) == 0;
+    TCPConnInfo stalledInfo = listening ? manager.openConnection("127.0.0.1", 14491) : TCPConnInfo{};
+    const SOCKET peer = stalledInfo.sockfd ? accept(listener, nullptr, nullptr) : INVALID_SOCKET;
+    UnitTestFramework::assert_true(peer != INVALID_SOCKET, "Client should connect to the peer that will reset");
+    if (peer != INVALID_SOCKET) {
+        const std::size_t connections = manager.connectionCount();
+        setsockopt(stalledInfo.sockfd, SOL_SOCKET, SO_SNDBUF, (const char*)&small_buffer, sizeof(small_buffer));
+        for (int i = 0; i < large_messages; ++i) manager.write(stalledInfo, std::string(256 * 1024, 'r'));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const struct linger abort{.l_onoff = 1, .l_linger = 0};
+        setsockopt(peer, SOL_SOCKET, SO_LINGER, (const char*)&abort, sizeof(abort));
+        closesocket(peer);
+        manager.write(stalledInfo, std::string(256 * 1024, 'r'));
+
+        for (int i = 0; i < 200 && manager.connectionCount() >= connections; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        UnitTestFramework::assert_true(manager.connectionCount() < connections,
+            "A connection reset during a zero-copy send should be closed");
+        stats = manager.zeroCopyStats();
+        for (int i = 0; i < 200 && stats.completed < stats.sends; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            stats = manager.zeroCopyStats();
+        }
+        UnitTestFramework::assert_equals((int)stats.sends, (int)stats.completed,
+            "Zero-copy sends to a reset peer should complete");
+    }
+    closesocket(listener);
+#endif
+
+    manager.stop();
+}
+
+// Test streaming a file with sendFile: ordering with write(), progress and completion callbacks, short files
+void test_send_file() {
+    std::cout << "\n--- Testing sendFile streaming ---" << std::endl;
+
+    const std::string file_path = "send_file_test.bin";
+    std::string file_content;
+    for (int i = 0; file_content.size() < 3 * 1024 * 1024; ++i) file_content += std::format("line {:07d}\n", i);
+    {
+        std::ofstream file(file_path, std::ios::binary);
+        file << file_content;
+    }
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    UnitTestFramework::assert_true(file != nullptr, "Test file should open");
+    if (!file) return;
+    const int fd = fileno(file);
+
+    TCPConnectionManager manager(2);
+    std::mutex received_mutex;
+    std::string received;
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received.append(data.begin(), data.end());
+            });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14500);
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14500);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0 && clientInfo.sockfd != 0, "sendFile connection should be established");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto client = manager.getConnection(clientInfo).lock();
+
+    std::atomic<int> progress_calls{0};
+    std::atomic<bool> progress_monotonic{true};
+    std::atomic<uint64_t> last_progress{0};
+    std::promise<std::pair<uint64_t, int>> done;
+    const uint64_t part_offset = 1000;
+    const uint64_t part_length = 100000;
+
+    // a whole file and a range of it, between ordinary writes
+    client->write("HEADER\n");
+    client->sendFile(fd, 0, file_content.size(), [&](uint64_t sent, uint64_t total) {
+        ++progress_calls;
+        if (sent < last_progress || sent > total) progress_monotonic = false;
+        last_progress = sent;
+    });
+    client->write("MIDDLE\n");
+    client->sendFile(fd, part_offset, part_length, {}, [&](uint64_t sent, int error) {
+        done.set_value({sent, error});
+    });
+    client->write("TRAILER\n");
+
+    auto done_future = done.get_future();
+    UnitTestFramework::assert_true(done_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready,
+        "sendFile completion should run");
+    const auto [part_sent, part_error] = done_future.get();
+    UnitTestFramework::assert_equals((int)part_length, (int)part_sent, "Completion should report the bytes sent");
+    UnitTestFramework::assert_equals(0, part_error, "Completion should report success");
+    UnitTestFramework::assert_true(progress_calls > 1 && progress_monotonic, "Progress should be reported per slice");
+    UnitTestFramework::assert_equals((int)file_content.size(), (int)last_progress.load(), "Progress should reach the total");
+
+    const std::string expected = "HEADER\n" + file_content + "MIDDLE\n" +
+        file_content.substr(part_offset, part_length) + "TRAILER\n";
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(received_mutex);
+            if (received.size() >= expected.size()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(received == expected, "File data and writes should arrive intact and in order");
+    }
+
+    // a range past the end of the file completes with what there was and an error
+    std::promise<std::pair<uint64_t, int>> short_done;
+    client->sendFile(fd, file_content.size() - 10, 100, {}, [&](uint64_t sent, int error) {
+        short_done.set_value({sent, error});
+    });
+    auto short_future = short_done.get_future();
+    UnitTestFramework::assert_true(short_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready,
+        "Short file completion should run");
+    const auto [short_sent, short_error] = short_future.get();
+    UnitTestFramework::assert_true(short_sent == 10 && short_error != 0, "A file ending early should report an error");
+
+    client.reset();
+    manager.stop();
+    std::fclose(file);
+    std::remove(file_path.c_str());
+}
+
+// Test broadcast fan-out through TCPServer: every client gets every message once, in order; closed clients leave
+void test_broadcast_group() {
+    std::cout << "\n--- Testing broadcast fan-out ---" << std::endl;
+
+    TCPConnectionManager manager(4);
+    TCPServer server(manager);
+    server.start("127.0.0.1", 14510);
+
+    const int num_clients = 20;
+    std::vector<TCPConnInfo> clients;
+    std::vector<std::string> received(num_clients);
+    std::mutex received_mutex;
+    for (int i = 0; i < num_clients; ++i) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14510);
+        if (clientInfo.sockfd == 0) continue;
+        if (auto connPtr = manager.getConnection(clientInfo).lock()) {
+            const std::size_t index = clients.size();
+            connPtr->newDataArrived.connect([&, index](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received[index].append(data.begin(), data.end());
+            });
+        }
+        clients.push_back(clientInfo);
+    }
+    UnitTestFramework::assert_equals(num_clients, (int)clients.size(), "All broadcast clients should connect");
+
+    const auto wait_for = [](const std::function<bool()>& condition) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!condition() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return condition();
+    };
+    UnitTestFramework::assert_true(wait_for([&]() { return server.clientCount() == (std::size_t)num_clients; }),
+        "Server should subscribe every accepted client");
+
+    std::string expected;
+    for (int i = 0; i < 50; ++i) {
+        const std::string message = std::format("B{:03d}\n", i);
+        expected += message;
+        server.broadcast(message);
+    }
+    const bool all_received = wait_for([&]() {
+        std::lock_guard lock(received_mutex);
+        return std::all_of(received.begin(), received.end(), [&](const std::string& r) { return r.size() >= expected.size(); });
+    });
+    {
+        std::lock_guard lock(received_mutex);
+        const bool intact = std::all_of(received.begin(), received.end(), [&](const std::string& r) { return r == expected; });
+        UnitTestFramework::assert_true(all_received && intact, "Every client should receive every broadcast once, in order");
+    }
+
+    // clients going away drop out of the group
+    for (int i = 0; i < 5; ++i) manager.closeConn(clients[i]);
+    UnitTestFramework::assert_true(wait_for([&]() { return server.clientCount() == (std::size_t)num_clients - 5; }),
+        "Closed clients should be unsubscribed");
+
+    // one shared buffer queued directly on a connection
+    auto shared = std::make_shared<const std::string>("shared\n");
+    UnitTestFramework::assert_true(manager.write(clients[5], shared), "Shared buffers should be writable to a connection");
+    UnitTestFramework::assert_true(!manager.write(clients[0], shared), "Writing to a closed connection should fail");
+
+    manager.stop();
+}
+
+// Test slow-consumer policies against a peer that stops reading: queue bound, watermark signals, what arrives
+void test_slow_consumer_policies() {
+    std::cout << "\n--- Testing slow-consumer policies ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    const std::size_t message_size = 16 * 1024;
+    const int num_messages = 64;
+    const WriteBufferLimits base_limits{.highWaterMark = 256 * 1024, .lowWaterMark = 64 * 1024};
+
+    struct Result {
+        bool connected{false};
+        std::size_t queued_after_writes{0};
+        int writes_refused{0};
+        std::vector<int> accepted; // message indexes the policy let through
+        int high_signals{0};
+        int low_signals{0};
+        std::vector<int> received; // message indexes, in arrival order
+        bool intact{true};
+        bool closed{false};
+    };
+
+    const auto run_policy = [&](SlowConsumerPolicy policy, uint16_t port) {
+        Result result;
+        const int small_buffer = 16 * 1024;
+        const int reuse = 1;
+        const SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        setsockopt(listener, SOL_SOCKET, SO_RCVBUF, (const char*)&small_buffer, sizeof(small_buffer));
+        sockaddr_storage addr{};
+        socklen_t addr_len = 0;
+        makeSockAddr("127.0.0.1", port, addr, addr_len);
+        if (bind(listener, (sockaddr*)&addr, addr_len) != 0 || listen(listener, 1) != 0) {
+            closesocket(listener);
+            return result;
+        }
+
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", port);
+        auto conn = manager.getConnection(clientInfo).lock();
+        const SOCKET peer = conn ? accept(listener, nullptr, nullptr) : INVALID_SOCKET;
+        if (!conn || peer == INVALID_SOCKET) {
+            closesocket(listener);
+            return result;
+        }
+        result.connected = true;
+        setsockopt(clientInfo.sockfd, SOL_SOCKET, SO_SNDBUF, (const char*)&small_buffer, sizeof(small_buffer));
+
+        WriteBufferLimits limits = base_limits;
+        limits.policy = policy;
+        conn->setWriteBufferLimits(limits);
+        std::atomic<int> high{0};
+        std::atomic<int> low{0};
+        conn->onWriteBufferHigh.connect([&](std::size_t) { ++high; });
+        conn->onWriteBufferLow.connect([&](std::size_t) { ++low; });
+
+        for (int i = 0; i < num_messages; ++i) {
+            std::string message = std::format("{:05d}", i);
+            message.resize(message_size, 'x');
+            if (manager.write(clientInfo, std::move(message))) result.accepted.push_back(i);
+            else ++result.writes_refused;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        result.queued_after_writes = conn->queuedBytes();
+
+        // the peer wakes up and reads whatever is left for it; a quiet socket only ends the read once the
+        // sender's queue is empty too, however slowly its loop gets to flushing
+        std::string data;
+        std::vector<char> buffer(64 * 1024);
+        const auto read_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (;;) {
+            WSAPOLLFD fd{};
+            fd.fd = peer;
+            fd.events = POLLIN;
+            if (WSAPoll(&fd, 1, 200) <= 0) {
+                if (conn->queuedBytes() > 0 && std::chrono::steady_clock::now() < read_deadline) continue;
+                break;
+            }
+            const int res = recv(peer, buffer.data(), (int)buffer.size(), 0);
+            if (res <= 0) {
+                result.closed = true;
+                break;
+            }
+            data.append(buffer.data(), res);
+        }
+        result.intact = data.size() % message_size == 0;
+        for (std::size_t pos = 0; result.intact && pos < data.size(); pos += message_size) {
+            result.received.push_back(std::stoi(data.substr(pos, 5)));
+            result.intact = data.find_first_not_of('x', pos + 5) >= pos + message_size;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        result.high_signals = high;
+        result.low_signals = low;
+
+        conn.reset();
+        manager.closeConn(clientInfo);
+        closesocket(peer);
+        closesocket(listener);
+        return result;
+    };
+
+    const Result buffered = run_policy(SlowConsumerPolicy::Buffer, 14520);
+    UnitTestFramework::assert_true(buffered.connected, "Buffer: stalled peer should connect");
+    UnitTestFramework::assert_true(buffered.queued_after_writes > base_limits.highWaterMark, "Buffer: queue may grow past the mark");
+    UnitTestFramework::assert_equals(num_messages, (int)buffered.received.size(), "Buffer: every message should arrive");
+    UnitTestFramework::assert_true(buffered.intact, "Buffer: messages should arrive whole");
+    UnitTestFramework::assert_true(buffered.high_signals == 1 && buffered.low_signals == 1, "Buffer: high and low should fire once each");
+
+    const auto stats_before = manager.slowConsumerStats();
+    const Result oldest = run_policy(SlowConsumerPolicy::DropOldest, 14521);
+    UnitTestFramework::assert_true(oldest.queued_after_writes <= base_limits.highWaterMark, "DropOldest: queue should stay under the mark");
+    UnitTestFramework::assert_true(oldest.intact && !oldest.received.empty() && oldest.received.size() < (std::size_t)num_messages,
+        "DropOldest: some whole messages should be dropped");
+    UnitTestFramework::assert_true(std::is_sorted(oldest.received.begin(), oldest.received.end()) &&
+        !oldest.received.empty() && oldest.received.back() == num_messages - 1, "DropOldest: the newest message should arrive");
+    UnitTestFramework::assert_true(oldest.high_signals == 1 && oldest.low_signals == 1, "DropOldest: high and low should fire once each");
+    UnitTestFramework::assert_true(manager.slowConsumerStats().droppedOldestBytes > stats_before.droppedOldestBytes, "DropOldest: dropped bytes counted");
+
+    const Result newest = run_policy(SlowConsumerPolicy::DropNewest, 14522);
+    UnitTestFramework::assert_true(newest.queued_after_writes <= base_limits.highWaterMark, "DropNewest: queue should stay under the mark");
+    UnitTestFramework::assert_true(newest.writes_refused > 0 && newest.writes_refused + (int)newest.received.size() == num_messages,
+        "DropNewest: refused writes should be exactly the missing messages");
+    // the loop may drain some of the queue between refusals, so later writes can get in again; whatever got in
+    // arrives, in order, starting with the oldest
+    UnitTestFramework::assert_true(newest.intact && !newest.accepted.empty() && newest.accepted.front() == 0 &&
+        newest.received == newest.accepted, "DropNewest: the oldest messages should arrive, in order");
+    UnitTestFramework::assert_equals((int)(newest.writes_refused * message_size), (int)manager.slowConsumerStats().droppedNewestBytes,
+        "DropNewest: dropped bytes counted");
+
+    const Result conflated = run_policy(SlowConsumerPolicy::Conflate, 14523);
+    UnitTestFramework::assert_true(conflated.intact && !conflated.received.empty() && conflated.received.back() == num_messages - 1,
+        "Conflate: the latest message should arrive");
+    UnitTestFramework::assert_true(conflated.received.size() < oldest.received.size() || conflated.received.size() < (std::size_t)num_messages / 2,
+        "Conflate: queued messages should collapse to the newest");
+    UnitTestFramework::assert_true(manager.slowConsumerStats().conflatedBytes > 0, "Conflate: conflated bytes counted");
+
+    const Result disconnected = run_policy(SlowConsumerPolicy::Disconnect, 14524);
+    UnitTestFramework::assert_true(disconnected.closed, "Disconnect: the slow peer should be disconnected");
+    UnitTestFramework::assert_true(disconnected.writes_refused > 0, "Disconnect: writes after the mark should be refused");
+    UnitTestFramework::assert_equals(1, (int)manager.slowConsumerStats().disconnects, "Disconnect: disconnect counted");
+
+    manager.stop();
+}
+
+// Test that the receive path reuses pooled buffers instead of allocating
+void test_recv_buffer_pool() {
+    std::cout << "\n--- Testing pooled receive buffers ---" << std::endl;
+
+    // handles share the bytes; the block goes back to the pool with the last one
+    {
+        RecvBuffer first = RecvBufferPool::acquire();
+        std::memcpy(first.writableData(), "pooled", 6);
+        first.resize(6);
+        RecvBuffer second = first;
+        const std::vector<char> copy(second);
+        UnitTestFramework::assert_true(second.data() == first.data() && second.view() == "pooled",
+            "Copied handles should share one buffer");
+        UnitTestFramework::assert_true(std::string(copy.begin(), copy.end()) == "pooled",
+            "Buffers should convert to std::vector<char> on request");
+    }
+
+    TCPConnectionManager manager(1);
+    std::atomic<std::size_t> bytes_received{0};
+    std::atomic<bool> counting{false};
+    std::mutex kept_mutex;
+    RecvBuffer kept;
+    std::string kept_copy;
+
+    manager.newConnection.connect([&](const TCPConnInfo& conn) {
+        if (auto connPtr = manager.getConnection(conn).lock()) {
+            connPtr->newDataArrived.connect([&](const RecvBuffer& data) {
+                t_count_allocations = counting.load();
+                {
+                    std::lock_guard lock(kept_mutex);
+                    if (kept.empty()) {
+                        kept = data;
+                        kept_copy.assign(data.begin(), data.end());
+                    }
+                }
+                bytes_received += data.size();
+            });
+        }
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14530);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for receive buffer test");
+
+    const SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    makeSockAddr("127.0.0.1", 14530, addr, addr_len);
+    const bool connected = connect(client, (sockaddr*)&addr, addr_len) == 0;
+    UnitTestFramework::assert_true(connected, "Raw client should connect for receive buffer test");
+    if (!connected) {
+        closesocket(client);
+        manager.stop();
+        return;
+    }
+
+    std::size_t bytes_sent = 0;
+    const std::string chunk(100, 'r');
+    auto send_and_wait = [&](int messages) {
+        for (int i = 0; i < messages; ++i) {
+            if (send(client, chunk.data(), (int)chunk.size(), 0) == (int)chunk.size()) bytes_sent += chunk.size();
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (bytes_received < bytes_sent && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    };
+
+    // warm up the pool and the signal, then count every allocation on the loop thread
+    send_and_wait(1000);
+    counting = true;
+    send_and_wait(1);
+    const std::size_t allocations_before = g_allocations.load();
+    const uint64_t blocks_before = RecvBufferPool::stats().allocations;
+    send_and_wait(5000);
+    const std::size_t allocations = g_allocations.load() - allocations_before;
+    counting = false;
+    send_and_wait(1);
+
+    UnitTestFramework::assert_equals((int)bytes_sent, (int)bytes_received.load(), "Every byte should be received");
+    UnitTestFramework::assert_equals(0, (int)allocations, "The receive path should not allocate in steady state");
+    UnitTestFramework::assert_true(RecvBufferPool::stats().allocations == blocks_before,
+        "Receive buffers should come from the pool");
+    {
+        std::lock_guard lock(kept_mutex);
+        UnitTestFramework::assert_true(!kept.empty() && std::string(kept.view()) == kept_copy,
+            "A buffer kept by a slot should not be reused while held");
+    }
+
+    closesocket(client);
+    manager.stop();
+}
+
+// Test EventSignal and deferred emission
+void test_event_signal() {
+    std::cout << "\n--- Testing EventSignal ---" << std::endl;
+
+    EventSignal<int> signal;
+    UnitTestFramework::assert_true(signal.empty(), "New signal should have no slots");
+
+    int first_total = 0;
+    int second_total = 0;
+    EventConnection first = signal.connect([&](int value) { first_total += value; });
+    {
+        ScopedEventConnection second = signal.connect([&](int value) { second_total += value; });
+        signal(1);
+        UnitTestFramework::assert_equals(2, (int)signal.slotCount(), "Both slots should be connected");
+    }
+    signal(10);
+    UnitTestFramework::assert_equals(11, first_total, "First slot should see both emissions");
+    UnitTestFramework::assert_equals(1, second_total, "Scoped slot should be gone after its scope");
+
+    first.disconnect();
+    signal(100);
+    UnitTestFramework::assert_true(!first.connected() && signal.empty() && first_total == 11,
+        "Disconnected slot should not be called");
+
+    // the first slot is stored in the slot list: one allocation, and its handle keeps working once others join
+    EventSignal<int> single;
+    int single_total = 0;
+    int joined_total = 0;
+    t_count_allocations = true;
+    const std::size_t before_connect = g_allocations.load();
+    EventConnection only = single.connect([&](int value) { single_total += value; });
+    const std::size_t connect_allocations = g_allocations.load() - before_connect;
+    t_count_allocations = false;
+    UnitTestFramework::assert_equals(1, (int)connect_allocations, "The first slot should share the list's allocation");
+    single(1);
+    EventConnection joined = single.connect([&](int value) { joined_total += value; });
+    single(10);
+    only.disconnect();
+    single(100);
+    UnitTestFramework::assert_true(single_total == 11 && joined_total == 110 && !only.connected() && joined.connected() &&
+                                   single.slotCount() == 1,
+                                   "The inline first slot should be reachable and disconnectable from later lists");
+
+    // connected during an emission: not called by it; disconnected during it: skipped
+    int late_calls = 0;
+    int victim_calls = 0;
+    EventConnection victim;
+    signal.connect([&](int) {
+        signal.connect([&](int) { ++late_calls; });
+        victim.disconnect();
+    });
+    victim = signal.connect([&](int) { ++victim_calls; });
+    signal(1);
+    UnitTestFramework::assert_true(late_calls == 0 && victim_calls == 0,
+        "Slots connected or disconnected during an emission should not run in it");
+    signal(1);
+    UnitTestFramework::assert_equals(1, late_calls, "Slot connected during an emission should run in the next one");
+
+    // concurrent emission and reconnection
+    EventSignal<int> busy;
+    std::atomic<int> calls{0};
+    busy.connect([&](int) { ++calls; });
+    std::atomic<bool> done{false};
+    std::thread emitter([&]() { while (!done) busy(1); });
+    while (calls == 0) std::this_thread::yield();
+    for (int i = 0; i < 2000; ++i) busy.connect([&](int) {}).disconnect();
+    done = true;
+    emitter.join();
+    UnitTestFramework::assert_true(calls > 0 && busy.slotCount() == 1, "Reconnecting during emissions should be safe");
+}
+
+// Test connection lookups racing with connections being opened and closed
+void test_connection_registry() {
+    std::cout << "\n--- Testing lock-free connection registry ---" << std::endl;
+
+    TCPConnectionManager manager(2);
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14540);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for registry test");
+
+    std::mutex clients_mutex;
+    std::vector<TCPConnInfo> clients;
+    for (int i = 0; i < 16; ++i) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14540);
+        if (clientInfo.sockfd) clients.push_back(clientInfo);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // the listener, 16 clients and the 16 connections accepted for them
+    UnitTestFramework::assert_equals(33, (int)manager.connectionCount(), "Every connection should be registered");
+
+    std::atomic<bool> done{false};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                std::vector<TCPConnInfo> current;
+                {
+                    std::lock_guard lock(clients_mutex);
+                    current = clients;
+                }
+                for (const auto& client : current) {
+                    try {
+                        auto conn = manager.getConnection(client).lock();
+                        if (conn && conn->connInfo().sockfd != client.sockfd) ++mismatches;
+                        manager.write(client, "x");
+                    } catch (const std::out_of_range&) {
+                        // closed since the copy was taken
+                    }
+                }
+            }
+        });
+    }
+
+    // replace connections while the readers look them up
+    int reopened = 0;
+    for (int i = 0; i < 200; ++i) {
+        TCPConnInfo victim;
+        {
+            std::lock_guard lock(clients_mutex);
+            victim = clients[i % clients.size()];
+        }
+        manager.closeConn(victim);
+        TCPConnInfo replacement = manager.openConnection("127.0.0.1", 14540);
+        if (!replacement.sockfd) continue;
+        ++reopened;
+        std::lock_guard lock(clients_mutex);
+        clients[i % clients.size()] = replacement;
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+
+    UnitTestFramework::assert_equals(0, mismatches.load(), "Lookups should never return another socket's connection");
+    UnitTestFramework::assert_equals(200, reopened, "Every replacement connection should open");
+    bool closed_throws = false;
+    try {
+        manager.getConnection(TCPConnInfo{.sockfd = (SOCKET)999999, .peerIP = {}, .peerPort = 0}).lock();
+    } catch (const std::out_of_range&) {
+        closed_throws = true;
+    }
+    UnitTestFramework::assert_true(closed_throws, "Unknown sockets should throw");
+
+    manager.stop();
+    UnitTestFramework::assert_equals(0, (int)manager.connectionCount(), "Stop should empty the registry");
+}
+
+void test_connection_handles() {
+    std::cout << "\n--- Testing generation-tagged connection handles ---" << std::endl;
+
+    const IPAddress v4 = "10.0.0.1";
+    const IPAddress v6 = "::1";
+    UnitTestFramework::assert_true(v4.family() == AF_INET && v4.toString() == "10.0.0.1", "IPv4 should round-trip");
+    UnitTestFramework::assert_true(v6.family() == AF_INET6 && v6.toString() == "::1", "IPv6 should round-trip");
+    UnitTestFramework::assert_true(IPAddress("not an address").empty(), "Unparsable text should give an empty address");
+    UnitTestFramework::assert_true(std::is_trivially_copyable_v<TCPConnInfo>, "TCPConnInfo should be trivially copyable");
+
+    const ConnHandle packed((SOCKET)1234, 0xdeadbeef);
+    UnitTestFramework::assert_true(packed.sockfd() == 1234 && packed.generation() == 0xdeadbeef,
+                                   "Handles should pack socket and generation");
+    UnitTestFramework::assert_true(sizeof(ConnHandle) == 8, "Handles should be 64 bits");
+
+    TCPConnectionManager manager(1);
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14550);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0 && serverInfo.generation != 0,
+                                   "Listeners should be registered with a generation");
+
+    std::mutex closed_mutex;
+    std::vector<TCPConnInfo> closed;
+    auto closedConnection = manager.connectionClosed.connect([&](TCPConnInfo info) {
+        std::lock_guard lock(closed_mutex);
+        closed.push_back(info);
+    });
+
+    const TCPConnInfo first = manager.openConnection("127.0.0.1", 14550);
+    UnitTestFramework::assert_true(first.sockfd != 0 && first.generation != 0, "Clients should get a generation");
+    UnitTestFramework::assert_true(first.peerIP == "127.0.0.1" && first.peerPort == 14550,
+                                   "The peer endpoint should be kept");
+
+    // a hand-built info without a generation still reaches the connection
+    TCPConnInfo byFd{.sockfd = first.sockfd, .peerIP = {}, .peerPort = 0};
+    UnitTestFramework::assert_true(manager.getConnection(byFd).lock() != nullptr, "Generation 0 should match any");
+
+    manager.closeConn(first);
+    {
+        // the accepted side may notice the close, and report it, before this one
+        std::lock_guard lock(closed_mutex);
+        const bool reported = std::any_of(closed.begin(), closed.end(),
+                                          [&](const TCPConnInfo& info) { return info.handle() == first.handle(); });
+        UnitTestFramework::assert_true(reported, "connectionClosed should carry the registered handle");
+    }
+
+    // wait for the descriptor to be closed on the loop, then open connections until one reuses it
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    TCPConnInfo reused;
+    std::vector<TCPConnInfo> others;
+    for (int i = 0; i < 8 && !reused.sockfd; ++i) {
+        const TCPConnInfo next = manager.openConnection("127.0.0.1", 14550);
+        if (next.sockfd == first.sockfd) reused = next;
+        else others.push_back(next);
+    }
+    UnitTestFramework::assert_true(reused.sockfd != 0, "The closed descriptor should be reused");
+    if (reused.sockfd) {
+        UnitTestFramework::assert_true(reused.generation != first.generation, "Reuse should bump the generation");
+        UnitTestFramework::assert_true(!manager.write(first, "stale"), "Writes on a stale handle should fail");
+        bool stale_throws = false;
+        try {
+            manager.getConnection(first).lock();
+        } catch (const std::out_of_range&) {
+            stale_throws = true;
+        }
+        UnitTestFramework::assert_true(stale_throws, "Looking up a stale handle should throw");
+
+        manager.closeConn(first);
+        UnitTestFramework::assert_true(manager.write(reused, "fresh"),
+                                       "Closing a stale handle should leave the new connection open");
+    }
+
+    closedConnection.disconnect();
+    manager.stop();
+}
+
+struct RetireProbe : EventLoop::Retirable {
+    int producer{0};
+    int index{0};
+    std::function<void(RetireProbe&)> onRetired;
+
+    void retired() override { onRetired(*this); }
+};
+
+void test_retire_queue() {
+    std::cout << "\n--- Testing event loop retire queue ---" << std::endl;
+
+    ReactorLoop loop;
+    loop.start();
+    std::thread::id loop_thread;
+    loop.post([&]() { loop_thread = std::this_thread::get_id(); });
+
+    const int num_producers = 4;
+    const int per_producer = 500;
+    std::vector<std::vector<RetireProbe>> probes(num_producers, std::vector<RetireProbe>(per_producer));
+    std::atomic<int> retired{0};
+    std::atomic<int> wrong_thread{0};
+    std::vector<int> last_index(num_producers, -1);
+    int out_of_order = 0; // only touched by the loop thread
+    for (int p = 0; p < num_producers; ++p) {
+        for (int i = 0; i < per_producer; ++i) {
+            probes[p][i].producer = p;
+            probes[p][i].index = i;
+            probes[p][i].onRetired = [&](RetireProbe& probe) {
+                if (std::this_thread::get_id() != loop_thread) ++wrong_thread;
+                if (probe.index <= last_index[probe.producer]) ++out_of_order;
+                last_index[probe.producer] = probe.index;
+                ++retired;
+            };
+        }
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (auto& probe : probes[p]) loop.retire(INVALID_SOCKET, probe);
+        });
+    }
+    for (auto& producer : producers) producer.join();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (retired < num_producers * per_producer && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    UnitTestFramework::assert_equals(num_producers * per_producer, retired.load(), "Every item should be retired once");
+    UnitTestFramework::assert_equals(0, wrong_thread.load(), "Items should be retired on the loop thread");
+    UnitTestFramework::assert_equals(0, out_of_order, "Each producer's items should be retired in order");
+
+    // a task posted before a retire runs first, also when a task of the running batch posts both
+    std::atomic<bool> posted_ran{false};
+    std::atomic<bool> ran_before_retire{false};
+    std::atomic<bool> ordered_retired{false};
+    RetireProbe ordered;
+    ordered.onRetired = [&](RetireProbe&) {
+        ran_before_retire = posted_ran.load();
+        ordered_retired = true;
+    };
+    loop.post([&]() {
+        loop.post([&]() { posted_ran = true; });
+        loop.retire(INVALID_SOCKET, ordered);
+    });
+    const auto ordered_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!ordered_retired && std::chrono::steady_clock::now() < ordered_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    UnitTestFramework::assert_true(ordered_retired.load() && ran_before_retire.load(),
+                                   "Tasks posted before a retire should run before it");
+
+    loop.stop();
+    bool ran_inline = false;
+    RetireProbe late;
+    late.onRetired = [&](RetireProbe&) { ran_inline = true; };
+    loop.retire(INVALID_SOCKET, late);
+    UnitTestFramework::assert_true(ran_inline, "Retiring on a stopped loop should run on the caller");
+
+    // many threads closing connections at once: each is closed exactly once and nothing is left behind
+    TCPConnectionManager manager(2);
+    std::atomic<int> closed{0};
+    manager.connectionClosed.connect([&](TCPConnInfo) { ++closed; });
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14560);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for teardown test");
+
+    const int num_clients = 64;
+    std::vector<TCPConnInfo> clients;
+    for (int i = 0; i < num_clients; ++i) {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14560);
+        if (clientInfo.sockfd) clients.push_back(clientInfo);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<std::thread> closers;
+    for (int t = 0; t < 4; ++t) {
+        // every thread closes every client; only one close per connection may win
+        closers.emplace_back([&]() {
+            for (const auto& client : clients) manager.closeConn(client);
+        });
+    }
+    for (auto& closer : closers) closer.join();
+
+    const auto close_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (manager.connectionCount() > 1 && std::chrono::steady_clock::now() < close_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    UnitTestFramework::assert_equals(num_clients, (int)clients.size(), "All clients should connect");
+    UnitTestFramework::assert_equals(1, (int)manager.connectionCount(), "Only the listener should be left");
+    UnitTestFramework::assert_equals(2 * num_clients, closed.load(),
+                                     "Both ends of every connection should close exactly once");
+
+    // connections closed right after they were opened: the close must not overtake the socket's registration
+    closed = 0;
+    std::atomic<int> churned{0};
+    std::vector<std::thread> churners;
+    for (int t = 0; t < 4; ++t) {
+        churners.emplace_back([&]() {
+            for (int i = 0; i < 200; ++i) {
+                const TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14560);
+                if (!clientInfo.sockfd) continue;
+                ++churned;
+                manager.closeConn(clientInfo);
+            }
+        });
+    }
+    for (auto& churner : churners) churner.join();
+
+    const auto churn_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((manager.connectionCount() > 1 || closed < 2 * churned) &&
+           std::chrono::steady_clock::now() < churn_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    UnitTestFramework::assert_equals(800, churned.load(), "Every churned client should connect");
+    UnitTestFramework::assert_equals(1, (int)manager.connectionCount(),
+                                     "Connections closed right after connecting should not leak");
+    UnitTestFramework::assert_equals(2 * churned.load(), closed.load(),
+                                     "Both ends of every churned connection should close exactly once");
+
+    manager.stop();
+}
+
+RecvBuffer make_recv_buffer(std::string_view bytes) {
+    RecvBuffer buffer = RecvBufferPool::acquire();
+    std::memcpy(buffer.writableData(), bytes.data(), bytes.size());
+    buffer.resize(bytes.size());
+    return buffer;
+}
+
+void test_frame_codec() {
+    std::cout << "\n--- Testing length-prefixed frame codec ---" << std::endl;
+
+    std::vector<std::string> payloads = {"", "a", "hello", std::string(1000, 'x'), std::string(20000, 'y')};
+    std::string stream;
+    for (const auto& payload : payloads) stream += FrameCodec::encode(payload);
+
+    // every split of the stream into two buffers, and the stream fed byte by byte, gives the same frames
+    bool splits_ok = true;
+    for (std::size_t cut = 0; cut <= 1100 && splits_ok; ++cut) {
+        FrameDecoder decoder(1 << 20);
+        std::vector<std::string> frames;
+        auto collect = [&](const Frame& frame) { frames.emplace_back(frame.view()); };
+        std::string_view rest(stream);
+        while (!rest.empty()) {
+            const std::size_t n = std::min({rest.size(), cut ? cut : rest.size(), RecvBufferPool::blockSize});
+            decoder.feed(make_recv_buffer(rest.substr(0, n)), collect);
+            rest.remove_prefix(n);
+        }
+        splits_ok = frames == payloads;
+    }
+    UnitTestFramework::assert_true(splits_ok, "Frames should survive any split of the stream");
+
+    FrameDecoder decoder(1 << 20);
+    std::vector<Frame> kept;
+    decoder.feed(make_recv_buffer(FrameCodec::encode("one") + FrameCodec::encode("two")),
+                 [&](const Frame& frame) { kept.push_back(frame); });
+    UnitTestFramework::assert_true(kept.size() == 2 && !kept[0].assembled() && !kept[1].assembled(),
+                                   "Frames within one buffer should be views into it");
+    UnitTestFramework::assert_true(kept[0].view() == "one" && kept[1].view() == "two",
+                                   "Kept frames should stay intact after the call");
+
+    const std::string big = FrameCodec::encode(std::string(100000, 'z'));
+    std::vector<Frame> spanning;
+    for (std::size_t pos = 0; pos < big.size(); pos += RecvBufferPool::blockSize) {
+        decoder.feed(make_recv_buffer(std::string_view(big).substr(pos, RecvBufferPool::blockSize)),
+                     [&](const Frame& frame) { spanning.push_back(frame); });
+    }
+    UnitTestFramework::assert_true(spanning.size() == 1 && spanning[0].assembled() && spanning[0].size() == 100000 &&
+                                       spanning[0].view().find_first_not_of('z') == std::string_view::npos,
+                                   "A frame larger than a buffer should be assembled");
+
+    FrameDecoder limited(16);
+    int oversized_frames = 0;
+    const bool accepted = limited.feed(make_recv_buffer(FrameCodec::encode(std::string(17, 'o'))),
+                                       [&](const Frame&) { ++oversized_frames; });
+    UnitTestFramework::assert_true(!accepted && limited.failed() && oversized_frames == 0,
+                                   "Frames above the limit should fail the decoder");
+
+    // end to end: large frames split by TCP, and a peer announcing a frame above the limit
+    TCPConnectionManager manager(1);
+    FrameCodec codec(manager, FrameCodecOptions{.maxFrameSize = 4 * 1024 * 1024});
+    std::mutex frames_mutex;
+    std::vector<std::string> received;
+    std::atomic<int> closed{0};
+    manager.newConnection.connect([&](const TCPConnInfo& conn) { codec.attach(conn); });
+    manager.connectionClosed.connect([&](TCPConnInfo) { ++closed; });
+    codec.frameArrived.connect([&](const TCPConnInfo&, const Frame& frame) {
+        std::lock_guard lock(frames_mutex);
+        received.emplace_back(frame.view());
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14570);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for frame codec test");
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14570);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<std::string> sent;
+    for (std::size_t size : {10, 3 * 1024 * 1024, 0, 70000, 5}) {
+        sent.push_back(std::string(size, char('a' + sent.size())));
+        codec.send(clientInfo, sent.back());
+    }
+    UnitTestFramework::assert_true(!codec.send(clientInfo, std::string(5 * 1024 * 1024, 'x')),
+                                   "Sending a frame above the limit should fail");
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(frames_mutex);
+            if (received.size() >= sent.size()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    {
+        std::lock_guard lock(frames_mutex);
+        UnitTestFramework::assert_true(received == sent, "Large frames should arrive whole and in order");
+    }
+    UnitTestFramework::assert_true(codec.framesAssembled() >= 2, "Frames spanning buffers should be assembled");
+
+    // a raw length prefix above the limit closes the connection
+    manager.write(clientInfo, FrameCodec::encode(std::string(5 * 1024 * 1024, 'x')));
+    const auto close_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (closed < 2 && std::chrono::steady_clock::now() < close_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    UnitTestFramework::assert_equals(2, closed.load(), "An oversized frame should close the connection");
+    UnitTestFramework::assert_equals(0, (int)codec.attachedCount(), "Closed connections should detach");
+
+    manager.stop();
+}
+
+void test_delimiter_codec() {
+    std::cout << "\n--- Testing delimiter framing ---" << std::endl;
+
+    // every kernel finds the same delimiters as a byte-by-byte scan, at any length and alignment
+    std::mt19937 rng(42);
+    std::string noise(300, '\0');
+    for (auto& c : noise) c = "ab\n"[rng() % 3];
+    bool kernels_agree = true;
+    for (auto kernel : {DelimiterScanner::Kernel::Scalar, DelimiterScanner::Kernel::Sse2, DelimiterScanner::Kernel::Avx2}) {
+        if (!simdKernelAvailable(kernel)) continue;
+        const DelimiterScanner scanner('\n', kernel);
+        for (std::size_t offset = 0; offset < 8; ++offset) {
+            for (std::size_t size = 0; size + offset <= noise.size(); ++size) {
+                const std::string_view data(noise.data() + offset, size);
+                std::vector<std::size_t> expected, found;
+                for (std::size_t i = 0; i < size; ++i) {
+                    if (data[i] == '\n') expected.push_back(i);
+                }
+                scanner.findAll(data, found);
+                kernels_agree = kernels_agree && found == expected;
+            }
+        }
+    }
+    UnitTestFramework::assert_true(kernels_agree, std::format("Delimiter kernels should agree with a plain scan (best: {})",
+        simdKernelName(bestSimdKernel())));
+
+    std::vector<std::string> lines = {"", "first", "second line", std::string(500, 'x'), "", "last"};
+    std::string stream;
+    for (const auto& line : lines) stream += line + "\r\n";
+
+    // every split of the stream gives the same records, however many reads a record spans
+    bool splits_ok = true;
+    for (std::size_t cut = 1; cut <= stream.size() && splits_ok; ++cut) {
+        DelimiterDecoder decoder(DelimiterCodecOptions{.trimCarriageReturn = true});
+        std::vector<std::string> records;
+        for (std::size_t pos = 0; pos < stream.size(); pos += cut) {
+            decoder.feed(std::string_view(stream).substr(pos, cut), [&](std::span<const std::string_view> batch) {
+                records.insert(records.end(), batch.begin(), batch.end());
+            });
+        }
+        splits_ok = records == lines && decoder.pendingBytes() == 0;
+    }
+    UnitTestFramework::assert_true(splits_ok, "Records should survive any split of the stream");
+
+    DelimiterDecoder pipes(DelimiterCodecOptions{.delimiter = '|'});
+    int batches = 0;
+    std::vector<std::string> pipe_records;
+    pipes.feed("a|bb|cc", [&](std::span<const std::string_view> batch) {
+        ++batches;
+        pipe_records.insert(pipe_records.end(), batch.begin(), batch.end());
+    });
+    UnitTestFramework::assert_true(batches == 1 && pipe_records == std::vector<std::string>{"a", "bb"} &&
+                                       pipes.pendingBytes() == 2,
+                                   "One read should deliver one batch and keep the unterminated record");
+
+    DelimiterDecoder limited(DelimiterCodecOptions{.maxRecordSize = 8});
+    const bool within = limited.feed("12345", [](std::span<const std::string_view>) {});
+    const bool beyond = limited.feed("6789", [](std::span<const std::string_view>) {});
+    UnitTestFramework::assert_true(within && !beyond && limited.failed(), "Records above the limit should fail the decoder");
+
+    // end to end: lines written in batches arrive in order; an endless line closes the connection
+    TCPConnectionManager manager(1);
+    DelimiterCodec codec(manager, DelimiterCodecOptions{.maxRecordSize = 1024});
+    std::mutex records_mutex;
+    std::vector<std::string> received;
+    std::atomic<int> closed{0};
+    manager.newConnection.connect([&](const TCPConnInfo& conn) { codec.attach(conn); });
+    manager.connectionClosed.connect([&](TCPConnInfo) { ++closed; });
+    codec.recordsArrived.connect([&](const TCPConnInfo&, std::span<const std::string_view> batch) {
+        std::lock_guard lock(records_mutex);
+        received.insert(received.end(), batch.begin(), batch.end());
+    });
+
+    TCPConnInfo serverInfo = manager.openListenSocket("127.0.0.1", 14580);
+    UnitTestFramework::assert_true(serverInfo.sockfd != 0, "Server should be created for delimiter codec test");
+    TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14580);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const int num_lines = 5000;
+    std::vector<std::string> sent;
+    for (int i = 0; i < num_lines; ++i) sent.push_back(std::format("line {} {}", i, std::string(i % 200, '.')));
+    for (int i = 0; i < num_lines; i += 100) {
+        std::vector<std::string_view> batch(sent.begin() + i, sent.begin() + i + 100);
+        codec.send(clientInfo, batch);
+    }
+    UnitTestFramework::assert_true(!codec.send(clientInfo, "two\nlines"), "Records containing the delimiter should be refused");
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(records_mutex);
+            if (received.size() >= sent.size()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    {
+        std::lock_guard lock(records_mutex);
+        UnitTestFramework::assert_true(received == sent, "Lines should arrive whole and in order");
+    }
+    UnitTestFramework::assert_true(codec.batchesDelivered() < codec.recordsDelivered(),
+                                   "Records should be delivered in batches");
+
+    manager.write(clientInfo, std::string(4096, 'x'));
+    const auto close_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (closed < 2 && std::chrono::steady_clock::now() < close_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    UnitTestFramework::assert_equals(2, closed.load(), "An overlong record should close the connection");
+    UnitTestFramework::assert_equals(0, (int)codec.attachedCount(), "Closed connections should detach");
+
+    manager.stop();
+}
+
+void test_http_server() {
+    std::cout << "\n--- Testing HTTP/1.1 parser, router and server ---" << std::endl;
+
+    struct Parsed {
+        std::string method, path, query, host, body;
+        bool keepAlive;
+    };
+    auto collect = [](std::vector<Parsed>& out) {
+        return [&out](const HttpRequest& request) {
+            out.push_back({std::string(request.method), std::string(request.path), std::string(request.query),
+                           std::string(request.header("host")), std::string(request.body), request.keepAlive});
+        };
+    };
+
+    // pipelined requests with a fixed-length and a chunked body, split at every possible byte
+    const std::string pipeline =
+        "GET /a?x=1 HTTP/1.1\r\nHost: one\r\n\r\n"
+        "POST /b HTTP/1.1\r\nHost: two\r\nContent-Length: 5\r\n\r\nhello"
+        "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3;ext=1\r\nabc\r\n2\r\nde\r\n0\r\nTrailer: x\r\n\r\n"
+        "GET /d HTTP/1.0\r\n\r\n";
+    bool splits_ok = true;
+    for (std::size_t cut = 0; cut < pipeline.size() && splits_ok; ++cut) {
+        HttpRequestParser parser;
+        std::vector<Parsed> requests;
+        parser.feed(std::string_view(pipeline).substr(0, cut), collect(requests));
+        parser.feed(std::string_view(pipeline).substr(cut), collect(requests));
+        splits_ok = requests.size() == 4 && requests[0].path == "/a" && requests[0].query == "x=1" &&
+                    requests[0].host == "one" && requests[1].body == "hello" && requests[2].body == "abcde" &&
+                    requests[2].method == "POST" && requests[3].path == "/d" && requests[0].keepAlive &&
+                    !requests[3].keepAlive && parser.pendingBytes() == 0;
+    }
+    UnitTestFramework::assert_true(splits_ok, "Pipelined requests should parse the same however they are split");
+
+    HttpRequestParser in_place;
+    const std::string single = "GET /view HTTP/1.1\r\nHost: here\r\n\r\n";
+    bool views_in_buffer = false;
+    in_place.feed(single, [&](const HttpRequest& request) {
+        views_in_buffer = request.path.data() >= single.data() && request.path.data() < single.data() + single.size() &&
+                          request.header("HOST").data() > single.data();
+    });
+    UnitTestFramework::assert_true(views_in_buffer, "Requests within one buffer should be parsed in place");
+
+    auto error_for = [](std::string_view input, HttpParserLimits limits = {}) {
+        HttpRequestParser parser(limits);
+        parser.feed(input, [](const HttpRequest&) {});
+        return parser.errorStatus();
+    };
+    UnitTestFramework::assert_equals(400, error_for("GARBAGE\r\n\r\n"), "A malformed request line is a 400");
+    UnitTestFramework::assert_equals(400, error_for("GET / HTTP/1.1\r\nBad Header: x\r\n\r\n"),
+                                     "Whitespace in a header name is a 400");
+    UnitTestFramework::assert_equals(400, error_for("POST / HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n"),
+                                     "Content-Length together with chunked is a 400");
+    UnitTestFramework::assert_equals(505, error_for("GET / HTTP/2.0\r\n\r\n"), "Other HTTP versions are a 505");
+    UnitTestFramework::assert_equals(501, error_for("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n"),
+                                     "Unknown transfer codings are a 501");
+    UnitTestFramework::assert_equals(413, error_for("POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\n", {.maxBodySize = 10}),
+                                     "Bodies above the limit are a 413");
+    UnitTestFramework::assert_equals(431, error_for("GET / HTTP/1.1\r\nX: " + std::string(200, 'x'), {.maxHeaderSize = 100}),
+                                     "Header blocks above the limit are a 431");
+
+    HttpRouter router;
+    auto reply = [](std::string text) {
+        return [text](const HttpRequest&, HttpResponse& response) { response.body = text; };
+    };
+    router.add("GET", "/", reply("root"));
+    router.add("GET", "/users", reply("users"));
+    router.add("POST", "/users", reply("create"));
+    router.add("GET", "/static/*", reply("static"));
+    router.add("GET", "/static/special", reply("special"));
+    router.add("", "/any", reply("any"));
+    router.add("POST", "/echo", [](const HttpRequest& request, HttpResponse& response) {
+        response.setHeader("Content-Type", "text/plain");
+        response.body = request.body;
+    });
+    router.add("GET", "/throw", [](const HttpRequest&, HttpResponse&) { throw std::runtime_error("handler failure"); });
+
+    HttpRouter lookup = router;
+    lookup.compile();
+    auto routed = [&](std::string_view method, std::string_view path) {
+        const auto match = lookup.find(method, path);
+        if (!match.handler) return std::string(match.pathFound ? "405" : "404");
+        HttpResponse response;
+        (*match.handler)(HttpRequest{}, response);
+        return response.body;
+    };
+    UnitTestFramework::assert_true(routed("GET", "/") == "root" && routed("GET", "/users") == "users" &&
+                                       routed("POST", "/users") == "create" && routed("HEAD", "/users") == "users",
+                                   "Exact routes should resolve by method, HEAD falling back to GET");
+    UnitTestFramework::assert_true(routed("GET", "/static/css/site.css") == "static" &&
+                                       routed("GET", "/static/special") == "special" &&
+                                       routed("GET", "/static/specialist") == "static",
+                                   "Prefix routes should match below them, exact routes first");
+    UnitTestFramework::assert_true(routed("DELETE", "/any") == "any" && routed("DELETE", "/users") == "405" &&
+                                       routed("GET", "/user") == "404" && routed("GET", "/usersx") == "404",
+                                   "Unknown methods should be a 405 and unknown paths a 404");
+
+    // end to end over loopback
+    TCPConnectionManager manager(1);
+    HttpServer server(manager, router);
+    UnitTestFramework::assert_true(server.start("127.0.0.1", 14590), "HTTP server should start");
+
+    std::mutex received_mutex;
+    std::string received;
+    std::atomic<int> closed{0};
+    auto open_client = [&]() {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14590);
+        if (auto conn = manager.getConnection(clientInfo).lock()) {
+            conn->newDataArrived.connect([&](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received.append(data.view());
+            });
+        }
+        return clientInfo;
+    };
+    auto wait_for = [&](auto&& done) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard lock(received_mutex);
+                if (done()) return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    };
+    auto count = [&](std::string_view needle) {
+        std::size_t n = 0;
+        for (std::size_t pos = received.find(needle); pos != std::string::npos; pos = received.find(needle, pos + 1)) ++n;
+        return n;
+    };
+
+    TCPConnInfo client = open_client();
+    manager.connectionClosed.connect([&](TCPConnInfo conn) {
+        if (conn.handle() == client.handle()) ++closed;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.write(client, "GET /users HTTP/1.1\r\nHost: t\r\n\r\n"
+                          "POST /echo HTTP/1.1\r\nHost: t\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nping\r\n0\r\n\r\n"
+                          "GET /missing HTTP/1.1\r\nHost: t\r\n\r\n"
+                          "GET /throw HTTP/1.1\r\nHost: t\r\n\r\n");
+    wait_for([&]() { return count("HTTP/1.1 ") >= 4; });
+    {
+        std::lock_guard lock(received_mutex);
+        const std::size_t users = received.find("\r\n\r\nusers");
+        const std::size_t echo = received.find("Content-Type: text/plain\r\nContent-Length: 4\r\n\r\nping");
+        const std::size_t missing = received.find("HTTP/1.1 404 Not Found");
+        const std::size_t failure = received.find("HTTP/1.1 500 Internal Server Error");
+        UnitTestFramework::assert_true(users != std::string::npos && echo != std::string::npos &&
+                                           missing != std::string::npos && failure != std::string::npos &&
+                                           users < echo && echo < missing && missing < failure,
+                                       "Pipelined requests should be answered in order");
+        received.clear();
+    }
+    UnitTestFramework::assert_equals(0, closed.load(), "Keep-alive connections should stay open");
+    manager.write(client, "GET / HTTP/1.1\r\nConnection: close\r\n\r\nGET /users HTTP/1.1\r\n\r\n");
+    wait_for([&]() { return closed.load() > 0 && count("HTTP/1.1 ") >= 1; });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(received.find("Connection: close\r\n\r\nroot") != std::string::npos &&
+                                           count("HTTP/1.1 ") == 1,
+                                       "Connection: close should be answered, then the connection closed");
+        received.clear();
+    }
+    UnitTestFramework::assert_equals(1, closed.load(), "The server should close the connection after the response");
+
+    client = open_client();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.write(client, "BROKEN\r\n\r\n");
+    wait_for([&]() { return count("HTTP/1.1 400 Bad Request") >= 1; });
+    UnitTestFramework::assert_true(count("HTTP/1.1 400 Bad Request") == 1, "Malformed requests should get a 400");
+
+    UnitTestFramework::assert_true(server.requestsServed() >= 5, "Requests should be counted");
+    manager.stop();
+}
+
+void test_http_client() {
+    std::cout << "\n--- Testing HTTP/1.1 response parser and pooled client ---" << std::endl;
+
+    struct Parsed {
+        int status;
+        std::string body;
+        bool keepAlive;
+    };
+    // pipelined responses: a fixed-length body, an interim 100 before a chunked one, a HEAD response with a length
+    // but no body, a 204, and an HTTP/1.0 body ended by the close; split at every possible byte
+    const std::string stream =
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2;x=y\r\nde\r\n0\r\nT: v\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 7\r\n\r\n"
+        "HTTP/1.1 204 No Content\r\n\r\n"
+        "HTTP/1.0 200 OK\r\n\r\nuntil close";
+    bool splits_ok = true;
+    for (std::size_t cut = 0; cut <= stream.size() && splits_ok; ++cut) {
+        HttpResponseParser parser;
+        for (const bool head : {false, false, true, false, false}) parser.expectResponse(head);
+        std::vector<Parsed> responses;
+        auto collect = [&](HttpClientResponse&& response) {
+            responses.push_back({response.status, response.bodyString(), response.keepAlive});
+        };
+        parser.feed(make_recv_buffer(std::string_view(stream).substr(0, cut)), collect);
+        parser.feed(make_recv_buffer(std::string_view(stream).substr(cut)), collect);
+        const bool finished = parser.finish(collect);
+        splits_ok = finished && responses.size() == 5 && responses[0].body == "hello" && responses[1].status == 201 &&
+                    responses[1].body == "abcde" && responses[2].body.empty() && responses[3].status == 204 &&
+                    responses[4].body == "until close" && responses[3].keepAlive && !responses[4].keepAlive &&
+                    parser.expectedResponses() == 0;
+    }
+    UnitTestFramework::assert_true(splits_ok, "Pipelined responses should parse the same however they are split");
+
+    // a body spanning buffers is a segment per buffer, pointing into them
+    HttpResponseParser segmented;
+    segmented.expectResponse(false);
+    const RecvBuffer first = make_recv_buffer("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n01234");
+    const RecvBuffer second = make_recv_buffer("56789");
+    HttpClientResponse kept;
+    segmented.feed(first, [&](HttpClientResponse&& response) { kept = std::move(response); });
+    segmented.feed(second, [&](HttpClientResponse&& response) { kept = std::move(response); });
+    UnitTestFramework::assert_true(kept.body.size() == 2 && kept.body[0].data() == first.data() + first.size() - 5 &&
+                                       kept.body[1].data() == second.data() && kept.bodyString() == "0123456789" &&
+                                       kept.header("content-length") == "10",
+                                   "Bodies should stay in the receive buffers they arrived in");
+
+    auto fails = [](std::string_view input, bool expect = true) {
+        HttpResponseParser parser;
+        if (expect) parser.expectResponse(false);
+        parser.feed(make_recv_buffer(input), [](HttpClientResponse&&) {});
+        return parser.failed() || !parser.finish([](HttpClientResponse&&) {});
+    };
+    UnitTestFramework::assert_true(fails("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n", false),
+                                   "A response nobody asked for should be an error");
+    UnitTestFramework::assert_true(fails("HTTP/1.1 2x0 OK\r\n\r\n") && fails("ICY 200 OK\r\n\r\n"),
+                                   "Malformed status lines should be an error");
+    UnitTestFramework::assert_true(fails("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nTransfer-Encoding: chunked\r\n\r\n"),
+                                   "Content-Length together with chunked should be an error");
+    UnitTestFramework::assert_true(fails("HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\nshort"),
+                                   "A close in the middle of a body should be an error");
+
+    // end to end over loopback, against HttpServer
+    HttpRouter router;
+    router.add("GET", "/hello", [](const HttpRequest&, HttpResponse& response) { response.body = "world"; });
+    router.add("GET", "/big", [](const HttpRequest&, HttpResponse& response) { response.body.assign(100000, 'b'); });
+    router.add("GET", "/path/*", [](const HttpRequest& request, HttpResponse& response) {
+        response.body = request.path;
+    });
+    router.add("POST", "/echo", [](const HttpRequest& request, HttpResponse& response) {
+        response.body = request.body;
+    });
+    TCPConnectionManager server_manager(1);
+    HttpServer server(server_manager, router);
+    UnitTestFramework::assert_true(server.start("127.0.0.1", 14600), "HTTP server should start");
+
+    TCPConnectionManager client_manager(1);
+    auto get = [](std::future<HttpClientResult> future) {
+        if (future.wait_for(std::chrono::seconds(5)) != std::future_status::ready) return HttpClientResult{-1, {}};
+        return future.get();
+    };
+    {
+        HttpClient client(client_manager);
+        bool all_ok = true;
+        for (int i = 0; i < 20; ++i) {
+            const auto hello = get(client.request("127.0.0.1", 14600,
+                                                  HttpClientRequest{.target = "/hello", .headers = {}, .body = {}}));
+            all_ok = all_ok && hello.error == 0 && hello.response.status == 200 && hello.response.bodyString() == "world";
+        }
+        UnitTestFramework::assert_true(all_ok, "Sequential requests should all be answered");
+        UnitTestFramework::assert_equals(1ull, (unsigned long long)client.stats().connectionsOpened,
+                                         "Sequential requests should reuse one pooled connection");
+
+        const auto echo = get(client.request("127.0.0.1", 14600,
+                                             HttpClientRequest{.method = "POST", .target = "/echo", .headers = {},
+                                                               .body = "payload"}));
+        UnitTestFramework::assert_true(echo.error == 0 && echo.response.bodyString() == "payload",
+                                       "A POST body should reach the server");
+        const auto head = get(client.request(
+            "127.0.0.1", 14600, HttpClientRequest{.method = "HEAD", .target = "/hello", .headers = {}, .body = {}}));
+        const auto after_head = get(client.request("127.0.0.1", 14600,
+                                                   HttpClientRequest{.target = "/hello", .headers = {}, .body = {}}));
+        UnitTestFramework::assert_true(head.error == 0 && head.response.status == 200 && head.response.body.empty() &&
+                                           after_head.response.bodyString() == "world",
+                                       "A HEAD response should end at its headers, whatever its Content-Length");
+        const auto big = get(client.request("127.0.0.1", 14600,
+                                            HttpClientRequest{.target = "/big", .headers = {}, .body = {}}));
+        UnitTestFramework::assert_true(big.error == 0 && big.response.bodySize() == 100000 &&
+                                           big.response.body.size() > 1 &&
+                                           big.response.bodyString() == std::string(100000, 'b'),
+                                       "A large body should arrive whole, in segments");
+        UnitTestFramework::assert_equals(1ull, (unsigned long long)client.stats().connectionsOpened,
+                                         "All of it should run over the one pooled connection");
+    }
+
+    {
+        // one connection, so concurrent requests have to be pipelined
+        HttpClient client(client_manager, HttpClientOptions{.maxConnectionsPerHost = 1, .maxPipelineDepth = 8});
+        std::vector<std::future<HttpClientResult>> futures;
+        for (int i = 0; i < 32; ++i) {
+            futures.push_back(client.request(
+                "127.0.0.1", 14600, HttpClientRequest{.target = std::format("/path/{}", i), .headers = {}, .body = {}}));
+        }
+        bool matched = true;
+        for (int i = 0; i < 32; ++i) {
+            const auto result = get(std::move(futures[i]));
+            matched = matched && result.error == 0 && result.response.bodyString() == std::format("/path/{}", i);
+        }
+        const auto stats = client.stats();
+        UnitTestFramework::assert_true(matched, "Every pipelined request should get its own response");
+        UnitTestFramework::assert_true(stats.connectionsOpened == 1 && stats.pipelinedRequests > 0,
+                                       "Requests beyond the pool should be pipelined");
+    }
+
+    {
+        HttpClient client(client_manager);
+        const auto closing = get(client.request("127.0.0.1", 14600,
+                                                HttpClientRequest{.target = "/hello",
+                                                                  .headers = {{"Connection", "close"}}, .body = {}}));
+        const auto next = get(client.request("127.0.0.1", 14600,
+                                             HttpClientRequest{.target = "/hello", .headers = {}, .body = {}}));
+        UnitTestFramework::assert_true(closing.error == 0 && !closing.response.keepAlive && next.error == 0 &&
+                                           client.stats().connectionsOpened == 2,
+                                       "A connection the server closes should not be reused");
+    }
+
+    // a server that accepts and never answers
+    TCPConnectionManager silent_manager(1);
+    silent_manager.openListenSocket("127.0.0.1", 14601);
+    {
+        HttpClient client(client_manager);
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = get(client.request("127.0.0.1", 14601,
+                                               HttpClientRequest{.headers = {}, .body = {},
+                                                                 .timeout = std::chrono::milliseconds(200)}));
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        UnitTestFramework::assert_equals(ETIMEDOUT, result.error, "A request past its deadline should fail");
+        UnitTestFramework::assert_true(elapsed < std::chrono::seconds(2) && client.stats().timeouts == 1,
+                                       "The deadline should be enforced on time");
+
+        const auto refused = get(client.request("127.0.0.1", 14602, {}));
+        UnitTestFramework::assert_true(refused.error != 0 && refused.error != -1,
+                                       "A refused connection should fail the request");
+    }
+
+    // a server that drops the first connection without answering, as with a keep-alive race
+    TCPConnectionManager flaky_manager(1);
+    std::atomic<int> flaky_connections{0};
+    flaky_manager.newConnection.connect([&](TCPConnInfo connInfo) {
+        const bool drop = flaky_connections++ == 0;
+        if (auto conn = flaky_manager.getConnection(connInfo).lock()) {
+            conn->newDataArrived.connect([&, connInfo, drop](const RecvBuffer&) {
+                if (drop) flaky_manager.closeConn(connInfo);
+                else flaky_manager.write(connInfo, std::string("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"));
+            });
+        }
+    });
+    flaky_manager.openListenSocket("127.0.0.1", 14603);
+    {
+        HttpClient client(client_manager);
+        const auto result = get(client.request("127.0.0.1", 14603, {}));
+        UnitTestFramework::assert_true(result.error == 0 && result.response.bodyString() == "ok" &&
+                                           client.stats().retries == 1 && client.stats().connectionsOpened == 2,
+                                       "An idempotent request whose connection was lost unanswered should be retried");
+        const auto post = get(client.request("127.0.0.1", 14603,
+                                             HttpClientRequest{.method = "POST", .headers = {}, .body = {}}));
+        UnitTestFramework::assert_true(post.error == 0 && client.stats().retries == 1,
+                                       "Requests after a retry should run normally");
+    }
+
+    {
+        // outstanding requests fail once the client goes away
+        std::future<HttpClientResult> pending;
+        {
+            HttpClient client(client_manager);
+            pending = client.request("127.0.0.1", 14601, {});
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        UnitTestFramework::assert_equals(ECANCELED, get(std::move(pending)).error,
+                                         "Requests outstanding when the client is destroyed should be cancelled");
+    }
+
+    flaky_manager.stop();
+    silent_manager.stop();
+    client_manager.stop();
+    server_manager.stop();
+}
+
+void test_websocket() {
+    std::cout << "\n--- Testing WebSocket framing, unmasking and server ---" << std::endl;
+
+    UnitTestFramework::assert_true(websocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+                                   "The accept key should match the RFC 6455 example");
+
+    // every kernel against a byte loop, at every length up to a few vectors and every key offset, also in place
+    const WebSocketMasker::Key key{0x12, 0x34, 0x56, 0x78};
+    std::string plain(300, '\0');
+    for (std::size_t i = 0; i < plain.size(); ++i) plain[i] = char(i * 7 + 3);
+    for (const auto kernel : {WebSocketMasker::Kernel::Scalar, WebSocketMasker::Kernel::Sse2, WebSocketMasker::Kernel::Avx2}) {
+        if (!simdKernelAvailable(kernel)) continue;
+        const WebSocketMasker masker(kernel);
+        bool agrees = true;
+        for (std::size_t size = 0; size <= plain.size() && agrees; ++size) {
+            for (std::size_t offset = 0; offset < 4 && agrees; ++offset) {
+                std::string expected(size, '\0'), out(size, '\0');
+                for (std::size_t i = 0; i < size; ++i) expected[i] = char(plain[i] ^ key[(offset + i) % 4]);
+                masker.apply(out.data(), plain.data(), size, key, offset);
+                std::string in_place = plain.substr(0, size);
+                masker.apply(in_place.data(), in_place.data(), size, key, offset);
+                agrees = out == expected && in_place == expected;
+            }
+        }
+        UnitTestFramework::assert_true(agrees, std::format("{} unmasking should match a byte loop", simdKernelName(kernel)));
+    }
+
+    struct Frame {
+        WebSocketOpcode opcode;
+        std::string payload;
+    };
+    auto collect = [](std::vector<Frame>& out) {
+        return [&out](WebSocketOpcode opcode, std::string_view payload) { out.push_back({opcode, std::string(payload)}); };
+    };
+
+    // server frames: the length encodings either side of 126 and 65536, decoded by a client-side decoder
+    bool lengths_ok = true;
+    for (const std::size_t size : {0, 125, 126, 65535, 65536, 70000}) {
+        const std::string payload(size, 'x');
+        const std::string frame = encodeWebSocketFrame(WebSocketOpcode::Binary, payload);
+        std::vector<Frame> frames;
+        WebSocketDecoder client(1 << 20, false);
+        client.feed(frame, collect(frames));
+        lengths_ok = lengths_ok && frame.size() == websocketHeaderSize(size, false) + size &&
+                     frame.size() - size == (size < 126 ? 2u : size <= 65535 ? 4u : 10u) && frames.size() == 1 &&
+                     frames[0].opcode == WebSocketOpcode::Binary && frames[0].payload == payload;
+    }
+    UnitTestFramework::assert_true(lengths_ok, "Frames should use the shortest length encoding and decode back");
+
+    const std::string unmasked = encodeWebSocketFrame(WebSocketOpcode::Text, "in place");
+    bool zero_copy = false;
+    WebSocketDecoder client(1024, false);
+    client.feed(unmasked, [&](WebSocketOpcode, std::string_view payload) {
+        zero_copy = payload == "in place" && payload.data() == unmasked.data() + 2;
+    });
+    UnitTestFramework::assert_true(zero_copy, "Whole unmasked frames should be handed out in place");
+
+    // a fragmented text message with a ping between its fragments, a masked binary frame and a close, split at
+    // every possible byte
+    std::string stream;
+    appendWebSocketFrame(stream, WebSocketOpcode::Text, "Hel", false, &key);
+    appendWebSocketFrame(stream, WebSocketOpcode::Ping, "p", true, &key);
+    appendWebSocketFrame(stream, WebSocketOpcode::Continuation, "lo", false, &key);
+    appendWebSocketFrame(stream, WebSocketOpcode::Continuation, "", true, &key);
+    appendWebSocketFrame(stream, WebSocketOpcode::Binary, plain, true, &key);
+    appendWebSocketFrame(stream, WebSocketOpcode::Close, "\x03\xe8", true, &key);
+    bool splits_ok = true;
+    for (std::size_t cut = 0; cut <= stream.size() && splits_ok; ++cut) {
+        WebSocketDecoder server;
+        std::vector<Frame> frames;
+        const bool ok = server.feed(std::string_view(stream).substr(0, cut), collect(frames)) &&
+                        server.feed(std::string_view(stream).substr(cut), collect(frames));
+        splits_ok = ok && frames.size() == 4 && frames[0].opcode == WebSocketOpcode::Ping &&
+                    frames[0].payload == "p" && frames[1].opcode == WebSocketOpcode::Text &&
+                    frames[1].payload == "Hello" && frames[2].opcode == WebSocketOpcode::Binary &&
+                    frames[2].payload == plain && frames[3].opcode == WebSocketOpcode::Close &&
+                    frames[3].payload == "\x03\xe8";
+    }
+    UnitTestFramework::assert_true(splits_ok, "Fragmented masked messages should decode the same however they are split");
+
+    auto close_code_for = [&](auto&& build, std::size_t maxMessageSize = 1024) {
+        std::string input;
+        build(input);
+        WebSocketDecoder server(maxMessageSize);
+        server.feed(input, [](WebSocketOpcode, std::string_view) {});
+        return (int)server.closeCode();
+    };
+    UnitTestFramework::assert_equals(1002, close_code_for([](std::string& s) { appendWebSocketFrame(s, WebSocketOpcode::Text, "x"); }),
+                                     "Unmasked client frames should be a protocol error");
+    UnitTestFramework::assert_equals(1002, close_code_for([&](std::string& s) { appendWebSocketFrame(s, WebSocketOpcode::Ping, "x", false, &key); }),
+                                     "Fragmented control frames should be a protocol error");
+    UnitTestFramework::assert_equals(1002, close_code_for([&](std::string& s) { appendWebSocketFrame(s, WebSocketOpcode::Continuation, "x", true, &key); }),
+                                     "A continuation without a message should be a protocol error");
+    UnitTestFramework::assert_equals(1002, close_code_for([&](std::string& s) {
+                                         appendWebSocketFrame(s, WebSocketOpcode::Text, "x", false, &key);
+                                         appendWebSocketFrame(s, WebSocketOpcode::Text, "y", true, &key);
+                                     }),
+                                     "A new message inside a fragmented one should be a protocol error");
+    UnitTestFramework::assert_equals(1002, close_code_for([&](std::string& s) {
+                                         appendWebSocketFrame(s, WebSocketOpcode::Text, "x", true, &key);
+                                         s[0] |= 0x40;
+                                     }),
+                                     "Reserved bits should be a protocol error");
+    UnitTestFramework::assert_equals(1009, close_code_for([&](std::string& s) {
+                                         appendWebSocketFrame(s, WebSocketOpcode::Text, std::string(600, 'a'), false, &key);
+                                         appendWebSocketFrame(s, WebSocketOpcode::Continuation, std::string(600, 'b'), true, &key);
+                                     }),
+                                     "Messages above the limit should close with 1009");
+
+    // end to end over loopback: an echo server
+    TCPConnectionManager manager(1);
+    WebSocketServer server(manager, {.path = "/chat"});
+    std::mutex session_mutex;
+    std::vector<TCPConnInfo> sessions;
+    std::atomic<int> pongs{0};
+    server.sessionOpened.connect([&](TCPConnInfo session) {
+        std::lock_guard lock(session_mutex);
+        sessions.push_back(session);
+    });
+    server.messageArrived.connect([&](const TCPConnInfo& session, WebSocketOpcode opcode, std::string_view payload) {
+        server.send(session, payload, opcode);
+    });
+    server.pongArrived.connect([&](const TCPConnInfo&, std::string_view payload) {
+        if (payload == "sp") ++pongs;
+    });
+    UnitTestFramework::assert_true(server.start("127.0.0.1", 14610), "WebSocket server should start");
+
+    std::mutex received_mutex;
+    std::map<ConnHandle, std::string> received; // by handle, as closed sockets are reused
+    std::set<ConnHandle> closed;
+    manager.connectionClosed.connect([&](TCPConnInfo conn) {
+        std::lock_guard lock(received_mutex);
+        closed.insert(conn.handle());
+    });
+    auto open_client = [&]() {
+        TCPConnInfo clientInfo = manager.openConnection("127.0.0.1", 14610);
+        if (auto conn = manager.getConnection(clientInfo).lock()) {
+            conn->newDataArrived.connect([&, handle = clientInfo.handle()](const RecvBuffer& data) {
+                std::lock_guard lock(received_mutex);
+                received[handle].append(data.view());
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return clientInfo;
+    };
+    auto wait_for = [&](auto&& done) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard lock(received_mutex);
+                if (done()) return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    };
+    // the response head of a client, and the frames after it; received_mutex held
+    auto head_of = [&](const TCPConnInfo& client) {
+        const std::string& in = received[client.handle()];
+        return in.substr(0, in.find("\r\n\r\n"));
+    };
+    auto frames_of = [&](const TCPConnInfo& client) {
+        const std::string& in = received[client.handle()];
+        std::vector<Frame> frames;
+        const std::size_t end = in.find("\r\n\r\n");
+        if (end == std::string::npos) return frames;
+        WebSocketDecoder decoder(1 << 20, false);
+        decoder.feed(std::string_view(in).substr(end + 4), collect(frames));
+        return frames;
+    };
+    auto has_frame = [&](const TCPConnInfo& client, WebSocketOpcode opcode, std::string_view payload) {
+        const auto frames = frames_of(client);
+        return std::any_of(frames.begin(), frames.end(),
+                           [&](const Frame& f) { return f.opcode == opcode && f.payload == payload; });
+    };
+    auto handshake = [](std::string_view path, std::string_view version) {
+        return std::format("GET {} HTTP/1.1\r\nHost: t\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\n"
+                           "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: {}\r\n\r\n",
+                           path, version);
+    };
+    auto send_frame = [&](const TCPConnInfo& client, WebSocketOpcode opcode, std::string_view payload, bool fin = true) {
+        std::string frame;
+        appendWebSocketFrame(frame, opcode, payload, fin, &key);
+        manager.write(client, std::move(frame));
+    };
+
+    const TCPConnInfo client1 = open_client();
+    manager.write(client1, handshake("/chat", "13"));
+    wait_for([&]() { return received[client1.handle()].find("\r\n\r\n") != std::string::npos; });
+    {
+        std::lock_guard lock(received_mutex);
+        const std::string head = head_of(client1);
+        UnitTestFramework::assert_true(head.starts_with("HTTP/1.1 101 Switching Protocols") &&
+                                           head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos,
+                                       "The upgrade should be answered with 101 and the accept key");
+    }
+    send_frame(client1, WebSocketOpcode::Text, "Hel", false);
+    send_frame(client1, WebSocketOpcode::Ping, "cp");
+    send_frame(client1, WebSocketOpcode::Continuation, "lo");
+    send_frame(client1, WebSocketOpcode::Binary, plain);
+    wait_for([&]() { return frames_of(client1).size() >= 3; });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(has_frame(client1, WebSocketOpcode::Text, "Hello") &&
+                                           has_frame(client1, WebSocketOpcode::Binary, plain),
+                                       "Reassembled messages should be echoed");
+        UnitTestFramework::assert_true(has_frame(client1, WebSocketOpcode::Pong, "cp"),
+                                       "Pings between fragments should be answered with pongs");
+    }
+
+    TCPConnInfo session1;
+    {
+        std::lock_guard lock(session_mutex);
+        UnitTestFramework::assert_equals(1, (int)sessions.size(), "sessionOpened should fire once per session");
+        if (!sessions.empty()) session1 = sessions[0];
+    }
+    UnitTestFramework::assert_equals(1, (int)server.sessionCount(), "One session should be open");
+    UnitTestFramework::assert_equals(1, (int)server.broadcast("to all"), "Broadcasts should reach the open session");
+    server.ping(session1, "sp");
+    wait_for([&]() { return has_frame(client1, WebSocketOpcode::Text, "to all") && has_frame(client1, WebSocketOpcode::Ping, "sp"); });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(has_frame(client1, WebSocketOpcode::Text, "to all") &&
+                                           has_frame(client1, WebSocketOpcode::Ping, "sp"),
+                                       "Broadcasts and server pings should arrive as frames");
+    }
+    send_frame(client1, WebSocketOpcode::Pong, "sp");
+    send_frame(client1, WebSocketOpcode::Close, "\x03\xe8");
+    wait_for([&]() { return closed.count(client1.handle()) > 0; });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(has_frame(client1, WebSocketOpcode::Close, "\x03\xe8") && closed.count(client1.handle()),
+                                       "A client Close should be echoed and the connection closed");
+    }
+    UnitTestFramework::assert_equals(1, pongs.load(), "Pongs should be reported");
+
+    // the server closes: the Close goes out first, the connection closes once the client answers
+    const TCPConnInfo client2 = open_client();
+    manager.write(client2, handshake("/chat", "13"));
+    wait_for([&]() { return received[client2.handle()].find("\r\n\r\n") != std::string::npos; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    TCPConnInfo session2;
+    {
+        std::lock_guard lock(session_mutex);
+        if (sessions.size() == 2) session2 = sessions[1];
+    }
+    UnitTestFramework::assert_true(server.close(session2, 1001, "bye"), "close() should accept an open session");
+    UnitTestFramework::assert_true(!server.send(session2, "late"), "Nothing should be sent after the Close");
+    wait_for([&]() { return has_frame(client2, WebSocketOpcode::Close, "\x03\xe9" "bye"); });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(has_frame(client2, WebSocketOpcode::Close, "\x03\xe9" "bye") &&
+                                           !closed.count(client2.handle()),
+                                       "The server's Close should carry its code and reason");
+    }
+    send_frame(client2, WebSocketOpcode::Close, "\x03\xe9");
+    UnitTestFramework::assert_true(wait_for([&]() { return closed.count(client2.handle()) > 0; }),
+                                   "The connection should close once the client answers the Close");
+
+    // handshakes the server refuses
+    const TCPConnInfo plain_get = open_client();
+    manager.write(plain_get, "GET /chat HTTP/1.1\r\nHost: t\r\n\r\n");
+    const TCPConnInfo old_version = open_client();
+    manager.write(old_version, handshake("/chat", "8"));
+    const TCPConnInfo wrong_path = open_client();
+    manager.write(wrong_path, handshake("/other", "13"));
+    wait_for([&]() { return closed.count(plain_get.handle()) && closed.count(old_version.handle()) && closed.count(wrong_path.handle()); });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(head_of(plain_get).starts_with("HTTP/1.1 426 Upgrade Required") &&
+                                           head_of(old_version).find("Sec-WebSocket-Version: 13") != std::string::npos &&
+                                           head_of(wrong_path).starts_with("HTTP/1.1 404 Not Found"),
+                                       "Refused handshakes should get 426 or 404");
+        UnitTestFramework::assert_true(closed.count(plain_get.handle()) && closed.count(old_version.handle()) &&
+                                           closed.count(wrong_path.handle()),
+                                       "Refused handshakes should close the connection");
+    }
+    UnitTestFramework::assert_equals(0, (int)server.sessionCount(), "Closed sessions should be gone");
+    manager.stop();
+}
+
+void test_kv_server() {
+    std::cout << "\n--- Testing key-value store, RESP parser and server ---" << std::endl;
+
+    SlabAllocator slab(SlabAllocator::pageSize);
+    void* first = slab.allocate(100);
+    UnitTestFramework::assert_true(first && slab.chunkSize(100) >= 100 && slab.usedBytes() == slab.chunkSize(100),
+                                   "Slabs should hand out chunks of the size class");
+    slab.deallocate(first);
+    UnitTestFramework::assert_true(slab.allocate(90) == first, "Freed chunks should be reused by their class");
+    std::vector<void*> chunks{first};
+    while (void* chunk = slab.allocate(100)) chunks.push_back(chunk);
+    UnitTestFramework::assert_true(chunks.size() == SlabAllocator::maxChunkSize / slab.chunkSize(100) &&
+                                       slab.reservedBytes() == SlabAllocator::pageSize && !slab.allocate(1000),
+                                   "Allocation should stop at the memory limit");
+    for (void* chunk : chunks) slab.deallocate(chunk);
+    UnitTestFramework::assert_true(slab.usedBytes() == 0 && slab.reservedBytes() == 0 && slab.allocate(1000),
+                                   "An emptied page should go back to the pool, for any size class");
+
+    // random operations against std::unordered_map: inserts, overwrites in and out of place, erases that shift
+    // probe runs back, across table growth
+    KvStore store({.shards = 4, .memoryLimit = 0, .maxItemSize = SlabAllocator::maxChunkSize});
+    std::unordered_map<std::string, std::string> model;
+    std::mt19937 rng(11);
+    bool agrees = true;
+    for (int i = 0; i < 50000 && agrees; ++i) {
+        const std::string key = "key:" + std::to_string(rng() % 3000);
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            const std::string value(rng() % 200, char('a' + rng() % 26));
+            agrees = store.set(key, value);
+            model[key] = value;
+            break;
+        }
+        case 2:
+            agrees = store.erase(key) == (model.erase(key) == 1);
+            break;
+        default: {
+            std::string found;
+            const bool hit = store.get(key, [&](std::string_view value) { found = value; });
+            const auto it = model.find(key);
+            agrees = hit == (it != model.end()) && (!hit || found == it->second);
+        }
+        }
+    }
+    for (const auto& [key, value] : model) {
+        if (!agrees) break;
+        agrees = store.get(key, [&](std::string_view found) { agrees = found == value; }) && agrees;
+    }
+    UnitTestFramework::assert_true(agrees && store.size() == model.size(),
+                                   "The store should agree with std::unordered_map over random operations");
+
+    int64_t counter = 0;
+    store.set("text", "abc");
+    UnitTestFramework::assert_true(store.increment("counter", 5, counter) && counter == 5 &&
+                                       store.increment("counter", -7, counter) && counter == -2 &&
+                                       !store.increment("text", 1, counter) && counter == -2,
+                                   "Counters should increment from nothing and refuse non-integers");
+    store.set("max", std::to_string(std::numeric_limits<int64_t>::max()));
+    UnitTestFramework::assert_true(!store.increment("max", 1, counter), "Counter overflow should be refused");
+    const std::size_t before = store.stats().usedBytes;
+    store.clear();
+    UnitTestFramework::assert_true(store.size() == 0 && store.stats().usedBytes == 0 && before > 0,
+                                   "clear() should release every item");
+
+    KvStore small({.shards = 1, .memoryLimit = SlabAllocator::pageSize, .maxItemSize = 1024});
+    UnitTestFramework::assert_true(!small.set("big", std::string(2000, 'x')) && !small.contains("big"),
+                                   "Items above the size limit should be refused");
+    int stored = 0;
+    while (small.set("k" + std::to_string(stored), std::string(100, 'v')) && stored < 100000) ++stored;
+    UnitTestFramework::assert_true(stored > 1000 && stored < 100000 && small.contains("k0"),
+                                   "A full store should refuse new items and keep the old ones");
+
+    // a budget of a few pages per shard, as from KV_Server with a small memory limit
+    KvStore tight({.shards = 64, .memoryLimit = 32 * SlabAllocator::pageSize, .maxItemSize = SlabAllocator::maxChunkSize});
+    bool accepted = tight.set("k", "v");
+    for (std::size_t size = 1; size <= 256 * 1024 && accepted; size *= 2) {
+        accepted = tight.set("size:" + std::to_string(size), std::string(size, 'v'));
+    }
+    UnitTestFramework::assert_true(accepted, "Small memory limits should take values of every size");
+    tight.clear();
+    stored = 0;
+    while (tight.set("k" + std::to_string(stored), std::string(100, 'v')) && stored < 1000000) ++stored;
+    tight.clear();
+    UnitTestFramework::assert_true(stored > 100000 && tight.set("big", std::string(500 * 1024, 'x')),
+                                   "All shards should draw on one budget, and pages freed by one class serve another");
+
+    // pipelined commands, bulk and inline, split at every possible byte
+    using Args = std::vector<std::string>;
+    const std::string pipeline = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$12\r\nhello\r\nworld\r\n"
+                                 "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n"
+                                 "*0\r\n"
+                                 "PING  inline\r\n"
+                                 "\r\n"
+                                 "*1\r\n$0\r\n\r\n";
+    const std::vector<Args> expected = {{"SET", "key", "hello\r\nworld"}, {"GET", "key"}, {"PING", "inline"}, {""}};
+    bool splits_ok = true;
+    for (std::size_t cut = 0; cut <= pipeline.size() && splits_ok; ++cut) {
+        RespParser parser;
+        std::vector<Args> commands;
+        auto collect = [&](const std::vector<std::string_view>& args) { commands.emplace_back(args.begin(), args.end()); };
+        splits_ok = parser.feed(std::string_view(pipeline).substr(0, cut), collect) &&
+                    parser.feed(std::string_view(pipeline).substr(cut), collect) && commands == expected &&
+                    parser.pendingBytes() == 0;
+    }
+    UnitTestFramework::assert_true(splits_ok, "Pipelined RESP commands should parse the same however they are split");
+
+    // a big command trickling in: parsing resumes where the previous buffer stopped
+    {
+        RespParser parser;
+        std::vector<Args> commands;
+        auto collect = [&](const std::vector<std::string_view>& args) { commands.emplace_back(args.begin(), args.end()); };
+        Args mset = {"MSET"};
+        std::string command = "*20001\r\n$4\r\nMSET\r\n";
+        for (int i = 0; i < 10000; ++i) {
+            for (const std::string& arg : {std::format("key:{}", i), std::format("value:{}", i)}) {
+                command += std::format("${}\r\n{}\r\n", arg.size(), arg);
+                mset.push_back(arg);
+            }
+        }
+        bool fed = true;
+        for (std::size_t i = 0; i < pipeline.size() && fed; ++i) {
+            fed = parser.feed(std::string_view(pipeline).substr(i, 1), collect);
+        }
+        for (std::size_t i = 0; i < command.size() && fed; i += 7) {
+            fed = parser.feed(std::string_view(command).substr(i, 7), collect);
+        }
+        std::vector<Args> trickled = expected;
+        trickled.push_back(mset);
+        UnitTestFramework::assert_true(fed && commands == trickled && parser.pendingBytes() == 0,
+                                       "Commands fed a few bytes at a time should parse whole");
+    }
+
+    auto error_for = [](std::string_view input) {
+        RespParser parser({.maxArgs = 8, .maxBulkSize = 16, .maxInlineSize = 32});
+        parser.feed(input, [](const std::vector<std::string_view>&) {});
+        return parser.error();
+    };
+    UnitTestFramework::assert_true(error_for("*x\r\n") == "invalid multibulk length" &&
+                                       error_for("*9\r\n") == "invalid multibulk length" &&
+                                       error_for("*1\r\n$17\r\n") == "invalid bulk length" &&
+                                       error_for("*1\r\n:1\r\n") == "expected '$', got ':'" &&
+                                       error_for("*1\r\n$1\r\nab\r\n") == "bulk string not terminated" &&
+                                       error_for(std::string(40, 'x')) == "too big inline request",
+                                   "Malformed commands and commands above the limits should fail");
+
+    // end to end over loopback
+    TCPConnectionManager manager(1);
+    KvStore served;
+    KvServer server(manager, served);
+    UnitTestFramework::assert_true(server.start("127.0.0.1", 14620), "KV server should start");
+
+    std::mutex received_mutex;
+    std::string received;
+    std::atomic<int> closed{0};
+    TCPConnInfo client = manager.openConnection("127.0.0.1", 14620);
+    if (auto conn = manager.getConnection(client).lock()) {
+        conn->newDataArrived.connect([&](const RecvBuffer& data) {
+            std::lock_guard lock(received_mutex);
+            received.append(data.view());
+        });
+    }
+    manager.connectionClosed.connect([&](TCPConnInfo conn) {
+        if (conn.handle() == client.handle()) ++closed;
+    });
+    auto wait_for = [&](auto&& done) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard lock(received_mutex);
+                if (done()) return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    };
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const std::string replies = "+OK\r\n$5\r\nhello\r\n+OK\r\n*3\r\n$5\r\nhello\r\n$-1\r\n$1\r\n2\r\n:1\r\n:42\r\n:2\r\n:3\r\n"
+                                "-ERR value is not an integer or out of range\r\n-ERR wrong number of arguments for 'get' command\r\n"
+                                "-ERR unknown command 'NOPE'\r\n+PONG\r\n";
+    manager.write(client, "*3\r\n$3\r\nSET\r\n$1\r\na\r\n$5\r\nhello\r\n*2\r\n$3\r\nget\r\n$1\r\na\r\n"
+                          "MSET b 1 c 2\r\nMGET a missing c\r\nDEL b\r\nINCRBY n 42\r\nEXISTS a n\r\nDBSIZE\r\n"
+                          "INCR a\r\nGET\r\nNOPE\r\nPING\r\n");
+    wait_for([&]() { return received.size() >= replies.size(); });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(received == replies, "Pipelined commands should be answered in order");
+        received.clear();
+    }
+    manager.write(client, "QUIT\r\nPING\r\n");
+    wait_for([&]() { return closed.load() > 0; });
+    {
+        std::lock_guard lock(received_mutex);
+        UnitTestFramework::assert_true(received == "+OK\r\n" && closed.load() == 1,
+                                       "QUIT should be answered, then the connection closed");
+    }
+
+    client = manager.openConnection("127.0.0.1", 14620);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.write(client, "*1\r\n$x\r\n");
+    UnitTestFramework::assert_true(wait_for([&]() { return closed.load() == 2; }),
+                                   "Protocol errors should close the connection");
+    UnitTestFramework::assert_true(server.commandsServed() >= 13, "Commands should be counted");
+    manager.stop();
+}
+
+// Small-buffer storage of rmg::ByteArray
+void test_bytearray() {
+    std::cout << "\n--- Testing ByteArray ---" << std::endl;
+
+    // up to the inline capacity nothing is allocated, whatever the array is built from
+    const std::string header(rmg::ByteArray::inlineCapacity, 'h');
+    t_count_allocations = true;
+    const std::size_t before = g_allocations.load();
+    {
+        rmg::ByteArray a("GET /");
+        a.append(" HTTP/1.1").append('\r').append('\n');
+        rmg::ByteArray b(header);
+        rmg::ByteArray c(a);
+        rmg::ByteArray d(std::move(b));
+        c = d;
+        c.truncate(8);
+        c.prepend("x").insert(4, ':');
+        rmg::ByteArray e = c.sliced(2, 4);
+        e += d.first(3).toUpper();
+    }
+    const std::size_t inline_allocations = g_allocations.load() - before;
+    t_count_allocations = false;
+    UnitTestFramework::assert_equals(0, (int)inline_allocations, "Arrays within the inline capacity should not allocate");
+
+    rmg::ByteArray grown(header);
+    UnitTestFramework::assert_true(grown.isInline() && grown.capacity() == rmg::ByteArray::inlineCapacity,
+                                   "A full inline array should still be inline");
+    grown.append('+');
+    UnitTestFramework::assert_true(!grown.isInline() && grown.capacity() == 2 * rmg::ByteArray::inlineCapacity &&
+                                   grown == header + "+",
+                                   "Growing past the inline capacity should move the bytes to the heap");
+    grown.append(grown);
+    UnitTestFramework::assert_true(grown == header + "+" + header + "+", "Appending an array to itself should work across a reallocation");
+    grown.truncate(3);
+    grown.shrink_to_fit();
+    UnitTestFramework::assert_true(grown.isInline() && grown == "hhh", "shrink_to_fit should go back to inline storage");
+
+    // moves hand over the heap buffer, and copy inline bytes
+    rmg::ByteArray heap(std::string(100, 'x'));
+    const char* heap_data = heap.data();
+    rmg::ByteArray moved(std::move(heap));
+    rmg::ByteArray small("small");
+    rmg::ByteArray moved_small(std::move(small));
+    UnitTestFramework::assert_true(moved.data() == heap_data && heap.isEmpty() && heap.isInline() &&
+                                   moved_small == "small" && moved_small.isInline() && small.isEmpty(),
+                                   "Moves should steal the heap buffer and copy inline bytes");
+    moved.swap(moved_small);
+    UnitTestFramework::assert_true(moved == "small" && moved_small.size() == 100 && moved_small.data() == heap_data,
+                                   "swap should exchange inline and heap arrays");
+
+    // the capacity is a template parameter
+    rmg::BasicByteArray<8> tiny("12345678");
+    const bool tiny_inline = tiny.isInline();
+    tiny += "9";
+    rmg::BasicByteArray<64> wide(std::string(64, 'w'));
+    UnitTestFramework::assert_true(tiny_inline && !tiny.isInline() && tiny == "123456789" && wide.isInline(),
+                                   "The inline capacity should be configurable");
+
+    rmg::ByteArray edit("hello");
+    edit.prepend("<<").insert(9, '!');
+    const bool padded = edit == "<<hello  !";
+    edit.remove(2, 5).remove(3, 100);
+    UnitTestFramework::assert_true(padded && edit == "<< " && rmg::ByteArray("  a b \r\n").trimmed() == "a b" &&
+                                   rmg::ByteArray("abcdef").mid(2, 2) == "cd" && rmg::ByteArray("abcdef").sliced(4) == "ef",
+                                   "insert, remove, trimmed and slicing should edit in place");
+
+    const rmg::ByteArray text("key=value; key=other");
+    UnitTestFramework::assert_true(text.indexOf("key") == 0 && text.indexOf("key", 1) == 11 && text.indexOf('!') == std::size_t(-1) &&
+                                   text.lastIndexOf("key") == 11 && text.lastIndexOf('=', 10) == 3 && text.count("key") == 2 &&
+                                   text.left(3) == "key" && text.right(5) == "other" && text.last(5) == "other" &&
+                                   text.left(100) == text.toStdString() && rmg::ByteArray(3, 'z') == "zzz",
+                                   "Searches and slices should find the bytes they name");
+    UnitTestFramework::assert_true(rmg::ByteArray("ab").leftJustified(4, '.') == "ab.." &&
+                                   rmg::ByteArray("abcdef").leftJustified(4, '.', true) == "abcd" &&
+                                   rmg::ByteArray("ab").rightJustified(4) == "  ab" &&
+                                   rmg::ByteArray("  a \t b\n ").simplified() == "a b",
+                                   "Justifying and simplifying should pad, truncate and collapse whitespace");
+
+    rmg::ByteArray replaced(text);
+    replaced.replace("key", "k").replace(';', ',').replace(0, 1, "key");
+    replaced.replace(4, 100, replaced.left(3));
+    UnitTestFramework::assert_true(replaced == "key=key" && rmg::ByteArray("a-b").replace('-', rmg::ByteArray("--")) == "a--b" &&
+                                   rmg::ByteArray("abcdef").replace(1, 4, "X", 1) == "aXf",
+                                   "replace should grow, shrink and take bytes from the array itself");
+
+    bool ok = false;
+    bool bad_ok = true;
+    rmg::ByteArray number;
+    UnitTestFramework::assert_true(rmg::ByteArray(" 42 ").toInt(&ok) == 42 && ok && rmg::ByteArray("ff").toInt(nullptr, 16) == 255 &&
+                                   rmg::ByteArray("4x").toLong(&bad_ok) == 0 && !bad_ok &&
+                                   rmg::ByteArray("-1").toLongLong() == -1 && rmg::ByteArray("-1").toULongLong() == 0 &&
+                                   rmg::ByteArray("2.5").toDouble() == 2.5 && number.setNum(-63) == "-63" &&
+                                   number.setNum(63, 16) == "3f" && number.setNum(2.5, 'f', 2) == "2.50",
+                                   "Numbers should convert both ways");
+    UnitTestFramework::assert_true(rmg::ByteArray("\x01\xab").toHex() == "01ab" && rmg::ByteArray("\x01\xab").toHex(':') == "01:ab" &&
+                                   rmg::ByteArray("a b/~").toPercentEncoding("/") == "a%20b/~" &&
+                                   rmg::ByteArray("h\xc3\xa9").isValidUtf8() && !rmg::ByteArray("\xc0\xaf").isValidUtf8() &&
+                                   !rmg::ByteArray("\xed\xa0\x80").isValidUtf8() && !rmg::ByteArray("\xe2\x82").isValidUtf8(),
+                                   "toHex, toPercentEncoding and isValidUtf8 should encode and check bytes");
+}
+
 int main() {
     std::cout << "=== TCP Connection Manager Unit Tests ===" << std::endl;
     std::cout << "Running focused unit tests for edge cases and error conditions..." << std::endl;
@@ -851,6 +3549,30 @@ int main() {
     test_thread_management();
     test_connection_map_integrity();
     test_memory_leak_detection();
+    test_event_loop_reactor();
+    test_io_uring_backend();
+    test_reuseport_sharding();
+    test_batched_accept();
+    test_async_connect();
+    test_happy_eyeballs();
+    test_dns_resolver();
+    test_outbound_queue();
+    test_zero_copy_send();
+    test_send_file();
+    test_broadcast_group();
+    test_slow_consumer_policies();
+    test_recv_buffer_pool();
+    test_event_signal();
+    test_connection_registry();
+    test_connection_handles();
+    test_retire_queue();
+    test_frame_codec();
+    test_delimiter_codec();
+    test_http_server();
+    test_http_client();
+    test_websocket();
+    test_kv_server();
+    test_bytearray();
 
     UnitTestFramework::print_results();
 
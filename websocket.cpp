@@ -0,0 +1,502 @@
+#include "websocket.hpp"
+
+#include <atomic>
+#include <format>
+#include <iostream>
+
+#include "cpu_features.hpp"
+#include "http_server.hpp"
+
+namespace
+{
+// pattern holds the key in memory order, already rotated to the first byte of src
+void maskTail(char* dst, const char* src, std::size_t size, uint32_t pattern)
+{
+    uint8_t key[4];
+    std::memcpy(key, &pattern, sizeof(key));
+    for (std::size_t i = 0; i < size; ++i) dst[i] = char(src[i] ^ key[i & 3]);
+}
+
+void maskScalar(char* dst, const char* src, std::size_t size, uint32_t pattern)
+{
+    const uint64_t wide = (uint64_t(pattern) << 32) | pattern;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, src + i, sizeof(word));
+        word ^= wide;
+        std::memcpy(dst + i, &word, sizeof(word));
+    }
+    // i is a multiple of 4, so the tail starts on the key's first byte again
+    maskTail(dst + i, src + i, size - i, pattern);
+}
+
+#ifdef SIMD_X86
+void maskSse2(char* dst, const char* src, std::size_t size, uint32_t pattern)
+{
+    const __m128i key = _mm_set1_epi32((int)pattern);
+    auto xorAt = [&](std::size_t at) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + at));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + at), _mm_xor_si128(block, key));
+    };
+    std::size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        xorAt(i);
+        xorAt(i + 16);
+        xorAt(i + 32);
+        xorAt(i + 48);
+    }
+    for (; i + 16 <= size; i += 16) xorAt(i);
+    maskScalar(dst + i, src + i, size - i, pattern);
+}
+
+SIMD_AVX2_TARGET
+void maskAvx2(char* dst, const char* src, std::size_t size, uint32_t pattern)
+{
+    const __m256i key = _mm256_set1_epi32((int)pattern);
+    auto xorAt = [&](std::size_t at) SIMD_AVX2_TARGET {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + at));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + at), _mm256_xor_si256(block, key));
+    };
+    std::size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        xorAt(i);
+        xorAt(i + 32);
+        xorAt(i + 64);
+        xorAt(i + 96);
+    }
+    for (; i + 32 <= size; i += 32) xorAt(i);
+    maskScalar(dst + i, src + i, size - i, pattern);
+}
+#endif // SIMD_X86
+
+// FIPS 180-4; only ever hashes a handshake key, so it is written for clarity rather than speed
+std::array<uint8_t, 20> sha1(std::string_view message)
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+    std::string padded(message);
+    padded += char(0x80);
+    while (padded.size() % 64 != 56) padded += char(0);
+    const uint64_t bits = uint64_t(message.size()) * 8;
+    for (int shift = 56; shift >= 0; shift -= 8) padded += char(bits >> shift);
+
+    for (std::size_t block = 0; block < padded.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const uint8_t*>(padded.data() + block + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40) f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else f = b ^ c ^ d, k = 0xCA62C1D6;
+            const uint32_t next = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = next;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i) digest[i] = uint8_t(h[i / 4] >> (24 - (i % 4) * 8));
+    return digest;
+}
+
+std::string base64(const uint8_t* data, std::size_t size)
+{
+    static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (std::size_t i = 0; i < size; i += 3) {
+        const uint32_t chunk = (uint32_t(data[i]) << 16) | (i + 1 < size ? uint32_t(data[i + 1]) << 8 : 0) |
+                               (i + 2 < size ? data[i + 2] : 0);
+        out += alphabet[(chunk >> 18) & 63];
+        out += alphabet[(chunk >> 12) & 63];
+        out += i + 1 < size ? alphabet[(chunk >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[chunk & 63] : '=';
+    }
+    return out;
+}
+
+// RFC 6455, section 4.1: the key is 16 random bytes in base64
+bool validClientKey(std::string_view key)
+{
+    if (key.size() != 24 || key.substr(22) != "==") return false;
+    return std::all_of(key.begin(), key.end() - 2, [](char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+    });
+}
+
+void appendHandshakeError(std::string& out, int status, std::string_view extraHeader = {})
+{
+    const std::string_view reason = httpReasonPhrase(status);
+    out += std::format("HTTP/1.1 {} {}\r\nContent-Length: {}\r\nConnection: close\r\n", status, reason, reason.size());
+    if (!extraHeader.empty()) {
+        out += extraHeader;
+        out += "\r\n";
+    }
+    out += "\r\n";
+    out += reason;
+}
+
+void appendCloseFrame(std::string& out, uint16_t code, std::string_view reason)
+{
+    char payload[125];
+    payload[0] = char(code >> 8);
+    payload[1] = char(code & 0xFF);
+    // a control frame carries at most 125 bytes
+    reason = reason.substr(0, sizeof(payload) - 2);
+    std::copy(reason.begin(), reason.end(), payload + 2);
+    appendWebSocketFrame(out, WebSocketOpcode::Close, std::string_view(payload, 2 + reason.size()));
+}
+} // namespace
+
+WebSocketMasker::WebSocketMasker(Kernel kernel) : m_apply(maskScalar)
+{
+    if (!simdKernelAvailable(kernel)) {
+        std::cerr << std::format("{} unmasking isn't available on this CPU; using {}\n", simdKernelName(kernel),
+                                 simdKernelName(bestSimdKernel()));
+        kernel = bestSimdKernel();
+    }
+    m_kernel = kernel;
+#ifdef SIMD_X86
+    if (kernel == Kernel::Avx2) m_apply = maskAvx2;
+    else if (kernel == Kernel::Sse2) m_apply = maskSse2;
+#endif
+}
+
+void WebSocketMasker::apply(char* dst, const char* src, std::size_t size, Key key, std::size_t offset) const
+{
+    uint8_t rotated[4];
+    for (std::size_t i = 0; i < 4; ++i) rotated[i] = key[(offset + i) & 3];
+    uint32_t pattern;
+    std::memcpy(&pattern, rotated, sizeof(pattern));
+    m_apply(dst, src, size, pattern);
+}
+
+std::string websocketAcceptKey(std::string_view clientKey)
+{
+    std::string keyed(clientKey);
+    keyed += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    const auto digest = sha1(keyed);
+    return base64(digest.data(), digest.size());
+}
+
+std::size_t websocketHeaderSize(std::size_t size, bool masked)
+{
+    return 2 + (size < 126 ? 0 : size <= 0xFFFF ? 2 : 8) + (masked ? 4 : 0);
+}
+
+void appendWebSocketFrame(std::string& out, WebSocketOpcode opcode, std::string_view payload, bool fin,
+                          const WebSocketMasker::Key* key)
+{
+    const std::size_t start = out.size();
+    out.reserve(start + websocketHeaderSize(payload.size(), key) + payload.size());
+
+    out += char((fin ? 0x80 : 0) | (uint8_t)opcode);
+    const char maskBit = key ? char(0x80) : 0;
+    if (payload.size() < 126) {
+        out += char(maskBit | (char)payload.size());
+    } else if (payload.size() <= 0xFFFF) {
+        out += char(maskBit | 126);
+        out += char(payload.size() >> 8);
+        out += char(payload.size() & 0xFF);
+    } else {
+        out += char(maskBit | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) out += char(uint64_t(payload.size()) >> shift);
+    }
+    if (!key) {
+        out += payload;
+        return;
+    }
+
+    out.append(reinterpret_cast<const char*>(key->data()), key->size());
+    const std::size_t body = out.size();
+    out += payload;
+    static const WebSocketMasker masker;
+    masker.apply(out.data() + body, out.data() + body, payload.size(), *key);
+}
+
+std::string encodeWebSocketFrame(WebSocketOpcode opcode, std::string_view payload, bool fin)
+{
+    std::string frame;
+    appendWebSocketFrame(frame, opcode, payload, fin);
+    return frame;
+}
+
+WebSocketDecoder::WebSocketDecoder(std::size_t maxMessageSize, bool masked, WebSocketMasker::Kernel kernel)
+    : m_maxMessageSize(maxMessageSize), m_masked(masked), m_masker(kernel)
+{
+}
+
+std::size_t WebSocketDecoder::headerSize(uint8_t /*first*/, uint8_t second)
+{
+    const uint8_t length = second & 0x7F;
+    return 2 + (length == 126 ? 2 : length == 127 ? 8 : 0) + ((second & 0x80) ? 4 : 0);
+}
+
+bool WebSocketDecoder::parseHeader(const uint8_t* header)
+{
+    FrameHeader frame{};
+    frame.fin = header[0] & 0x80;
+    frame.opcode = WebSocketOpcode(header[0] & 0x0F);
+    frame.masked = header[1] & 0x80;
+    // no extensions are negotiated, so the reserved bits must be clear
+    if (header[0] & 0x70) return fail(WebSocketClose::ProtocolError);
+    if (frame.masked != m_masked) return fail(WebSocketClose::ProtocolError);
+
+    const uint8_t* pos = header + 2;
+    frame.length = header[1] & 0x7F;
+    if (frame.length == 126) {
+        frame.length = (uint64_t(pos[0]) << 8) | pos[1];
+        pos += 2;
+    } else if (frame.length == 127) {
+        frame.length = 0;
+        for (int i = 0; i < 8; ++i) frame.length = (frame.length << 8) | pos[i];
+        if (frame.length >> 63) return fail(WebSocketClose::ProtocolError);
+        pos += 8;
+    }
+    if (frame.masked) std::memcpy(frame.key.data(), pos, frame.key.size());
+
+    switch (frame.opcode) {
+    case WebSocketOpcode::Close:
+    case WebSocketOpcode::Ping:
+    case WebSocketOpcode::Pong:
+        if (!frame.fin || frame.length > 125) return fail(WebSocketClose::ProtocolError);
+        break;
+    case WebSocketOpcode::Continuation:
+        if (!m_inMessage) return fail(WebSocketClose::ProtocolError);
+        if (frame.length > m_maxMessageSize - m_message.size()) return fail(WebSocketClose::MessageTooBig);
+        break;
+    case WebSocketOpcode::Text:
+    case WebSocketOpcode::Binary:
+        // the previous message must be finished first
+        if (m_inMessage) return fail(WebSocketClose::ProtocolError);
+        if (frame.length > m_maxMessageSize) return fail(WebSocketClose::MessageTooBig);
+        m_inMessage = true;
+        m_messageOpcode = frame.opcode;
+        break;
+    default:
+        return fail(WebSocketClose::ProtocolError);
+    }
+
+    m_frame = frame;
+    m_inFrame = true;
+    m_payloadRead = 0;
+    return true;
+}
+
+bool WebSocketDecoder::consumePayload(std::string_view data, std::size_t& consumed)
+{
+    const std::size_t take = (std::size_t)std::min<uint64_t>(m_frame.length - m_payloadRead, data.size());
+    std::string& into = (uint8_t)m_frame.opcode >= 0x8 ? m_control : m_message;
+    const std::size_t at = into.size();
+    into.append(data.data(), take);
+    if (m_frame.masked) m_masker.apply(into.data() + at, into.data() + at, take, m_frame.key, (std::size_t)m_payloadRead);
+    m_payloadRead += take;
+    consumed = take;
+    return m_payloadRead == m_frame.length;
+}
+
+bool WebSocketDecoder::fail(uint16_t code)
+{
+    m_closeCode = code;
+    return false;
+}
+
+struct WebSocketServer::Session {
+    Session(const TCPConnInfo& connInfo, EventLoop& loop, const WebSocketServerOptions& options)
+        : connInfo(connInfo), loop(loop), parser(options.handshakeLimits), decoder(options.maxMessageSize)
+    {
+    }
+
+    const TCPConnInfo connInfo;
+    EventLoop& loop; // the connection's; every frame is queued from here
+    ScopedEventConnection dataConnection;
+    std::atomic<bool> open{false};      // the handshake was answered
+    // a Close frame is queued; no other frame may follow it. Only set on the loop, read anywhere for early outs.
+    std::atomic<bool> closeSent{false};
+    std::atomic<bool> closeRequested{false}; // close() was called; its Close frame may still be on the way
+
+    // only touched by the connection's event loop
+    HttpRequestParser parser;
+    WebSocketDecoder decoder;
+    std::string out;     // handshake response and control frames answering the buffer being handled
+    bool closing{false}; // the connection closes once out is sent; later input is ignored
+};
+
+WebSocketServer::WebSocketServer(TCPConnectionManager& tcpConnMgr, WebSocketServerOptions options)
+    : m_tcpConnMgr(tcpConnMgr), m_options(std::move(options)), m_sessions(tcpConnMgr),
+      m_server(
+          tcpConnMgr,
+          [this](const TCPConnInfo& connInfo, TCPConnection& tcpConn) {
+              return std::make_shared<Session>(connInfo, tcpConn.eventLoop(), m_options);
+          },
+          [this](Session& session, const RecvBuffer& buffer) { onData(session, buffer); })
+{
+}
+
+WebSocketServer::~WebSocketServer()
+{
+    m_server.stop();
+}
+
+bool WebSocketServer::start(const std::string& address, uint16_t port)
+{
+    return m_server.start(address, port, m_options.shards);
+}
+
+std::size_t WebSocketServer::sessionCount() const
+{
+    return m_sessions.size();
+}
+
+bool WebSocketServer::send(ConnHandle session, std::string_view payload, WebSocketOpcode opcode)
+{
+    const auto found = findOpen(session);
+    if (!found || found->closeRequested || found->closeSent) return false;
+    // checked again on the loop, which is where the Close frame gets queued
+    found->loop.post([this, found, frame = encodeWebSocketFrame(opcode, payload)]() mutable {
+        if (!found->closeSent) m_tcpConnMgr.write(found->connInfo, std::move(frame));
+    });
+    return true;
+}
+
+bool WebSocketServer::ping(ConnHandle session, std::string_view payload)
+{
+    return send(session, payload.substr(0, 125), WebSocketOpcode::Ping);
+}
+
+bool WebSocketServer::close(ConnHandle session, uint16_t code, std::string_view reason)
+{
+    const auto found = findOpen(session);
+    if (!found || found->closeSent || found->closeRequested.exchange(true)) return false;
+    std::string frame;
+    appendCloseFrame(frame, code, reason);
+    found->loop.post([this, found, frame = std::move(frame)]() mutable {
+        if (found->closeSent.exchange(true)) return;
+        // Broadcasts are queued by tasks on this loop too: those posted before this one went out ahead of the
+        // Close frame, and those posted after it no longer find the session.
+        m_sessions.unsubscribe(found->connInfo);
+        m_tcpConnMgr.write(found->connInfo, std::move(frame));
+    });
+    return true;
+}
+
+std::size_t WebSocketServer::broadcast(std::string_view payload, WebSocketOpcode opcode)
+{
+    return m_sessions.publish(std::make_shared<const std::string>(encodeWebSocketFrame(opcode, payload)));
+}
+
+std::shared_ptr<WebSocketServer::Session> WebSocketServer::findOpen(ConnHandle handle) const
+{
+    auto session = m_server.find(handle);
+    return session && session->open ? session : nullptr;
+}
+
+void WebSocketServer::onData(Session& session, const RecvBuffer& buffer)
+{
+    if (session.closing) return;
+
+    const bool wasOpen = session.open;
+    if (!wasOpen) {
+        bool answered = false;
+        bool early = false;
+        const bool ok = session.parser.feed(buffer.view(), [&](const HttpRequest& request) {
+            if (answered) {
+                early = true;
+                return;
+            }
+            answered = true;
+            handshake(session, request);
+        });
+        if (!answered && !ok) {
+            appendHandshakeError(session.out, session.parser.errorStatus());
+            session.closing = true;
+        } else if (session.open && (early || !ok || session.parser.pendingBytes() > 0)) {
+            // RFC 6455, section 4.1: the client sends nothing more before it has seen the 101
+            closeWith(session, WebSocketClose::ProtocolError, "data before the handshake completed");
+        }
+    } else {
+        const bool ok = session.decoder.feed(buffer.view(), [&](WebSocketOpcode opcode, std::string_view payload) {
+            if (!session.closing) onFrame(session, opcode, payload);
+        });
+        if (!ok && !session.closing) closeWith(session, session.decoder.closeCode(), {});
+    }
+
+    // broadcasts are queued from this loop too, so none can land between the unsubscribe and the write
+    if (session.closing) m_sessions.unsubscribe(session.connInfo);
+    m_server.flush(session);
+    if (!session.closing && !wasOpen && session.open) {
+        // after the 101 is queued, so frames the slot sends follow it
+        sessionOpened(session.connInfo);
+    }
+}
+
+void WebSocketServer::handshake(Session& session, const HttpRequest& request)
+{
+    auto reject = [&](int status, std::string_view extraHeader = {}) {
+        appendHandshakeError(session.out, status, extraHeader);
+        session.closing = true;
+    };
+
+    if (request.method != "GET" || request.minorVersion < 1) return reject(400);
+    if (!m_options.path.empty() && request.path != m_options.path) return reject(404);
+    if (!httpHasToken(request.header("Upgrade"), "websocket") || !httpHasToken(request.header("Connection"), "upgrade")) {
+        return reject(426, "Upgrade: websocket");
+    }
+    if (request.header("Sec-WebSocket-Version") != "13") return reject(426, "Sec-WebSocket-Version: 13");
+    const std::string_view key = request.header("Sec-WebSocket-Key");
+    if (!validClientKey(key)) return reject(400);
+
+    session.out += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: ";
+    session.out += websocketAcceptKey(key);
+    session.out += "\r\n\r\n";
+    session.open = true;
+    m_sessions.subscribe(session.connInfo);
+}
+
+void WebSocketServer::onFrame(Session& session, WebSocketOpcode opcode, std::string_view payload)
+{
+    switch (opcode) {
+    case WebSocketOpcode::Ping:
+        if (!session.closeSent) appendWebSocketFrame(session.out, WebSocketOpcode::Pong, payload);
+        break;
+    case WebSocketOpcode::Pong:
+        pongArrived(session.connInfo, payload);
+        break;
+    case WebSocketOpcode::Close:
+        // a code is two bytes; one byte alone is malformed
+        if (payload.size() == 1) return closeWith(session, WebSocketClose::ProtocolError, {});
+        if (session.closeSent.exchange(true)) {
+            // the answer to our Close
+            session.closing = true;
+            return;
+        }
+        // echo the code, as RFC 6455 section 5.5.1 suggests
+        if (payload.empty()) appendWebSocketFrame(session.out, WebSocketOpcode::Close, {});
+        else appendCloseFrame(session.out, uint16_t((uint8_t(payload[0]) << 8) | uint8_t(payload[1])), {});
+        session.closing = true;
+        break;
+    default:
+        messageArrived(session.connInfo, opcode, payload);
+        break;
+    }
+}
+
+void WebSocketServer::closeWith(Session& session, uint16_t code, std::string_view reason)
+{
+    if (!session.closeSent.exchange(true)) appendCloseFrame(session.out, code, reason);
+    session.closing = true;
+}